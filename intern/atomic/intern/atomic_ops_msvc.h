@@ -72,6 +72,17 @@ ATOMIC_INLINE uint64_t atomic_fetch_and_sub_uint64(uint64_t *p, uint64_t x)
   return InterlockedExchangeAdd64((int64_t *)p, -((int64_t)x));
 }
 
+/* Volatile accesses are not ordered on ARM, use full barriers instead. */
+ATOMIC_INLINE uint64_t atomic_load_uint64(const uint64_t *v)
+{
+  return InterlockedCompareExchange64((int64_t *)v, 0, 0);
+}
+
+ATOMIC_INLINE void atomic_store_uint64(uint64_t *p, uint64_t v)
+{
+  InterlockedExchange64((int64_t *)p, (int64_t)v);
+}
+
 /* Signed */
 ATOMIC_INLINE int64_t atomic_add_and_fetch_int64(int64_t *p, int64_t x)
 {
@@ -116,6 +127,16 @@ ATOMIC_INLINE uint32_t atomic_cas_uint32(uint32_t *v, uint32_t old, uint32_t _ne
   return InterlockedCompareExchange((long *)v, _new, old);
 }
 
+ATOMIC_INLINE uint32_t atomic_load_uint32(const uint32_t *v)
+{
+  return InterlockedCompareExchange((long *)v, 0, 0);
+}
+
+ATOMIC_INLINE void atomic_store_uint32(uint32_t *p, uint32_t v)
+{
+  InterlockedExchange((long *)p, (long)v);
+}
+
 ATOMIC_INLINE uint32_t atomic_fetch_and_add_uint32(uint32_t *p, uint32_t x)
 {
   return InterlockedExchangeAdd(p, x);
@@ -311,6 +311,16 @@ ATOMIC_LOCKING_CAS_DEFINE(int64)
 
 #endif
 
+ATOMIC_INLINE uint64_t atomic_load_uint64(const uint64_t *v)
+{
+  return __atomic_load_n(v, __ATOMIC_ACQUIRE);
+}
+
+ATOMIC_INLINE void atomic_store_uint64(uint64_t *p, uint64_t v)
+{
+  __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
 /** \} */
 
 /* -------------------------------------------------------------------- */
@@ -427,6 +437,16 @@ ATOMIC_LOCKING_CAS_DEFINE(int32)
 
 #endif
 
+ATOMIC_INLINE uint32_t atomic_load_uint32(const uint32_t *v)
+{
+  return __atomic_load_n(v, __ATOMIC_ACQUIRE);
+}
+
+ATOMIC_INLINE void atomic_store_uint32(uint32_t *p, uint32_t v)
+{
+  __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
 #if !defined(ATOMIC_FORCE_USE_FALLBACK) && \
     (defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_4) || defined(JE_FORCE_SYNC_COMPARE_AND_SWAP_4))
 /* Unsigned */
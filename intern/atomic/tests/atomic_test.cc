@@ -114,6 +114,16 @@ TEST(atomic, atomic_fetch_and_sub_uint64)
   }
 }
 
+TEST(atomic, atomic_load_store_uint64)
+{
+  {
+    uint64_t value = 0x1234567890abcdef;
+    EXPECT_EQ(atomic_load_uint64(&value), 0x1234567890abcdef);
+    atomic_store_uint64(&value, 0xfedcba0987654321);
+    EXPECT_EQ(value, 0xfedcba0987654321);
+  }
+}
+
 TEST(atomic, atomic_cas_uint64)
 {
   {
@@ -331,6 +341,16 @@ TEST(atomic, atomic_sub_and_fetch_uint32)
   }
 }
 
+TEST(atomic, atomic_load_store_uint32)
+{
+  {
+    uint32_t value = 0x12345678;
+    EXPECT_EQ(atomic_load_uint32(&value), 0x12345678);
+    atomic_store_uint32(&value, 0x87654321);
+    EXPECT_EQ(value, 0x87654321);
+  }
+}
+
 TEST(atomic, atomic_cas_uint32)
 {
   {
@@ -881,6 +901,16 @@ TEST(atomic, atomic_cas_ptr)
   }
 }
 
+TEST(atomic, atomic_load_store_ptr)
+{
+  {
+    void *value = INT_AS_PTR(0x7f);
+    EXPECT_EQ(atomic_load_ptr(&value), INT_AS_PTR(0x7f));
+    atomic_store_ptr(&value, INT_AS_PTR(0xef));
+    EXPECT_EQ(value, INT_AS_PTR(0xef));
+  }
+}
+
 #undef INT_AS_PTR
 
 /** \} */
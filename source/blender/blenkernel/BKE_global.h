@@ -78,6 +78,7 @@ typedef struct Global {
    *   *   1112: Disable new Cloth internal springs handling (09/2014).
    *   *   1234: Disable new dyntopo code fixing skinny faces generation (04/2015).
    *   *   3001: Enable additional Fluid modifier (Mantaflow) options (02/2020).
+   *   *   3200: Disable multi-threaded DNA conversion when reading blend files (10/2026).
    *   *   4000: Line Art state output and debugging logs (03/2021).
    *   * 16384 and above: Reserved for python (add-ons) usage.
    */
@@ -193,6 +194,23 @@ enum {
    * As users/developers may not want their paths exposed in publicly distributed files.
    */
   G_FILE_RECOVER_WRITE = (1 << 24),
+  /**
+   * On read, leave the contents of large packed files in the blend-file
+   * until they are accessed, see #BKE_packedfile_data_ensure.
+   */
+  G_FILE_LAZY_PACKED_READ = (1 << 25),
+  /**
+   * On write, store identical data blocks only once.
+   * Versions before file version 300.26 don't support #DDUP blocks, such files raise their
+   * minimum version so that these versions report the missing data.
+   */
+  G_FILE_DEDUPLICATE = (1 << 29),
+  /**
+   * On write, when the file was written before by this session, only append the IDs that
+   * changed since. Versions before file version 300.26 don't support #SKIP blocks, such files
+   * raise their minimum version like with #G_FILE_DEDUPLICATE.
+   */
+  G_FILE_SAVE_INCREMENTAL = (1 << 30),
   /** BMesh option to save as older mesh format */
   /* #define G_FILE_MESH_COMPAT       (1 << 26) */
   /* #define G_FILE_GLSL_NO_ENV_LIGHTING (1 << 28) */ /* deprecated */
@@ -202,7 +220,9 @@ enum {
  * Run-time only #G.fileflags which are never read or written to/from Blend files.
  * This means we can change the values without worrying about do-versions.
  */
-#define G_FILE_FLAG_ALL_RUNTIME (G_FILE_NO_UI | G_FILE_RECOVER_READ | G_FILE_RECOVER_WRITE)
+#define G_FILE_FLAG_ALL_RUNTIME \
+  (G_FILE_NO_UI | G_FILE_RECOVER_READ | G_FILE_RECOVER_WRITE | G_FILE_LAZY_PACKED_READ | \
+   G_FILE_DEDUPLICATE | G_FILE_SAVE_INCREMENTAL)
 
 /** #Global.moving, signals drawing in (3d) window to denote transform */
 enum {
@@ -22,6 +22,8 @@
  * \ingroup bke
  */
 
+#include "BLI_sys_types.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -116,6 +118,12 @@ enum ePF_FileCompare BKE_packedfile_compare_to_file(const char *ref_file_name,
                                                     const char *filename,
                                                     struct PackedFile *pf);
 
+/* deferred reading */
+bool BKE_packedfile_data_defer(struct PackedFile *pf,
+                               const char *filepath,
+                               int64_t file_offset);
+bool BKE_packedfile_data_ensure(struct PackedFile *pf);
+
 /* read */
 int BKE_packedfile_seek(struct PackedFile *pf, int offset, int whence);
 void BKE_packedfile_rewind(struct PackedFile *pf);
@@ -33,6 +33,8 @@
 #include "MEM_guardedalloc.h"
 #include <string.h>
 
+#include "atomic_ops.h"
+
 #include "DNA_ID.h"
 #include "DNA_image_types.h"
 #include "DNA_packedFile_types.h"
@@ -41,6 +43,8 @@
 #include "DNA_volume_types.h"
 
 #include "BLI_blenlib.h"
+#include "BLI_ghash.h"
+#include "BLI_threads.h"
 #include "BLI_utildefines.h"
 
 #include "BKE_font.h"
@@ -56,6 +60,135 @@
 
 #include "BLO_read_write.h"
 
+/* -------------------------------------------------------------------- */
+/** \name Deferred Packed Data
+ *
+ * When reading blend-files with #G_FILE_LAZY_PACKED_READ, the contents of packed files are
+ * left in the blend-file and only read on first access, see #BKE_packedfile_data_ensure.
+ * Until then #PackedFile.data is NULL and the location of the data is stored here.
+ * \{ */
+
+typedef struct PackedFileDeferred {
+  char filepath[FILE_MAX];
+  int64_t file_offset;
+  /** Used to detect the blend-file was changed on disk after reading it. */
+  int64_t file_size;
+  int64_t file_mtime;
+} PackedFileDeferred;
+
+/** Maps #PackedFile pointers to #PackedFileDeferred. */
+static GHash *g_packedfile_deferred = NULL;
+static ThreadMutex g_packedfile_deferred_mutex = BLI_MUTEX_INITIALIZER;
+
+/** Takes ownership of \a deferred. */
+static void packedfile_data_deferred_insert(PackedFile *pf, PackedFileDeferred *deferred)
+{
+  BLI_mutex_lock(&g_packedfile_deferred_mutex);
+  if (g_packedfile_deferred == NULL) {
+    g_packedfile_deferred = BLI_ghash_ptr_new(__func__);
+  }
+  BLI_ghash_insert(g_packedfile_deferred, pf, deferred);
+  BLI_mutex_unlock(&g_packedfile_deferred_mutex);
+}
+
+/**
+ * Store where the contents of \a pf can be read from, instead of reading them now.
+ * \return false when the file can't be used for deferred reading, the data must be read then.
+ */
+bool BKE_packedfile_data_defer(PackedFile *pf, const char *filepath, int64_t file_offset)
+{
+  BLI_assert(pf->data == NULL);
+
+  BLI_stat_t st;
+  if (BLI_stat(filepath, &st) != 0) {
+    return false;
+  }
+
+  PackedFileDeferred *deferred = MEM_mallocN(sizeof(*deferred), __func__);
+  BLI_strncpy(deferred->filepath, filepath, sizeof(deferred->filepath));
+  deferred->file_offset = file_offset;
+  deferred->file_size = (int64_t)st.st_size;
+  deferred->file_mtime = (int64_t)st.st_mtime;
+
+  packedfile_data_deferred_insert(pf, deferred);
+  return true;
+}
+
+static bool packedfile_deferred_read(const PackedFileDeferred *deferred, PackedFile *pf)
+{
+  BLI_stat_t st;
+  if (BLI_stat(deferred->filepath, &st) != 0 || (int64_t)st.st_size != deferred->file_size ||
+      (int64_t)st.st_mtime != deferred->file_mtime) {
+    printf("%s: blend-file '%s' changed since it was read, packed data is lost\n",
+           __func__,
+           deferred->filepath);
+    return false;
+  }
+
+  const int file = BLI_open(deferred->filepath, O_BINARY | O_RDONLY, 0);
+  if (file == -1) {
+    return false;
+  }
+
+  bool success = false;
+  void *data = MEM_mallocN((size_t)pf->size, "packFile");
+  if (BLI_lseek(file, deferred->file_offset, SEEK_SET) == deferred->file_offset &&
+      read(file, data, (size_t)pf->size) == pf->size) {
+    /* Pairs with the load in #BKE_packedfile_data_ensure, which doesn't lock. */
+    atomic_store_ptr(&pf->data, data);
+    success = true;
+  }
+  else {
+    MEM_freeN(data);
+  }
+  close(file);
+  return success;
+}
+
+/**
+ * Make sure the contents of \a pf are in memory, reading them from the blend-file they were
+ * deferred from if needed. Must be called before accessing #PackedFile.data.
+ *
+ * \return false when the data could not be read.
+ */
+bool BKE_packedfile_data_ensure(PackedFile *pf)
+{
+  if (atomic_load_ptr(&pf->data) != NULL) {
+    return true;
+  }
+
+  BLI_mutex_lock(&g_packedfile_deferred_mutex);
+  /* Check again, another thread may have read it in the meantime. */
+  bool success = pf->data != NULL;
+  if (!success && g_packedfile_deferred != NULL) {
+    PackedFileDeferred *deferred = BLI_ghash_lookup(g_packedfile_deferred, pf);
+    if (deferred != NULL) {
+      success = packedfile_deferred_read(deferred, pf);
+      if (success) {
+        BLI_ghash_remove(g_packedfile_deferred, pf, NULL, MEM_freeN);
+      }
+    }
+  }
+  BLI_mutex_unlock(&g_packedfile_deferred_mutex);
+
+  return success;
+}
+
+static void packedfile_data_deferred_remove(PackedFile *pf)
+{
+  BLI_mutex_lock(&g_packedfile_deferred_mutex);
+  if (g_packedfile_deferred != NULL) {
+    BLI_ghash_remove(g_packedfile_deferred, pf, NULL, MEM_freeN);
+    if (BLI_ghash_len(g_packedfile_deferred) == 0) {
+      BLI_ghash_free(g_packedfile_deferred, NULL, NULL);
+      g_packedfile_deferred = NULL;
+    }
+  }
+  BLI_mutex_unlock(&g_packedfile_deferred_mutex);
+}
+
+/** \} */
+
 int BKE_packedfile_seek(PackedFile *pf, int offset, int whence)
 {
   int oldseek = -1, seek = 0;
@@ -95,7 +228,7 @@ void BKE_packedfile_rewind(PackedFile *pf)
 
 int BKE_packedfile_read(PackedFile *pf, void *data, int size)
 {
-  if ((pf != NULL) && (size >= 0) && (data != NULL)) {
+  if ((pf != NULL) && (size >= 0) && (data != NULL) && BKE_packedfile_data_ensure(pf)) {
     if (size + pf->seek > pf->size) {
       size = pf->size - pf->seek;
     }
@@ -155,7 +288,9 @@ int BKE_packedfile_count_all(Main *bmain)
 void BKE_packedfile_free(PackedFile *pf)
 {
   if (pf) {
-    BLI_assert(pf->data != NULL);
+    if (pf->data == NULL) {
+      packedfile_data_deferred_remove(pf);
+    }
 
     MEM_SAFE_FREE(pf->data);
     MEM_freeN(pf);
@@ -168,6 +303,8 @@ void BKE_packedfile_free(PackedFile *pf)
 PackedFile *BKE_packedfile_duplicate(const PackedFile *pf_src)
 {
   BLI_assert(pf_src != NULL);
+  /* Reading deferred data does not change the packed file as far as callers are concerned. */
+  BKE_packedfile_data_ensure((PackedFile *)pf_src);
   BLI_assert(pf_src->data != NULL);
 
   PackedFile *pf_dst;
@@ -339,7 +476,7 @@ int BKE_packedfile_write_to_file(ReportList *reports,
     ret_value = RET_ERROR;
   }
   else {
-    if (write(file, pf->data, pf->size) != pf->size) {
+    if (!BKE_packedfile_data_ensure(pf) || write(file, pf->data, pf->size) != pf->size) {
       BKE_reportf(reports, RPT_ERROR, "Error writing file '%s'", name);
       ret_value = RET_ERROR;
     }
@@ -399,6 +536,9 @@ enum ePF_FileCompare BKE_packedfile_compare_to_file(const char *ref_file_name,
   else if (st.st_size != pf->size) {
     ret_val = PF_CMP_DIFFERS;
   }
+  else if (!BKE_packedfile_data_ensure(pf)) {
+    ret_val = PF_CMP_DIFFERS;
+  }
   else {
     /* we'll have to compare the two... */
 
@@ -534,7 +674,8 @@ static void unpack_generate_paths(const char *name,
     /* For images we can add the file extension based on the file magic. */
     if (id_type == ID_IM) {
       ImagePackedFile *imapf = ((Image *)id)->packedfiles.last;
-      if (imapf != NULL && imapf->packedfile != NULL) {
+      if (imapf != NULL && imapf->packedfile != NULL &&
+          BKE_packedfile_data_ensure(imapf->packedfile)) {
         const PackedFile *pf = imapf->packedfile;
         enum eImbFileType ftype = IMB_ispic_type_from_memory((const uchar *)pf->data, pf->size);
         if (ftype != IMB_FTYPE_NONE) {
@@ -876,11 +1017,42 @@ void BKE_packedfile_id_unpack(Main *bmain, ID *id, ReportList *reports, enum ePF
   }
 }
 
+/**
+ * Undo steps only store where deferred contents are in the blend-file, instead of reading them.
+ * \return false when the contents of \a pf are not deferred.
+ */
+static bool packedfile_blend_write_deferred(BlendWriter *writer, PackedFile *pf)
+{
+  if (!BLO_write_is_undo(writer) || atomic_load_ptr(&pf->data) != NULL) {
+    return false;
+  }
+
+  /* Lock while writing, so that another thread reading the contents can't free the location. */
+  BLI_mutex_lock(&g_packedfile_deferred_mutex);
+  PackedFileDeferred *deferred = (g_packedfile_deferred != NULL) ?
+                                     BLI_ghash_lookup(g_packedfile_deferred, pf) :
+                                     NULL;
+  if (deferred != NULL) {
+    PackedFile pf_deferred = *pf;
+    pf_deferred.flag |= PF_FLAG_DATA_DEFERRED;
+    pf_deferred.data = deferred;
+    BLO_write_struct_at_address(writer, PackedFile, pf, &pf_deferred);
+    BLO_write_raw(writer, sizeof(*deferred), deferred);
+  }
+  BLI_mutex_unlock(&g_packedfile_deferred_mutex);
+
+  return deferred != NULL;
+}
+
 void BKE_packedfile_blend_write(BlendWriter *writer, PackedFile *pf)
 {
   if (pf == NULL) {
     return;
   }
+  if (packedfile_blend_write_deferred(writer, pf)) {
+    return;
+  }
+  BKE_packedfile_data_ensure(pf);
   BLO_write_struct(writer, PackedFile, pf);
   BLO_write_raw(writer, pf->size, pf->data);
 }
@@ -893,6 +1065,31 @@ void BKE_packedfile_blend_read(BlendDataReader *reader, PackedFile **pf_p)
     return;
   }
 
+  if (pf->flag & PF_FLAG_DATA_DEFERRED) {
+    /* Written by #packedfile_blend_write_deferred, for undo or when the undo memfile is saved
+     * for recovery. */
+    pf->flag &= ~PF_FLAG_DATA_DEFERRED;
+    PackedFileDeferred *deferred = pf->data;
+    pf->data = NULL;
+    BLO_read_data_address(reader, &deferred);
+    if (deferred != NULL) {
+      packedfile_data_deferred_insert(pf, deferred);
+      return;
+    }
+  }
+
+  /* Leave large contents in the file, when requested. */
+  const char *filepath;
+  int64_t file_offset;
+  if (BLO_read_data_file_location(reader, pf->data, &filepath, &file_offset)) {
+    const void *data_old = pf->data;
+    pf->data = NULL;
+    if (BKE_packedfile_data_defer(pf, filepath, file_offset)) {
+      return;
+    }
+    pf->data = (void *)data_old;
+  }
+
   BLO_read_packed_address(reader, &pf->data);
   if (pf->data == NULL) {
     /* We cannot allow a PackedFile with a NULL data field,
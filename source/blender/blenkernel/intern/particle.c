@@ -2672,10 +2672,36 @@ void psys_find_parents(ParticleSimulationData *sim, const bool use_render_params
 
   BLI_kdtree_3d_balance(tree);
 
-  for (; p < totchild; p++, cpa++) {
-    psys_particle_on_emitter(
-        sim->psmd, from, cpa->num, DMCACHE_ISCHILD, cpa->fuv, cpa->foffset, co, 0, 0, 0, orco);
-    cpa->parent = BLI_kdtree_3d_find_nearest(tree, orco, NULL);
+  /* Find the parent of all remaining children at once. */
+  const int search_len = totchild - p;
+  if (search_len > 0) {
+    float(*search_co)[3] = MEM_malloc_arrayN((size_t)search_len, sizeof(*search_co), __func__);
+    KDTreeNearest_3d *nearest = MEM_malloc_arrayN((size_t)search_len, sizeof(*nearest), __func__);
+    ChildParticle *cpa_search = cpa;
+
+    for (int i = 0; i < search_len; i++, cpa++) {
+      psys_particle_on_emitter(sim->psmd,
+                               from,
+                               cpa->num,
+                               DMCACHE_ISCHILD,
+                               cpa->fuv,
+                               cpa->foffset,
+                               co,
+                               0,
+                               0,
+                               0,
+                               search_co[i]);
+    }
+
+    BLI_kdtree_3d_find_nearest_batch(
+        tree, (const float(*)[3])search_co, (uint)search_len, nearest);
+
+    for (int i = 0; i < search_len; i++) {
+      cpa_search[i].parent = nearest[i].index;
+    }
+
+    MEM_freeN(search_co);
+    MEM_freeN(nearest);
   }
 
   BLI_kdtree_3d_free(tree);
@@ -28,6 +28,8 @@
 #include "BLI_array.hh"
 #include "BLI_math_base.h"
 #include "BLI_memory_utils.hh"
+#include "BLI_probing_strategies.hh"
+#include "BLI_simd.h"
 #include "BLI_string.h"
 #include "BLI_string_ref.hh"
 #include "BLI_utildefines.h"
@@ -258,6 +260,144 @@ template<typename Pointer> struct PointerKeyInfo {
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name Control Bytes
+ *
+ * Hash tables using the #GroupProbingStrategy store a control byte for every slot next to the
+ * slot array. The control byte of an occupied slot contains seven bits of the hash of its key, the
+ * other values indicate that a slot is empty or removed. The hash table has to keep them in sync
+ * with the state of the slots.
+ *
+ * With other probing strategies, #HashTableControlBytes is empty and all its methods do nothing,
+ * so that hash tables can use it unconditionally.
+ *
+ * \{ */
+
+template<typename ProbingStrategy, int64_t InlineBufferCapacity, typename Allocator>
+class HashTableControlBytes {
+ public:
+  HashTableControlBytes(Allocator UNUSED(allocator) = {}) noexcept
+  {
+  }
+
+  explicit HashTableControlBytes(const int64_t UNUSED(total_slots),
+                                 Allocator UNUSED(allocator) = {})
+  {
+  }
+
+  void reinitialize(const int64_t UNUSED(total_slots))
+  {
+  }
+
+  uint8_t hash_to_control_byte(const uint64_t UNUSED(hash)) const
+  {
+    return 0;
+  }
+
+  void set_occupied(const int64_t UNUSED(index), const uint64_t UNUSED(hash))
+  {
+  }
+
+  void set_removed(const int64_t UNUSED(index))
+  {
+  }
+
+  int64_t size_in_bytes() const
+  {
+    return 0;
+  }
+};
+
+template<int64_t InlineBufferCapacity, typename Allocator>
+class HashTableControlBytes<GroupProbingStrategy, InlineBufferCapacity, Allocator> {
+ private:
+  static constexpr int64_t group_size = GroupProbingStrategy::group_size;
+  static constexpr uint8_t empty_byte = 0x80;
+  static constexpr uint8_t removed_byte = 0xfe;
+
+  /**
+   * Contains at least one group, even when there are fewer slots. The bytes after the last slot
+   * are marked as removed, so that they are never probed.
+   */
+  Array<uint8_t, std::max(InlineBufferCapacity, group_size), Allocator> bytes_;
+
+ public:
+  /**
+   * Control bytes for the single empty slot of a hash table that has not been grown yet.
+   */
+  HashTableControlBytes(Allocator allocator = {}) noexcept
+      : bytes_(group_size, removed_byte, allocator)
+  {
+    bytes_[0] = empty_byte;
+  }
+
+  explicit HashTableControlBytes(const int64_t total_slots, Allocator allocator = {})
+      : bytes_(NoExceptConstructor(), allocator)
+  {
+    this->reinitialize(total_slots);
+  }
+
+  /**
+   * Mark all slots as empty.
+   */
+  void reinitialize(const int64_t total_slots)
+  {
+    BLI_assert(total_slots >= 1);
+    bytes_.reinitialize(std::max(total_slots, group_size));
+    std::fill_n(bytes_.data(), total_slots, empty_byte);
+    std::fill(bytes_.begin() + total_slots, bytes_.end(), removed_byte);
+  }
+
+  uint8_t hash_to_control_byte(const uint64_t hash) const
+  {
+    /* Use the high bits of a remixed hash. The low bits are used to find the group already and
+     * many hash functions put little information into the high bits. */
+    return static_cast<uint8_t>((hash * 0x9e3779b97f4a7c15ull) >> 57);
+  }
+
+  void set_occupied(const int64_t index, const uint64_t hash)
+  {
+    bytes_[index] = this->hash_to_control_byte(hash);
+  }
+
+  void set_removed(const int64_t index)
+  {
+    bytes_[index] = removed_byte;
+  }
+
+  /**
+   * Get a bit mask of the slots in the group starting at \a group_start that might contain a key
+   * with the given control byte, followed by the first empty slot of the group. Slots are always
+   * occupied in order within a group, so keys are never stored after the first empty slot.
+   */
+  uint32_t find_candidates(const int64_t group_start, const uint8_t control_byte) const
+  {
+    const uint8_t *group = bytes_.data() + group_start;
+#ifdef BLI_HAVE_SSE2
+    const __m128i group_bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+    const uint32_t matches = static_cast<uint32_t>(_mm_movemask_epi8(
+        _mm_cmpeq_epi8(group_bytes, _mm_set1_epi8(static_cast<char>(control_byte)))));
+    const uint32_t empty = static_cast<uint32_t>(_mm_movemask_epi8(
+        _mm_cmpeq_epi8(group_bytes, _mm_set1_epi8(static_cast<char>(empty_byte)))));
+#else
+    uint32_t matches = 0;
+    uint32_t empty = 0;
+    for (int64_t i = 0; i < group_size; i++) {
+      matches |= static_cast<uint32_t>(group[i] == control_byte) << i;
+      empty |= static_cast<uint32_t>(group[i] == empty_byte) << i;
+    }
+#endif
+    return matches | (empty & (0u - empty));
+  }
+
+  int64_t size_in_bytes() const
+  {
+    return bytes_.size();
+  }
+};
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name Hash Table Stats
  *
@@ -102,6 +102,11 @@ enum {
   BVH_RAYCAST_WATERTIGHT = (1 << 0),
 };
 #define BVH_RAYCAST_DEFAULT (BVH_RAYCAST_WATERTIGHT)
+enum {
+  /* Split nodes with a binned surface area heuristic instead of the median of the largest axis.
+   * Slower to build, faster queries for unevenly distributed or sized primitives. */
+  BVH_BUILD_SAH = (1 << 0),
+};
 #define BVH_RAYCAST_DIST_MAX (FLT_MAX / 2.0f)
 
 /* callback must update nearest in case it finds a nearest result */
@@ -143,6 +148,7 @@ typedef bool (*BVHTree_WalkOrderCallback)(const BVHTreeAxisRange *bounds,
                                           void *userdata);
 
 BVHTree *BLI_bvhtree_new(int maxsize, float epsilon, char tree_type, char axis);
+BVHTree *BLI_bvhtree_new_ex(int maxsize, float epsilon, char tree_type, char axis, int flag);
 void BLI_bvhtree_free(BVHTree *tree);
 
 /* construct: first insert points, then call balance */
@@ -233,6 +239,16 @@ void BLI_bvhtree_ray_cast_all(BVHTree *tree,
                               BVHTree_RayCastCallback callback,
                               void *userdata);
 
+void BLI_bvhtree_ray_cast_batch(BVHTree *tree,
+                                const float (*co)[3],
+                                const float (*dir)[3],
+                                const int rays_num,
+                                float radius,
+                                BVHTreeRayHit *hits,
+                                BVHTree_RayCastCallback callback,
+                                void *userdata,
+                                int flag);
+
 float BLI_bvhtree_bb_raycast(const float bv[6],
                              const float light_start[3],
                              const float light_end[3],
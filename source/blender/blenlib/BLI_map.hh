@@ -46,6 +46,8 @@
  * - The hash function can be customized. See BLI_hash.hh for details.
  * - The probing strategy can be customized. See BLI_probing_strategies.hh for details.
  * - The slot type can be customized. See BLI_map_slots.hh for details.
+ * - The #GroupProbingStrategy can be faster when keys are expensive to compare or many lookups
+ *   fail. It stores an additional control byte per slot, so that most slots are not accessed.
  * - Small buffer optimization is enabled by default, if Key and Value are not too large.
  * - The methods `add_new` and `remove_contained` should be used instead of `add` and `remove`
  *   whenever appropriate. Assumptions and intention are described better this way.
@@ -154,6 +156,10 @@ class Map {
   LoadFactor max_load_factor_ = LoadFactor(LOAD_FACTOR);
   using SlotArray =
       Array<Slot, LoadFactor::compute_total_slots(InlineBufferCapacity, LOAD_FACTOR), Allocator>;
+  using ControlBytes = HashTableControlBytes<
+      ProbingStrategy,
+      LoadFactor::compute_total_slots(InlineBufferCapacity, LOAD_FACTOR),
+      Allocator>;
 #undef LOAD_FACTOR
 
   /**
@@ -162,11 +168,17 @@ class Map {
    */
   SlotArray slots_;
 
+  /**
+   * Only contains data when the probing strategy needs it, see #HashTableControlBytes. Takes no
+   * space in the hash table otherwise.
+   */
+  BLI_NO_UNIQUE_ADDRESS ControlBytes control_bytes_;
+
   /** Iterate over a slot index sequence for a given hash. */
 #define MAP_SLOT_PROBING_BEGIN(HASH, R_SLOT) \
-  SLOT_PROBING_BEGIN (ProbingStrategy, HASH, slot_mask_, SLOT_INDEX) \
+  CONTROL_SLOT_PROBING_BEGIN (ProbingStrategy, HASH, slot_mask_, control_bytes_, SLOT_INDEX) \
     auto &R_SLOT = slots_[SLOT_INDEX];
-#define MAP_SLOT_PROBING_END() SLOT_PROBING_END()
+#define MAP_SLOT_PROBING_END() CONTROL_SLOT_PROBING_END()
 
  public:
   /**
@@ -181,7 +193,8 @@ class Map {
         slot_mask_(0),
         hash_(),
         is_equal_(),
-        slots_(1, allocator)
+        slots_(1, allocator),
+        control_bytes_(allocator)
   {
   }
 
@@ -208,6 +221,7 @@ class Map {
         throw;
       }
     }
+    control_bytes_ = std::move(other.control_bytes_);
     removed_slots_ = other.removed_slots_;
     occupied_and_removed_slots_ = other.occupied_and_removed_slots_;
     usable_slots_ = other.usable_slots_;
@@ -344,8 +358,7 @@ class Map {
     if (slot == nullptr) {
       return false;
     }
-    slot->remove();
-    removed_slots_++;
+    this->remove_slot(*slot);
     return true;
   }
 
@@ -360,8 +373,7 @@ class Map {
   template<typename ForwardKey> void remove_contained_as(const ForwardKey &key)
   {
     Slot &slot = this->lookup_slot(key, hash_(key));
-    slot.remove();
-    removed_slots_++;
+    this->remove_slot(slot);
   }
 
   /**
@@ -376,8 +388,7 @@ class Map {
   {
     Slot &slot = this->lookup_slot(key, hash_(key));
     Value value = std::move(*slot.value());
-    slot.remove();
-    removed_slots_++;
+    this->remove_slot(slot);
     return value;
   }
 
@@ -396,8 +407,7 @@ class Map {
       return {};
     }
     std::optional<Value> value = std::move(*slot->value());
-    slot->remove();
-    removed_slots_++;
+    this->remove_slot(*slot);
     return value;
   }
 
@@ -421,8 +431,7 @@ class Map {
       return Value(std::forward<ForwardValue>(default_value)...);
     }
     Value value = std::move(*slot->value());
-    slot->remove();
-    removed_slots_++;
+    this->remove_slot(*slot);
     return value;
   }
 
@@ -897,6 +906,7 @@ class Map {
     Slot &slot = iterator.current_slot();
     BLI_assert(slot.is_occupied());
     slot.remove();
+    control_bytes_.set_removed(iterator.current_slot_);
     removed_slots_++;
   }
 
@@ -948,7 +958,7 @@ class Map {
    */
   int64_t size_per_element() const
   {
-    return sizeof(Slot);
+    return sizeof(Slot) + control_bytes_.size_in_bytes() / slots_.size();
   }
 
   /**
@@ -957,7 +967,7 @@ class Map {
    */
   int64_t size_in_bytes() const
   {
-    return static_cast<int64_t>(sizeof(Slot) * slots_.size());
+    return static_cast<int64_t>(sizeof(Slot) * slots_.size()) + control_bytes_.size_in_bytes();
   }
 
   /**
@@ -1003,6 +1013,7 @@ class Map {
     if (this->size() == 0) {
       try {
         slots_.reinitialize(total_slots);
+        control_bytes_.reinitialize(total_slots);
       }
       catch (...) {
         this->noexcept_reset();
@@ -1016,15 +1027,17 @@ class Map {
     }
 
     SlotArray new_slots(total_slots);
+    ControlBytes new_control_bytes(total_slots);
 
     try {
       for (Slot &slot : slots_) {
         if (slot.is_occupied()) {
-          this->add_after_grow(slot, new_slots, new_slot_mask);
+          this->add_after_grow(slot, new_slots, new_control_bytes, new_slot_mask);
           slot.remove();
         }
       }
       slots_ = std::move(new_slots);
+      control_bytes_ = std::move(new_control_bytes);
     }
     catch (...) {
       this->noexcept_reset();
@@ -1037,17 +1050,29 @@ class Map {
     slot_mask_ = new_slot_mask;
   }
 
-  void add_after_grow(Slot &old_slot, SlotArray &new_slots, uint64_t new_slot_mask)
+  void add_after_grow(Slot &old_slot,
+                      SlotArray &new_slots,
+                      ControlBytes &new_control_bytes,
+                      uint64_t new_slot_mask)
   {
     uint64_t hash = old_slot.get_hash(Hash());
-    SLOT_PROBING_BEGIN (ProbingStrategy, hash, new_slot_mask, slot_index) {
+    CONTROL_SLOT_PROBING_BEGIN (
+        ProbingStrategy, hash, new_slot_mask, new_control_bytes, slot_index) {
       Slot &slot = new_slots[slot_index];
       if (slot.is_empty()) {
         slot.occupy(std::move(*old_slot.key()), hash, std::move(*old_slot.value()));
+        new_control_bytes.set_occupied(slot_index, hash);
         return;
       }
     }
-    SLOT_PROBING_END();
+    CONTROL_SLOT_PROBING_END();
+  }
+
+  void remove_slot(Slot &slot)
+  {
+    slot.remove();
+    control_bytes_.set_removed(&slot - slots_.data());
+    removed_slots_++;
   }
 
   void noexcept_reset() noexcept
@@ -1067,6 +1092,7 @@ class Map {
     MAP_SLOT_PROBING_BEGIN (hash, slot) {
       if (slot.is_empty()) {
         slot.occupy(std::forward<ForwardKey>(key), hash, std::forward<ForwardValue>(value)...);
+        control_bytes_.set_occupied(SLOT_INDEX, hash);
         occupied_and_removed_slots_++;
         return;
       }
@@ -1082,6 +1108,7 @@ class Map {
     MAP_SLOT_PROBING_BEGIN (hash, slot) {
       if (slot.is_empty()) {
         slot.occupy(std::forward<ForwardKey>(key), hash, std::forward<ForwardValue>(value)...);
+        control_bytes_.set_occupied(SLOT_INDEX, hash);
         occupied_and_removed_slots_++;
         return true;
       }
@@ -1111,12 +1138,14 @@ class Map {
         if constexpr (std::is_void_v<CreateReturnT>) {
           create_value(value_ptr);
           slot.occupy_no_value(std::forward<ForwardKey>(key), hash);
+          control_bytes_.set_occupied(SLOT_INDEX, hash);
           occupied_and_removed_slots_++;
           return;
         }
         else {
           auto &&return_value = create_value(value_ptr);
           slot.occupy_no_value(std::forward<ForwardKey>(key), hash);
+          control_bytes_.set_occupied(SLOT_INDEX, hash);
           occupied_and_removed_slots_++;
           return return_value;
         }
@@ -1137,6 +1166,7 @@ class Map {
     MAP_SLOT_PROBING_BEGIN (hash, slot) {
       if (slot.is_empty()) {
         slot.occupy(std::forward<ForwardKey>(key), hash, create_value());
+        control_bytes_.set_occupied(SLOT_INDEX, hash);
         occupied_and_removed_slots_++;
         return *slot.value();
       }
@@ -1155,6 +1185,7 @@ class Map {
     MAP_SLOT_PROBING_BEGIN (hash, slot) {
       if (slot.is_empty()) {
         slot.occupy(std::forward<ForwardKey>(key), hash, std::forward<ForwardValue>(value)...);
+        control_bytes_.set_occupied(SLOT_INDEX, hash);
         occupied_and_removed_slots_++;
         return *slot.value();
       }
@@ -49,6 +49,12 @@ int incircle_fast(const double2 &a, const double2 &b, const double2 &c, const do
 int orient3d(const double3 &a, const double3 &b, const double3 &c, const double3 &d);
 int orient3d_fast(const double3 &a, const double3 &b, const double3 &c, const double3 &d);
 
+/* #orient3d_filter evaluates #orient3d in double arithmetic with a forward error bound
+ * (Burnikel et al.), treating the inputs as possibly rounded from exact values.
+ * It returns the exact sign if it can be certified, and 0 if the result is uncertain,
+ * in which case the caller has to fall back to an exact computation. */
+int orient3d_filter(const double3 &a, const double3 &b, const double3 &c, const double3 &d);
+
 int insphere(
     const double3 &a, const double3 &b, const double3 &c, const double3 &d, const double3 &e);
 int insphere_fast(
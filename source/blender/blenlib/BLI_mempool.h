@@ -92,6 +92,26 @@ enum {
 void BLI_mempool_iternew(BLI_mempool *pool, BLI_mempool_iter *iter) ATTR_NONNULL();
 void *BLI_mempool_iterstep(BLI_mempool_iter *iter) ATTR_WARN_UNUSED_RESULT ATTR_NONNULL();
 
+/**
+ * Thread-local allocation, to allocate and free elements of one pool from multiple threads.
+ * Each thread uses its own #BLI_mempool_tls, e.g. created lazily in the user data chunk of
+ * #BLI_task_parallel_range and destroyed in #TaskParallelSettings.func_free.
+ *
+ * While any #BLI_mempool_tls of a pool exists, the pool must only be accessed through them.
+ * #BLI_mempool_len, iteration and the other pool functions are valid again
+ * once they have all been destroyed.
+ */
+typedef struct BLI_mempool_tls BLI_mempool_tls;
+
+BLI_mempool_tls *BLI_mempool_tls_create(BLI_mempool *pool)
+    ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_RETURNS_NONNULL ATTR_NONNULL(1);
+void *BLI_mempool_tls_alloc(BLI_mempool_tls *tls)
+    ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_RETURNS_NONNULL ATTR_NONNULL(1);
+void *BLI_mempool_tls_calloc(BLI_mempool_tls *tls)
+    ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_RETURNS_NONNULL ATTR_NONNULL(1);
+void BLI_mempool_tls_free(BLI_mempool_tls *tls, void *addr) ATTR_NONNULL(1, 2);
+void BLI_mempool_tls_destroy(BLI_mempool_tls *tls) ATTR_NONNULL(1);
+
 #ifdef __cplusplus
 }
 #endif
@@ -38,7 +38,8 @@
  * This is necessary for correctness. If this is not the case, empty slots might not be found.
  *
  * The SLOT_PROBING_BEGIN and SLOT_PROBING_END macros can be used to implement a loop that iterates
- * over a probing sequence.
+ * over a probing sequence. Hash tables that support the #GroupProbingStrategy use the
+ * CONTROL_SLOT_PROBING_BEGIN and CONTROL_SLOT_PROBING_END macros instead.
  *
  * Probing strategies can be evaluated with many different criteria. Different use cases often
  * have different optimal strategies. Examples:
@@ -53,7 +54,9 @@
  *   probing might work best.
  */
 
+#include "BLI_math_bits.h"
 #include "BLI_sys_types.h"
+#include "BLI_utildefines.h"
 
 namespace blender {
 
@@ -207,11 +210,127 @@ template<uint64_t LinearSteps = 2, bool PreShuffle = false> class ShuffleProbing
   }
 };
 
+/**
+ * Probes groups of #group_size consecutive slots instead of individual slots, similar to the
+ * "Swiss tables" in Abseil. The values in the sequence are group indices.
+ *
+ * A hash table using this strategy stores a control byte for every slot in #HashTableControlBytes.
+ * It contains seven bits of the hash of the key in an occupied slot, or a special value for empty
+ * and removed slots. The control bytes of an entire group are compared to the hash at once using
+ * SSE2, so that usually only the slot that actually contains the key has to be accessed. This
+ * avoids most comparisons of keys that are expensive to compare (like strings), and looking up a
+ * key that is not in the hash table rarely has to access any slot at all. The cost is an
+ * additional byte per slot. When the first probed slot usually contains the key already (e.g.
+ * with well distributed integer keys), reading the control bytes is an additional cache miss in
+ * very large hash tables, so the default strategy is faster there.
+ *
+ * Groups are probed in the same order as slots are probed by the #PythonProbingStrategy.
+ */
+class GroupProbingStrategy {
+ private:
+  uint64_t hash_;
+  uint64_t perturb_;
+
+ public:
+  static constexpr int64_t group_size = 16;
+
+  GroupProbingStrategy(const uint64_t hash) : hash_(hash), perturb_(hash)
+  {
+  }
+
+  void next()
+  {
+    perturb_ >>= 5;
+    hash_ = 5 * hash_ + 1 + perturb_;
+  }
+
+  uint64_t get() const
+  {
+    return hash_;
+  }
+
+  int64_t linear_steps() const
+  {
+    return 1;
+  }
+};
+
 /**
  * Having a specified default is convenient.
  */
 using DefaultProbingStrategy = PythonProbingStrategy<>;
 
+/**
+ * The slot indices that are visited in one step of a probing sequence, i.e. before
+ * `ProbingStrategy::next()` is called. For most probing strategies, these are
+ * `linear_steps()` consecutive slots.
+ *
+ * ControlBytes is the #HashTableControlBytes type of the hash table, it is only used by probing
+ * strategies that need it.
+ */
+template<typename ProbingStrategy> class ProbingStep {
+ private:
+  uint64_t hash_;
+  uint64_t mask_;
+  int64_t linear_offset_ = 0;
+  int64_t linear_steps_;
+
+ public:
+  template<typename ControlBytes>
+  ProbingStep(const ProbingStrategy &probing_strategy,
+              const uint64_t mask,
+              const ControlBytes &UNUSED(control_bytes),
+              const uint8_t UNUSED(control_byte))
+      : hash_(probing_strategy.get()),
+        mask_(mask),
+        linear_steps_(probing_strategy.linear_steps())
+  {
+  }
+
+  bool has_next() const
+  {
+    return linear_offset_ < linear_steps_;
+  }
+
+  int64_t next()
+  {
+    return static_cast<int64_t>((hash_ + static_cast<uint64_t>(linear_offset_++)) & mask_);
+  }
+};
+
+/**
+ * With the #GroupProbingStrategy, only the slots in a group whose control byte matches the hash
+ * are visited, followed by the first empty slot of the group (if there is one).
+ */
+template<> class ProbingStep<GroupProbingStrategy> {
+ private:
+  int64_t group_start_;
+  uint32_t candidates_;
+
+ public:
+  template<typename ControlBytes>
+  ProbingStep(const GroupProbingStrategy &probing_strategy,
+              const uint64_t mask,
+              const ControlBytes &control_bytes,
+              const uint8_t control_byte)
+      : group_start_(static_cast<int64_t>(
+            (probing_strategy.get() & (mask / GroupProbingStrategy::group_size)) *
+            GroupProbingStrategy::group_size)),
+        candidates_(control_bytes.find_candidates(group_start_, control_byte))
+  {
+  }
+
+  bool has_next() const
+  {
+    return candidates_ != 0;
+  }
+
+  int64_t next()
+  {
+    return group_start_ + bitscan_forward_clear_uint(&candidates_);
+  }
+};
+
 /* Turning off clang format here, because otherwise it will mess up the alignment between the
  * macros. */
 // clang-format off
@@ -242,6 +361,27 @@ using DefaultProbingStrategy = PythonProbingStrategy<>;
     probing_strategy.next(); \
   } while (true)
 
+/**
+ * Same as SLOT_PROBING_BEGIN and SLOT_PROBING_END, but also supports probing strategies that use
+ * control bytes, like the #GroupProbingStrategy. The same restrictions apply.
+ *
+ * CONTROL_BYTES: The #HashTableControlBytes that belong to the slots.
+ */
+#define CONTROL_SLOT_PROBING_BEGIN( \
+    PROBING_STRATEGY, HASH, MASK, CONTROL_BYTES, R_SLOT_INDEX) \
+  PROBING_STRATEGY probing_strategy(HASH); \
+  const uint8_t probing_control_byte = (CONTROL_BYTES).hash_to_control_byte(HASH); \
+  do { \
+    ProbingStep<PROBING_STRATEGY> probing_step( \
+        probing_strategy, MASK, CONTROL_BYTES, probing_control_byte); \
+    while (probing_step.has_next()) { \
+      int64_t R_SLOT_INDEX = probing_step.next();
+
+#define CONTROL_SLOT_PROBING_END() \
+    } \
+    probing_strategy.next(); \
+  } while (true)
+
 // clang-format on
 
 }  // namespace blender
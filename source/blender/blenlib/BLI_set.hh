@@ -45,6 +45,8 @@
  * - The hash function can be customized. See BLI_hash.hh for details.
  * - The probing strategy can be customized. See BLI_probing_stragies.hh for details.
  * - The slot type can be customized. See BLI_set_slots.hh for details.
+ * - The #GroupProbingStrategy can be faster when keys are expensive to compare or many lookups
+ *   fail. It stores an additional control byte per slot, so that most slots are not accessed.
  * - Small buffer optimization is enabled by default, if the key is not too large.
  * - The methods `add_new` and `remove_contained` should be used instead of `add` and `remove`
  *   whenever appropriate. Assumptions and intention are described better this way.
@@ -160,6 +162,10 @@ class Set {
   LoadFactor max_load_factor_ = LoadFactor(LOAD_FACTOR);
   using SlotArray =
       Array<Slot, LoadFactor::compute_total_slots(InlineBufferCapacity, LOAD_FACTOR), Allocator>;
+  using ControlBytes = HashTableControlBytes<
+      ProbingStrategy,
+      LoadFactor::compute_total_slots(InlineBufferCapacity, LOAD_FACTOR),
+      Allocator>;
 #undef LOAD_FACTOR
 
   /**
@@ -168,11 +174,17 @@ class Set {
    */
   SlotArray slots_;
 
+  /**
+   * Only contains data when the probing strategy needs it, see #HashTableControlBytes. Takes no
+   * space in the hash table otherwise.
+   */
+  BLI_NO_UNIQUE_ADDRESS ControlBytes control_bytes_;
+
   /** Iterate over a slot index sequence for a given hash. */
 #define SET_SLOT_PROBING_BEGIN(HASH, R_SLOT) \
-  SLOT_PROBING_BEGIN (ProbingStrategy, HASH, slot_mask_, SLOT_INDEX) \
+  CONTROL_SLOT_PROBING_BEGIN (ProbingStrategy, HASH, slot_mask_, control_bytes_, SLOT_INDEX) \
     auto &R_SLOT = slots_[SLOT_INDEX];
-#define SET_SLOT_PROBING_END() SLOT_PROBING_END()
+#define SET_SLOT_PROBING_END() CONTROL_SLOT_PROBING_END()
 
  public:
   /**
@@ -185,7 +197,8 @@ class Set {
         occupied_and_removed_slots_(0),
         usable_slots_(0),
         slot_mask_(0),
-        slots_(1, allocator)
+        slots_(1, allocator),
+        control_bytes_(allocator)
   {
   }
 
@@ -225,6 +238,7 @@ class Set {
         throw;
       }
     }
+    control_bytes_ = std::move(other.control_bytes_);
     removed_slots_ = other.removed_slots_;
     occupied_and_removed_slots_ = other.occupied_and_removed_slots_;
     usable_slots_ = other.usable_slots_;
@@ -557,7 +571,7 @@ class Set {
    */
   int64_t size_per_element() const
   {
-    return sizeof(Slot);
+    return sizeof(Slot) + control_bytes_.size_in_bytes() / slots_.size();
   }
 
   /**
@@ -566,7 +580,7 @@ class Set {
    */
   int64_t size_in_bytes() const
   {
-    return sizeof(Slot) * slots_.size();
+    return sizeof(Slot) * slots_.size() + control_bytes_.size_in_bytes();
   }
 
   /**
@@ -621,6 +635,7 @@ class Set {
     if (this->size() == 0) {
       try {
         slots_.reinitialize(total_slots);
+        control_bytes_.reinitialize(total_slots);
       }
       catch (...) {
         this->noexcept_reset();
@@ -635,15 +650,17 @@ class Set {
 
     /* The grown array that we insert the keys into. */
     SlotArray new_slots(total_slots);
+    ControlBytes new_control_bytes(total_slots);
 
     try {
       for (Slot &slot : slots_) {
         if (slot.is_occupied()) {
-          this->add_after_grow(slot, new_slots, new_slot_mask);
+          this->add_after_grow(slot, new_slots, new_control_bytes, new_slot_mask);
           slot.remove();
         }
       }
       slots_ = std::move(new_slots);
+      control_bytes_ = std::move(new_control_bytes);
     }
     catch (...) {
       this->noexcept_reset();
@@ -656,18 +673,23 @@ class Set {
     slot_mask_ = new_slot_mask;
   }
 
-  void add_after_grow(Slot &old_slot, SlotArray &new_slots, const uint64_t new_slot_mask)
+  void add_after_grow(Slot &old_slot,
+                      SlotArray &new_slots,
+                      ControlBytes &new_control_bytes,
+                      const uint64_t new_slot_mask)
   {
     const uint64_t hash = old_slot.get_hash(Hash());
 
-    SLOT_PROBING_BEGIN (ProbingStrategy, hash, new_slot_mask, slot_index) {
+    CONTROL_SLOT_PROBING_BEGIN (
+        ProbingStrategy, hash, new_slot_mask, new_control_bytes, slot_index) {
       Slot &slot = new_slots[slot_index];
       if (slot.is_empty()) {
         slot.occupy(std::move(*old_slot.key()), hash);
+        new_control_bytes.set_occupied(slot_index, hash);
         return;
       }
     }
-    SLOT_PROBING_END();
+    CONTROL_SLOT_PROBING_END();
   }
 
   /**
@@ -731,6 +753,7 @@ class Set {
     SET_SLOT_PROBING_BEGIN (hash, slot) {
       if (slot.is_empty()) {
         slot.occupy(std::forward<ForwardKey>(key), hash);
+        control_bytes_.set_occupied(SLOT_INDEX, hash);
         occupied_and_removed_slots_++;
         return;
       }
@@ -745,6 +768,7 @@ class Set {
     SET_SLOT_PROBING_BEGIN (hash, slot) {
       if (slot.is_empty()) {
         slot.occupy(std::forward<ForwardKey>(key), hash);
+        control_bytes_.set_occupied(SLOT_INDEX, hash);
         occupied_and_removed_slots_++;
         return true;
       }
@@ -760,6 +784,7 @@ class Set {
     SET_SLOT_PROBING_BEGIN (hash, slot) {
       if (slot.contains(key, is_equal_, hash)) {
         slot.remove();
+        control_bytes_.set_removed(SLOT_INDEX);
         removed_slots_++;
         return true;
       }
@@ -778,6 +803,7 @@ class Set {
     SET_SLOT_PROBING_BEGIN (hash, slot) {
       if (slot.contains(key, is_equal_, hash)) {
         slot.remove();
+        control_bytes_.set_removed(SLOT_INDEX);
         removed_slots_++;
         return;
       }
@@ -796,6 +822,7 @@ class Set {
       }
       if (slot.is_empty()) {
         slot.occupy(std::forward<ForwardKey>(key), hash);
+        control_bytes_.set_occupied(SLOT_INDEX, hash);
         occupied_and_removed_slots_++;
         return *slot.key();
       }
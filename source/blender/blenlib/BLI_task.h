@@ -362,6 +362,35 @@ void BLI_task_graph_edge_create(struct TaskNode *from_node, struct TaskNode *to_
  */
 void BLI_task_isolate(void (*func)(void *userdata), void *userdata);
 
+/* Task Profiling
+ *
+ * Opt-in recording of the tasks run by task pools, task graphs and parallel loops, to find out
+ * where threads are waiting and how well work is balanced between them. Every task is recorded
+ * with its call site, duration, thread and whether it was stolen by another thread than the one
+ * that created it. See BLI_task_profile.hh for details.
+ *
+ * The recording can be exported as JSON in the Chrome trace event format, which can be opened in
+ * `chrome://tracing` or https://ui.perfetto.dev.
+ */
+
+/**
+ * Start recording. Events recorded earlier are discarded.
+ * \param filepath: When not null, the trace is written to this file by #BLI_task_profile_end.
+ */
+void BLI_task_profile_begin(const char *filepath);
+/**
+ * Stop recording. Prints statistics and writes the trace file if one was passed to
+ * #BLI_task_profile_begin. The recorded events are kept until the next recording starts.
+ */
+void BLI_task_profile_end(void);
+bool BLI_task_profile_is_enabled(void);
+/** Discard all recorded events. Must not be called while tasks are running. */
+void BLI_task_profile_clear(void);
+/** Write the recorded events as Chrome trace JSON. Returns false when the file can't be written. */
+bool BLI_task_profile_write_chrome_trace(const char *filepath);
+/** Print per call site and per thread statistics of the recorded events to stdout. */
+void BLI_task_profile_print_stats(void);
+
 #ifdef __cplusplus
 }
 #endif
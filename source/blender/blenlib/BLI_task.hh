@@ -32,6 +32,7 @@
 #  include <tbb/blocked_range.h>
 #  include <tbb/parallel_for.h>
 #  include <tbb/parallel_for_each.h>
+#  include <tbb/parallel_invoke.h>
 #  include <tbb/task_arena.h>
 #  ifdef WIN32
 /* We cannot keep this defined, since other parts of the code deal with this on their own, leading
@@ -44,6 +45,7 @@
 #endif
 
 #include "BLI_index_range.hh"
+#include "BLI_task_profile.hh"
 #include "BLI_utildefines.h"
 
 namespace blender::threading {
@@ -67,6 +69,21 @@ void parallel_for(IndexRange range, int64_t grain_size, const Function &function
     return;
   }
 #ifdef WITH_TBB
+  if (profile::is_enabled()) {
+    const profile::CallSite *call_site = profile::call_site_for_type<Function>(
+        profile::Category::ParallelFor);
+    const int origin_thread = profile::thread_index();
+    profile::ScopedEvent call_event(
+        call_site, profile::EventType::Call, range.size(), origin_thread);
+    tbb::parallel_for(
+        tbb::blocked_range<int64_t>(range.first(), range.one_after_last(), grain_size),
+        [&](const tbb::blocked_range<int64_t> &subrange) {
+          profile::ScopedEvent task_event(
+              call_site, profile::EventType::Task, subrange.size(), origin_thread);
+          function(IndexRange(subrange.begin(), subrange.size()));
+        });
+    return;
+  }
   tbb::parallel_for(tbb::blocked_range<int64_t>(range.first(), range.one_after_last(), grain_size),
                     [&](const tbb::blocked_range<int64_t> &subrange) {
                       function(IndexRange(subrange.begin(), subrange.size()));
@@ -98,6 +115,18 @@ Value parallel_reduce(IndexRange range,
 #endif
 }
 
+/**
+ * Execute the given functions, potentially in parallel. Returns when all of them are done.
+ */
+template<typename... Functions> void parallel_invoke(const Functions &...functions)
+{
+#ifdef WITH_TBB
+  tbb::parallel_invoke(functions...);
+#else
+  (functions(), ...);
+#endif
+}
+
 /** See #BLI_task_isolate for a description of what isolating a task means. */
 template<typename Function> void isolate_task(const Function &function)
 {
@@ -0,0 +1,137 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ *
+ * Opt-in instrumentation of the task scheduler. See the "Task Profiling" section in BLI_task.h
+ * for the C API that starts, stops and exports recordings.
+ *
+ * When profiling is enabled, every task pool task, task graph node and chunk of a parallel loop
+ * is recorded as an event with its start and end time, the thread it ran on and the thread that
+ * created it. Events are grouped by call site, which is the callback function for the C API and
+ * the type of the callable for the C++ API. Every lambda has its own type, so that is enough to
+ * distinguish the places that start parallel work.
+ *
+ * When profiling is disabled, the overhead is a relaxed atomic load per parallel loop or task.
+ * This header is included by BLI_task.hh, the statistics of a recording are declared in
+ * BLI_task_profile_stats.hh.
+ */
+
+#include <atomic>
+#include <cstdint>
+
+namespace blender::threading::profile {
+
+enum class Category {
+  /** Tasks pushed to a #TaskPool. */
+  TaskPool,
+  /** Nodes of a #TaskGraph. */
+  TaskGraph,
+  /** #BLI_task_parallel_range. */
+  ParallelRange,
+  /** #threading::parallel_for. */
+  ParallelFor,
+};
+
+enum class EventType {
+  /** A task or a chunk of a parallel loop, executed on a single thread. */
+  Task,
+  /** An entire parallel loop, recorded on the thread that started it. */
+  Call,
+};
+
+/** A place in the code that starts parallel work. Owned by the profiler, never freed. */
+struct CallSite;
+
+extern std::atomic<bool> is_enabled_flag;
+
+inline bool is_enabled()
+{
+  return is_enabled_flag.load(std::memory_order_relaxed);
+}
+
+/**
+ * Small number that identifies the current thread in recordings. Unlike thread ids of the
+ * operating system, they start at zero in the order in which threads start doing work.
+ */
+int thread_index();
+
+/** Get the call site for a C callback. */
+const CallSite *call_site_for_function(const void *function, Category category);
+
+/**
+ * Get the call site for a C++ callable, based on its type.
+ * \param type_key: Unique address per type.
+ * \param signature: Signature of the function template, that contains the name of the type.
+ */
+const CallSite *call_site_for_type(const void *type_key, const char *signature, Category category);
+
+/** Every type has its own variable, so its address identifies the type. */
+template<typename T> inline const char call_site_type_key = 0;
+
+template<typename Function> inline const CallSite *call_site_for_type(const Category category)
+{
+#ifdef _MSC_VER
+  return call_site_for_type(&call_site_type_key<Function>, __FUNCSIG__, category);
+#else
+  return call_site_for_type(&call_site_type_key<Function>, __PRETTY_FUNCTION__, category);
+#endif
+}
+
+/**
+ * Records the time between its construction and destruction as event of the given call site.
+ * Does nothing when the call site is null, without leaving the inlined code.
+ */
+class ScopedEvent {
+ private:
+  const CallSite *call_site_;
+  EventType type_;
+  int64_t items_;
+  int origin_thread_;
+  int64_t start_time_;
+
+ public:
+  /**
+   * \param items: Number of loop iterations or similar work items processed in the event.
+   * \param origin_thread: Index of the thread that created the work, -1 when unknown.
+   */
+  ScopedEvent(const CallSite *call_site,
+              const EventType type,
+              const int64_t items,
+              const int origin_thread)
+      : call_site_(call_site), type_(type), items_(items), origin_thread_(origin_thread)
+  {
+    if (call_site_ != nullptr) {
+      this->begin();
+    }
+  }
+
+  ~ScopedEvent()
+  {
+    if (call_site_ != nullptr) {
+      this->end();
+    }
+  }
+
+ private:
+  void begin();
+  void end();
+};
+
+}  // namespace blender::threading::profile
@@ -0,0 +1,73 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+/** \file
+ * \ingroup bli
+ *
+ * Statistics of a task profiling recording, see BLI_task_profile.hh.
+ */
+
+#include <string>
+
+#include "BLI_task_profile.hh"
+#include "BLI_vector.hh"
+
+namespace blender::threading::profile {
+
+struct CallSite {
+  /** Demangled name of the callback or the type of the callable. */
+  std::string name;
+  Category category;
+};
+
+/** Accumulated statistics of all events of one call site. */
+struct CallSiteStats {
+  const CallSite *call_site;
+  /** Number of parallel loops started. Always zero for task pools and task graphs. */
+  int64_t calls = 0;
+  /** Wall-clock time of all parallel loops, in nanoseconds. */
+  int64_t call_time = 0;
+  /** Number of tasks or loop chunks. */
+  int64_t tasks = 0;
+  /** Number of tasks that ran on another thread than the one that created them. */
+  int64_t stolen_tasks = 0;
+  int64_t items = 0;
+  /** Task durations in nanoseconds. */
+  int64_t task_time = 0;
+  int64_t min_task_time = INT64_MAX;
+  int64_t max_task_time = 0;
+};
+
+/** Accumulated statistics of one thread. */
+struct ThreadStats {
+  int thread_index;
+  int64_t tasks = 0;
+  /** Time spent in events that are not nested in other events, in nanoseconds. */
+  int64_t busy_time = 0;
+  /** Time of the recording that the thread was not running any event, in nanoseconds. */
+  int64_t idle_time = 0;
+};
+
+/**
+ * Compute statistics of the current recording. Must not be called while parallel work is being
+ * recorded. Call sites are sorted by decreasing task time.
+ */
+Vector<CallSiteStats> call_site_stats();
+Vector<ThreadStats> thread_stats();
+
+}  // namespace blender::threading::profile
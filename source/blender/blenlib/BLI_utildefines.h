@@ -824,6 +824,22 @@ extern bool BLI_memory_is_zero(const void *arr, const size_t arr_size);
 #  define ENUM_OPERATORS(_type, _max)
 #endif
 
+#ifdef __cplusplus
+/* Lets an empty member take no space in its class, like an empty base class would. The standard
+ * attribute is only part of C++20 and MSVC ignores it in favor of its own spelling. */
+#  if defined(_MSC_VER)
+#    define BLI_NO_UNIQUE_ADDRESS [[msvc::no_unique_address]]
+#  elif defined(__has_cpp_attribute)
+#    if __has_cpp_attribute(no_unique_address)
+#      define BLI_NO_UNIQUE_ADDRESS [[no_unique_address]]
+#    else
+#      define BLI_NO_UNIQUE_ADDRESS
+#    endif
+#  else
+#    define BLI_NO_UNIQUE_ADDRESS
+#  endif
+#endif
+
 /** \} */
 
 /* -------------------------------------------------------------------- */
@@ -30,6 +30,8 @@
  *
  * - Ray-cast:
  *   #BLI_bvhtree_ray_cast, #BVHRayCastData
+ * - Batched ray-cast:
+ *   #BLI_bvhtree_ray_cast_batch, #BVHRayCastPacket
  * - Nearest point on surface:
  *   #BLI_bvhtree_find_nearest, #BVHNearestData
  * - Overlapping 2 trees:
@@ -44,6 +46,7 @@
 #include "BLI_heap_simple.h"
 #include "BLI_kdopbvh.h"
 #include "BLI_math.h"
+#include "BLI_simd.h"
 #include "BLI_stack.h"
 #include "BLI_task.h"
 #include "BLI_utildefines.h"
@@ -98,8 +101,10 @@ struct BVHTree {
   int totleaf;         /* leafs */
   int totbranch;
   axis_t start_axis, stop_axis; /* bvhtree_kdop_axes array indices according to axis */
-  axis_t axis;                  /* KDOP type (6 => OBB, 7 => AABB, ...) */
-  char tree_type;               /* type of tree (4 => quad-tree). */
+  /* Both share a byte, the tree would grow by a pointer size otherwise. */
+  axis_t axis : 5; /* KDOP type (6 => OBB, 7 => AABB, ...), at most 26. */
+  axis_t flag : 3; /* BVH_BUILD_* flags. */
+  char tree_type;  /* type of tree (4 => quad-tree). */
 };
 
 /* optimization, ensure we stay small */
@@ -863,14 +868,366 @@ static void non_recursive_bvh_div_nodes(const BVHTree *tree,
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name Binned SAH Tree Building (#BVH_BUILD_SAH)
+ *
+ * Alternative to the implicit tree for unevenly distributed or sized primitives.
+ * Branches are still built level by level so all branches of a level are split in parallel,
+ * but each branch is split into up to `tree_type` clusters using a binned
+ * surface area heuristic on the X, Y and Z axes of the bounding volumes.
+ *
+ * Branches are stored breadth first after the leafs: children always have a greater index than
+ * their parent and the branches of each depth are contiguous, like in the implicit tree.
+ * \{ */
+
+#define BVH_SAH_BINS 16
+
+typedef struct BVHSAHBin {
+  float min[3], max[3];
+  int num;
+} BVHSAHBin;
+
+typedef struct BVHSAHCluster {
+  int begin, end;
+  /** Half surface area of the bounds of the cluster. */
+  float area;
+} BVHSAHCluster;
+
+typedef struct BVHSAHBuildData {
+  const BVHTree *tree;
+  BVHNode **leafs_array;
+
+  /* Branches of the level being split and their leafs range. */
+  BVHNode *level_branches;
+  const int (*level_ranges)[2];
+
+  /* Output: `tree_type + 1` split positions and the number of children per branch. */
+  int *level_positions;
+  int *level_children_num;
+} BVHSAHBuildData;
+
+BLI_INLINE float bvh_sah_half_area(const float min[3], const float max[3])
+{
+  const float d[3] = {max[0] - min[0], max[1] - min[1], max[2] - min[2]};
+  return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+}
+
+BLI_INLINE void bvh_sah_bounds_add(float min[3], float max[3], const float *bv)
+{
+  for (int axis = 0; axis < 3; axis++) {
+    min[axis] = min_ff(min[axis], bv[2 * axis]);
+    max[axis] = max_ff(max[axis], bv[2 * axis + 1]);
+  }
+}
+
+/* Centroid scaled by two, avoids a multiply. */
+BLI_INLINE float bvh_sah_centroid(const BVHNode *node, const int axis)
+{
+  return node->bv[2 * axis] + node->bv[2 * axis + 1];
+}
+
+BLI_INLINE int bvh_sah_bin_index(const BVHNode *node,
+                                 const int axis,
+                                 const float cent_min,
+                                 const float scale)
+{
+  const int bin = (int)((bvh_sah_centroid(node, axis) - cent_min) * scale);
+  return min_ii(bin, BVH_SAH_BINS - 1);
+}
+
+static float bvh_sah_range_area(BVHNode **leafs_array, const int begin, const int end)
+{
+  float min[3], max[3];
+  INIT_MINMAX(min, max);
+  for (int i = begin; i < end; i++) {
+    bvh_sah_bounds_add(min, max, leafs_array[i]->bv);
+  }
+  return bvh_sah_half_area(min, max);
+}
+
+/**
+ * Split the leafs of `cluster` in two, partitioning `leafs_array` in place.
+ *
+ * \return the split axis.
+ */
+static int bvh_sah_split(BVHNode **leafs_array,
+                         const BVHSAHCluster *cluster,
+                         BVHSAHCluster *r_left,
+                         BVHSAHCluster *r_right)
+{
+  const int begin = cluster->begin;
+  const int end = cluster->end;
+  float cent_min[3], cent_max[3];
+  float scale[3];
+  BVHSAHBin bins[3][BVH_SAH_BINS];
+  int axis, i;
+
+  INIT_MINMAX(cent_min, cent_max);
+  for (i = begin; i < end; i++) {
+    const float cent[3] = {bvh_sah_centroid(leafs_array[i], 0),
+                           bvh_sah_centroid(leafs_array[i], 1),
+                           bvh_sah_centroid(leafs_array[i], 2)};
+    minmax_v3v3_v3(cent_min, cent_max, cent);
+  }
+
+  for (axis = 0; axis < 3; axis++) {
+    const float extent = cent_max[axis] - cent_min[axis];
+    scale[axis] = (extent > 0.0f) ? ((float)BVH_SAH_BINS / extent) : 0.0f;
+    for (int b = 0; b < BVH_SAH_BINS; b++) {
+      INIT_MINMAX(bins[axis][b].min, bins[axis][b].max);
+      bins[axis][b].num = 0;
+    }
+  }
+
+  for (i = begin; i < end; i++) {
+    const BVHNode *node = leafs_array[i];
+    for (axis = 0; axis < 3; axis++) {
+      if (scale[axis] != 0.0f) {
+        BVHSAHBin *bin = &bins[axis][bvh_sah_bin_index(node, axis, cent_min[axis], scale[axis])];
+        bvh_sah_bounds_add(bin->min, bin->max, node->bv);
+        bin->num++;
+      }
+    }
+  }
+
+  /* Sweep the bins from both sides, the best split is between `best_bin` and `best_bin + 1`. */
+  float best_cost = FLT_MAX, best_left_area = 0.0f, best_right_area = 0.0f;
+  int best_axis = -1, best_bin = 0;
+
+  for (axis = 0; axis < 3; axis++) {
+    if (scale[axis] == 0.0f) {
+      continue;
+    }
+    float right_area[BVH_SAH_BINS], min[3], max[3];
+    int right_num[BVH_SAH_BINS], num = 0;
+    int b;
+
+    INIT_MINMAX(min, max);
+    for (b = BVH_SAH_BINS - 1; b > 0; b--) {
+      if (bins[axis][b].num) {
+        minmax_v3v3_v3(min, max, bins[axis][b].min);
+        minmax_v3v3_v3(min, max, bins[axis][b].max);
+        num += bins[axis][b].num;
+      }
+      right_area[b] = num ? bvh_sah_half_area(min, max) : 0.0f;
+      right_num[b] = num;
+    }
+
+    INIT_MINMAX(min, max);
+    num = 0;
+    for (b = 0; b < BVH_SAH_BINS - 1; b++) {
+      if (bins[axis][b].num) {
+        minmax_v3v3_v3(min, max, bins[axis][b].min);
+        minmax_v3v3_v3(min, max, bins[axis][b].max);
+        num += bins[axis][b].num;
+      }
+      if (num == 0 || right_num[b + 1] == 0) {
+        continue;
+      }
+      const float left_area = bvh_sah_half_area(min, max);
+      const float cost = left_area * (float)num + right_area[b + 1] * (float)right_num[b + 1];
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_axis = axis;
+        best_bin = b;
+        best_left_area = left_area;
+        best_right_area = right_area[b + 1];
+      }
+    }
+  }
+
+  int mid;
+  if (best_axis != -1) {
+    int left = begin, right = end - 1;
+    while (left <= right) {
+      if (bvh_sah_bin_index(leafs_array[left], best_axis, cent_min[best_axis], scale[best_axis]) <=
+          best_bin) {
+        left++;
+      }
+      else {
+        SWAP(BVHNode *, leafs_array[left], leafs_array[right]);
+        right--;
+      }
+    }
+    mid = left;
+  }
+  else {
+    /* All centroids are in the same place, split by count. */
+    mid = (begin + end) / 2;
+    best_axis = 0;
+    best_left_area = bvh_sah_range_area(leafs_array, begin, mid);
+    best_right_area = bvh_sah_range_area(leafs_array, mid, end);
+  }
+
+  r_left->begin = begin;
+  r_left->end = mid;
+  r_left->area = best_left_area;
+  r_right->begin = mid;
+  r_right->end = end;
+  r_right->area = best_right_area;
+
+  return best_axis;
+}
+
+static void bvh_sah_split_branch_task_cb(void *__restrict userdata,
+                                         const int j,
+                                         const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const BVHSAHBuildData *data = userdata;
+  const int tree_type = data->tree->tree_type;
+  BVHNode *node = &data->level_branches[j];
+  BVHSAHCluster clusters[MAX_TREETYPE];
+  int clusters_num = 1;
+
+  clusters[0].begin = data->level_ranges[j][0];
+  clusters[0].end = data->level_ranges[j][1];
+  clusters[0].area = 0.0f;
+
+  refit_kdop_hull(data->tree, node, clusters[0].begin, clusters[0].end);
+
+  /* Repeatedly split the cluster with the largest area until there is one per child. */
+  while (clusters_num < tree_type) {
+    int split = -1;
+    for (int k = 0; k < clusters_num; k++) {
+      if ((clusters[k].end - clusters[k].begin > 1) &&
+          (split == -1 || clusters[k].area > clusters[split].area)) {
+        split = k;
+      }
+    }
+    if (split == -1) {
+      break;
+    }
+
+    BVHSAHCluster left, right;
+    const int split_axis = bvh_sah_split(data->leafs_array, &clusters[split], &left, &right);
+    if (clusters_num == 1) {
+      /* Save split axis (this can be used on ray-tracing to speedup the query time) */
+      node->main_axis = (char)split_axis;
+    }
+
+    /* Keep clusters in leafs order, so the children are sorted along the first split axis. */
+    memmove(&clusters[split + 2],
+            &clusters[split + 1],
+            sizeof(*clusters) * (size_t)(clusters_num - split - 1));
+    clusters[split] = left;
+    clusters[split + 1] = right;
+    clusters_num++;
+  }
+
+  int *nth_positions = &data->level_positions[j * (tree_type + 1)];
+  for (int k = 0; k < clusters_num; k++) {
+    nth_positions[k] = clusters[k].begin;
+  }
+  nth_positions[clusters_num] = clusters[clusters_num - 1].end;
+  data->level_children_num[j] = clusters_num;
+}
+
+/**
+ * Build the branches of a tree with more than one leaf using #BVH_BUILD_SAH,
+ * sets `tree->totbranch` and links the branches into `tree->nodes`.
+ */
+static void bvh_sah_build(BVHTree *tree)
+{
+  const int tree_type = tree->tree_type;
+  const int totleaf = tree->totleaf;
+  BVHNode **leafs_array = tree->nodes;
+  BVHNode *branches = tree->nodearray + totleaf;
+
+  /* Every branch has at least two leafs, so there are less than `totleaf / 2` per level. */
+  const int level_len_max = max_ii(totleaf / 2, 1);
+  int(*level_ranges)[2] = MEM_malloc_arrayN(
+      (size_t)level_len_max, sizeof(*level_ranges), __func__);
+  int(*level_ranges_next)[2] = MEM_malloc_arrayN(
+      (size_t)level_len_max, sizeof(*level_ranges_next), __func__);
+  int *level_positions = NULL;
+  int *level_children_num = NULL;
+  int level_alloc_len = 0;
+
+  int level_first = 0, level_len = 1;
+  int branches_num = 1;
+
+  branches[0].parent = NULL;
+  level_ranges[0][0] = 0;
+  level_ranges[0][1] = totleaf;
+
+  BVHSAHBuildData data = {
+      .tree = tree,
+      .leafs_array = leafs_array,
+  };
+
+  while (level_len != 0) {
+    if (level_len > level_alloc_len) {
+      level_alloc_len = min_ii(level_len * 2, level_len_max);
+      MEM_SAFE_FREE(level_positions);
+      MEM_SAFE_FREE(level_children_num);
+      level_positions = MEM_malloc_arrayN(
+          (size_t)level_alloc_len * (size_t)(tree_type + 1), sizeof(int), __func__);
+      level_children_num = MEM_malloc_arrayN((size_t)level_alloc_len, sizeof(int), __func__);
+    }
+
+    data.level_branches = &branches[level_first];
+    data.level_ranges = (const int(*)[2])level_ranges;
+    data.level_positions = level_positions;
+    data.level_children_num = level_children_num;
+
+    TaskParallelSettings settings;
+    BLI_parallel_range_settings_defaults(&settings);
+    settings.use_threading = (totleaf > KDOPBVH_THREAD_LEAF_THRESHOLD);
+    BLI_task_parallel_range(0, level_len, &data, bvh_sah_split_branch_task_cb, &settings);
+
+    /* Link the children, branches of the next level are allocated in order. */
+    int level_len_next = 0;
+    for (int j = 0; j < level_len; j++) {
+      BVHNode *parent = &branches[level_first + j];
+      const int *nth_positions = &level_positions[j * (tree_type + 1)];
+      int k;
+      for (k = 0; k < level_children_num[j]; k++) {
+        BVHNode *child;
+        if (nth_positions[k + 1] - nth_positions[k] == 1) {
+          child = leafs_array[nth_positions[k]];
+        }
+        else {
+          child = &branches[branches_num++];
+          level_ranges_next[level_len_next][0] = nth_positions[k];
+          level_ranges_next[level_len_next][1] = nth_positions[k + 1];
+          level_len_next++;
+        }
+        parent->children[k] = child;
+        child->parent = parent;
+      }
+      parent->totnode = (char)k;
+    }
+
+    int(*level_ranges_swap)[2] = level_ranges;
+    level_ranges = level_ranges_next;
+    level_ranges_next = level_ranges_swap;
+    level_first += level_len;
+    level_len = level_len_next;
+  }
+
+  BLI_assert(branches_num < totleaf);
+  tree->totbranch = branches_num;
+  for (int i = 0; i < branches_num; i++) {
+    tree->nodes[totleaf + i] = &branches[i];
+  }
+
+  MEM_freeN(level_ranges);
+  MEM_freeN(level_ranges_next);
+  MEM_freeN(level_positions);
+  MEM_freeN(level_children_num);
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name BLI_bvhtree API
  * \{ */
 
 /**
+ * \param flag: #BVH_BUILD_SAH to build the tree using the surface area heuristic.
  * \note many callers don't check for `NULL` return.
  */
-BVHTree *BLI_bvhtree_new(int maxsize, float epsilon, char tree_type, char axis)
+BVHTree *BLI_bvhtree_new_ex(int maxsize, float epsilon, char tree_type, char axis, int flag)
 {
   BVHTree *tree;
   int numnodes, i;
@@ -888,7 +1245,8 @@ BVHTree *BLI_bvhtree_new(int maxsize, float epsilon, char tree_type, char axis)
   if (tree) {
     tree->epsilon = epsilon;
     tree->tree_type = tree_type;
-    tree->axis = axis;
+    tree->axis = (axis_t)(axis & 0x1f);
+    tree->flag = (axis_t)(flag & 0x7);
 
     if (axis == 26) {
       tree->start_axis = 0;
@@ -919,6 +1277,10 @@ BVHTree *BLI_bvhtree_new(int maxsize, float epsilon, char tree_type, char axis)
 
     /* Allocate arrays */
     numnodes = maxsize + implicit_needed_branches(tree_type, maxsize) + tree_type;
+    if (flag & BVH_BUILD_SAH) {
+      /* Branches may have less than `tree_type` children, at most one per leaf is needed. */
+      numnodes = max_ii(numnodes, maxsize + maxsize + tree_type);
+    }
 
     tree->nodes = MEM_callocN(sizeof(BVHNode *) * (size_t)numnodes, "BVHNodes");
     tree->nodebv = MEM_callocN(sizeof(float) * (size_t)(axis * numnodes), "BVHNodeBV");
@@ -942,6 +1304,11 @@ fail:
   return NULL;
 }
 
+BVHTree *BLI_bvhtree_new(int maxsize, float epsilon, char tree_type, char axis)
+{
+  return BLI_bvhtree_new_ex(maxsize, epsilon, tree_type, axis, 0);
+}
+
 void BLI_bvhtree_free(BVHTree *tree)
 {
   if (tree) {
@@ -961,15 +1328,21 @@ void BLI_bvhtree_balance(BVHTree *tree)
    * (some big bug goes here if its being called more than once per tree) */
   BLI_assert(tree->totbranch == 0);
 
-  /* Build the implicit tree */
-  non_recursive_bvh_div_nodes(
-      tree, tree->nodearray + (tree->totleaf - 1), leafs_array, tree->totleaf);
+  /* The SAH builder only bins along X, Y and Z which aren't available for 18-DOP's. */
+  if ((tree->flag & BVH_BUILD_SAH) && (tree->totleaf > 1) && (tree->start_axis == 0)) {
+    bvh_sah_build(tree);
+  }
+  else {
+    /* Build the implicit tree */
+    non_recursive_bvh_div_nodes(
+        tree, tree->nodearray + (tree->totleaf - 1), leafs_array, tree->totleaf);
 
-  /* current code expects the branches to be linked to the nodes array
-   * we perform that linkage here */
-  tree->totbranch = implicit_needed_branches(tree->tree_type, tree->totleaf);
-  for (int i = 0; i < tree->totbranch; i++) {
-    tree->nodes[tree->totleaf + i] = &tree->nodearray[tree->totleaf + i];
+    /* current code expects the branches to be linked to the nodes array
+     * we perform that linkage here */
+    tree->totbranch = implicit_needed_branches(tree->tree_type, tree->totleaf);
+    for (int i = 0; i < tree->totbranch; i++) {
+      tree->nodes[tree->totleaf + i] = &tree->nodearray[tree->totleaf + i];
+    }
   }
 
 #ifdef USE_SKIP_LINKS
@@ -1038,11 +1411,92 @@ bool BLI_bvhtree_update_node(
   return true;
 }
 
+/* Deepest tree refitted in parallel, SAH trees of very unbalanced input can be deeper. */
+#define BVH_REFIT_LEVELS_MAX 256
+
+typedef struct BVHRefitData {
+  BVHTree *tree;
+  BVHNode **branches;
+} BVHRefitData;
+
+static void bvhtree_refit_task_cb(void *__restrict userdata,
+                                  const int i,
+                                  const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BVHRefitData *data = userdata;
+  node_join(data->tree, data->branches[i]);
+}
+
+/**
+ * Join all branches of the same depth in parallel, deepest first.
+ *
+ * \return false when the branches aren't stored breadth first (which both builders do),
+ * or the tree is too deep, the caller must refit sequentially then.
+ */
+static bool bvhtree_update_tree_threaded(BVHTree *tree)
+{
+  BVHNode **branches = tree->nodes + tree->totleaf;
+  int level_first[BVH_REFIT_LEVELS_MAX + 1];
+  int levels_num = 0;
+  int first = 0, len = 1;
+
+  /* Find the range of branches of each depth,
+   * checking the children of each level are the branches following it. */
+  while (len != 0) {
+    if (levels_num == BVH_REFIT_LEVELS_MAX) {
+      return false;
+    }
+    level_first[levels_num++] = first;
+
+    int next = first + len;
+    for (int i = first; i < first + len; i++) {
+      const BVHNode *node = branches[i];
+      for (int k = 0; k < node->totnode; k++) {
+        if (node->children[k]->totnode != 0) {
+          if (next >= tree->totbranch || node->children[k] != branches[next]) {
+            return false;
+          }
+          next++;
+        }
+      }
+    }
+    first += len;
+    len = next - first;
+  }
+  if (first != tree->totbranch) {
+    return false;
+  }
+  level_first[levels_num] = first;
+
+  BVHRefitData data = {
+      .tree = tree,
+      .branches = branches,
+  };
+
+  for (int level = levels_num - 1; level >= 0; level--) {
+    const int level_len = level_first[level + 1] - level_first[level];
+    TaskParallelSettings settings;
+    BLI_parallel_range_settings_defaults(&settings);
+    settings.use_threading = (level_len > KDOPBVH_THREAD_LEAF_THRESHOLD);
+    BLI_task_parallel_range(
+        level_first[level], level_first[level + 1], &data, bvhtree_refit_task_cb, &settings);
+  }
+  return true;
+}
+
 /**
  * Call #BLI_bvhtree_update_node() first for every node/point/triangle.
+ *
+ * Only the bounds are refitted, the topology of the tree is kept.
  */
 void BLI_bvhtree_update_tree(BVHTree *tree)
 {
+  if (tree->totbranch != 0 && tree->totleaf > KDOPBVH_THREAD_LEAF_THRESHOLD) {
+    if (bvhtree_update_tree_threaded(tree)) {
+      return;
+    }
+  }
+
   /* Update bottom=>top
    * TRICKY: the way we build the tree all the children have an index greater than the parent
    * This allows us todo a bottom up update by starting on the bigger numbered branch. */
@@ -2077,6 +2531,233 @@ void BLI_bvhtree_ray_cast_all(BVHTree *tree,
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name BLI_bvhtree_ray_cast_batch
+ *
+ * Rays are cast in packets: with SSE2 a packet traverses the tree once, testing each node
+ * against all of its rays together and only descending for the rays that hit the node.
+ * This pays off for coherent rays (similar origins and directions, such as rays cast from
+ * neighboring points). Packets are cast in parallel.
+ *
+ * \{ */
+
+#define BVH_RAYCAST_PACKET_SIZE 4
+
+#ifdef DEBUG
+#  define KDOPBVH_THREAD_RAY_PACKET_THRESHOLD 0
+#else
+#  define KDOPBVH_THREAD_RAY_PACKET_THRESHOLD 64
+#endif
+
+typedef struct BVHRayCastPacket {
+  /** Structure of arrays copy of the rays for the bounding volume tests. */
+  float origin[3][BVH_RAYCAST_PACKET_SIZE];
+  float idot_axis[3][BVH_RAYCAST_PACKET_SIZE];
+  /** Copy of `data[i].hit.dist`. */
+  float dist[BVH_RAYCAST_PACKET_SIZE];
+
+  BVHRayCastData data[BVH_RAYCAST_PACKET_SIZE];
+  int len;
+} BVHRayCastPacket;
+
+typedef struct BVHRayCastBatchData {
+  const BVHTree *tree;
+  const float (*co)[3];
+  const float (*dir)[3];
+  int rays_num;
+  float radius;
+  BVHTreeRayHit *hits;
+  BVHTree_RayCastCallback callback;
+  void *userdata;
+  int flag;
+} BVHRayCastBatchData;
+
+#ifdef BLI_HAVE_SSE2
+
+/**
+ * Packet version of #fast_ray_nearest_hit, giving the same results for every ray.
+ *
+ * \return The mask of rays in \a mask that hit the node closer than their current hit,
+ * with the distances to the node in \a r_dist.
+ */
+static uint packet_ray_nearest_hit(const BVHRayCastPacket *packet,
+                                   const BVHNode *node,
+                                   const uint mask,
+                                   float r_dist[BVH_RAYCAST_PACKET_SIZE])
+{
+  const float *bv = node->bv;
+
+  __m128 t_near = _mm_setzero_ps(), t_far = _mm_setzero_ps();
+  for (int axis = 0; axis < 3; axis++) {
+    const __m128 origin = _mm_loadu_ps(packet->origin[axis]);
+    const __m128 idot = _mm_loadu_ps(packet->idot_axis[axis]);
+    const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bv[2 * axis]), origin), idot);
+    const __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bv[2 * axis + 1]), origin), idot);
+    if (axis == 0) {
+      t_near = _mm_min_ps(t1, t2);
+      t_far = _mm_max_ps(t1, t2);
+    }
+    else {
+      t_near = _mm_max_ps(t_near, _mm_min_ps(t1, t2));
+      t_far = _mm_min_ps(t_far, _mm_max_ps(t1, t2));
+    }
+  }
+  const __m128 is_hit = _mm_and_ps(
+      _mm_and_ps(_mm_cmple_ps(t_near, t_far), _mm_cmpge_ps(t_far, _mm_setzero_ps())),
+      _mm_cmplt_ps(t_near, _mm_loadu_ps(packet->dist)));
+  _mm_storeu_ps(r_dist, t_near);
+  return (uint)_mm_movemask_ps(is_hit) & mask;
+}
+
+static void dfs_raycast_packet(BVHRayCastPacket *packet, const BVHNode *node, uint mask)
+{
+  float dist[BVH_RAYCAST_PACKET_SIZE];
+  mask = packet_ray_nearest_hit(packet, node, mask, dist);
+  if (mask == 0) {
+    return;
+  }
+
+  if (node->totnode == 0) {
+    for (int i = 0; i < packet->len; i++) {
+      if ((mask & (1u << i)) == 0) {
+        continue;
+      }
+      BVHRayCastData *data = &packet->data[i];
+      if (data->callback) {
+        data->callback(data->userdata, node->index, &data->ray, &data->hit);
+      }
+      else {
+        data->hit.index = node->index;
+        data->hit.dist = dist[i];
+        madd_v3_v3v3fl(data->hit.co, data->ray.origin, data->ray.direction, dist[i]);
+      }
+      packet->dist[i] = data->hit.dist;
+    }
+  }
+  else {
+    /* Pick the loop direction per ray like #dfs_raycast, so each ray visits the leaves in the
+     * same order (giving the same hit on ties). Coherent rays mostly agree on the direction. */
+    uint mask_forward = 0;
+    for (int i = 0; i < packet->len; i++) {
+      if (packet->data[i].ray_dot_axis[node->main_axis] > 0.0f) {
+        mask_forward |= (1u << i);
+      }
+    }
+    mask_forward &= mask;
+    const uint mask_backward = mask & ~mask_forward;
+
+    if (mask_forward) {
+      for (int i = 0; i != node->totnode; i++) {
+        dfs_raycast_packet(packet, node->children[i], mask_forward);
+      }
+    }
+    if (mask_backward) {
+      for (int i = node->totnode - 1; i >= 0; i--) {
+        dfs_raycast_packet(packet, node->children[i], mask_backward);
+      }
+    }
+  }
+}
+
+#endif /* BLI_HAVE_SSE2 */
+
+static void bvhtree_ray_cast_batch_task_cb(void *__restrict userdata,
+                                           const int packet_index,
+                                           const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const BVHRayCastBatchData *batch = userdata;
+  BVHNode *root = batch->tree->nodes[batch->tree->totleaf];
+  const int ray_start = packet_index * BVH_RAYCAST_PACKET_SIZE;
+
+  BVHRayCastPacket packet;
+  packet.len = min_ii(BVH_RAYCAST_PACKET_SIZE, batch->rays_num - ray_start);
+
+  for (int i = 0; i < BVH_RAYCAST_PACKET_SIZE; i++) {
+    /* Unused lanes repeat the last ray, so they never produce invalid values. */
+    const int ray_index = ray_start + min_ii(i, packet.len - 1);
+    BVHRayCastData *data = &packet.data[i];
+
+    BLI_ASSERT_UNIT_V3(batch->dir[ray_index]);
+
+    data->tree = batch->tree;
+    data->callback = batch->callback;
+    data->userdata = batch->userdata;
+    copy_v3_v3(data->ray.origin, batch->co[ray_index]);
+    copy_v3_v3(data->ray.direction, batch->dir[ray_index]);
+    data->ray.radius = batch->radius;
+    bvhtree_ray_cast_data_precalc(data, batch->flag);
+    data->hit = batch->hits[ray_index];
+
+    for (int axis = 0; axis < 3; axis++) {
+      packet.origin[axis][i] = data->ray.origin[axis];
+      packet.idot_axis[axis][i] = data->idot_axis[axis];
+    }
+    packet.dist[i] = data->hit.dist;
+  }
+
+#ifdef BLI_HAVE_SSE2
+  /* The packet test doesn't support a radius, see #fast_ray_nearest_hit. */
+  if (batch->radius == 0.0f) {
+    dfs_raycast_packet(&packet, root, (1u << packet.len) - 1);
+  }
+  else
+#endif
+  {
+    for (int i = 0; i < packet.len; i++) {
+      dfs_raycast(&packet.data[i], root);
+    }
+  }
+
+  for (int i = 0; i < packet.len; i++) {
+    batch->hits[ray_start + i] = packet.data[i].hit;
+  }
+}
+
+/**
+ * Cast \a rays_num rays, giving the same results as calling #BLI_bvhtree_ray_cast_ex
+ * for each of them.
+ *
+ * \param hits: The hit for each ray, \a index and \a dist must be initialized
+ * (typically to -1 and the maximum ray length), and are updated in place.
+ * \param callback: Must be thread-safe, rays are cast in parallel.
+ */
+void BLI_bvhtree_ray_cast_batch(BVHTree *tree,
+                                const float (*co)[3],
+                                const float (*dir)[3],
+                                const int rays_num,
+                                float radius,
+                                BVHTreeRayHit *hits,
+                                BVHTree_RayCastCallback callback,
+                                void *userdata,
+                                int flag)
+{
+  if (rays_num == 0 || tree->nodes[tree->totleaf] == NULL) {
+    return;
+  }
+
+  BVHRayCastBatchData batch = {
+      .tree = tree,
+      .co = co,
+      .dir = dir,
+      .rays_num = rays_num,
+      .radius = radius,
+      .hits = hits,
+      .callback = callback,
+      .userdata = userdata,
+      .flag = flag,
+  };
+
+  const int packets_num = (rays_num + BVH_RAYCAST_PACKET_SIZE - 1) / BVH_RAYCAST_PACKET_SIZE;
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (packets_num > KDOPBVH_THREAD_RAY_PACKET_THRESHOLD);
+  settings.min_iter_per_thread = 16;
+  BLI_task_parallel_range(0, packets_num, &batch, bvhtree_ray_cast_batch_task_cb, &settings);
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name BLI_bvhtree_range_query
  *
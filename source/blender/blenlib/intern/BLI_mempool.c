@@ -27,6 +27,7 @@
  * - Freeing chunks.
  * - Iterating over allocated chunks
  *   (optionally when using the #BLI_MEMPOOL_ALLOW_ITER flag).
+ * - Allocating and freeing from multiple threads, using a #BLI_mempool_tls per thread.
  */
 
 #include <stdlib.h>
@@ -34,6 +35,7 @@
 
 #include "atomic_ops.h"
 
+#include "BLI_threads.h"
 #include "BLI_utildefines.h"
 
 #include "BLI_mempool.h"         /* own include */
@@ -132,6 +134,16 @@ struct BLI_mempool {
   uint maxchunks;
   /** Number of elements currently in use. */
   uint totused;
+  /** Protects #BLI_mempool.chunks and #BLI_mempool.free when using #BLI_mempool_tls. */
+  SpinLock lock;
+  /** Number of #BLI_mempool_tls that exist for this pool. */
+  uint tls_len;
+  /**
+   * Sum of the #BLI_mempool_tls.totused_delta of the destroyed handles. Only applied to
+   * #BLI_mempool.totused once all handles are destroyed, because one thread can free elements
+   * allocated by another, so the delta of a single handle can be lower than `-totused`.
+   */
+  int64_t tls_totused_delta;
 #ifdef USE_TOTALLOC
   /** Number of elements allocated in total. */
   uint totalloc;
@@ -186,23 +198,10 @@ static BLI_mempool_chunk *mempool_chunk_alloc(BLI_mempool *pool)
 }
 
 /**
- * Initialize a chunk and add into \a pool->chunks
- *
- * \param pool: The pool to add the chunk into.
- * \param mpchunk: The new uninitialized chunk (can be malloc'd)
- * \param last_tail: The last element of the previous chunk
- * (used when building free chunks initially)
- * \return The last chunk,
+ * Append \a mpchunk to the end of \a pool->chunks.
  */
-static BLI_freenode *mempool_chunk_add(BLI_mempool *pool,
-                                       BLI_mempool_chunk *mpchunk,
-                                       BLI_freenode *last_tail)
+static void mempool_chunk_append(BLI_mempool *pool, BLI_mempool_chunk *mpchunk)
 {
-  const uint esize = pool->esize;
-  BLI_freenode *curnode = CHUNK_DATA(mpchunk);
-  uint j;
-
-  /* append */
   if (pool->chunk_tail) {
     pool->chunk_tail->next = mpchunk;
   }
@@ -213,10 +212,19 @@ static BLI_freenode *mempool_chunk_add(BLI_mempool *pool,
 
   mpchunk->next = NULL;
   pool->chunk_tail = mpchunk;
+}
 
-  if (UNLIKELY(pool->free == NULL)) {
-    pool->free = curnode;
-  }
+/**
+ * Link all elements of \a mpchunk into a free list, starting at the chunk data.
+ *
+ * \return The last element of the list.
+ */
+static BLI_freenode *mempool_chunk_free_list_init(const BLI_mempool *pool,
+                                                  BLI_mempool_chunk *mpchunk)
+{
+  const uint esize = pool->esize;
+  BLI_freenode *curnode = CHUNK_DATA(mpchunk);
+  uint j;
 
   /* loop through the allocated data, building the pointer structures */
   j = pool->pchunk;
@@ -239,6 +247,32 @@ static BLI_freenode *mempool_chunk_add(BLI_mempool *pool,
   curnode = NODE_STEP_PREV(curnode);
   curnode->next = NULL;
 
+  return curnode;
+}
+
+/**
+ * Initialize a chunk and add into \a pool->chunks
+ *
+ * \param pool: The pool to add the chunk into.
+ * \param mpchunk: The new uninitialized chunk (can be malloc'd)
+ * \param last_tail: The last element of the previous chunk
+ * (used when building free chunks initially)
+ * \return The last chunk,
+ */
+static BLI_freenode *mempool_chunk_add(BLI_mempool *pool,
+                                       BLI_mempool_chunk *mpchunk,
+                                       BLI_freenode *last_tail)
+{
+  BLI_freenode *curnode;
+
+  mempool_chunk_append(pool, mpchunk);
+
+  if (UNLIKELY(pool->free == NULL)) {
+    pool->free = CHUNK_DATA(mpchunk);
+  }
+
+  curnode = mempool_chunk_free_list_init(pool, mpchunk);
+
 #ifdef USE_TOTALLOC
   pool->totalloc += pool->pchunk;
 #endif
@@ -316,6 +350,9 @@ BLI_mempool *BLI_mempool_create(uint esize, uint totelem, uint pchunk, uint flag
   pool->totalloc = 0;
 #endif
   pool->totused = 0;
+  BLI_spin_init(&pool->lock);
+  pool->tls_len = 0;
+  pool->tls_totused_delta = 0;
 
   if (totelem) {
     /* Allocate the actual chunks. */
@@ -710,6 +747,217 @@ void *mempool_iter_threadsafe_step(BLI_mempool_threadsafe_iter *ts_iter)
 
 #endif
 
+/* -------------------------------------------------------------------- */
+/** \name Thread-Local Allocation
+ *
+ * Each thread allocates from and frees into the free list of its own #BLI_mempool_tls,
+ * which needs no synchronization. The pool lock is only taken to append a new chunk,
+ * or to move a batch of free elements between a thread-local list and #BLI_mempool.free,
+ * which is how elements freed by one thread get reused by the others.
+ * \{ */
+
+/**
+ * Thread-local free list of elements, exchanged with the pool at most a chunk at a time.
+ */
+struct BLI_mempool_tls {
+  BLI_mempool *pool;
+  BLI_freenode *free;
+  uint free_len;
+  /** Change of #BLI_mempool.totused, see #BLI_mempool.tls_totused_delta. */
+  int64_t totused_delta;
+};
+
+/** Thread-local free lists longer than this many chunks give a chunk back to the pool. */
+#define MEMPOOL_TLS_FREE_CHUNKS_MAX 2
+
+BLI_mempool_tls *BLI_mempool_tls_create(BLI_mempool *pool)
+{
+  BLI_mempool_tls *tls = MEM_mallocN(sizeof(*tls), __func__);
+  tls->pool = pool;
+  tls->free = NULL;
+  tls->free_len = 0;
+  tls->totused_delta = 0;
+
+  BLI_spin_lock(&pool->lock);
+  pool->tls_len++;
+  BLI_spin_unlock(&pool->lock);
+  return tls;
+}
+
+/**
+ * Fill the empty thread-local free list, stealing up to a chunk of elements from
+ * the shared free list and only allocating a new chunk when that is empty too.
+ */
+static void mempool_tls_refill(BLI_mempool_tls *tls)
+{
+  BLI_mempool *pool = tls->pool;
+  BLI_assert(tls->free == NULL);
+
+  BLI_spin_lock(&pool->lock);
+  if (pool->free) {
+    BLI_freenode *tail = pool->free;
+    uint len = 1;
+    while (len < pool->pchunk && tail->next) {
+      tail = tail->next;
+      len++;
+    }
+    tls->free = pool->free;
+    tls->free_len = len;
+    pool->free = tail->next;
+    tail->next = NULL;
+    BLI_spin_unlock(&pool->lock);
+    return;
+  }
+  BLI_spin_unlock(&pool->lock);
+
+  /* Allocate and initialize outside of the lock, the chunk isn't visible to others yet. */
+  BLI_mempool_chunk *mpchunk = mempool_chunk_alloc(pool);
+  mempool_chunk_free_list_init(pool, mpchunk);
+  tls->free = CHUNK_DATA(mpchunk);
+  tls->free_len = pool->pchunk;
+
+  BLI_spin_lock(&pool->lock);
+  mempool_chunk_append(pool, mpchunk);
+#ifdef USE_TOTALLOC
+  pool->totalloc += pool->pchunk;
+#endif
+  BLI_spin_unlock(&pool->lock);
+}
+
+/**
+ * Move all but the first \a keep_len elements of the thread-local free list
+ * to the shared free list of the pool.
+ */
+static void mempool_tls_release(BLI_mempool_tls *tls, const uint keep_len)
+{
+  BLI_mempool *pool = tls->pool;
+  BLI_freenode *head, *tail;
+
+  if (tls->free_len <= keep_len) {
+    return;
+  }
+  if (keep_len == 0) {
+    head = tls->free;
+    tls->free = NULL;
+  }
+  else {
+    BLI_freenode *keep_tail = tls->free;
+    for (uint i = 1; i < keep_len; i++) {
+      keep_tail = keep_tail->next;
+    }
+    head = keep_tail->next;
+    keep_tail->next = NULL;
+  }
+  tls->free_len = keep_len;
+
+  for (tail = head; tail->next; tail = tail->next) {
+    /* pass */
+  }
+
+  BLI_spin_lock(&pool->lock);
+  tail->next = pool->free;
+  pool->free = head;
+  BLI_spin_unlock(&pool->lock);
+}
+
+void *BLI_mempool_tls_alloc(BLI_mempool_tls *tls)
+{
+  BLI_mempool *pool = tls->pool;
+  BLI_freenode *free_pop;
+
+  if (UNLIKELY(tls->free == NULL)) {
+    mempool_tls_refill(tls);
+  }
+
+  free_pop = tls->free;
+
+  if (pool->flag & BLI_MEMPOOL_ALLOW_ITER) {
+    free_pop->freeword = USEDWORD;
+  }
+
+  tls->free = free_pop->next;
+  tls->free_len--;
+  tls->totused_delta++;
+
+#ifdef WITH_MEM_VALGRIND
+  VALGRIND_MEMPOOL_ALLOC(pool, free_pop, pool->esize);
+#endif
+
+  return (void *)free_pop;
+}
+
+void *BLI_mempool_tls_calloc(BLI_mempool_tls *tls)
+{
+  void *retval = BLI_mempool_tls_alloc(tls);
+  memset(retval, 0, (size_t)tls->pool->esize);
+  return retval;
+}
+
+/**
+ * Free an element into the thread-local free list.
+ * The element may have been allocated by any thread.
+ *
+ * \note doesn't protect against double frees, take care!
+ */
+void BLI_mempool_tls_free(BLI_mempool_tls *tls, void *addr)
+{
+  BLI_mempool *pool = tls->pool;
+  BLI_freenode *newhead = addr;
+
+#ifndef NDEBUG
+  /* Enable for debugging. */
+  if (UNLIKELY(mempool_debug_memset)) {
+    memset(addr, 255, pool->esize);
+  }
+#endif
+
+  if (pool->flag & BLI_MEMPOOL_ALLOW_ITER) {
+#ifndef NDEBUG
+    /* This will detect double free's. */
+    BLI_assert(newhead->freeword != FREEWORD);
+#endif
+    newhead->freeword = FREEWORD;
+  }
+
+  newhead->next = tls->free;
+  tls->free = newhead;
+  tls->free_len++;
+  tls->totused_delta--;
+
+#ifdef WITH_MEM_VALGRIND
+  VALGRIND_MEMPOOL_FREE(pool, addr);
+#endif
+
+  if (UNLIKELY(tls->free_len > pool->pchunk * MEMPOOL_TLS_FREE_CHUNKS_MAX)) {
+    mempool_tls_release(tls, pool->pchunk);
+  }
+}
+
+/**
+ * Give the thread-local free elements back to the pool. The element count of the pool is
+ * updated when the last handle is destroyed.
+ */
+void BLI_mempool_tls_destroy(BLI_mempool_tls *tls)
+{
+  BLI_mempool *pool = tls->pool;
+
+  mempool_tls_release(tls, 0);
+
+  BLI_spin_lock(&pool->lock);
+  BLI_assert(pool->tls_len > 0);
+  pool->tls_totused_delta += tls->totused_delta;
+  if (--pool->tls_len == 0) {
+    BLI_assert((int64_t)pool->totused + pool->tls_totused_delta >= 0);
+    pool->totused = (uint)((int64_t)pool->totused + pool->tls_totused_delta);
+    pool->tls_totused_delta = 0;
+  }
+  BLI_spin_unlock(&pool->lock);
+
+  MEM_freeN(tls);
+}
+
+/** \} */
+
 /**
  * Empty the pool, as if it were just created.
  *
@@ -783,6 +1031,8 @@ void BLI_mempool_destroy(BLI_mempool *pool)
 {
   mempool_chunk_free_all(pool->chunks);
 
+  BLI_spin_end(&pool->lock);
+
 #ifdef WITH_MEM_VALGRIND
   VALGRIND_DESTROY_MEMPOOL(pool);
 #endif
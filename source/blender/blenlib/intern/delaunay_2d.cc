@@ -313,6 +313,12 @@ template<typename Arith_t> struct CDTArrangement {
    */
   void delete_edge(SymEdge<Arith_t> *se);
 
+  /**
+   * Move all edges and faces of \a other to the end of this arrangement. They must not refer to
+   * faces of \a other, except for the outer face, which has to be shared.
+   */
+  void take_elements_from(CDTArrangement<Arith_t> &other);
+
   /**
    * If the vertex with index i in the vert array has not been merge, return it.
    * Else return the one that it has merged to.
@@ -872,6 +878,17 @@ template<typename T> CDTFace<T> *CDTArrangement<T>::add_face()
   return f;
 }
 
+template<typename T> void CDTArrangement<T>::take_elements_from(CDTArrangement<T> &other)
+{
+  BLI_assert(other.verts.is_empty());
+  this->edges.extend(other.edges);
+  this->faces.extend(other.faces);
+  /* The elements are owned by this arrangement now. */
+  other.edges.clear();
+  other.faces.clear();
+  other.outer_face = nullptr;
+}
+
 template<typename T> void CDTArrangement<T>::reserve(int num_verts, int num_edges, int num_faces)
 {
   /* These reserves are just guesses; OK if they aren't exactly right since vectors will resize. */
@@ -1242,6 +1259,12 @@ inline bool dc_tri_valid(SymEdge<T> *se, SymEdge<T> *basel, SymEdge<T> *basel_sy
   return filtered_orient2d(se->next->vert->co, basel_sym->vert->co, basel->vert->co) > 0;
 }
 
+/**
+ * Sub-problems with at least this many sites are split into halves that are triangulated in
+ * parallel. Smaller ones are not worth the overhead of the separate arrangement.
+ */
+constexpr int dc_tri_parallel_threshold = 16384;
+
 /**
  * Delaunay triangulate sites[start} to sites[end-1].
  * Assume sites are lexicographically sorted by coordinate.
@@ -1308,8 +1331,23 @@ void dc_tri(CDTArrangement<T> *cdt,
   SymEdge<T> *ldi;
   SymEdge<T> *rdi;
   SymEdge<T> *rdo;
-  dc_tri(cdt, sites, start, start + n2, &ldo, &ldi);
-  dc_tri(cdt, sites, start + n2, end, &rdi, &rdo);
+  if (n >= dc_tri_parallel_threshold) {
+    /* The halves are independent, so they can be triangulated in parallel. The right half adds its
+     * elements to a separate arrangement, which are appended afterwards. That way the elements end
+     * up in the same order as when triangulating serially, so the output does not depend on
+     * threading. */
+    CDTArrangement<T> right_cdt;
+    right_cdt.outer_face = cdt->outer_face;
+    threading::parallel_invoke(
+        [&]() { dc_tri(cdt, sites, start, start + n2, &ldo, &ldi); },
+        [&]() { dc_tri(&right_cdt, sites, start + n2, end, &rdi, &rdo); });
+    BLI_assert(right_cdt.outer_face == cdt->outer_face);
+    cdt->take_elements_from(right_cdt);
+  }
+  else {
+    dc_tri(cdt, sites, start, start + n2, &ldo, &ldi);
+    dc_tri(cdt, sites, start + n2, end, &rdi, &rdo);
+  }
   if (dbg_level > 0) {
     std::cout << "\nDC_TRI merge step for start=" << start << ", end=" << end << "\n";
     std::cout << "ldo " << ldo << "\n"
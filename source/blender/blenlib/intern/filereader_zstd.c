@@ -28,9 +28,37 @@
 #include "BLI_endian_switch.h"
 #include "BLI_filereader.h"
 #include "BLI_math_base.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
 
 #include "MEM_guardedalloc.h"
 
+/**
+ * Upper limit for the number of frames kept in memory when reading ahead,
+ * the writer uses frames of 1mb of uncompressed data.
+ */
+#define ZSTD_READAHEAD_FRAMES_MAX 16
+
+typedef enum eZstdFrameState {
+  ZSTD_FRAME_EMPTY = 0,
+  /** The compressed data is read, waiting to be decompressed. */
+  ZSTD_FRAME_QUEUED,
+  ZSTD_FRAME_RUNNING,
+  ZSTD_FRAME_DONE,
+  ZSTD_FRAME_FAILED,
+} eZstdFrameState;
+
+/** A cached frame, used for frame `frame % slots_len` of the seek table. */
+typedef struct ZstdFrameSlot {
+  int frame;
+  /** #eZstdFrameState, protected by the mutex of the reader. */
+  int state;
+  char *compressed_data;
+  size_t compressed_size;
+  char *uncompressed_data;
+  size_t uncompressed_size;
+} ZstdFrameSlot;
+
 typedef struct {
   FileReader reader;
 
@@ -45,8 +73,17 @@ typedef struct {
     size_t *compressed_ofs;
     size_t *uncompressed_ofs;
 
-    char *cached_content;
-    int cached_frame;
+    /**
+     * Decompressed frames. When reading frames in order, the following frames are decompressed
+     * on worker threads while the current one is being read, see #zstd_readahead.
+     */
+    ZstdFrameSlot *slots;
+    int slots_len;
+    int last_frame;
+    /** Only used for reading ahead, NULL when there is only a single slot. */
+    TaskPool *pool;
+    ThreadMutex mutex;
+    ThreadCondition cond;
   } seek;
 } ZstdReader;
 
@@ -142,11 +179,43 @@ static bool zstd_read_seek_table(ZstdReader *zstd)
     return false;
   }
 
-  zstd->seek.cached_frame = -1;
-
   return true;
 }
 
+static void zstd_slots_init(ZstdReader *zstd)
+{
+  const int threads_len = BLI_system_thread_count();
+  zstd->seek.slots_len = (threads_len > 1) ?
+                             min_ii(min_ii(threads_len * 2, ZSTD_READAHEAD_FRAMES_MAX),
+                                    zstd->seek.num_frames) :
+                             1;
+  zstd->seek.slots_len = max_ii(zstd->seek.slots_len, 1);
+  zstd->seek.slots = MEM_calloc_arrayN(
+      zstd->seek.slots_len, sizeof(*zstd->seek.slots), "ZstdReader.seek.slots");
+  zstd->seek.last_frame = -1;
+
+  BLI_mutex_init(&zstd->seek.mutex);
+  BLI_condition_init(&zstd->seek.cond);
+  if (zstd->seek.slots_len > 1) {
+    zstd->seek.pool = BLI_task_pool_create(zstd, TASK_PRIORITY_HIGH);
+  }
+}
+
+static void zstd_slots_free(ZstdReader *zstd)
+{
+  if (zstd->seek.pool) {
+    BLI_task_pool_work_and_wait(zstd->seek.pool);
+    BLI_task_pool_free(zstd->seek.pool);
+  }
+  for (int i = 0; i < zstd->seek.slots_len; i++) {
+    MEM_SAFE_FREE(zstd->seek.slots[i].compressed_data);
+    MEM_SAFE_FREE(zstd->seek.slots[i].uncompressed_data);
+  }
+  MEM_freeN(zstd->seek.slots);
+  BLI_mutex_end(&zstd->seek.mutex);
+  BLI_condition_end(&zstd->seek.cond);
+}
+
 /* Find out which frame contains the given position in the uncompressed stream.
  * Basically just bisection. */
 static int zstd_frame_from_pos(ZstdReader *zstd, size_t pos)
@@ -170,41 +239,155 @@ static int zstd_frame_from_pos(ZstdReader *zstd, size_t pos)
   return low;
 }
 
-/* Ensure that the currently loaded frame is the correct one. */
-static const char *zstd_ensure_cache(ZstdReader *zstd, int frame)
+/**
+ * Decompress the data of a queued slot, \a ctx may be NULL when called from a worker thread.
+ */
+static bool zstd_slot_decompress(ZstdFrameSlot *slot, ZSTD_DCtx *ctx)
+{
+  char *uncompressed_data = MEM_mallocN(slot->uncompressed_size, __func__);
+  size_t res = ctx ? ZSTD_decompressDCtx(ctx,
+                                         uncompressed_data,
+                                         slot->uncompressed_size,
+                                         slot->compressed_data,
+                                         slot->compressed_size) :
+                     ZSTD_decompress(uncompressed_data,
+                                     slot->uncompressed_size,
+                                     slot->compressed_data,
+                                     slot->compressed_size);
+  MEM_SAFE_FREE(slot->compressed_data);
+  if (ZSTD_isError(res) || res < slot->uncompressed_size) {
+    MEM_freeN(uncompressed_data);
+    return false;
+  }
+  slot->uncompressed_data = uncompressed_data;
+  return true;
+}
+
+static int zstd_slot_state_get(ZstdReader *zstd, const ZstdFrameSlot *slot)
 {
-  if (zstd->seek.cached_frame == frame) {
-    /* Cached frame matches, so just return it. */
-    return zstd->seek.cached_content;
+  BLI_mutex_lock(&zstd->seek.mutex);
+  const int state = slot->state;
+  BLI_mutex_unlock(&zstd->seek.mutex);
+  return state;
+}
+
+/** Decompress the slot on the calling thread, unless a worker thread already started it. */
+static void zstd_slot_run(ZstdReader *zstd, ZstdFrameSlot *slot, ZSTD_DCtx *ctx)
+{
+  BLI_mutex_lock(&zstd->seek.mutex);
+  if (slot->state != ZSTD_FRAME_QUEUED) {
+    BLI_mutex_unlock(&zstd->seek.mutex);
+    return;
   }
+  slot->state = ZSTD_FRAME_RUNNING;
+  BLI_mutex_unlock(&zstd->seek.mutex);
 
-  /* Cached frame doesn't match, so discard it and cache the wanted one instead. */
-  MEM_SAFE_FREE(zstd->seek.cached_content);
+  const bool ok = zstd_slot_decompress(slot, ctx);
 
-  size_t compressed_size = zstd->seek.compressed_ofs[frame + 1] - zstd->seek.compressed_ofs[frame];
-  size_t uncompressed_size = zstd->seek.uncompressed_ofs[frame + 1] -
-                             zstd->seek.uncompressed_ofs[frame];
+  BLI_mutex_lock(&zstd->seek.mutex);
+  slot->state = ok ? ZSTD_FRAME_DONE : ZSTD_FRAME_FAILED;
+  BLI_condition_notify_all(&zstd->seek.cond);
+  BLI_mutex_unlock(&zstd->seek.mutex);
+}
 
-  char *uncompressed_data = MEM_mallocN(uncompressed_size, __func__);
+static void zstd_slot_task(TaskPool *__restrict pool, void *taskdata)
+{
+  ZstdReader *zstd = BLI_task_pool_user_data(pool);
+  zstd_slot_run(zstd, taskdata, NULL);
+}
+
+/** Wait for the slot to be decompressed, doing it on the calling thread when it wasn't started. */
+static void zstd_slot_wait(ZstdReader *zstd, ZstdFrameSlot *slot)
+{
+  zstd_slot_run(zstd, slot, zstd->ctx);
+
+  BLI_mutex_lock(&zstd->seek.mutex);
+  while (slot->state == ZSTD_FRAME_RUNNING) {
+    BLI_condition_wait(&zstd->seek.cond, &zstd->seek.mutex);
+  }
+  BLI_mutex_unlock(&zstd->seek.mutex);
+}
+
+/** Discard the frame in the slot, waiting for the worker thread decompressing it to finish. */
+static void zstd_slot_clear(ZstdReader *zstd, ZstdFrameSlot *slot)
+{
+  BLI_mutex_lock(&zstd->seek.mutex);
+  while (slot->state == ZSTD_FRAME_RUNNING) {
+    BLI_condition_wait(&zstd->seek.cond, &zstd->seek.mutex);
+  }
+  /* A task that is still queued finds the slot empty, or decompresses the frame loaded next. */
+  slot->state = ZSTD_FRAME_EMPTY;
+  BLI_mutex_unlock(&zstd->seek.mutex);
+
+  MEM_SAFE_FREE(slot->compressed_data);
+  MEM_SAFE_FREE(slot->uncompressed_data);
+}
+
+/**
+ * Read the compressed data of \a frame into its slot. Only the reading thread accesses the base
+ * reader, the decompression can then be done on any thread.
+ */
+static ZstdFrameSlot *zstd_slot_load(ZstdReader *zstd, int frame)
+{
+  ZstdFrameSlot *slot = &zstd->seek.slots[frame % zstd->seek.slots_len];
+  if (slot->frame == frame &&
+      !ELEM(zstd_slot_state_get(zstd, slot), ZSTD_FRAME_EMPTY, ZSTD_FRAME_FAILED)) {
+    return slot;
+  }
+  zstd_slot_clear(zstd, slot);
+
+  size_t compressed_size = zstd->seek.compressed_ofs[frame + 1] - zstd->seek.compressed_ofs[frame];
   char *compressed_data = MEM_mallocN(compressed_size, __func__);
   if (zstd->base->seek(zstd->base, zstd->seek.compressed_ofs[frame], SEEK_SET) < 0 ||
       zstd->base->read(zstd->base, compressed_data, compressed_size) < compressed_size) {
     MEM_freeN(compressed_data);
-    MEM_freeN(uncompressed_data);
     return NULL;
   }
 
-  size_t res = ZSTD_decompressDCtx(
-      zstd->ctx, uncompressed_data, uncompressed_size, compressed_data, compressed_size);
-  MEM_freeN(compressed_data);
-  if (ZSTD_isError(res) || res < uncompressed_size) {
-    MEM_freeN(uncompressed_data);
+  slot->frame = frame;
+  slot->compressed_data = compressed_data;
+  slot->compressed_size = compressed_size;
+  slot->uncompressed_size = zstd->seek.uncompressed_ofs[frame + 1] -
+                            zstd->seek.uncompressed_ofs[frame];
+  BLI_mutex_lock(&zstd->seek.mutex);
+  slot->state = ZSTD_FRAME_QUEUED;
+  BLI_mutex_unlock(&zstd->seek.mutex);
+  return slot;
+}
+
+/** Queue decompression of the frames following \a frame on worker threads. */
+static void zstd_readahead(ZstdReader *zstd, int frame)
+{
+  const int frame_end = min_ii(frame + zstd->seek.slots_len, zstd->seek.num_frames);
+  for (int frame_next = frame + 1; frame_next < frame_end; frame_next++) {
+    ZstdFrameSlot *slot = &zstd->seek.slots[frame_next % zstd->seek.slots_len];
+    if (slot->frame == frame_next && zstd_slot_state_get(zstd, slot) != ZSTD_FRAME_EMPTY) {
+      continue;
+    }
+    slot = zstd_slot_load(zstd, frame_next);
+    if (slot == NULL) {
+      break;
+    }
+    BLI_task_pool_push(zstd->seek.pool, zstd_slot_task, slot, false, NULL);
+  }
+}
+
+/* Ensure that the wanted frame is decompressed and return its data. */
+static const char *zstd_ensure_cache(ZstdReader *zstd, int frame)
+{
+  ZstdFrameSlot *slot = zstd_slot_load(zstd, frame);
+  if (slot == NULL) {
     return NULL;
   }
 
-  zstd->seek.cached_frame = frame;
-  zstd->seek.cached_content = uncompressed_data;
-  return uncompressed_data;
+  /* Only read ahead for sequential reading, random access would mostly waste the work. */
+  if (zstd->seek.pool && frame == zstd->seek.last_frame + 1) {
+    zstd_readahead(zstd, frame);
+  }
+  zstd->seek.last_frame = frame;
+
+  zstd_slot_wait(zstd, slot);
+  return (zstd_slot_state_get(zstd, slot) == ZSTD_FRAME_DONE) ? slot->uncompressed_data : NULL;
 }
 
 static ssize_t zstd_read_seekable(FileReader *reader, void *buffer, size_t size)
@@ -295,9 +478,9 @@ static void zstd_close(FileReader *reader)
 
   ZSTD_freeDCtx(zstd->ctx);
   if (zstd->reader.seek) {
+    zstd_slots_free(zstd);
     MEM_freeN(zstd->seek.uncompressed_ofs);
     MEM_freeN(zstd->seek.compressed_ofs);
-    MEM_freeN(zstd->seek.cached_content);
   }
   else {
     MEM_freeN((void *)zstd->in_buf.src);
@@ -315,6 +498,7 @@ FileReader *BLI_filereader_new_zstd(FileReader *base)
   zstd->base = base;
 
   if (zstd_read_seek_table(zstd)) {
+    zstd_slots_init(zstd);
     zstd->reader.read = zstd_read_seekable;
     zstd->reader.seek = zstd_seek;
   }
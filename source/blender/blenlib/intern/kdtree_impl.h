@@ -23,6 +23,7 @@
 #include "BLI_kdtree_impl.h"
 #include "BLI_math.h"
 #include "BLI_strict_flags.h"
+#include "BLI_task.h"
 #include "BLI_utildefines.h"
 
 #define _CONCAT_AUX(MACRO_ARG1, MACRO_ARG2) MACRO_ARG1##MACRO_ARG2
@@ -58,6 +59,11 @@ struct KDTree {
 
 #define KD_NODE_UNSET ((uint)-1)
 
+/* Sub-trees with more nodes than this are balanced in their own task. */
+#define KD_BALANCE_THREAD_THRESHOLD 8192
+/* Number of query points handled by each task of the batch queries. */
+#define KD_BATCH_CHUNK_SIZE 256
+
 /**
  * When set we know all values are unbalanced,
  * otherwise clear them when re-balancing: see T62210.
@@ -145,19 +151,15 @@ void BLI_kdtree_nd_(insert)(KDTree *tree, int index, const float co[KD_DIMS])
 #endif
 }
 
-static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs)
+/**
+ * Partition the nodes so the median along \a axis is in the middle,
+ * smaller values before it, larger values after.
+ */
+static uint kdtree_balance_median(KDTreeNode *nodes, uint nodes_len, uint axis)
 {
-  KDTreeNode *node;
   float co;
   uint left, right, median, i, j;
 
-  if (nodes_len <= 0) {
-    return KD_NODE_UNSET;
-  }
-  else if (nodes_len == 1) {
-    return 0 + ofs;
-  }
-
   /* Quick-sort style sorting around median. */
   left = 0;
   right = nodes_len - 1;
@@ -190,6 +192,23 @@ static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const u
     }
   }
 
+  return median;
+}
+
+static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs)
+{
+  KDTreeNode *node;
+  uint median;
+
+  if (nodes_len <= 0) {
+    return KD_NODE_UNSET;
+  }
+  else if (nodes_len == 1) {
+    return 0 + ofs;
+  }
+
+  median = kdtree_balance_median(nodes, nodes_len, axis);
+
   /* set node and sort subnodes */
   node = &nodes[median];
   node->d = axis;
@@ -201,6 +220,53 @@ static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const u
   return median + ofs;
 }
 
+typedef struct KDTreeBalanceTask {
+  KDTreeNode *nodes;
+  uint nodes_len;
+  uint axis;
+  uint ofs;
+} KDTreeBalanceTask;
+
+static uint kdtree_balance_threaded(
+    TaskPool *pool, KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs);
+
+static void kdtree_balance_task_run(TaskPool *__restrict pool, void *taskdata)
+{
+  const KDTreeBalanceTask *task = taskdata;
+  kdtree_balance_threaded(pool, task->nodes, task->nodes_len, task->axis, task->ofs);
+}
+
+/**
+ * Same result as #kdtree_balance, the left side of large sub-trees is balanced in a new task.
+ * Both sides only touch their own nodes, and the index of their root is known up-front
+ * since it's always the middle of the range.
+ */
+static uint kdtree_balance_threaded(
+    TaskPool *pool, KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs)
+{
+  if (nodes_len <= KD_BALANCE_THREAD_THRESHOLD) {
+    return kdtree_balance(nodes, nodes_len, axis, ofs);
+  }
+
+  const uint median = kdtree_balance_median(nodes, nodes_len, axis);
+  KDTreeNode *node = &nodes[median];
+  node->d = axis;
+  axis = (axis + 1) % KD_DIMS;
+
+  KDTreeBalanceTask *task = MEM_mallocN(sizeof(*task), __func__);
+  task->nodes = nodes;
+  task->nodes_len = median;
+  task->axis = axis;
+  task->ofs = ofs;
+  BLI_task_pool_push(pool, kdtree_balance_task_run, task, true, NULL);
+
+  node->left = (median / 2) + ofs;
+  node->right = kdtree_balance_threaded(
+      pool, nodes + median + 1, (nodes_len - (median + 1)), axis, (median + 1) + ofs);
+
+  return median + ofs;
+}
+
 void BLI_kdtree_nd_(balance)(KDTree *tree)
 {
   if (tree->root != KD_NODE_ROOT_IS_INIT) {
@@ -210,7 +276,15 @@ void BLI_kdtree_nd_(balance)(KDTree *tree)
     }
   }
 
-  tree->root = kdtree_balance(tree->nodes, tree->nodes_len, 0, 0);
+  if (tree->nodes_len > KD_BALANCE_THREAD_THRESHOLD) {
+    TaskPool *pool = BLI_task_pool_create(NULL, TASK_PRIORITY_HIGH);
+    tree->root = kdtree_balance_threaded(pool, tree->nodes, tree->nodes_len, 0, 0);
+    BLI_task_pool_work_and_wait(pool);
+    BLI_task_pool_free(pool);
+  }
+  else {
+    tree->root = kdtree_balance(tree->nodes, tree->nodes_len, 0, 0);
+  }
 
 #ifdef DEBUG
   tree->is_balanced = true;
@@ -625,8 +699,10 @@ static void nearest_add_in_range(KDTreeNearest **r_nearest,
   KDTreeNearest *to;
 
   if (UNLIKELY(nearest_index >= *nearest_len_capacity)) {
+    /* Grow geometrically, batch searches collect the results of many points in one array. */
+    *nearest_len_capacity = max_uu(*nearest_len_capacity * 2, KD_FOUND_ALLOC_INC);
     *r_nearest = MEM_reallocN_id(
-        *r_nearest, (*nearest_len_capacity += KD_FOUND_ALLOC_INC) * sizeof(KDTreeNode), __func__);
+        *r_nearest, *nearest_len_capacity * sizeof(KDTreeNearest), __func__);
   }
 
   to = (*r_nearest) + nearest_index;
@@ -637,40 +713,29 @@ static void nearest_add_in_range(KDTreeNearest **r_nearest,
 }
 
 /**
- * Range search returns number of points nearest_len, with results in nearest
+ * Range search appending the results to \a nearest (starting at \a nearest_len),
+ * the appended results are sorted by distance.
  *
- * \param r_nearest: Allocated array of nearest nearest_len (caller is responsible for freeing).
+ * \return the number of results appended.
  */
-int BLI_kdtree_nd_(range_search_with_len_squared_cb)(
+static uint kdtree_range_search_append(
     const KDTree *tree,
     const float co[KD_DIMS],
-    KDTreeNearest **r_nearest,
     const float range,
     float (*len_sq_fn)(const float co_search[KD_DIMS],
                        const float co_test[KD_DIMS],
                        const void *user_data),
-    const void *user_data)
+    const void *user_data,
+    KDTreeNearest **nearest,
+    uint *nearest_len,
+    uint *nearest_len_capacity)
 {
   const KDTreeNode *nodes = tree->nodes;
   uint *stack, stack_default[KD_STACK_INIT];
-  KDTreeNearest *nearest = NULL;
   const float range_sq = range * range;
+  const uint nearest_len_prev = *nearest_len;
   float dist_sq;
   uint stack_len_capacity, cur = 0;
-  uint nearest_len = 0, nearest_len_capacity = 0;
-
-#ifdef DEBUG
-  BLI_assert(tree->is_balanced == true);
-#endif
-
-  if (UNLIKELY(tree->root == KD_NODE_UNSET)) {
-    return 0;
-  }
-
-  if (len_sq_fn == NULL) {
-    len_sq_fn = len_squared_vnvn_cb;
-    BLI_assert(user_data == NULL);
-  }
 
   stack = stack_default;
   stack_len_capacity = ARRAY_SIZE(stack_default);
@@ -694,7 +759,7 @@ int BLI_kdtree_nd_(range_search_with_len_squared_cb)(
       dist_sq = len_sq_fn(co, node->co, user_data);
       if (dist_sq <= range_sq) {
         nearest_add_in_range(
-            &nearest, nearest_len++, &nearest_len_capacity, node->index, dist_sq, node->co);
+            nearest, (*nearest_len)++, nearest_len_capacity, node->index, dist_sq, node->co);
       }
 
       if (node->left != KD_NODE_UNSET) {
@@ -714,10 +779,48 @@ int BLI_kdtree_nd_(range_search_with_len_squared_cb)(
     MEM_freeN(stack);
   }
 
-  if (nearest_len) {
-    qsort(nearest, nearest_len, sizeof(KDTreeNearest), nearest_cmp_dist);
+  const uint found_len = *nearest_len - nearest_len_prev;
+  if (found_len) {
+    qsort(*nearest + nearest_len_prev, found_len, sizeof(KDTreeNearest), nearest_cmp_dist);
+  }
+
+  return found_len;
+}
+
+/**
+ * Range search returns number of points nearest_len, with results in nearest
+ *
+ * \param r_nearest: Allocated array of nearest nearest_len (caller is responsible for freeing).
+ */
+int BLI_kdtree_nd_(range_search_with_len_squared_cb)(
+    const KDTree *tree,
+    const float co[KD_DIMS],
+    KDTreeNearest **r_nearest,
+    const float range,
+    float (*len_sq_fn)(const float co_search[KD_DIMS],
+                       const float co_test[KD_DIMS],
+                       const void *user_data),
+    const void *user_data)
+{
+  KDTreeNearest *nearest = NULL;
+  uint nearest_len = 0, nearest_len_capacity = 0;
+
+#ifdef DEBUG
+  BLI_assert(tree->is_balanced == true);
+#endif
+
+  if (UNLIKELY(tree->root == KD_NODE_UNSET)) {
+    return 0;
+  }
+
+  if (len_sq_fn == NULL) {
+    len_sq_fn = len_squared_vnvn_cb;
+    BLI_assert(user_data == NULL);
   }
 
+  kdtree_range_search_append(
+      tree, co, range, len_sq_fn, user_data, &nearest, &nearest_len, &nearest_len_capacity);
+
   *r_nearest = nearest;
 
   return (int)nearest_len;
@@ -806,6 +909,236 @@ finally:
   }
 }
 
+/* -------------------------------------------------------------------- */
+/** \name BLI_kdtree_3d batch queries
+ *
+ * Search for many points at once, threaded over chunks of #KD_BATCH_CHUNK_SIZE points.
+ * Searches returning a variable number of results per point write them into a single array,
+ * the results of point `i` are in `r_offsets[i]` to `r_offsets[i + 1]`.
+ * \{ */
+
+typedef struct KDTreeBatchData {
+  const KDTree *tree;
+  const float (*co)[KD_DIMS];
+  uint co_len;
+
+  /* Search arguments. */
+  uint nearest_len_capacity;
+  float range;
+
+  /* Results of #BLI_kdtree_3d_find_nearest_batch. */
+  KDTreeNearest *r_nearest;
+
+  /* The results found by each chunk of points, the number of results per point are stored
+   * in `r_offsets[i + 1]` until they are accumulated into offsets. */
+  KDTreeNearest **chunk_nearest;
+  int *r_offsets;
+  KDTreeNearest *nearest;
+} KDTreeBatchData;
+
+static void kdtree_batch_find_nearest_cb(void *__restrict userdata,
+                                         const int i,
+                                         const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const KDTreeBatchData *data = userdata;
+  if (BLI_kdtree_nd_(find_nearest)(data->tree, data->co[i], &data->r_nearest[i]) == -1) {
+    data->r_nearest[i].index = -1;
+  }
+}
+
+static void kdtree_batch_find_nearest_n_cb(void *__restrict userdata,
+                                           const int chunk,
+                                           const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const KDTreeBatchData *data = userdata;
+  const uint begin = (uint)chunk * KD_BATCH_CHUNK_SIZE;
+  const uint end = min_uu(begin + KD_BATCH_CHUNK_SIZE, data->co_len);
+  KDTreeNearest *nearest = data->nearest_len_capacity ?
+                               MEM_malloc_arrayN((end - begin) * data->nearest_len_capacity,
+                                                 sizeof(*nearest),
+                                                 __func__) :
+                               NULL;
+  uint nearest_len = 0;
+
+  for (uint i = begin; i < end; i++) {
+    const int found_len = BLI_kdtree_nd_(find_nearest_n)(
+        data->tree, data->co[i], nearest + nearest_len, data->nearest_len_capacity);
+    nearest_len += (uint)found_len;
+    data->r_offsets[i + 1] = found_len;
+  }
+  data->chunk_nearest[chunk] = nearest;
+}
+
+static void kdtree_batch_range_search_cb(void *__restrict userdata,
+                                         const int chunk,
+                                         const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const KDTreeBatchData *data = userdata;
+  const uint begin = (uint)chunk * KD_BATCH_CHUNK_SIZE;
+  const uint end = min_uu(begin + KD_BATCH_CHUNK_SIZE, data->co_len);
+  KDTreeNearest *nearest = NULL;
+  uint nearest_len = 0, nearest_len_capacity = 0;
+
+  for (uint i = begin; i < end; i++) {
+    data->r_offsets[i + 1] = (int)kdtree_range_search_append(data->tree,
+                                                             data->co[i],
+                                                             data->range,
+                                                             len_squared_vnvn_cb,
+                                                             NULL,
+                                                             &nearest,
+                                                             &nearest_len,
+                                                             &nearest_len_capacity);
+  }
+  data->chunk_nearest[chunk] = nearest;
+}
+
+static void kdtree_batch_gather_cb(void *__restrict userdata,
+                                   const int chunk,
+                                   const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const KDTreeBatchData *data = userdata;
+  const uint begin = (uint)chunk * KD_BATCH_CHUNK_SIZE;
+  const uint end = min_uu(begin + KD_BATCH_CHUNK_SIZE, data->co_len);
+  const int nearest_len = data->r_offsets[end] - data->r_offsets[begin];
+
+  if (nearest_len) {
+    memcpy(data->nearest + data->r_offsets[begin],
+           data->chunk_nearest[chunk],
+           sizeof(*data->nearest) * (size_t)nearest_len);
+  }
+  MEM_SAFE_FREE(data->chunk_nearest[chunk]);
+}
+
+/**
+ * Run \a chunk_fn for all chunks of points, then gather their results into one array.
+ */
+static int kdtree_batch_search(KDTreeBatchData *data,
+                               TaskParallelRangeFunc chunk_fn,
+                               KDTreeNearest **r_nearest)
+{
+  const int chunks_num = (int)((data->co_len + KD_BATCH_CHUNK_SIZE - 1) / KD_BATCH_CHUNK_SIZE);
+
+  data->r_offsets[0] = 0;
+  if (UNLIKELY(data->tree->root == KD_NODE_UNSET)) {
+    for (uint i = 0; i < data->co_len; i++) {
+      data->r_offsets[i + 1] = 0;
+    }
+    *r_nearest = NULL;
+    return 0;
+  }
+
+  data->chunk_nearest = MEM_calloc_arrayN((size_t)chunks_num, sizeof(KDTreeNearest *), __func__);
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (chunks_num > 1);
+  BLI_task_parallel_range(0, chunks_num, data, chunk_fn, &settings);
+
+  for (uint i = 0; i < data->co_len; i++) {
+    data->r_offsets[i + 1] += data->r_offsets[i];
+  }
+  const int nearest_len = data->r_offsets[data->co_len];
+
+  data->nearest = nearest_len ?
+                      MEM_malloc_arrayN((size_t)nearest_len, sizeof(KDTreeNearest), __func__) :
+                      NULL;
+  BLI_task_parallel_range(0, chunks_num, data, kdtree_batch_gather_cb, &settings);
+  MEM_freeN(data->chunk_nearest);
+
+  *r_nearest = data->nearest;
+  return nearest_len;
+}
+
+/**
+ * #BLI_kdtree_3d_find_nearest for each point in \a co.
+ *
+ * \param r_nearest: An array of \a co_len, the index is -1 when no node is found.
+ */
+void BLI_kdtree_nd_(find_nearest_batch)(const KDTree *tree,
+                                        const float (*co)[KD_DIMS],
+                                        const uint co_len,
+                                        KDTreeNearest *r_nearest)
+{
+  KDTreeBatchData data = {
+      .tree = tree,
+      .co = co,
+      .co_len = co_len,
+      .r_nearest = r_nearest,
+  };
+
+#ifdef DEBUG
+  BLI_assert(tree->is_balanced == true);
+#endif
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (co_len > KD_BATCH_CHUNK_SIZE);
+  settings.min_iter_per_thread = KD_BATCH_CHUNK_SIZE;
+  BLI_task_parallel_range(0, (int)co_len, &data, kdtree_batch_find_nearest_cb, &settings);
+}
+
+/**
+ * #BLI_kdtree_3d_find_nearest_n for each point in \a co.
+ *
+ * \param r_nearest: Allocated array of all results, sorted by distance for each point
+ * (caller is responsible for freeing).
+ * \param r_offsets: An array of `co_len + 1`, the start of the results of each point.
+ * \return the total number of results.
+ */
+int BLI_kdtree_nd_(find_nearest_n_batch)(const KDTree *tree,
+                                         const float (*co)[KD_DIMS],
+                                         const uint co_len,
+                                         const uint nearest_len_capacity,
+                                         KDTreeNearest **r_nearest,
+                                         int *r_offsets)
+{
+  KDTreeBatchData data = {
+      .tree = tree,
+      .co = co,
+      .co_len = co_len,
+      .nearest_len_capacity = nearest_len_capacity,
+      .r_offsets = r_offsets,
+  };
+
+#ifdef DEBUG
+  BLI_assert(tree->is_balanced == true);
+#endif
+
+  return kdtree_batch_search(&data, kdtree_batch_find_nearest_n_cb, r_nearest);
+}
+
+/**
+ * #BLI_kdtree_3d_range_search for each point in \a co.
+ *
+ * \param r_nearest: Allocated array of all results, sorted by distance for each point
+ * (caller is responsible for freeing).
+ * \param r_offsets: An array of `co_len + 1`, the start of the results of each point.
+ * \return the total number of results.
+ */
+int BLI_kdtree_nd_(range_search_batch)(const KDTree *tree,
+                                       const float (*co)[KD_DIMS],
+                                       const uint co_len,
+                                       const float range,
+                                       KDTreeNearest **r_nearest,
+                                       int *r_offsets)
+{
+  KDTreeBatchData data = {
+      .tree = tree,
+      .co = co,
+      .co_len = co_len,
+      .range = range,
+      .r_offsets = r_offsets,
+  };
+
+#ifdef DEBUG
+  BLI_assert(tree->is_balanced == true);
+#endif
+
+  return kdtree_batch_search(&data, kdtree_batch_range_search_cb, r_nearest);
+}
+
+/** \} */
+
 /**
  * Use when we want to loop over nodes ordered by index.
  * Requires indices to be aligned with nodes.
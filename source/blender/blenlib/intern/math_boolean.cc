@@ -2518,6 +2518,45 @@ int orient3d_fast(const double3 &a, const double3 &b, const double3 &c, const do
   return sgn(robust_pred::orient3dfast(a, b, c, d));
 }
 
+/**
+ * Index of the #orient3d determinant, using the Burnikel et al. rules with input
+ * coordinates of index 1: the differences have index 2, the 2x2 minors have index 6,
+ * the three terms of the expansion have index 9, and the two additions make it 11.
+ */
+constexpr int index_orient3d = 11;
+
+int orient3d_filter(const double3 &a, const double3 &b, const double3 &c, const double3 &d)
+{
+  double adx = a[0] - d[0];
+  double bdx = b[0] - d[0];
+  double cdx = c[0] - d[0];
+  double ady = a[1] - d[1];
+  double bdy = b[1] - d[1];
+  double cdy = c[1] - d[1];
+  double adz = a[2] - d[2];
+  double bdz = b[2] - d[2];
+  double cdz = c[2] - d[2];
+
+  double det = adz * (bdx * cdy - cdx * bdy) + bdz * (cdx * ady - adx * cdy) +
+               cdz * (adx * bdy - bdx * ady);
+  if (det == 0.0) {
+    return 0;
+  }
+
+  /* The supremum replaces every difference by a sum and every value by its absolute value. */
+  double3 abs_d = double3::abs(d);
+  double3 sa = double3::abs(a) + abs_d;
+  double3 sb = double3::abs(b) + abs_d;
+  double3 sc = double3::abs(c) + abs_d;
+  double supremum = sa.z * (sb.x * sc.y + sc.x * sb.y) + sb.z * (sc.x * sa.y + sa.x * sc.y) +
+                    sc.z * (sa.x * sb.y + sb.x * sa.y);
+  double err_bound = supremum * index_orient3d * DBL_EPSILON;
+  if (fabs(det) > err_bound) {
+    return det > 0 ? 1 : -1;
+  }
+  return 0;
+}
+
 int insphere(
     const double3 &a, const double3 &b, const double3 &c, const double3 &d, const double3 &e)
 {
@@ -23,6 +23,7 @@
 #include "MEM_guardedalloc.h"
 
 #include "BLI_task.h"
+#include "BLI_task_profile.hh"
 
 #include <memory>
 #include <vector>
@@ -91,19 +92,31 @@ struct TaskNode {
 #ifdef WITH_TBB
   tbb::flow::continue_msg run(const tbb::flow::continue_msg UNUSED(input))
   {
-    run_func(task_data);
+    run_task();
     return tbb::flow::continue_msg();
   }
 #endif
 
   void run_serial()
   {
-    run_func(task_data);
+    run_task();
     for (TaskNode *successor : successors) {
       successor->run_serial();
     }
   }
 
+  void run_task()
+  {
+    namespace profile = blender::threading::profile;
+    /* Nodes are started by their predecessors, so there is no meaningful origin thread. */
+    const profile::CallSite *profile_call_site =
+        profile::is_enabled() ?
+            profile::call_site_for_function((const void *)run_func, profile::Category::TaskGraph) :
+            nullptr;
+    profile::ScopedEvent profile_event(profile_call_site, profile::EventType::Task, 1, -1);
+    run_func(task_data);
+  }
+
 #ifdef WITH_CXX_GUARDEDALLOC
   MEM_CXX_CLASS_ALLOC_FUNCS("task_graph:TaskNode")
 #endif
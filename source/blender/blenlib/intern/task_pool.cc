@@ -31,6 +31,7 @@
 #include "BLI_math.h"
 #include "BLI_mempool.h"
 #include "BLI_task.h"
+#include "BLI_task_profile.hh"
 #include "BLI_threads.h"
 
 #ifdef WITH_TBB
@@ -39,6 +40,8 @@
 #  include <tbb/task_group.h>
 #endif
 
+namespace profile = blender::threading::profile;
+
 /* Task
  *
  * Unit of work to execute. This is a C++ class to work with TBB. */
@@ -50,13 +53,20 @@ class Task {
   void *taskdata;
   bool free_taskdata;
   TaskFreeFunction freedata;
+  /* Thread that created the task, only set while task profiling is enabled. */
+  int profile_thread;
 
   Task(TaskPool *pool,
        TaskRunFunction run,
        void *taskdata,
        bool free_taskdata,
        TaskFreeFunction freedata)
-      : pool(pool), run(run), taskdata(taskdata), free_taskdata(free_taskdata), freedata(freedata)
+      : pool(pool),
+        run(run),
+        taskdata(taskdata),
+        free_taskdata(free_taskdata),
+        freedata(freedata),
+        profile_thread(profile::is_enabled() ? profile::thread_index() : -1)
   {
   }
 
@@ -81,7 +91,8 @@ class Task {
         run(other.run),
         taskdata(other.taskdata),
         free_taskdata(other.free_taskdata),
-        freedata(other.freedata)
+        freedata(other.freedata),
+        profile_thread(other.profile_thread)
   {
     other.pool = nullptr;
     other.run = nullptr;
@@ -96,7 +107,8 @@ class Task {
         run(other.run),
         taskdata(other.taskdata),
         free_taskdata(other.free_taskdata),
-        freedata(other.freedata)
+        freedata(other.freedata),
+        profile_thread(other.profile_thread)
   {
     ((Task &)other).pool = NULL;
     ((Task &)other).run = NULL;
@@ -175,6 +187,12 @@ struct TaskPool {
 /* Execute task. */
 void Task::operator()() const
 {
+  const profile::CallSite *profile_call_site =
+      profile::is_enabled() ?
+          profile::call_site_for_function((const void *)run, profile::Category::TaskPool) :
+          nullptr;
+  profile::ScopedEvent profile_event(
+      profile_call_site, profile::EventType::Task, 1, profile_thread);
   run(pool, taskdata);
 }
 
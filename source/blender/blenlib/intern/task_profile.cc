@@ -0,0 +1,490 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup bli
+ *
+ * Recording of task scheduler events, see BLI_task_profile.hh.
+ *
+ * Every thread appends events to its own buffer, so that recording does not require locks. The
+ * buffers are registered globally and never freed, because threads of the scheduler may outlive
+ * a recording. Reading the buffers is only allowed when no tasks are running.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+
+#include "BLI_fileops.h"
+#include "BLI_map.hh"
+#include "BLI_task.h"
+#include "BLI_task_profile_stats.hh"
+
+#if defined(__linux__) || defined(__APPLE__)
+#  include <dlfcn.h>
+#endif
+#ifdef __GNUC__
+#  include <cxxabi.h>
+#endif
+
+namespace blender::threading::profile {
+
+std::atomic<bool> is_enabled_flag = false;
+
+struct Event {
+  const CallSite *call_site;
+  EventType type;
+  /** Nesting level of the event on its thread. Zero for events that are not inside others. */
+  int depth;
+  int origin_thread;
+  int64_t items;
+  /** Nanoseconds since the start of the recording. */
+  int64_t start_time;
+  int64_t end_time;
+};
+
+struct ThreadBuffer {
+  int thread_index;
+  int depth = 0;
+  Vector<Event> events;
+};
+
+using Clock = std::chrono::steady_clock;
+
+static struct {
+  std::mutex mutex;
+  Vector<std::unique_ptr<ThreadBuffer>> thread_buffers;
+  Map<std::pair<const void *, Category>, std::unique_ptr<CallSite>> call_sites;
+  Clock::time_point start_time = Clock::now();
+  int64_t end_time = 0;
+  std::string filepath;
+} g_profile;
+
+static thread_local ThreadBuffer *g_thread_buffer = nullptr;
+
+static int64_t current_time()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                              g_profile.start_time)
+      .count();
+}
+
+static ThreadBuffer &get_thread_buffer()
+{
+  if (g_thread_buffer == nullptr) {
+    std::lock_guard lock{g_profile.mutex};
+    std::unique_ptr<ThreadBuffer> buffer = std::make_unique<ThreadBuffer>();
+    buffer->thread_index = static_cast<int>(g_profile.thread_buffers.size());
+    g_thread_buffer = buffer.get();
+    g_profile.thread_buffers.append(std::move(buffer));
+  }
+  return *g_thread_buffer;
+}
+
+int thread_index()
+{
+  return get_thread_buffer().thread_index;
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Call Sites
+ * \{ */
+
+static std::string demangle(const char *name)
+{
+#ifdef __GNUC__
+  int status;
+  char *demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+  if (status == 0) {
+    std::string result = demangled;
+    free(demangled);
+    return result;
+  }
+#endif
+  return name;
+}
+
+static std::string function_name(const void *function)
+{
+#if defined(__linux__) || defined(__APPLE__)
+  Dl_info info;
+  if (dladdr(function, &info) && info.dli_sname != nullptr) {
+    return demangle(info.dli_sname);
+  }
+#endif
+  char address[32];
+  snprintf(address, sizeof(address), "%p", function);
+  return address;
+}
+
+/** Extract the template argument from the signature of #call_site_for_type. */
+static std::string type_name(const std::string &signature)
+{
+  /* GCC and Clang: `... call_site_for_type(Category) [with Function = Type]`. */
+  const std::string gnu_prefix = "Function = ";
+  const size_t gnu_start = signature.find(gnu_prefix);
+  if (gnu_start != std::string::npos && signature.back() == ']') {
+    const size_t start = gnu_start + gnu_prefix.size();
+    return signature.substr(start, signature.size() - start - 1);
+  }
+  /* MSVC: `... call_site_for_type<Type>(...)`. */
+  const std::string msvc_prefix = "call_site_for_type<";
+  const size_t msvc_start = signature.find(msvc_prefix);
+  const size_t msvc_end = signature.rfind(">(");
+  if (msvc_start != std::string::npos && msvc_end != std::string::npos && msvc_end > msvc_start) {
+    const size_t start = msvc_start + msvc_prefix.size();
+    return signature.substr(start, msvc_end - start);
+  }
+  return signature;
+}
+
+template<typename GetNameFn>
+static const CallSite *lookup_call_site(const void *key,
+                                        const Category category,
+                                        const GetNameFn &get_name)
+{
+  /* Looking up a call site happens for every task, avoid locking the global map every time. */
+  static thread_local Map<std::pair<const void *, Category>, const CallSite *> cache;
+  const std::pair<const void *, Category> cache_key{key, category};
+  if (const CallSite *const *call_site = cache.lookup_ptr(cache_key)) {
+    return *call_site;
+  }
+  std::lock_guard lock{g_profile.mutex};
+  const CallSite *call_site = g_profile.call_sites
+                                  .lookup_or_add_cb(cache_key,
+                                                    [&]() {
+                                                      return std::make_unique<CallSite>(
+                                                          CallSite{get_name(), category});
+                                                    })
+                                  .get();
+  cache.add_new(cache_key, call_site);
+  return call_site;
+}
+
+const CallSite *call_site_for_function(const void *function, const Category category)
+{
+  return lookup_call_site(function, category, [&]() { return function_name(function); });
+}
+
+const CallSite *call_site_for_type(const void *type_key,
+                                   const char *signature,
+                                   const Category category)
+{
+  return lookup_call_site(type_key, category, [&]() { return type_name(signature); });
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Recording
+ * \{ */
+
+void ScopedEvent::begin()
+{
+  get_thread_buffer().depth++;
+  start_time_ = current_time();
+}
+
+void ScopedEvent::end()
+{
+  const int64_t end_time = current_time();
+  ThreadBuffer &buffer = get_thread_buffer();
+  buffer.depth--;
+  buffer.events.append(
+      {call_site_, type_, buffer.depth, origin_thread_, items_, start_time_, end_time});
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Statistics
+ * \{ */
+
+static int64_t recording_end_time()
+{
+  return is_enabled() ? current_time() : g_profile.end_time;
+}
+
+Vector<CallSiteStats> call_site_stats()
+{
+  Map<const CallSite *, CallSiteStats> stats_map;
+  for (const std::unique_ptr<ThreadBuffer> &buffer : g_profile.thread_buffers) {
+    for (const Event &event : buffer->events) {
+      CallSiteStats &stats = stats_map.lookup_or_add_cb(event.call_site, [&]() {
+        CallSiteStats stats;
+        stats.call_site = event.call_site;
+        return stats;
+      });
+      const int64_t duration = event.end_time - event.start_time;
+      if (event.type == EventType::Call) {
+        stats.calls++;
+        stats.call_time += duration;
+        continue;
+      }
+      stats.tasks++;
+      if (event.origin_thread != -1 && event.origin_thread != buffer->thread_index) {
+        stats.stolen_tasks++;
+      }
+      stats.items += event.items;
+      stats.task_time += duration;
+      stats.min_task_time = std::min(stats.min_task_time, duration);
+      stats.max_task_time = std::max(stats.max_task_time, duration);
+    }
+  }
+
+  Vector<CallSiteStats> result;
+  for (const CallSiteStats &stats : stats_map.values()) {
+    result.append(stats);
+  }
+  std::sort(result.begin(), result.end(), [](const CallSiteStats &a, const CallSiteStats &b) {
+    return a.task_time > b.task_time;
+  });
+  return result;
+}
+
+Vector<ThreadStats> thread_stats()
+{
+  const int64_t total_time = recording_end_time();
+  Vector<ThreadStats> result;
+  for (const std::unique_ptr<ThreadBuffer> &buffer : g_profile.thread_buffers) {
+    ThreadStats stats;
+    stats.thread_index = buffer->thread_index;
+    for (const Event &event : buffer->events) {
+      if (event.type == EventType::Task) {
+        stats.tasks++;
+      }
+      /* Nested events run while the thread is busy with the outer event already. */
+      if (event.depth == 0) {
+        stats.busy_time += event.end_time - event.start_time;
+      }
+    }
+    stats.idle_time = std::max<int64_t>(total_time - stats.busy_time, 0);
+    result.append(stats);
+  }
+  return result;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Chrome Trace Export
+ * \{ */
+
+static const char *category_name(const Category category)
+{
+  switch (category) {
+    case Category::TaskPool:
+      return "task_pool";
+    case Category::TaskGraph:
+      return "task_graph";
+    case Category::ParallelRange:
+      return "parallel_range";
+    case Category::ParallelFor:
+      return "parallel_for";
+  }
+  return "";
+}
+
+static void write_json_string(FILE *file, const StringRef str)
+{
+  fputc('"', file);
+  for (const char c : str) {
+    switch (c) {
+      case '"':
+        fputs("\\\"", file);
+        break;
+      case '\\':
+        fputs("\\\\", file);
+        break;
+      case '\n':
+        fputs("\\n", file);
+        break;
+      case '\t':
+        fputs("\\t", file);
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          fprintf(file, "\\u%04x", c);
+        }
+        else {
+          fputc(c, file);
+        }
+        break;
+    }
+  }
+  fputc('"', file);
+}
+
+static bool write_chrome_trace(const char *filepath)
+{
+  FILE *file = BLI_fopen(filepath, "w");
+  if (file == nullptr) {
+    return false;
+  }
+
+  fputs("{\"traceEvents\":[\n", file);
+  bool is_first = true;
+  for (const std::unique_ptr<ThreadBuffer> &buffer : g_profile.thread_buffers) {
+    if (!is_first) {
+      fputs(",\n", file);
+    }
+    is_first = false;
+    fprintf(file,
+            "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,"
+            "\"args\":{\"name\":\"Thread %d\"}}",
+            buffer->thread_index,
+            buffer->thread_index);
+
+    for (const Event &event : buffer->events) {
+      const bool is_stolen = event.origin_thread != -1 &&
+                             event.origin_thread != buffer->thread_index;
+      fputs(",\n{\"name\":", file);
+      write_json_string(file, event.call_site->name);
+      /* Timestamps are in microseconds. */
+      fprintf(file,
+              ",\"cat\":\"%s%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+              "\"args\":{\"items\":%" PRId64 ",\"origin_thread\":%d,\"stolen\":%s}}",
+              category_name(event.call_site->category),
+              event.type == EventType::Call ? "_call" : "",
+              buffer->thread_index,
+              event.start_time / 1000.0,
+              (event.end_time - event.start_time) / 1000.0,
+              event.items,
+              event.origin_thread,
+              is_stolen ? "true" : "false");
+    }
+  }
+  fputs("\n],\"displayTimeUnit\":\"ms\"}\n", file);
+
+  const bool success = ferror(file) == 0;
+  fclose(file);
+  return success;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Printing
+ * \{ */
+
+static void print_stats()
+{
+  const Vector<CallSiteStats> call_sites = call_site_stats();
+  const Vector<ThreadStats> threads = thread_stats();
+  const double ms = 1e-6;
+
+  printf("Task profile: %.3f ms recorded on %d threads\n",
+         recording_end_time() * ms,
+         static_cast<int>(threads.size()));
+
+  printf("%10s %8s %8s %8s %12s %10s %10s  %s\n",
+         "Time (ms)",
+         "Calls",
+         "Tasks",
+         "Stolen",
+         "Items",
+         "Min (ms)",
+         "Max (ms)",
+         "Call Site");
+  for (const CallSiteStats &stats : call_sites) {
+    printf("%10.3f %8" PRId64 " %8" PRId64 " %8" PRId64 " %12" PRId64 " %10.3f %10.3f  [%s] %s\n",
+           stats.task_time * ms,
+           stats.calls,
+           stats.tasks,
+           stats.stolen_tasks,
+           stats.items,
+           stats.tasks > 0 ? stats.min_task_time * ms : 0.0,
+           stats.max_task_time * ms,
+           category_name(stats.call_site->category),
+           stats.call_site->name.c_str());
+  }
+
+  printf("%10s %8s %10s %10s\n", "Thread", "Tasks", "Busy (ms)", "Idle (ms)");
+  for (const ThreadStats &stats : threads) {
+    printf("%10d %8" PRId64 " %10.3f %10.3f\n",
+           stats.thread_index,
+           stats.tasks,
+           stats.busy_time * ms,
+           stats.idle_time * ms);
+  }
+}
+
+/** \} */
+
+}  // namespace blender::threading::profile
+
+/* -------------------------------------------------------------------- */
+/** \name C API
+ * \{ */
+
+using namespace blender::threading::profile;
+
+void BLI_task_profile_begin(const char *filepath)
+{
+  BLI_task_profile_clear();
+  g_profile.filepath = filepath ? filepath : "";
+  g_profile.start_time = Clock::now();
+  is_enabled_flag = true;
+}
+
+void BLI_task_profile_end(void)
+{
+  if (!is_enabled()) {
+    return;
+  }
+  g_profile.end_time = current_time();
+  is_enabled_flag = false;
+
+  print_stats();
+  if (!g_profile.filepath.empty()) {
+    if (write_chrome_trace(g_profile.filepath.c_str())) {
+      printf("Task profile written to \"%s\"\n", g_profile.filepath.c_str());
+    }
+    else {
+      fprintf(stderr, "Unable to write task profile to \"%s\"\n", g_profile.filepath.c_str());
+    }
+  }
+}
+
+bool BLI_task_profile_is_enabled(void)
+{
+  return is_enabled();
+}
+
+void BLI_task_profile_clear(void)
+{
+  std::lock_guard lock{g_profile.mutex};
+  for (std::unique_ptr<ThreadBuffer> &buffer : g_profile.thread_buffers) {
+    buffer->events.clear_and_make_inline();
+  }
+  g_profile.start_time = Clock::now();
+  g_profile.end_time = 0;
+}
+
+bool BLI_task_profile_write_chrome_trace(const char *filepath)
+{
+  return write_chrome_trace(filepath);
+}
+
+void BLI_task_profile_print_stats(void)
+{
+  print_stats();
+}
+
+/** \} */
@@ -27,6 +27,7 @@
 #include "DNA_listBase.h"
 
 #include "BLI_task.h"
+#include "BLI_task_profile.hh"
 #include "BLI_threads.h"
 
 #include "atomic_ops.h"
@@ -38,6 +39,8 @@
 #  include <tbb/parallel_reduce.h>
 #endif
 
+namespace profile = blender::threading::profile;
+
 #ifdef WITH_TBB
 
 /* Functor for running TBB parallel_for and parallel_reduce. */
@@ -48,23 +51,43 @@ struct RangeTask {
 
   void *userdata_chunk;
 
+  /* Only set while task profiling is enabled. */
+  const profile::CallSite *profile_call_site;
+  int profile_thread;
+
   /* Root constructor. */
-  RangeTask(TaskParallelRangeFunc func, void *userdata, const TaskParallelSettings *settings)
-      : func(func), userdata(userdata), settings(settings)
+  RangeTask(TaskParallelRangeFunc func,
+            void *userdata,
+            const TaskParallelSettings *settings,
+            const profile::CallSite *profile_call_site,
+            int profile_thread)
+      : func(func),
+        userdata(userdata),
+        settings(settings),
+        profile_call_site(profile_call_site),
+        profile_thread(profile_thread)
   {
     init_chunk(settings->userdata_chunk);
   }
 
   /* Copy constructor. */
   RangeTask(const RangeTask &other)
-      : func(other.func), userdata(other.userdata), settings(other.settings)
+      : func(other.func),
+        userdata(other.userdata),
+        settings(other.settings),
+        profile_call_site(other.profile_call_site),
+        profile_thread(other.profile_thread)
   {
     init_chunk(settings->userdata_chunk);
   }
 
   /* Splitting constructor for parallel reduce. */
   RangeTask(RangeTask &other, tbb::split /* unused */)
-      : func(other.func), userdata(other.userdata), settings(other.settings)
+      : func(other.func),
+        userdata(other.userdata),
+        settings(other.settings),
+        profile_call_site(other.profile_call_site),
+        profile_thread(other.profile_thread)
   {
     init_chunk(settings->userdata_chunk);
   }
@@ -90,6 +113,8 @@ struct RangeTask {
 
   void operator()(const tbb::blocked_range<int> &r) const
   {
+    profile::ScopedEvent profile_event(
+        profile_call_site, profile::EventType::Task, r.size(), profile_thread);
     TaskParallelTLS tls;
     tls.userdata_chunk = userdata_chunk;
     for (int i = r.begin(); i != r.end(); ++i) {
@@ -114,7 +139,17 @@ void BLI_task_parallel_range(const int start,
 #ifdef WITH_TBB
   /* Multithreading. */
   if (settings->use_threading && BLI_task_scheduler_num_threads() > 1) {
-    RangeTask task(func, userdata, settings);
+    const profile::CallSite *profile_call_site = nullptr;
+    int profile_thread = -1;
+    if (profile::is_enabled()) {
+      profile_call_site = profile::call_site_for_function((const void *)func,
+                                                          profile::Category::ParallelRange);
+      profile_thread = profile::thread_index();
+    }
+    profile::ScopedEvent profile_event(
+        profile_call_site, profile::EventType::Call, stop - start, profile_thread);
+
+    RangeTask task(func, userdata, settings, profile_call_site, profile_thread);
     const size_t grainsize = MAX2(settings->min_iter_per_thread, 1);
     const tbb::blocked_range<int> range(start, stop, grainsize);
 
@@ -68,8 +68,10 @@ void BLI_task_scheduler_init()
 
 void BLI_task_scheduler_exit()
 {
+  /* Write the recording of `--debug-task-profile`. */
+  BLI_task_profile_end();
 #ifdef WITH_TBB_GLOBAL_CONTROL
-  OBJECT_GUARDED_DELETE(task_scheduler_global_control, tbb::global_control);
+  OBJECT_GUARDED_SAFE_DELETE(task_scheduler_global_control, tbb::global_control);
 #endif
 }
 
@@ -5,6 +5,7 @@
 #include "MEM_guardedalloc.h"
 
 extern "C" {
+#include "BLI_convexhull_2d.h"
 #include "BLI_math.h"
 #include "BLI_rand.h"
 #include "PIL_time.h"
@@ -1449,6 +1450,41 @@ template<typename T> void square_o_test()
   }
 }
 
+template<typename T> void manypts_test()
+{
+  /* Enough points for the initial triangulation to be split into parallel tasks. */
+  const int npts = 40000;
+  CDT_input<T> in;
+  in.vert = Array<vec2<T>>(npts);
+  float(*co)[2] = (float(*)[2])MEM_malloc_arrayN(npts, sizeof(*co), __func__);
+  RNG *rng = BLI_rng_new(0);
+  for (int i = 0; i < npts; ++i) {
+    co[i][0] = BLI_rng_get_float(rng);
+    co[i][1] = BLI_rng_get_float(rng);
+    in.vert[i] = vec2<T>(T(co[i][0]), T(co[i][1]));
+  }
+  BLI_rng_free(rng);
+  CDT_result<T> out = delaunay_2d_calc(in, CDT_FULL);
+
+  /* For points in general position, the triangulation only depends on the convex hull size. */
+  Array<int> hull(npts);
+  const int hull_len = BLI_convexhull_2d(co, npts, hull.data());
+  MEM_freeN(co);
+  EXPECT_EQ(out.vert.size(), npts);
+  EXPECT_EQ(out.edge.size(), 3 * npts - 3 - hull_len);
+  EXPECT_EQ(out.face.size(), 2 * npts - 2 - hull_len);
+  for (const Vector<int> &face : out.face) {
+    EXPECT_EQ(face.size(), 3);
+  }
+
+  /* The result must not depend on how the work was distributed over threads. */
+  CDT_result<T> out2 = delaunay_2d_calc(in, CDT_FULL);
+  ASSERT_EQ(out2.face.size(), out.face.size());
+  for (const int i : out.face.index_range()) {
+    EXPECT_EQ(out2.face[i], out.face[i]);
+  }
+}
+
 TEST(delaunay_d, Empty)
 {
   empty_test<double>();
@@ -1594,6 +1630,11 @@ TEST(delaunay_d, SquareO)
   square_o_test<double>();
 }
 
+TEST(delaunay_d, ManyPts)
+{
+  manypts_test<double>();
+}
+
 #  ifdef WITH_GMP
 TEST(delaunay_m, Empty)
 {
@@ -1733,6 +1774,11 @@ TEST(delaunay_m, RepeatTri)
 {
   repeattri_test<mpq_class>();
 }
+
+TEST(delaunay_m, ManyPts)
+{
+  manypts_test<mpq_class>();
+}
 #  endif
 #endif
 
@@ -0,0 +1,151 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <zstd.h>
+
+#include "BLI_filereader.h"
+#include "BLI_threads.h"
+
+static void append_u32(std::vector<char> &data, const uint32_t value)
+{
+  /* The seekable format is little endian. */
+  for (int i = 0; i < 4; i++) {
+    data.push_back(char((value >> (i * 8)) & 0xff));
+  }
+}
+
+/**
+ * Compress \a data into frames of \a frame_size, followed by the seek table, like
+ * `writefile.c` does for compressed blend-files.
+ */
+static std::vector<char> zstd_seekable_compress(const std::vector<char> &data,
+                                                const size_t frame_size)
+{
+  std::vector<char> result;
+  std::vector<uint32_t> frame_sizes;
+  for (size_t offset = 0; offset < data.size(); offset += frame_size) {
+    const size_t uncompressed_size = std::min(frame_size, data.size() - offset);
+    const size_t bound = ZSTD_compressBound(uncompressed_size);
+    const size_t result_size = result.size();
+    result.resize(result_size + bound);
+    const size_t compressed_size = ZSTD_compress(
+        &result[result_size], bound, &data[offset], uncompressed_size, 3);
+    EXPECT_FALSE(ZSTD_isError(compressed_size));
+    result.resize(result_size + compressed_size);
+    frame_sizes.push_back(uint32_t(compressed_size));
+    frame_sizes.push_back(uint32_t(uncompressed_size));
+  }
+
+  const uint32_t num_frames = uint32_t(frame_sizes.size() / 2);
+  append_u32(result, 0x184D2A5E);
+  append_u32(result, num_frames * 8 + 9);
+  for (const uint32_t size : frame_sizes) {
+    append_u32(result, size);
+  }
+  append_u32(result, num_frames);
+  result.push_back(0); /* Flags, no check-sums. */
+  append_u32(result, 0x8F92EAB1);
+  return result;
+}
+
+/** Data that compresses well but differs everywhere, so any misplaced read is detected. */
+static std::vector<char> test_data(const size_t size)
+{
+  std::vector<char> data(size);
+  for (size_t i = 0; i < size; i++) {
+    data[i] = char((i * 7) ^ (i >> 9) ^ (i >> 17));
+  }
+  return data;
+}
+
+/** Read with a seekable zstd reader that decompresses frames ahead on worker threads. */
+static FileReader *zstd_reader_new(const std::vector<char> &compressed)
+{
+  /* The number of frames decompressed ahead depends on the number of threads. */
+  const int threads_override = BLI_system_num_threads_override_get();
+  BLI_system_num_threads_override_set(8);
+  FileReader *reader = BLI_filereader_new_zstd(
+      BLI_filereader_new_memory(compressed.data(), compressed.size()));
+  BLI_system_num_threads_override_set(threads_override);
+  return reader;
+}
+
+static void expect_read(FileReader *reader,
+                        const std::vector<char> &data,
+                        const size_t offset,
+                        const size_t size)
+{
+  std::vector<char> buffer(size);
+  const size_t expected_size = offset < data.size() ? std::min(size, data.size() - offset) : 0;
+  ASSERT_EQ(reader->read(reader, buffer.data(), size), ssize_t(expected_size));
+  if (expected_size > 0) {
+    EXPECT_EQ(memcmp(buffer.data(), &data[offset], expected_size), 0) << "offset " << offset;
+  }
+}
+
+TEST(filereader, ZstdSeekableSequential)
+{
+  BLI_threadapi_init();
+
+  /* Many frames, more than are decompressed ahead, the last one is smaller. */
+  const size_t frame_size = 16 * 1024;
+  const std::vector<char> data = test_data(frame_size * 40 + 1234);
+  const std::vector<char> compressed = zstd_seekable_compress(data, frame_size);
+
+  FileReader *reader = zstd_reader_new(compressed);
+  ASSERT_NE(reader, nullptr);
+  ASSERT_NE(reader->seek, nullptr);
+
+  /* Reads that are smaller than frames and span frames. */
+  const size_t read_size = 5000;
+  for (size_t offset = 0; offset < data.size(); offset += read_size) {
+    expect_read(reader, data, offset, read_size);
+  }
+  expect_read(reader, data, data.size(), read_size);
+
+  reader->close(reader);
+  BLI_threadapi_exit();
+}
+
+TEST(filereader, ZstdSeekableSeek)
+{
+  BLI_threadapi_init();
+
+  const size_t frame_size = 16 * 1024;
+  const std::vector<char> data = test_data(frame_size * 40 + 1234);
+  const std::vector<char> compressed = zstd_seekable_compress(data, frame_size);
+
+  FileReader *reader = zstd_reader_new(compressed);
+  ASSERT_NE(reader, nullptr);
+
+  /* Start reading ahead, then seek back into frames that are being decompressed, forward past
+   * them, and continue reading in order after each seek. */
+  const size_t offsets[] = {0,
+                            frame_size * 3 + 100,
+                            frame_size * 2 - 10,
+                            frame_size * 30,
+                            frame_size * 5,
+                            frame_size * 6 - 1,
+                            frame_size * 39 + 17,
+                            frame_size};
+  for (const size_t offset : offsets) {
+    ASSERT_EQ(reader->seek(reader, off64_t(offset), SEEK_SET), off64_t(offset));
+    for (int i = 0; i < 4; i++) {
+      expect_read(reader, data, offset + i * frame_size, frame_size);
+    }
+  }
+
+  /* Relative seeks. */
+  ASSERT_EQ(reader->seek(reader, -off64_t(frame_size) * 2 - 3, SEEK_CUR),
+            off64_t(frame_size * 3 - 3));
+  expect_read(reader, data, frame_size * 3 - 3, frame_size * 2);
+  ASSERT_EQ(reader->seek(reader, -100, SEEK_END), off64_t(data.size() - 100));
+  expect_read(reader, data, data.size() - 100, frame_size);
+
+  reader->close(reader);
+  BLI_threadapi_exit();
+}
@@ -66,11 +66,15 @@ static void optimal_check_callback(void *userdata,
  * Note that a small epsilon is added to the BVH nodes bounds, even if we pass in zero.
  * Use rounding to ensure very close nodes don't cause the wrong node to be found as nearest.
  */
-static void find_nearest_points_test(
-    int points_len, float scale, int round, int random_seed, bool optimal = false)
+static void find_nearest_points_test(int points_len,
+                                     float scale,
+                                     int round,
+                                     int random_seed,
+                                     bool optimal = false,
+                                     int build_flag = 0)
 {
   struct RNG *rng = BLI_rng_new(random_seed);
-  BVHTree *tree = BLI_bvhtree_new(points_len, 0.0, 8, 8);
+  BVHTree *tree = BLI_bvhtree_new_ex(points_len, 0.0, 8, 8, build_flag);
 
   void *mem = MEM_mallocN(sizeof(float[3]) * points_len, __func__);
   float(*points)[3] = (float(*)[3])mem;
@@ -132,3 +136,144 @@ TEST(kdopbvh, OptimalFindNearest_500)
 {
   find_nearest_points_test(500, 1.0, 1000, 12, true);
 }
+
+TEST(kdopbvh, SAHFindNearest_1)
+{
+  find_nearest_points_test(1, 1.0, 1000, 1234, false, BVH_BUILD_SAH);
+}
+TEST(kdopbvh, SAHFindNearest_2)
+{
+  find_nearest_points_test(2, 1.0, 1000, 123, false, BVH_BUILD_SAH);
+}
+TEST(kdopbvh, SAHFindNearest_500)
+{
+  find_nearest_points_test(500, 1.0, 1000, 12, false, BVH_BUILD_SAH);
+}
+TEST(kdopbvh, SAHOptimalFindNearest_500)
+{
+  find_nearest_points_test(500, 1.0, 1000, 12, true, BVH_BUILD_SAH);
+}
+/* Many points in the same place, the SAH can't split these. */
+TEST(kdopbvh, SAHFindNearestCoincident_500)
+{
+  find_nearest_points_test(500, 1.0, 2, 12, false, BVH_BUILD_SAH);
+}
+
+/**
+ * Move all points after building, #BLI_bvhtree_update_tree must refit the tree
+ * so all of them are found in their new location.
+ */
+static void update_tree_find_nearest_test(int points_len,
+                                          char tree_type,
+                                          int random_seed,
+                                          int build_flag)
+{
+  struct RNG *rng = BLI_rng_new(random_seed);
+  BVHTree *tree = BLI_bvhtree_new_ex(points_len, 0.0, tree_type, 6, build_flag);
+
+  float(*points)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+  for (int i = 0; i < points_len; i++) {
+    rng_v3_round(points[i], 3, rng, 1000, 1.0f);
+    BLI_bvhtree_insert(tree, i, points[i], 1);
+  }
+  BLI_bvhtree_balance(tree);
+
+  for (int i = 0; i < points_len; i++) {
+    rng_v3_round(points[i], 3, rng, 1000, 2.0f);
+    BLI_bvhtree_update_node(tree, i, points[i], nullptr, 1);
+  }
+  BLI_bvhtree_update_tree(tree);
+
+  for (int i = 0; i < points_len; i++) {
+    const int j = BLI_bvhtree_find_nearest(tree, points[i], nullptr, nullptr, nullptr);
+    EXPECT_GE(j, 0);
+    EXPECT_LT(j, points_len);
+    EXPECT_EQ_ARRAY(points[i], points[j], 3);
+  }
+
+  BLI_bvhtree_free(tree);
+  BLI_rng_free(rng);
+  MEM_freeN(points);
+}
+
+TEST(kdopbvh, UpdateTree_5000)
+{
+  update_tree_find_nearest_test(5000, 2, 12, 0);
+  update_tree_find_nearest_test(5000, 4, 123, 0);
+}
+TEST(kdopbvh, SAHUpdateTree_5000)
+{
+  update_tree_find_nearest_test(5000, 2, 12, BVH_BUILD_SAH);
+  update_tree_find_nearest_test(5000, 4, 123, BVH_BUILD_SAH);
+}
+
+/**
+ * Check #BLI_bvhtree_ray_cast_batch gives the same hits as casting each ray separately.
+ */
+static void ray_cast_batch_test(
+    int points_len, int rays_len, float radius, int random_seed, bool axis_aligned = false)
+{
+  struct RNG *rng = BLI_rng_new(random_seed);
+  BVHTree *tree = BLI_bvhtree_new(points_len, 0.05f, 4, 6);
+
+  float(*points)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+  for (int i = 0; i < points_len; i++) {
+    rng_v3_round(points[i], 3, rng, 1000, 1.0f);
+    BLI_bvhtree_insert(tree, i, points[i], 1);
+  }
+  BLI_bvhtree_balance(tree);
+
+  float(*co)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * rays_len, __func__);
+  float(*dir)[3] = (float(*)[3])MEM_mallocN(sizeof(float[3]) * rays_len, __func__);
+  BVHTreeRayHit *hits = (BVHTreeRayHit *)MEM_mallocN(sizeof(BVHTreeRayHit) * rays_len, __func__);
+  for (int i = 0; i < rays_len; i++) {
+    rng_v3_round(co[i], 3, rng, 1000, 2.0f);
+    if (axis_aligned) {
+      zero_v3(dir[i]);
+      dir[i][i % 3] = (i % 2) ? 1.0f : -1.0f;
+    }
+    else {
+      BLI_rng_get_float_unit_v3(rng, dir[i]);
+    }
+    hits[i].index = -1;
+    hits[i].dist = BVH_RAYCAST_DIST_MAX;
+  }
+
+  BLI_bvhtree_ray_cast_batch(tree, co, dir, rays_len, radius, hits, nullptr, nullptr, 0);
+
+  for (int i = 0; i < rays_len; i++) {
+    BVHTreeRayHit hit;
+    hit.index = -1;
+    hit.dist = BVH_RAYCAST_DIST_MAX;
+    BLI_bvhtree_ray_cast_ex(tree, co[i], dir[i], radius, &hit, nullptr, nullptr, 0);
+    EXPECT_EQ(hit.index, hits[i].index);
+    if (hit.index != -1) {
+      EXPECT_EQ(hit.dist, hits[i].dist);
+      EXPECT_EQ_ARRAY(hit.co, hits[i].co, 3);
+    }
+  }
+
+  BLI_bvhtree_free(tree);
+  BLI_rng_free(rng);
+  MEM_freeN(points);
+  MEM_freeN(co);
+  MEM_freeN(dir);
+  MEM_freeN(hits);
+}
+
+TEST(kdopbvh, RayCastBatch_1)
+{
+  ray_cast_batch_test(1, 1, 0.0f, 1234);
+}
+TEST(kdopbvh, RayCastBatch_500)
+{
+  ray_cast_batch_test(500, 10003, 0.0f, 12);
+}
+TEST(kdopbvh, RayCastBatchAxisAligned_500)
+{
+  ray_cast_batch_test(500, 10003, 0.0f, 123, true);
+}
+TEST(kdopbvh, RayCastBatchRadius_500)
+{
+  ray_cast_batch_test(500, 10003, 0.01f, 1234);
+}
@@ -0,0 +1,173 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_kdtree.h"
+#include "BLI_math_vector.h"
+#include "BLI_rand.h"
+
+/* -------------------------------------------------------------------- */
+/* Helper Functions */
+
+/* More points than #KD_BALANCE_THREAD_THRESHOLD so balancing is threaded. */
+#define POINTS_LEN 20000
+#define SEARCH_LEN 2000
+
+static KDTree_3d *kdtree_random_new(float (*points)[3], int points_len, RNG *rng)
+{
+  KDTree_3d *tree = BLI_kdtree_3d_new(points_len);
+  for (int i = 0; i < points_len; i++) {
+    BLI_rng_get_float_unit_v3(rng, points[i]);
+    mul_v3_fl(points[i], BLI_rng_get_float(rng));
+    BLI_kdtree_3d_insert(tree, i, points[i]);
+  }
+  BLI_kdtree_3d_balance(tree);
+  return tree;
+}
+
+static void random_search_points(float (*search_co)[3], int search_len, RNG *rng)
+{
+  for (int i = 0; i < search_len; i++) {
+    BLI_rng_get_float_unit_v3(rng, search_co[i]);
+  }
+}
+
+/* -------------------------------------------------------------------- */
+/* Tests */
+
+TEST(kdtree, FindNearestBalanced)
+{
+  RNG *rng = BLI_rng_new(0);
+  float(*points)[3] = (float(*)[3])MEM_malloc_arrayN(POINTS_LEN, sizeof(*points), __func__);
+  KDTree_3d *tree = kdtree_random_new(points, POINTS_LEN, rng);
+
+  for (int i = 0; i < 100; i++) {
+    float co[3];
+    BLI_rng_get_float_unit_v3(rng, co);
+    float dist_sq_best = FLT_MAX;
+    for (int j = 0; j < POINTS_LEN; j++) {
+      dist_sq_best = min_ff(dist_sq_best, len_squared_v3v3(co, points[j]));
+    }
+    KDTreeNearest_3d nearest;
+    EXPECT_NE(BLI_kdtree_3d_find_nearest(tree, co, &nearest), -1);
+    EXPECT_FLOAT_EQ(nearest.dist, sqrtf(dist_sq_best));
+  }
+
+  BLI_kdtree_3d_free(tree);
+  MEM_freeN(points);
+  BLI_rng_free(rng);
+}
+
+TEST(kdtree, FindNearestBatch)
+{
+  RNG *rng = BLI_rng_new(1);
+  float(*points)[3] = (float(*)[3])MEM_malloc_arrayN(POINTS_LEN, sizeof(*points), __func__);
+  float(*search_co)[3] = (float(*)[3])MEM_malloc_arrayN(
+      SEARCH_LEN, sizeof(*search_co), __func__);
+  KDTree_3d *tree = kdtree_random_new(points, POINTS_LEN, rng);
+  random_search_points(search_co, SEARCH_LEN, rng);
+
+  KDTreeNearest_3d *nearest = (KDTreeNearest_3d *)MEM_malloc_arrayN(
+      SEARCH_LEN, sizeof(*nearest), __func__);
+  BLI_kdtree_3d_find_nearest_batch(tree, search_co, SEARCH_LEN, nearest);
+
+  for (int i = 0; i < SEARCH_LEN; i++) {
+    KDTreeNearest_3d nearest_single;
+    EXPECT_EQ(BLI_kdtree_3d_find_nearest(tree, search_co[i], &nearest_single), nearest[i].index);
+    EXPECT_EQ(nearest_single.dist, nearest[i].dist);
+  }
+
+  BLI_kdtree_3d_free(tree);
+  MEM_freeN(points);
+  MEM_freeN(search_co);
+  MEM_freeN(nearest);
+  BLI_rng_free(rng);
+}
+
+TEST(kdtree, FindNearestNBatch)
+{
+  RNG *rng = BLI_rng_new(2);
+  float(*points)[3] = (float(*)[3])MEM_malloc_arrayN(POINTS_LEN, sizeof(*points), __func__);
+  float(*search_co)[3] = (float(*)[3])MEM_malloc_arrayN(
+      SEARCH_LEN, sizeof(*search_co), __func__);
+  KDTree_3d *tree = kdtree_random_new(points, POINTS_LEN, rng);
+  random_search_points(search_co, SEARCH_LEN, rng);
+
+  const int nearest_len_capacity = 5;
+  KDTreeNearest_3d *nearest;
+  int *offsets = (int *)MEM_malloc_arrayN(SEARCH_LEN + 1, sizeof(int), __func__);
+  const int nearest_len = BLI_kdtree_3d_find_nearest_n_batch(
+      tree, search_co, SEARCH_LEN, nearest_len_capacity, &nearest, offsets);
+  EXPECT_EQ(nearest_len, SEARCH_LEN * nearest_len_capacity);
+  EXPECT_EQ(offsets[0], 0);
+  EXPECT_EQ(offsets[SEARCH_LEN], nearest_len);
+
+  for (int i = 0; i < SEARCH_LEN; i++) {
+    KDTreeNearest_3d nearest_single[nearest_len_capacity];
+    const int found = BLI_kdtree_3d_find_nearest_n(
+        tree, search_co[i], nearest_single, nearest_len_capacity);
+    EXPECT_EQ(found, offsets[i + 1] - offsets[i]);
+    for (int j = 0; j < found; j++) {
+      EXPECT_EQ(nearest_single[j].index, nearest[offsets[i] + j].index);
+    }
+  }
+
+  BLI_kdtree_3d_free(tree);
+  MEM_freeN(points);
+  MEM_freeN(search_co);
+  MEM_freeN(nearest);
+  MEM_freeN(offsets);
+  BLI_rng_free(rng);
+}
+
+TEST(kdtree, RangeSearchBatch)
+{
+  RNG *rng = BLI_rng_new(3);
+  float(*points)[3] = (float(*)[3])MEM_malloc_arrayN(POINTS_LEN, sizeof(*points), __func__);
+  float(*search_co)[3] = (float(*)[3])MEM_malloc_arrayN(
+      SEARCH_LEN, sizeof(*search_co), __func__);
+  KDTree_3d *tree = kdtree_random_new(points, POINTS_LEN, rng);
+  random_search_points(search_co, SEARCH_LEN, rng);
+
+  const float range = 0.1f;
+  KDTreeNearest_3d *nearest;
+  int *offsets = (int *)MEM_malloc_arrayN(SEARCH_LEN + 1, sizeof(int), __func__);
+  const int nearest_len = BLI_kdtree_3d_range_search_batch(
+      tree, search_co, SEARCH_LEN, range, &nearest, offsets);
+  EXPECT_GT(nearest_len, 0);
+  EXPECT_EQ(offsets[SEARCH_LEN], nearest_len);
+
+  for (int i = 0; i < SEARCH_LEN; i++) {
+    KDTreeNearest_3d *nearest_single = nullptr;
+    const int found = BLI_kdtree_3d_range_search(tree, search_co[i], &nearest_single, range);
+    EXPECT_EQ(found, offsets[i + 1] - offsets[i]);
+    for (int j = 0; j < found; j++) {
+      EXPECT_EQ(nearest_single[j].dist, nearest[offsets[i] + j].dist);
+    }
+    MEM_SAFE_FREE(nearest_single);
+  }
+
+  BLI_kdtree_3d_free(tree);
+  MEM_freeN(points);
+  MEM_freeN(search_co);
+  MEM_freeN(nearest);
+  MEM_freeN(offsets);
+  BLI_rng_free(rng);
+}
+
+TEST(kdtree, RangeSearchBatchEmpty)
+{
+  KDTree_3d *tree = BLI_kdtree_3d_new(0);
+  BLI_kdtree_3d_balance(tree);
+
+  const float search_co[2][3] = {{0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}};
+  KDTreeNearest_3d *nearest;
+  int offsets[3];
+  EXPECT_EQ(BLI_kdtree_3d_range_search_batch(tree, search_co, 2, 1.0f, &nearest, offsets), 0);
+  EXPECT_EQ(nearest, nullptr);
+  EXPECT_EQ(offsets[2], 0);
+
+  BLI_kdtree_3d_free(tree);
+}
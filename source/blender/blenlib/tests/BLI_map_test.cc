@@ -653,6 +653,107 @@ TEST(map, LookupKey)
   EXPECT_EQ(map.lookup_key_ptr("a"), map.lookup_key_ptr_as("a"));
 }
 
+TEST(map, GroupProbingStrategy)
+{
+  Map<int, int, 4, GroupProbingStrategy> map;
+  EXPECT_FALSE(map.contains(3));
+  map.add(3, 30);
+  map.add(5, 50);
+  EXPECT_EQ(map.lookup(3), 30);
+  EXPECT_EQ(map.lookup(5), 50);
+  EXPECT_FALSE(map.contains(4));
+  EXPECT_TRUE(map.remove(3));
+  EXPECT_FALSE(map.contains(3));
+  EXPECT_EQ(map.size(), 1);
+  map.clear();
+  EXPECT_FALSE(map.contains(5));
+
+  /* Compare many random operations with a map using the default probing strategy. */
+  Map<int, int> reference;
+  RNG *rng = BLI_rng_new(0);
+  for (int i = 0; i < 100000; i++) {
+    const int key = BLI_rng_get_int(rng) % 5000;
+    switch (i % 4) {
+      case 0:
+      case 1:
+        EXPECT_EQ(map.add(key, i), reference.add(key, i));
+        break;
+      case 2:
+        EXPECT_EQ(map.remove(key), reference.remove(key));
+        break;
+      case 3:
+        EXPECT_EQ(map.lookup_default(key, -1), reference.lookup_default(key, -1));
+        break;
+    }
+  }
+  BLI_rng_free(rng);
+
+  EXPECT_EQ(map.size(), reference.size());
+  for (auto item : reference.items()) {
+    EXPECT_EQ(map.lookup(item.key), item.value);
+  }
+  int count = 0;
+  for (auto item : map.items()) {
+    EXPECT_EQ(reference.lookup(item.key), item.value);
+    count++;
+  }
+  EXPECT_EQ(count, map.size());
+}
+
+TEST(map, GroupProbingStrategyCollisions)
+{
+  /* The default hash of integers is the identity, so all these keys start probing in the same
+   * group and have to be placed in other groups. */
+  Map<int, int, 0, GroupProbingStrategy> map;
+  for (int i = 0; i < 1000; i++) {
+    map.add_new(i << 20, i);
+  }
+  for (int i = 0; i < 1000; i += 2) {
+    EXPECT_EQ(map.pop(i << 20), i);
+  }
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_EQ(map.contains(i << 20), i % 2 == 1);
+    EXPECT_FALSE(map.contains((i << 20) + 1));
+  }
+
+  Map<int, int, 0, GroupProbingStrategy> moved_map = std::move(map);
+  Map<int, int, 0, GroupProbingStrategy> copied_map = moved_map;
+  EXPECT_EQ(copied_map.size(), 500);
+  copied_map.add_new(2 << 20, 2);
+  EXPECT_EQ(copied_map.lookup(1 << 20), 1);
+  EXPECT_EQ(copied_map.lookup(2 << 20), 2);
+  EXPECT_FALSE(moved_map.contains(2 << 20));
+
+  copied_map.clear();
+  EXPECT_FALSE(copied_map.contains(1 << 20));
+  copied_map.add_new(1 << 20, 5);
+  EXPECT_EQ(copied_map.lookup(1 << 20), 5);
+}
+
+TEST(map, GroupProbingStrategyRemoveDuringIteration)
+{
+  Map<std::string, int, 4, GroupProbingStrategy> map;
+  for (int i = 0; i < 100; i++) {
+    map.add(std::to_string(i), i);
+  }
+
+  using Iter = Map<std::string, int, 4, GroupProbingStrategy>::MutableItemIterator;
+  Iter begin = map.items().begin();
+  Iter end = map.items().end();
+  for (Iter iter = begin; iter != end; ++iter) {
+    if ((*iter).value % 3 == 0) {
+      map.remove(iter);
+    }
+  }
+
+  EXPECT_EQ(map.size(), 66);
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(map.contains(std::to_string(i)), i % 3 != 0);
+  }
+  map.add_new("3", 3);
+  EXPECT_EQ(map.lookup_as("3"), 3);
+}
+
 /**
  * Set this to 1 to activate the benchmark. It is disabled by default, because it prints a lot.
  */
@@ -0,0 +1,231 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_utildefines.h"
+
+#include "BLI_mempool.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+
+#define NUM_ITEMS 100000
+
+struct MempoolTestData {
+  BLI_mempool *pool;
+  /** Elements allocated by each iteration. */
+  int **elems;
+  /** Optional elements freed by each iteration, allocated by another iteration. */
+  int **elems_free;
+};
+
+struct MempoolTestChunk {
+  BLI_mempool_tls *tls;
+};
+
+static BLI_mempool_tls *mempool_test_tls_ensure(const MempoolTestData *data,
+                                                const TaskParallelTLS *__restrict tls)
+{
+  MempoolTestChunk *chunk = (MempoolTestChunk *)tls->userdata_chunk;
+  if (chunk->tls == nullptr) {
+    chunk->tls = BLI_mempool_tls_create(data->pool);
+  }
+  return chunk->tls;
+}
+
+static void mempool_test_tls_free_func(const void *__restrict UNUSED(userdata),
+                                       void *__restrict userdata_chunk)
+{
+  MempoolTestChunk *chunk = (MempoolTestChunk *)userdata_chunk;
+  if (chunk->tls != nullptr) {
+    BLI_mempool_tls_destroy(chunk->tls);
+    chunk->tls = nullptr;
+  }
+}
+
+static void mempool_test_alloc_func(void *__restrict userdata,
+                                    const int index,
+                                    const TaskParallelTLS *__restrict tls)
+{
+  MempoolTestData *data = (MempoolTestData *)userdata;
+  BLI_mempool_tls *pool_tls = mempool_test_tls_ensure(data, tls);
+
+  if (data->elems_free != nullptr) {
+    BLI_mempool_tls_free(pool_tls, data->elems_free[index]);
+  }
+
+  /* Allocate and free some temporary elements as well, to stress the thread-local lists. */
+  int *temp[3];
+  for (int *&elem : temp) {
+    elem = (int *)BLI_mempool_tls_calloc(pool_tls);
+    EXPECT_EQ(*elem, 0);
+    *elem = -1;
+  }
+  data->elems[index] = (int *)BLI_mempool_tls_alloc(pool_tls);
+  *data->elems[index] = index;
+  for (int *elem : temp) {
+    BLI_mempool_tls_free(pool_tls, elem);
+  }
+}
+
+static void mempool_test_free_func(void *__restrict userdata,
+                                   const int index,
+                                   const TaskParallelTLS *__restrict tls)
+{
+  MempoolTestData *data = (MempoolTestData *)userdata;
+  BLI_mempool_tls_free(mempool_test_tls_ensure(data, tls), data->elems[index]);
+  data->elems[index] = nullptr;
+}
+
+static void mempool_test_parallel(MempoolTestData *data,
+                                  TaskParallelRangeFunc func,
+                                  const int min_iter_per_thread)
+{
+  MempoolTestChunk chunk = {nullptr};
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = min_iter_per_thread;
+  settings.userdata_chunk = &chunk;
+  settings.userdata_chunk_size = sizeof(chunk);
+  settings.func_free = mempool_test_tls_free_func;
+  BLI_task_parallel_range(0, NUM_ITEMS, data, func, &settings);
+}
+
+/* Check that iterating over the pool gives every element of \a elems exactly once. */
+static void mempool_test_check_iter(BLI_mempool *pool, int **elems)
+{
+  EXPECT_EQ(BLI_mempool_len(pool), NUM_ITEMS);
+
+  bool *found = (bool *)MEM_callocN(sizeof(*found) * NUM_ITEMS, __func__);
+  int found_len = 0;
+  BLI_mempool_iter iter;
+  BLI_mempool_iternew(pool, &iter);
+  for (int *elem = (int *)BLI_mempool_iterstep(&iter); elem;
+       elem = (int *)BLI_mempool_iterstep(&iter)) {
+    ASSERT_TRUE(*elem >= 0 && *elem < NUM_ITEMS);
+    EXPECT_FALSE(found[*elem]);
+    EXPECT_EQ(elems[*elem], elem);
+    found[*elem] = true;
+    found_len++;
+  }
+  EXPECT_EQ(found_len, NUM_ITEMS);
+  MEM_freeN(found);
+}
+
+TEST(mempool, TlsAllocFree)
+{
+  BLI_threadapi_init();
+
+  MempoolTestData data;
+  data.pool = BLI_mempool_create(sizeof(int), 0, 512, BLI_MEMPOOL_ALLOW_ITER);
+  data.elems = (int **)MEM_callocN(sizeof(*data.elems) * NUM_ITEMS, __func__);
+  data.elems_free = nullptr;
+
+  mempool_test_parallel(&data, mempool_test_alloc_func, 1);
+  mempool_test_check_iter(data.pool, data.elems);
+
+  /* Free with a different partitioning, so elements are freed by other threads. */
+  mempool_test_parallel(&data, mempool_test_free_func, 4096);
+  EXPECT_EQ(BLI_mempool_len(data.pool), 0);
+
+  /* Reuse the freed elements. */
+  mempool_test_parallel(&data, mempool_test_alloc_func, 1024);
+  mempool_test_check_iter(data.pool, data.elems);
+
+  /* Regular single threaded use keeps working. */
+  for (int i = 0; i < NUM_ITEMS; i += 2) {
+    BLI_mempool_free(data.pool, data.elems[i]);
+  }
+  EXPECT_EQ(BLI_mempool_len(data.pool), NUM_ITEMS / 2);
+
+  MEM_freeN(data.elems);
+  BLI_mempool_destroy(data.pool);
+  BLI_threadapi_exit();
+}
+
+TEST(mempool, TlsAllocFreeInterleaved)
+{
+  BLI_threadapi_init();
+
+  MempoolTestData data;
+  data.pool = BLI_mempool_create(sizeof(int), NUM_ITEMS / 2, 64, BLI_MEMPOOL_ALLOW_ITER);
+
+  /* Start from a fragmented pool, with free elements spread over all chunks. */
+  int **elems_serial = (int **)MEM_mallocN(sizeof(*elems_serial) * NUM_ITEMS, __func__);
+  for (int i = 0; i < NUM_ITEMS; i++) {
+    elems_serial[i] = (int *)BLI_mempool_alloc(data.pool);
+    *elems_serial[i] = i;
+  }
+  for (int i = 0; i < NUM_ITEMS; i += 3) {
+    BLI_mempool_free(data.pool, elems_serial[i]);
+    elems_serial[i] = (int *)BLI_mempool_alloc(data.pool);
+    *elems_serial[i] = i;
+  }
+  for (int i = 1; i < NUM_ITEMS; i += 3) {
+    BLI_mempool_free(data.pool, elems_serial[i]);
+    elems_serial[i] = nullptr;
+  }
+  for (int i = 1; i < NUM_ITEMS; i += 3) {
+    elems_serial[i] = (int *)BLI_mempool_alloc(data.pool);
+    *elems_serial[i] = i;
+  }
+  mempool_test_check_iter(data.pool, elems_serial);
+
+  /* Every iteration frees an element allocated serially and allocates a new one. */
+  data.elems = (int **)MEM_callocN(sizeof(*data.elems) * NUM_ITEMS, __func__);
+  data.elems_free = elems_serial;
+  mempool_test_parallel(&data, mempool_test_alloc_func, 16);
+  mempool_test_check_iter(data.pool, data.elems);
+
+  /* Twice, so each iteration frees an element allocated by another thread. */
+  int **elems_prev = data.elems;
+  data.elems = elems_serial;
+  data.elems_free = elems_prev;
+  mempool_test_parallel(&data, mempool_test_alloc_func, 256);
+  mempool_test_check_iter(data.pool, data.elems);
+
+  MEM_freeN(elems_serial);
+  MEM_freeN(elems_prev);
+  BLI_mempool_destroy(data.pool);
+  BLI_threadapi_exit();
+}
+
+TEST(mempool, TlsDestroyFreeingHandleFirst)
+{
+  BLI_mempool *pool = BLI_mempool_create(sizeof(int), 0, 64, BLI_MEMPOOL_ALLOW_ITER);
+  int *elem_serial = (int *)BLI_mempool_alloc(pool);
+
+  /* Elements allocated through one handle are freed through another one, which is destroyed
+   * first. Its own change of the element count is more negative than the pool has elements. */
+  BLI_mempool_tls *tls_alloc = BLI_mempool_tls_create(pool);
+  BLI_mempool_tls *tls_free = BLI_mempool_tls_create(pool);
+  const int elems_len = 100;
+  int *elems[elems_len];
+  for (int i = 0; i < elems_len; i++) {
+    elems[i] = (int *)BLI_mempool_tls_alloc(tls_alloc);
+  }
+  for (int i = 0; i < elems_len; i++) {
+    BLI_mempool_tls_free(tls_free, elems[i]);
+  }
+  BLI_mempool_tls_destroy(tls_free);
+  BLI_mempool_tls_destroy(tls_alloc);
+  EXPECT_EQ(BLI_mempool_len(pool), 1);
+
+  /* The same with elements that existed before. */
+  tls_alloc = BLI_mempool_tls_create(pool);
+  tls_free = BLI_mempool_tls_create(pool);
+  BLI_mempool_tls_free(tls_free, elem_serial);
+  elem_serial = (int *)BLI_mempool_tls_alloc(tls_alloc);
+  for (int i = 0; i < elems_len; i++) {
+    elems[i] = (int *)BLI_mempool_tls_alloc(tls_alloc);
+  }
+  for (int i = 0; i < elems_len; i += 2) {
+    BLI_mempool_tls_free(tls_free, elems[i]);
+  }
+  BLI_mempool_tls_destroy(tls_free);
+  BLI_mempool_tls_destroy(tls_alloc);
+  EXPECT_EQ(BLI_mempool_len(pool), 1 + elems_len / 2);
+
+  BLI_mempool_destroy(pool);
+}
@@ -4,17 +4,24 @@
 
 #include <fstream>
 #include <iostream>
+#include <random>
 #include <sstream>
 
 #include "MEM_guardedalloc.h"
 
+#include "PIL_time.h"
+
 #include "BLI_array.hh"
 #include "BLI_map.hh"
 #include "BLI_math_mpq.hh"
 #include "BLI_mesh_boolean.hh"
 #include "BLI_mpq3.hh"
+#include "BLI_task.h"
 #include "BLI_vector.hh"
 
+#define DO_REGULAR_TESTS 1
+#define DO_PERF_TESTS 0
+
 #ifdef WITH_GMP
 namespace blender::meshintersect::tests {
 
@@ -109,6 +116,7 @@ static int all_shape_zero(int UNUSED(t))
   return 0;
 }
 
+#  if DO_REGULAR_TESTS
 TEST(boolean_trimesh, Empty)
 {
   IMeshArena arena;
@@ -953,5 +961,147 @@ TEST(boolean_polymesh, CubePlane)
   }
 }
 
+#  endif
+
+#  if DO_PERF_TESTS
+
+/* Add a triangulated axis aligned cube to \a faces. */
+static void fill_cube_data(const double3 &center,
+                           double half_size,
+                           IMeshArena *arena,
+                           Vector<Face *> &faces,
+                           int *r_vid,
+                           int *r_fid)
+{
+  const Vert *vert[8];
+  for (int i = 0; i < 8; i++) {
+    double3 co(i & 4 ? half_size : -half_size,
+               i & 2 ? half_size : -half_size,
+               i & 1 ? half_size : -half_size);
+    vert[i] = arena->add_or_find_vert(co + center, (*r_vid)++);
+  }
+  const int quads[6][4] = {
+      {0, 1, 3, 2}, {6, 2, 3, 7}, {4, 6, 7, 5}, {0, 4, 5, 1}, {0, 2, 6, 4}, {3, 1, 5, 7}};
+  for (const int *quad : quads) {
+    faces.append(arena->add_face({vert[quad[0]], vert[quad[1]], vert[quad[2]]}, (*r_fid)++));
+    faces.append(arena->add_face({vert[quad[0]], vert[quad[2]], vert[quad[3]]}, (*r_fid)++));
+  }
+}
+
+/**
+ * Add a triangulated uv-sphere with radius 1 centered at the origin to \a faces,
+ * with `nrings` rings and `2 * nrings` segments. Each vertex is displaced along its
+ * normal by up to \a noise, to resemble the dense and irregular surface of a scan.
+ */
+static void fill_scan_sphere_data(
+    int nrings, double noise, IMeshArena *arena, Vector<Face *> &faces, int *r_vid, int *r_fid)
+{
+  const int nsegs = 2 * nrings;
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> displace(-noise, noise);
+  Array<const Vert *> vert(nsegs * (nrings - 1));
+  for (int s = 0; s < nsegs; s++) {
+    const double phi = s * 2.0 * M_PI / nsegs;
+    for (int r = 1; r < nrings; r++) {
+      const double theta = r * M_PI / nrings;
+      const double radius = 1.0 + displace(rng);
+      double3 co(radius * sin(theta) * cos(phi),
+                 radius * sin(theta) * sin(phi),
+                 radius * cos(theta));
+      vert[s * (nrings - 1) + (r - 1)] = arena->add_or_find_vert(co, (*r_vid)++);
+    }
+  }
+  const Vert *vtop = arena->add_or_find_vert(double3(0, 0, 1), (*r_vid)++);
+  const Vert *vbot = arena->add_or_find_vert(double3(0, 0, -1), (*r_vid)++);
+  for (int s = 0; s < nsegs; s++) {
+    const int snext = (s + 1) % nsegs;
+    auto v = [&](int seg, int ring) {
+      return ring == 0 ? vtop : (ring == nrings ? vbot : vert[seg * (nrings - 1) + (ring - 1)]);
+    };
+    for (int r = 0; r < nrings; r++) {
+      if (r != nrings - 1) {
+        faces.append(arena->add_face({v(s, r), v(s, r + 1), v(snext, r + 1)}, (*r_fid)++));
+      }
+      if (r != 0) {
+        faces.append(arena->add_face({v(snext, r + 1), v(snext, r), v(s, r)}, (*r_fid)++));
+      }
+    }
+  }
+}
+
+/* Time a difference of a cube from a noisy sphere of `4 * nrings^2` triangles. */
+static void scan_sphere_cube_test(int nrings, double noise)
+{
+  BLI_task_scheduler_init(); /* Without this, no parallelism. */
+  double time_start = PIL_check_seconds_timer();
+  IMeshArena arena;
+  Vector<Face *> faces;
+  int vid = 0;
+  int fid = 0;
+  fill_scan_sphere_data(nrings, noise, &arena, faces, &vid, &fid);
+  const int num_sphere_tris = faces.size();
+  fill_cube_data(double3(0.5, 0.5, 0.5), 0.6, &arena, faces, &vid, &fid);
+  IMesh mesh(faces);
+  double time_create = PIL_check_seconds_timer();
+  IMesh out = boolean_trimesh(
+      mesh,
+      BoolOpType::Difference,
+      2,
+      [num_sphere_tris](int t) { return t < num_sphere_tris ? 0 : 1; },
+      false,
+      false,
+      &arena);
+  double time_boolean = PIL_check_seconds_timer();
+  std::cout << "Input triangles: " << mesh.face_size() << "\n";
+  std::cout << "Output triangles: " << out.face_size() << "\n";
+  std::cout << "Create time: " << time_create - time_start << "\n";
+  std::cout << "Boolean time: " << time_boolean - time_create << "\n";
+  if (DO_OBJ) {
+    write_obj_mesh(out, "scan_sphere_cube");
+  }
+  BLI_task_scheduler_exit();
+}
+
+/* Time many small booleans like the ones in the regular tests above,
+ * where the fixed overhead per intersection test dominates. */
+static void cube_cube_repeat_test(int repeat)
+{
+  double time_start = PIL_check_seconds_timer();
+  int out_tris = 0;
+  for (int i = 0; i < repeat; i++) {
+    IMeshArena arena;
+    Vector<Face *> faces;
+    int vid = 0;
+    int fid = 0;
+    fill_cube_data(double3(0, 0, 0), 1.0, &arena, faces, &vid, &fid);
+    const double offset = 0.5 + 0.001 * (i % 100);
+    fill_cube_data(double3(offset, offset * 0.75, offset * 0.5), 1.0, &arena, faces, &vid, &fid);
+    IMesh mesh(faces);
+    IMesh out = boolean_trimesh(
+        mesh, BoolOpType::Union, 2, [](int t) { return t < 12 ? 0 : 1; }, false, false, &arena);
+    out_tris += out.face_size();
+  }
+  double time_end = PIL_check_seconds_timer();
+  std::cout << "Booleans: " << repeat << ", output triangles: " << out_tris << "\n";
+  std::cout << "Boolean time: " << time_end - time_start << "\n";
+}
+
+TEST(boolean_trimesh_perf, CubeCubeRepeat)
+{
+  cube_cube_repeat_test(1000);
+}
+
+TEST(boolean_trimesh_perf, ScanSphereCube)
+{
+  scan_sphere_cube_test(64, 0.01);
+}
+
+TEST(boolean_trimesh_perf, ScanSphereCube1M)
+{
+  scan_sphere_cube_test(512, 0.001);
+}
+
+#  endif
+
 }  // namespace blender::meshintersect::tests
 #endif
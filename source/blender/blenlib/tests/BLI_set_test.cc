@@ -544,6 +544,59 @@ TEST(set, GenericAlgorithms)
   EXPECT_EQ(std::count(set.begin(), set.end(), 20), 1);
 }
 
+TEST(set, GroupProbingStrategy)
+{
+  Set<int, 4, GroupProbingStrategy> set;
+  Set<int> reference;
+  RNG *rng = BLI_rng_new(0);
+  for (int i = 0; i < 100000; i++) {
+    const int key = BLI_rng_get_int(rng) % 5000;
+    switch (i % 3) {
+      case 0:
+        EXPECT_EQ(set.add(key), reference.add(key));
+        break;
+      case 1:
+        EXPECT_EQ(set.remove(key), reference.remove(key));
+        break;
+      case 2:
+        EXPECT_EQ(set.contains(key), reference.contains(key));
+        break;
+    }
+  }
+  BLI_rng_free(rng);
+
+  EXPECT_EQ(set.size(), reference.size());
+  for (const int key : reference) {
+    EXPECT_TRUE(set.contains(key));
+  }
+  for (const int key : set) {
+    EXPECT_TRUE(reference.contains(key));
+  }
+
+  set.rehash();
+  EXPECT_EQ(set.size(), reference.size());
+  for (const int key : reference) {
+    EXPECT_TRUE(set.contains(key));
+  }
+}
+
+TEST(set, GroupProbingStrategyCollisions)
+{
+  Set<int, 0, GroupProbingStrategy> set;
+  for (int i = 0; i < 1000; i++) {
+    set.add_new(i << 20);
+  }
+  for (int i = 0; i < 1000; i += 2) {
+    set.remove_contained(i << 20);
+  }
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_EQ(set.contains(i << 20), i % 2 == 1);
+    EXPECT_FALSE(set.contains((i << 20) + 1));
+  }
+  EXPECT_EQ(set.lookup_key_or_add(1 << 20), 1 << 20);
+  EXPECT_EQ(set.size(), 500);
+}
+
 /**
  * Set this to 1 to activate the benchmark. It is disabled by default, because it prints a lot.
  */
@@ -12,6 +12,8 @@
 #include "BLI_listbase.h"
 #include "BLI_mempool.h"
 #include "BLI_task.h"
+#include "BLI_task.hh"
+#include "BLI_task_profile_stats.hh"
 
 #define NUM_ITEMS 10000
 
@@ -280,3 +282,113 @@ TEST(task, ListBaseIter)
   MEM_freeN(items_buffer);
   BLI_threadapi_exit();
 }
+
+/* *** Task profiling. *** */
+
+static void task_profile_range_func(void *userdata,
+                                    int index,
+                                    const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  int *data = (int *)userdata;
+  data[index] = index;
+}
+
+static void task_profile_pool_func(TaskPool *__restrict pool, void *taskdata)
+{
+  int *data = (int *)BLI_task_pool_user_data(pool);
+  const int index = POINTER_AS_INT(taskdata);
+  data[index] = index;
+}
+
+TEST(task, Profile)
+{
+  using namespace blender;
+  namespace profile = threading::profile;
+
+  int data[NUM_ITEMS] = {0};
+  const std::string filepath = testing::TempDir() + "task_profile_test.json";
+
+  BLI_threadapi_init();
+  BLI_task_profile_begin(nullptr);
+  EXPECT_TRUE(BLI_task_profile_is_enabled());
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 100;
+  BLI_task_parallel_range(0, NUM_ITEMS, data, task_profile_range_func, &settings);
+
+  TaskPool *pool = BLI_task_pool_create(data, TASK_PRIORITY_HIGH);
+  for (int i = 0; i < 100; i++) {
+    BLI_task_pool_push(pool, task_profile_pool_func, POINTER_FROM_INT(i), false, nullptr);
+  }
+  BLI_task_pool_work_and_wait(pool);
+  BLI_task_pool_free(pool);
+
+  threading::parallel_for(IndexRange(NUM_ITEMS), 256, [&](const IndexRange range) {
+    for (const int i : range) {
+      data[i] = i;
+    }
+  });
+
+  BLI_task_profile_end();
+  EXPECT_FALSE(BLI_task_profile_is_enabled());
+
+  int64_t pool_tasks = 0;
+  int64_t range_items = 0;
+  int64_t parallel_for_calls = 0;
+  int64_t parallel_for_items = 0;
+  for (const profile::CallSiteStats &stats : profile::call_site_stats()) {
+    EXPECT_LE(stats.stolen_tasks, stats.tasks);
+    EXPECT_LE(stats.min_task_time, stats.max_task_time);
+    switch (stats.call_site->category) {
+      case profile::Category::TaskPool:
+        pool_tasks += stats.tasks;
+        break;
+      case profile::Category::ParallelRange:
+        range_items += stats.items;
+        break;
+      case profile::Category::ParallelFor:
+        parallel_for_calls += stats.calls;
+        parallel_for_items += stats.items;
+        break;
+      case profile::Category::TaskGraph:
+        break;
+    }
+  }
+  EXPECT_EQ(pool_tasks, 100);
+  /* Single threaded ranges are not recorded. */
+  if (BLI_task_scheduler_num_threads() > 1) {
+    EXPECT_EQ(range_items, NUM_ITEMS);
+  }
+#ifdef WITH_TBB
+  EXPECT_EQ(parallel_for_calls, 1);
+  EXPECT_EQ(parallel_for_items, NUM_ITEMS);
+#endif
+
+  int64_t thread_tasks = 0;
+  for (const profile::ThreadStats &stats : profile::thread_stats()) {
+    EXPECT_GE(stats.idle_time, 0);
+    thread_tasks += stats.tasks;
+  }
+  EXPECT_GE(thread_tasks, 100);
+
+  EXPECT_TRUE(BLI_task_profile_write_chrome_trace(filepath.c_str()));
+  FILE *file = fopen(filepath.c_str(), "r");
+  ASSERT_NE(file, nullptr);
+  std::string json;
+  char buffer[4096];
+  size_t len;
+  while ((len = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    json.append(buffer, len);
+  }
+  fclose(file);
+  remove(filepath.c_str());
+  EXPECT_EQ(json.find("{\"traceEvents\":["), 0);
+  EXPECT_NE(json.find("\"cat\":\"task_pool\""), std::string::npos);
+  EXPECT_NE(json.find("\"ph\":\"M\""), std::string::npos);
+
+  BLI_task_profile_clear();
+  EXPECT_TRUE(profile::call_site_stats().is_empty());
+
+  BLI_threadapi_exit();
+}
@@ -0,0 +1,725 @@
+/* Apache License, Version 2.0 */
+
+/** \file
+ * Benchmarks of blenlib containers, allocators, spatial trees and task primitives.
+ *
+ * Every measurement is printed, and written as JSON when `BLI_BENCHMARK_OUTPUT` is set, see
+ * BLI_benchmark_report.hh.
+ *
+ * The time is that of one pass over `size` items, the fastest of all repetitions.
+ */
+
+#include "testing/testing.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_array.hh"
+#include "BLI_delaunay_2d.h"
+#include "BLI_edgehash.h"
+#include "BLI_float3.hh"
+#include "BLI_ghash.h"
+#include "BLI_kdopbvh.h"
+#include "BLI_kdtree.h"
+#include "BLI_linear_allocator.hh"
+#include "BLI_map.hh"
+#include "BLI_mempool.h"
+#include "BLI_rand.hh"
+#include "BLI_set.hh"
+#include "BLI_task.h"
+#include "BLI_task.hh"
+#include "BLI_threads.h"
+#include "BLI_utildefines.h"
+#include "BLI_vector.hh"
+#include "BLI_vector_set.hh"
+
+#include "PIL_time.h"
+
+#include "BLI_benchmark_report.hh"
+
+namespace blender::tests {
+
+/** Number of items processed per measurement, small sizes are repeated to reach it. */
+static constexpr int64_t BENCHMARK_ITEMS = 4000000;
+static constexpr int64_t BENCHMARK_SIZES[] = {100, 10000, 1000000};
+
+/** Written to, so that the compiler can't remove the benchmarked computations. */
+static volatile int64_t benchmark_sink = 0;
+
+static void benchmark_report(const char *group,
+                             const char *name,
+                             const char *type,
+                             const int64_t size,
+                             const double seconds)
+{
+  const double items_per_second = (double)size / seconds;
+  printf("\t%-10s %-20s %-12s %8lld: %.3e s, %8.2f M items/s\n",
+         group,
+         name,
+         type,
+         (long long)size,
+         seconds,
+         items_per_second / 1e6);
+
+  benchmark_write_json(group, name, type, size, seconds);
+}
+
+/**
+ * Run \a fn, which processes \a size items, enough times to process about #BENCHMARK_ITEMS
+ * and report the fastest run. \a setup is run untimed before every run.
+ */
+template<typename SetupFn, typename Fn>
+static void benchmark_run(const char *group,
+                          const char *name,
+                          const char *type,
+                          const int64_t size,
+                          const SetupFn &setup,
+                          const Fn &fn)
+{
+  const int64_t repeat = std::max<int64_t>(BENCHMARK_ITEMS / size, 3);
+  double best = DBL_MAX;
+  for (int64_t i = 0; i < repeat; i++) {
+    setup();
+    const double start = PIL_check_seconds_timer();
+    fn();
+    best = std::min(best, PIL_check_seconds_timer() - start);
+  }
+  benchmark_report(group, name, type, size, best);
+}
+
+template<typename Fn>
+static void benchmark_run(
+    const char *group, const char *name, const char *type, const int64_t size, const Fn &fn)
+{
+  benchmark_run(
+      group, name, type, size, []() {}, fn);
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Keys
+ *
+ * Keys are distinct and in random order, to avoid measuring cache friendly access patterns.
+ * \{ */
+
+template<typename Key> static Key benchmark_key(uint64_t value);
+
+template<> int benchmark_key<int>(const uint64_t value)
+{
+  return (int)value;
+}
+
+template<> uint64_t benchmark_key<uint64_t>(const uint64_t value)
+{
+  /* Spread over the whole range, so the high bits matter too. */
+  return value * 0x9E3779B97F4A7C15ull;
+}
+
+template<> std::string benchmark_key<std::string>(const uint64_t value)
+{
+  return "key_" + std::to_string(value * 7919);
+}
+
+template<typename Key> static Array<Key> benchmark_keys(const int64_t size)
+{
+  Array<int> order(size);
+  for (int i : order.index_range()) {
+    order[i] = i;
+  }
+  RandomNumberGenerator rng(0);
+  for (int64_t i = size - 1; i > 0; i--) {
+    std::swap(order[i], order[rng.get_int32() % (i + 1)]);
+  }
+  Array<Key> keys(size);
+  for (int64_t i : keys.index_range()) {
+    keys[i] = benchmark_key<Key>((uint64_t)order[i]);
+  }
+  return keys;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Containers
+ * \{ */
+
+template<typename Key, typename MapType = Map<Key, int>>
+static void benchmark_map(const char *group, const char *type, const int64_t size)
+{
+  const Array<Key> keys = benchmark_keys<Key>(size);
+  benchmark_run(group, "add", type, size, [&]() {
+    MapType map;
+    for (int i : keys.index_range()) {
+      map.add(keys[i], i);
+    }
+    benchmark_sink = benchmark_sink + map.size();
+  });
+  benchmark_run(group, "add_reserved", type, size, [&]() {
+    MapType map;
+    map.reserve(size);
+    for (int i : keys.index_range()) {
+      map.add_new(keys[i], i);
+    }
+    benchmark_sink = benchmark_sink + map.size();
+  });
+
+  MapType map;
+  for (int i : keys.index_range()) {
+    map.add(keys[i], i);
+  }
+  benchmark_run(group, "lookup", type, size, [&]() {
+    int64_t sum = 0;
+    for (const Key &key : keys) {
+      sum += map.lookup(key);
+    }
+    benchmark_sink = benchmark_sink + sum;
+  });
+  const Array<Key> mixed_keys = benchmark_keys<Key>(size * 2);
+  benchmark_run(group, "lookup_mixed", type, size, [&]() {
+    int64_t sum = 0;
+    for (int64_t i = size / 2; i < size + size / 2; i++) {
+      sum += map.lookup_default(mixed_keys[i], -1);
+    }
+    benchmark_sink = benchmark_sink + sum;
+  });
+
+  MapType map_remove;
+  benchmark_run(
+      group,
+      "remove",
+      type,
+      size,
+      [&]() { map_remove = map; },
+      [&]() {
+        for (const Key &key : keys) {
+          map_remove.remove(key);
+        }
+      });
+}
+
+template<typename Key, typename SetType = Set<Key>>
+static void benchmark_set(const char *group, const char *type, const int64_t size)
+{
+  const Array<Key> keys = benchmark_keys<Key>(size);
+  benchmark_run(group, "add", type, size, [&]() {
+    SetType set;
+    for (const Key &key : keys) {
+      set.add(key);
+    }
+    benchmark_sink = benchmark_sink + set.size();
+  });
+
+  SetType set;
+  for (const Key &key : keys) {
+    set.add(key);
+  }
+  const Array<Key> mixed_keys = benchmark_keys<Key>(size * 2);
+  benchmark_run(group, "contains_mixed", type, size, [&]() {
+    int64_t count = 0;
+    for (int64_t i = size / 2; i < size + size / 2; i++) {
+      count += set.contains(mixed_keys[i]);
+    }
+    benchmark_sink = benchmark_sink + count;
+  });
+}
+
+template<typename Key> static void benchmark_vector_set(const char *type, const int64_t size)
+{
+  const Array<Key> keys = benchmark_keys<Key>(size);
+  benchmark_run("VectorSet", "add", type, size, [&]() {
+    VectorSet<Key> set;
+    for (const Key &key : keys) {
+      set.add(key);
+    }
+    benchmark_sink = benchmark_sink + set.size();
+  });
+
+  VectorSet<Key> set;
+  for (const Key &key : keys) {
+    set.add(key);
+  }
+  benchmark_run("VectorSet", "index_of", type, size, [&]() {
+    int64_t sum = 0;
+    for (const Key &key : keys) {
+      sum += set.index_of(key);
+    }
+    benchmark_sink = benchmark_sink + sum;
+  });
+}
+
+template<typename Key> static void benchmark_vector(const char *type, const int64_t size)
+{
+  const Array<Key> keys = benchmark_keys<Key>(size);
+  benchmark_run("Vector", "append", type, size, [&]() {
+    Vector<Key> vector;
+    for (const Key &key : keys) {
+      vector.append(key);
+    }
+    benchmark_sink = benchmark_sink + vector.size();
+  });
+  benchmark_run("Vector", "append_reserved", type, size, [&]() {
+    Vector<Key> vector;
+    vector.reserve(size);
+    for (const Key &key : keys) {
+      vector.append_unchecked(key);
+    }
+    benchmark_sink = benchmark_sink + vector.size();
+  });
+}
+
+TEST(bli_benchmark, Map)
+{
+  for (const int64_t size : BENCHMARK_SIZES) {
+    benchmark_map<int>("Map", "int", size);
+    benchmark_map<uint64_t>("Map", "uint64_t", size);
+    benchmark_map<std::string>("Map", "std::string", size);
+  }
+}
+
+TEST(bli_benchmark, Set)
+{
+  for (const int64_t size : BENCHMARK_SIZES) {
+    benchmark_set<int>("Set", "int", size);
+    benchmark_set<uint64_t>("Set", "uint64_t", size);
+    benchmark_set<std::string>("Set", "std::string", size);
+  }
+}
+
+template<typename Key>
+using GroupProbingMap =
+    Map<Key, int, default_inline_buffer_capacity(sizeof(Key) + sizeof(int)), GroupProbingStrategy>;
+template<typename Key>
+using GroupProbingSet =
+    Set<Key, default_inline_buffer_capacity(sizeof(Key)), GroupProbingStrategy>;
+
+/**
+ * Compare the default probing strategy with the #GroupProbingStrategy on hash tables that are much
+ * larger than the CPU caches.
+ */
+TEST(bli_benchmark, HashTableProbing)
+{
+  for (const int64_t size : {1000000, 10000000}) {
+    benchmark_map<int>("Map", "int", size);
+    benchmark_map<int, GroupProbingMap<int>>("Map (group probing)", "int", size);
+    benchmark_map<uint64_t>("Map", "uint64_t", size);
+    benchmark_map<uint64_t, GroupProbingMap<uint64_t>>("Map (group probing)", "uint64_t", size);
+    benchmark_set<int>("Set", "int", size);
+    benchmark_set<int, GroupProbingSet<int>>("Set (group probing)", "int", size);
+  }
+  /* Comparing strings is expensive, that is where checking the control bytes first helps most. */
+  benchmark_map<std::string>("Map", "std::string", 1000000);
+  benchmark_map<std::string, GroupProbingMap<std::string>>(
+      "Map (group probing)", "std::string", 1000000);
+}
+
+TEST(bli_benchmark, VectorSet)
+{
+  for (const int64_t size : BENCHMARK_SIZES) {
+    benchmark_vector_set<int>("int", size);
+    benchmark_vector_set<std::string>("std::string", size);
+  }
+}
+
+TEST(bli_benchmark, Vector)
+{
+  for (const int64_t size : BENCHMARK_SIZES) {
+    benchmark_vector<int>("int", size);
+    benchmark_vector<std::string>("std::string", size);
+  }
+}
+
+TEST(bli_benchmark, GHash)
+{
+  for (const int64_t size : BENCHMARK_SIZES) {
+    const Array<int> keys = benchmark_keys<int>(size);
+    GHash *ghash = nullptr;
+    benchmark_run(
+        "GHash",
+        "insert",
+        "int",
+        size,
+        [&]() {
+          if (ghash) {
+            BLI_ghash_free(ghash, nullptr, nullptr);
+          }
+          ghash = BLI_ghash_int_new(__func__);
+        },
+        [&]() {
+          for (int i : keys.index_range()) {
+            BLI_ghash_insert(ghash, POINTER_FROM_INT(keys[i]), POINTER_FROM_INT(i));
+          }
+        });
+    benchmark_run("GHash", "lookup", "int", size, [&]() {
+      int64_t sum = 0;
+      for (const int key : keys) {
+        sum += POINTER_AS_INT(BLI_ghash_lookup(ghash, POINTER_FROM_INT(key)));
+      }
+      benchmark_sink = benchmark_sink + sum;
+    });
+    BLI_ghash_free(ghash, nullptr, nullptr);
+
+    const Array<std::string> str_keys = benchmark_keys<std::string>(size);
+    GHash *ghash_str = nullptr;
+    benchmark_run(
+        "GHash",
+        "insert",
+        "string",
+        size,
+        [&]() {
+          if (ghash_str) {
+            BLI_ghash_free(ghash_str, nullptr, nullptr);
+          }
+          ghash_str = BLI_ghash_str_new(__func__);
+        },
+        [&]() {
+          for (int i : str_keys.index_range()) {
+            BLI_ghash_insert(ghash_str, (void *)str_keys[i].c_str(), POINTER_FROM_INT(i));
+          }
+        });
+    benchmark_run("GHash", "lookup", "string", size, [&]() {
+      int64_t sum = 0;
+      for (const std::string &key : str_keys) {
+        sum += POINTER_AS_INT(BLI_ghash_lookup(ghash_str, key.c_str()));
+      }
+      benchmark_sink = benchmark_sink + sum;
+    });
+    BLI_ghash_free(ghash_str, nullptr, nullptr);
+  }
+}
+
+TEST(bli_benchmark, EdgeHash)
+{
+  for (const int64_t size : BENCHMARK_SIZES) {
+    /* Edges of a grid, like the edges of a mesh. */
+    const int grid_size = (int)sqrt((double)size / 2) + 1;
+    Array<std::pair<uint, uint>> edges(size);
+    const Array<int> order = benchmark_keys<int>(size);
+    for (int64_t i : edges.index_range()) {
+      const uint v = (uint)(order[i] / 2);
+      edges[i] = {v, (order[i] % 2) ? v + 1 : v + (uint)grid_size};
+    }
+    EdgeHash *ehash = nullptr;
+    benchmark_run(
+        "EdgeHash",
+        "insert",
+        "edge",
+        size,
+        [&]() {
+          if (ehash) {
+            BLI_edgehash_free(ehash, nullptr);
+          }
+          ehash = BLI_edgehash_new(__func__);
+        },
+        [&]() {
+          for (int i : edges.index_range()) {
+            BLI_edgehash_insert(ehash, edges[i].first, edges[i].second, POINTER_FROM_INT(i));
+          }
+        });
+    benchmark_run("EdgeHash", "lookup", "edge", size, [&]() {
+      int64_t sum = 0;
+      for (const std::pair<uint, uint> &edge : edges) {
+        sum += POINTER_AS_INT(BLI_edgehash_lookup(ehash, edge.second, edge.first));
+      }
+      benchmark_sink = benchmark_sink + sum;
+    });
+    BLI_edgehash_free(ehash, nullptr);
+  }
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Allocators
+ * \{ */
+
+TEST(bli_benchmark, LinearAllocator)
+{
+  for (const int64_t size : BENCHMARK_SIZES) {
+    benchmark_run("LinearAllocator", "allocate", "32 bytes", size, [&]() {
+      LinearAllocator<> allocator;
+      for (int64_t i = 0; i < size; i++) {
+        void *buffer = allocator.allocate(32, 8);
+        *(int64_t *)buffer = i;
+      }
+    });
+    const Array<std::string> strings = benchmark_keys<std::string>(size);
+    benchmark_run("LinearAllocator", "copy_string", "std::string", size, [&]() {
+      LinearAllocator<> allocator;
+      for (const std::string &str : strings) {
+        allocator.copy_string(str);
+      }
+    });
+  }
+}
+
+TEST(bli_benchmark, Mempool)
+{
+  for (const int64_t size : BENCHMARK_SIZES) {
+    Array<void *> elems(size);
+    BLI_mempool *pool = BLI_mempool_create(32, 0, 512, BLI_MEMPOOL_ALLOW_ITER);
+    benchmark_run(
+        "Mempool",
+        "alloc",
+        "32 bytes",
+        size,
+        [&]() { BLI_mempool_clear(pool); },
+        [&]() {
+          for (int64_t i : elems.index_range()) {
+            elems[i] = BLI_mempool_alloc(pool);
+          }
+        });
+    benchmark_run("Mempool", "iter", "32 bytes", size, [&]() {
+      int64_t count = 0;
+      BLI_mempool_iter iter;
+      BLI_mempool_iternew(pool, &iter);
+      while (BLI_mempool_iterstep(&iter)) {
+        count++;
+      }
+      benchmark_sink = benchmark_sink + count;
+    });
+    benchmark_run(
+        "Mempool",
+        "free",
+        "32 bytes",
+        size,
+        [&]() {
+          BLI_mempool_clear(pool);
+          for (int64_t i : elems.index_range()) {
+            elems[i] = BLI_mempool_alloc(pool);
+          }
+        },
+        [&]() {
+          for (int64_t i = size - 1; i >= 0; i -= 2) {
+            BLI_mempool_free(pool, elems[i]);
+          }
+        });
+    benchmark_run(
+        "Mempool",
+        "alloc_threaded",
+        "32 bytes",
+        size,
+        [&]() { BLI_mempool_clear(pool); },
+        [&]() {
+          threading::parallel_for(elems.index_range(), 4096, [&](IndexRange range) {
+            BLI_mempool_tls *tls = BLI_mempool_tls_create(pool);
+            for (int64_t i : range) {
+              elems[i] = BLI_mempool_tls_alloc(tls);
+            }
+            BLI_mempool_tls_destroy(tls);
+          });
+        });
+    BLI_mempool_destroy(pool);
+  }
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Spatial Trees
+ * \{ */
+
+static Array<float3> benchmark_points(const int64_t size, const uint32_t seed)
+{
+  Array<float3> points(size);
+  RandomNumberGenerator rng(seed);
+  for (float3 &co : points) {
+    co = rng.get_unit_float3() * rng.get_float();
+  }
+  return points;
+}
+
+TEST(bli_benchmark, KDTree)
+{
+  for (const int64_t size : BENCHMARK_SIZES) {
+    const Array<float3> points = benchmark_points(size, 0);
+    const Array<float3> queries = benchmark_points(size, 1);
+    KDTree_3d *tree = nullptr;
+    benchmark_run(
+        "KDTree",
+        "build",
+        "float3",
+        size,
+        [&]() {
+          if (tree) {
+            BLI_kdtree_3d_free(tree);
+          }
+          tree = BLI_kdtree_3d_new((uint)size);
+        },
+        [&]() {
+          for (int i : points.index_range()) {
+            BLI_kdtree_3d_insert(tree, i, points[i]);
+          }
+          BLI_kdtree_3d_balance(tree);
+        });
+    benchmark_run("KDTree", "find_nearest", "float3", size, [&]() {
+      int64_t sum = 0;
+      for (const float3 &co : queries) {
+        sum += BLI_kdtree_3d_find_nearest(tree, co, nullptr);
+      }
+      benchmark_sink = benchmark_sink + sum;
+    });
+    Array<KDTreeNearest_3d> nearest(size);
+    benchmark_run("KDTree", "find_nearest_batch", "float3", size, [&]() {
+      BLI_kdtree_3d_find_nearest_batch(
+          tree, (const float(*)[3])queries.data(), (uint)size, nearest.data());
+    });
+    const float range = 2.0f / cbrtf((float)size);
+    benchmark_run("KDTree", "range_search", "float3", size, [&]() {
+      int64_t count = 0;
+      for (const float3 &co : queries) {
+        KDTreeNearest_3d *found = nullptr;
+        count += BLI_kdtree_3d_range_search(tree, co, &found, range);
+        MEM_SAFE_FREE(found);
+      }
+      benchmark_sink = benchmark_sink + count;
+    });
+    BLI_kdtree_3d_free(tree);
+  }
+}
+
+static void benchmark_bvhtree(const char *type, const int64_t size, const int build_flag)
+{
+  const Array<float3> points = benchmark_points(size, 0);
+  const Array<float3> queries = benchmark_points(size, 1);
+  BVHTree *tree = nullptr;
+  benchmark_run(
+      "BVHTree",
+      "build",
+      type,
+      size,
+      [&]() {
+        if (tree) {
+          BLI_bvhtree_free(tree);
+        }
+        tree = BLI_bvhtree_new_ex((int)size, 0.0f, 4, 6, build_flag);
+      },
+      [&]() {
+        for (int i : points.index_range()) {
+          BLI_bvhtree_insert(tree, i, points[i], 1);
+        }
+        BLI_bvhtree_balance(tree);
+      });
+  benchmark_run("BVHTree", "find_nearest", type, size, [&]() {
+    int64_t sum = 0;
+    for (const float3 &co : queries) {
+      BVHTreeNearest nearest;
+      nearest.index = -1;
+      nearest.dist_sq = FLT_MAX;
+      sum += BLI_bvhtree_find_nearest(tree, co, &nearest, nullptr, nullptr);
+    }
+    benchmark_sink = benchmark_sink + sum;
+  });
+  benchmark_run("BVHTree", "update_tree", type, size, [&]() {
+    for (int i : points.index_range()) {
+      BLI_bvhtree_update_node(tree, i, queries[i], nullptr, 1);
+    }
+    BLI_bvhtree_update_tree(tree);
+  });
+  BLI_bvhtree_free(tree);
+}
+
+TEST(bli_benchmark, BVHTree)
+{
+  for (const int64_t size : BENCHMARK_SIZES) {
+    benchmark_bvhtree("points", size, 0);
+    benchmark_bvhtree("points_sah", size, BVH_BUILD_SAH);
+  }
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Delaunay Triangulation
+ * \{ */
+
+/**
+ * Re-initialize the task scheduler with the given number of threads, zero uses all of them.
+ */
+static void benchmark_set_threads(const int threads)
+{
+  BLI_task_scheduler_exit();
+  BLI_system_num_threads_override_set(threads);
+  BLI_task_scheduler_init();
+}
+
+template<typename T> static void benchmark_delaunay_2d(const char *type, const int64_t size)
+{
+  RandomNumberGenerator rng(0);
+  meshintersect::CDT_input<T> input;
+  input.vert = Array<meshintersect::vec2<T>>(size);
+  for (meshintersect::vec2<T> &co : input.vert) {
+    co = meshintersect::vec2<T>(T(rng.get_float()), T(rng.get_float()));
+  }
+  input.epsilon = T(0);
+  input.need_ids = false;
+
+  /* Measure how the triangulation scales with the number of threads. */
+  const int system_threads = BLI_system_thread_count();
+  for (int threads = 1;; threads = std::min(threads * 2, system_threads)) {
+    benchmark_set_threads(threads);
+    benchmark_run("Delaunay 2D", "random points", type, size, [&]() {
+      meshintersect::CDT_result<T> result = meshintersect::delaunay_2d_calc(input, CDT_FULL);
+      benchmark_sink = benchmark_sink + result.face.size();
+    });
+    if (threads == system_threads) {
+      break;
+    }
+  }
+  benchmark_set_threads(0);
+}
+
+TEST(bli_benchmark, Delaunay2D)
+{
+  benchmark_delaunay_2d<double>("double", 10000);
+  benchmark_delaunay_2d<double>("double", 1000000);
+#ifdef WITH_GMP
+  benchmark_delaunay_2d<mpq_class>("mpq", 10000);
+  benchmark_delaunay_2d<mpq_class>("mpq", 1000000);
+#endif
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Task Primitives
+ * \{ */
+
+TEST(bli_benchmark, ParallelFor)
+{
+  for (const int64_t size : BENCHMARK_SIZES) {
+    Array<float> values(size, 1.0f);
+    for (const int64_t grain_size : {1, 512, 4096}) {
+      const std::string type = "grain_" + std::to_string(grain_size);
+      benchmark_run("parallel_for", "scale", type.c_str(), size, [&]() {
+        threading::parallel_for(values.index_range(), grain_size, [&](IndexRange range) {
+          for (int64_t i : range) {
+            values[i] = values[i] * 0.5f + 1.0f;
+          }
+        });
+      });
+    }
+    benchmark_run("parallel_reduce", "sum", "float", size, [&]() {
+      const float sum = threading::parallel_reduce(
+          values.index_range(),
+          4096,
+          0.0f,
+          [&](IndexRange range, float init) {
+            for (int64_t i : range) {
+              init += values[i];
+            }
+            return init;
+          },
+          [](float a, float b) { return a + b; });
+      benchmark_sink = benchmark_sink + (int64_t)sum;
+    });
+  }
+}
+
+/** \} */
+
+}  // namespace blender::tests
@@ -0,0 +1,59 @@
+/* Apache License, Version 2.0 */
+
+#pragma once
+
+/** \file
+ * Shared output of the benchmarks in performance tests.
+ *
+ * When the `BLI_BENCHMARK_OUTPUT` environment variable is set, every measurement is appended to
+ * that file as a line of JSON, so results of different builds can be compared:
+ *
+ * `{"group": "Map", "name": "lookup", "type": "int", "size": 1000, "seconds": 1.2e-05, ...}`
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "BLI_task.h"
+
+namespace blender::tests {
+
+/**
+ * Append a measurement to the file in `BLI_BENCHMARK_OUTPUT`, if it is set.
+ * \param seconds: Time of one pass over \a size items.
+ * \param extra_json: Members that are appended to the JSON object, e.g. `"peak_memory": 1024`.
+ */
+inline void benchmark_write_json(const char *group,
+                                 const char *name,
+                                 const char *type,
+                                 const int64_t size,
+                                 const double seconds,
+                                 const char *extra_json = nullptr)
+{
+  const char *output_path = getenv("BLI_BENCHMARK_OUTPUT");
+  if (output_path == nullptr || output_path[0] == '\0') {
+    return;
+  }
+  FILE *file = fopen(output_path, "a");
+  if (file == nullptr) {
+    printf("ERROR: can't write benchmark output to %s\n", output_path);
+    return;
+  }
+  fprintf(file,
+          "{\"group\": \"%s\", \"name\": \"%s\", \"type\": \"%s\", \"size\": %lld, "
+          "\"seconds\": %.9g, \"items_per_second\": %.9g, \"threads\": %d",
+          group,
+          name,
+          type,
+          (long long)size,
+          seconds,
+          (double)size / seconds,
+          BLI_task_scheduler_num_threads());
+  if (extra_json != nullptr) {
+    fprintf(file, ", %s", extra_json);
+  }
+  fprintf(file, "}\n");
+  fclose(file);
+}
+
+}  // namespace blender::tests
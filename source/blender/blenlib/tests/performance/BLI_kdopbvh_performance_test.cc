@@ -0,0 +1,185 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_kdopbvh.h"
+#include "BLI_math.h"
+#include "BLI_rand.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+#include "BLI_utildefines.h"
+
+#include "PIL_time.h"
+
+/* A height-field grid of `2 * GRID_SIZE^2` triangles (10M). */
+#define GRID_SIZE 2236
+#define NUM_RAYS 4000000
+
+typedef struct RayCastTriangles {
+  float (*verts)[3];
+  uint (*tris)[3];
+} RayCastTriangles;
+
+static void raycast_triangle_cb(void *userdata,
+                                int index,
+                                const BVHTreeRay *ray,
+                                BVHTreeRayHit *hit)
+{
+  const RayCastTriangles *data = (const RayCastTriangles *)userdata;
+  const uint *tri = data->tris[index];
+  float dist;
+  if (isect_ray_tri_v3(ray->origin,
+                       ray->direction,
+                       data->verts[tri[0]],
+                       data->verts[tri[1]],
+                       data->verts[tri[2]],
+                       &dist,
+                       nullptr) &&
+      dist < hit->dist) {
+    hit->index = index;
+    hit->dist = dist;
+    madd_v3_v3v3fl(hit->co, ray->origin, ray->direction, dist);
+  }
+}
+
+typedef struct RayCastSingleData {
+  BVHTree *tree;
+  RayCastTriangles *triangles;
+  const float (*co)[3];
+  const float (*dir)[3];
+  BVHTreeRayHit *hits;
+} RayCastSingleData;
+
+static void raycast_single_task_cb(void *__restrict userdata,
+                                   const int i,
+                                   const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const RayCastSingleData *data = (const RayCastSingleData *)userdata;
+  BLI_bvhtree_ray_cast_ex(data->tree,
+                          data->co[i],
+                          data->dir[i],
+                          0.0f,
+                          &data->hits[i],
+                          raycast_triangle_cb,
+                          data->triangles,
+                          0);
+}
+
+static void raycast_hits_init(BVHTreeRayHit *hits, const int num)
+{
+  for (int i = 0; i < num; i++) {
+    hits[i].index = -1;
+    hits[i].dist = BVH_RAYCAST_DIST_MAX;
+  }
+}
+
+static void raycast_print_result(const char *id, const double time, const BVHTreeRayHit *hits)
+{
+  int num_hits = 0;
+  for (int i = 0; i < NUM_RAYS; i++) {
+    num_hits += (hits[i].index != -1);
+  }
+  printf("\t%s: %d rays (%d hits) in %fs, %.2f M rays/s\n",
+         id,
+         NUM_RAYS,
+         num_hits,
+         time,
+         (double)NUM_RAYS / time / 1e6);
+}
+
+TEST(kdopbvh, RayCastBatch10MTris)
+{
+  printf("\n========== STARTING %s ==========\n", "BVH ray-cast - 10M triangles");
+
+  BLI_threadapi_init();
+
+  RayCastTriangles data;
+  data.verts = (float(*)[3])MEM_malloc_arrayN(
+      (GRID_SIZE + 1) * (GRID_SIZE + 1), sizeof(*data.verts), __func__);
+  data.tris = (uint(*)[3])MEM_malloc_arrayN(
+      GRID_SIZE * GRID_SIZE * 2, sizeof(*data.tris), __func__);
+
+  for (int y = 0; y <= GRID_SIZE; y++) {
+    for (int x = 0; x <= GRID_SIZE; x++) {
+      float *co = data.verts[y * (GRID_SIZE + 1) + x];
+      co[0] = (float)x;
+      co[1] = (float)y;
+      co[2] = sinf((float)x * 0.05f) * cosf((float)y * 0.05f) * 10.0f;
+    }
+  }
+
+  BVHTree *tree = BLI_bvhtree_new(GRID_SIZE * GRID_SIZE * 2, 0.0f, 4, 6);
+  for (int y = 0; y < GRID_SIZE; y++) {
+    for (int x = 0; x < GRID_SIZE; x++) {
+      const uint v = (uint)(y * (GRID_SIZE + 1) + x);
+      const uint quad[4] = {v, v + 1, v + GRID_SIZE + 2, v + GRID_SIZE + 1};
+      for (int j = 0; j < 2; j++) {
+        const int index = (y * GRID_SIZE + x) * 2 + j;
+        uint *tri = data.tris[index];
+        tri[0] = quad[0];
+        tri[1] = quad[1 + j];
+        tri[2] = quad[2 + j];
+        float co[3][3];
+        for (int k = 0; k < 3; k++) {
+          copy_v3_v3(co[k], data.verts[tri[k]]);
+        }
+        BLI_bvhtree_insert(tree, index, co[0], 3);
+      }
+    }
+  }
+  BLI_bvhtree_balance(tree);
+
+  /* Coherent rays, cast down from neighboring points of a grid above the surface. */
+  float(*co)[3] = (float(*)[3])MEM_malloc_arrayN(NUM_RAYS, sizeof(*co), __func__);
+  float(*dir)[3] = (float(*)[3])MEM_malloc_arrayN(NUM_RAYS, sizeof(*dir), __func__);
+  BVHTreeRayHit *hits = (BVHTreeRayHit *)MEM_malloc_arrayN(NUM_RAYS, sizeof(*hits), __func__);
+  RNG *rng = BLI_rng_new(0);
+  const int rays_per_row = 2000;
+  const float step = (float)GRID_SIZE / (float)rays_per_row;
+  for (int i = 0; i < NUM_RAYS; i++) {
+    co[i][0] = (float)(i % rays_per_row) * step;
+    co[i][1] = (float)((i / rays_per_row) % rays_per_row) * step;
+    co[i][2] = 20.0f;
+    dir[i][0] = (BLI_rng_get_float(rng) - 0.5f) * 0.2f;
+    dir[i][1] = (BLI_rng_get_float(rng) - 0.5f) * 0.2f;
+    dir[i][2] = -1.0f;
+    normalize_v3(dir[i]);
+  }
+  BLI_rng_free(rng);
+
+  RayCastSingleData single_data = {tree, &data, co, dir, hits};
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+
+  double time_start;
+
+  raycast_hits_init(hits, NUM_RAYS);
+  time_start = PIL_check_seconds_timer();
+  for (int i = 0; i < NUM_RAYS; i++) {
+    BLI_bvhtree_ray_cast_ex(tree, co[i], dir[i], 0.0f, &hits[i], raycast_triangle_cb, &data, 0);
+  }
+  raycast_print_result("Single rays", PIL_check_seconds_timer() - time_start, hits);
+
+  raycast_hits_init(hits, NUM_RAYS);
+  time_start = PIL_check_seconds_timer();
+  BLI_task_parallel_range(0, NUM_RAYS, &single_data, raycast_single_task_cb, &settings);
+  raycast_print_result("Single rays - Threaded", PIL_check_seconds_timer() - time_start, hits);
+
+  raycast_hits_init(hits, NUM_RAYS);
+  time_start = PIL_check_seconds_timer();
+  BLI_bvhtree_ray_cast_batch(tree, co, dir, NUM_RAYS, 0.0f, hits, raycast_triangle_cb, &data, 0);
+  raycast_print_result("Batch - Threaded", PIL_check_seconds_timer() - time_start, hits);
+
+  BLI_bvhtree_free(tree);
+  MEM_freeN(data.verts);
+  MEM_freeN(data.tris);
+  MEM_freeN(co);
+  MEM_freeN(dir);
+  MEM_freeN(hits);
+
+  BLI_threadapi_exit();
+
+  printf("========== ENDED %s ==========\n\n", "BVH ray-cast - 10M triangles");
+}
@@ -40,6 +40,14 @@ enum {
    * (typically owned by #ID's, will be freed when there are no users).
    */
   DATA = BLEND_MAKE_ID('D', 'A', 'T', 'A'),
+  /**
+   * A #DATA block identical to an earlier one, only written when de-duplicating,
+   * the data is the `uint64_t` offset of the data of the earlier block in the file.
+   *
+   * \note Supported since file version 300.26. Older versions don't know this code and would skip
+   * these blocks, so files containing them raise the minimum version to 300.26.
+   */
+  DDUP = BLEND_MAKE_ID('D', 'D', 'U', 'P'),
   /**
    * Used for #Global struct.
    */
@@ -64,6 +72,14 @@ enum {
    * (written to #BLENDER_STARTUP_FILE & #BLENDER_USERPREF_FILE).
    */
   USER = BLEND_MAKE_ID('U', 'S', 'E', 'R'),
+  /**
+   * A block replaced by incremental saving, ignored along with the #DATA blocks following it.
+   * This code is written over the code of the replaced block (including #ENDB).
+   *
+   * \note Supported since file version 300.26, files containing them raise the minimum version
+   * to 300.26 like for #DDUP blocks.
+   */
+  SKIP = BLEND_MAKE_ID('S', 'K', 'I', 'P'),
   /**
    * Terminate reading (no data).
    */
@@ -218,6 +218,10 @@ bool BLO_read_data_is_undo(BlendDataReader *reader);
 void BLO_read_data_globmap_add(BlendDataReader *reader, void *oldaddr, void *newaddr);
 void BLO_read_glob_list(BlendDataReader *reader, struct ListBase *list);
 struct BlendFileReadReport *BLO_read_data_reports(BlendDataReader *reader);
+bool BLO_read_data_file_location(BlendDataReader *reader,
+                                 const void *old_address,
+                                 const char **r_filepath,
+                                 int64_t *r_file_offset);
 
 /* Blend Read Lib API
  * ===================
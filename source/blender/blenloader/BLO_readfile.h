@@ -147,6 +147,22 @@ BlendFileData *BLO_read_from_memfile(struct Main *oldmain,
 
 void BLO_blendfiledata_free(BlendFileData *bfd);
 
+void BLO_sdna_cache_free(void);
+
+/**
+ * Profile loading of blend files with #BLO_read_from_file, appending a JSON report per file to
+ * \a filepath (`-` for the standard output). Pass NULL to disable.
+ */
+void BLO_read_profile_set(const char *filepath);
+
+/**
+ * Convert all blocks of a file which DNA differs from the current one with and without threads,
+ * for tests.
+ * \return The number of converted blocks, or -1 when the results differ or reading failed.
+ */
+int BLO_read_file_reconstruct_structs_compare(const char *filepath,
+                                              struct BlendFileReadReport *reports);
+
 /** \} */
 
 /* -------------------------------------------------------------------- */
@@ -26,15 +26,25 @@
 
 #include "BLI_filereader.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 struct GHash;
+struct MemFileBuffer;
 struct Scene;
 
 typedef struct {
   void *next, *prev;
-  const char *buf;
+  /**
+   * The memory of the chunk, shared by all chunks with the same content in any step.
+   * Compressed in the background once no recent step uses it.
+   */
+  struct MemFileBuffer *buffer;
   /** Size in bytes. */
   size_t size;
-  /** When true, this chunk doesn't own the memory, it's shared with a previous #MemFileChunk */
+  /** When true, this chunk is identical to the one at the same position in the previous step
+   * (used by undo code to detect unchanged IDs). */
   bool is_identical;
   /** When true, this chunk is also identical to the one in the next step (used by undo code to
    * detect unchanged IDs).
@@ -47,6 +57,7 @@ typedef struct {
 
 typedef struct MemFile {
   ListBase chunks;
+  /** Memory used by the buffers this memfile owns, with the compressed size of cold buffers. */
   size_t size;
 } MemFile;
 
@@ -75,6 +86,10 @@ typedef struct {
   int undo_direction;
 
   bool memchunk_identical;
+
+  /** Decompressed data of the last compressed buffer read from. */
+  struct MemFileBuffer *cache_buffer;
+  char *cache_data;
 } UndoReader;
 
 /* actually only used writefile.c */
@@ -90,11 +105,18 @@ void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, size_t s
 extern void BLO_memfile_free(MemFile *memfile);
 extern void BLO_memfile_merge(MemFile *first, MemFile *second);
 extern void BLO_memfile_clear_future(MemFile *memfile);
+extern void BLO_memfile_storage_exit(void);
 
 /* utilities */
 extern struct Main *BLO_memfile_main_get(struct MemFile *memfile,
                                          struct Main *bmain,
                                          struct Scene **r_scene);
 extern bool BLO_memfile_write_file(struct MemFile *memfile, const char *filename);
+extern const char *BLO_memfile_chunk_data_get(const MemFileChunk *chunk, char **r_data_temp);
+extern uint64_t BLO_memfile_chunk_content_key(const MemFileChunk *chunk);
 
 FileReader *BLO_memfile_new_filereader(MemFile *memfile, int undo_direction);
+
+#ifdef __cplusplus
+}
+#endif
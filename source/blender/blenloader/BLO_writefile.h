@@ -24,6 +24,10 @@
  * \brief external writefile function prototypes.
  */
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 struct BlendThumbnail;
 struct Main;
 struct MemFile;
@@ -71,4 +75,11 @@ extern bool BLO_write_file_mem(struct Main *mainvar,
                                struct MemFile *current,
                                int write_flags);
 
+extern bool BLO_write_memfile_incremental(struct MemFile *memfile, const char *filepath);
+extern void BLO_write_incremental_free(void);
+
 /** \} */
+
+#ifdef __cplusplus
+}
+#endif
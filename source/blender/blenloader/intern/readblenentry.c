@@ -40,6 +40,8 @@
 #include "DNA_genfile.h"
 #include "DNA_sdna_types.h"
 
+#include "PIL_time.h"
+
 #include "BKE_icons.h"
 #include "BKE_idtype.h"
 #include "BKE_main.h"
@@ -276,7 +278,7 @@ PreviewImage *BLO_blendhandle_get_preview_for_id(BlendHandle *bh,
   const int sdna_preview_image = DNA_struct_find_nr(fd->filesdna, "PreviewImage");
 
   for (BHead *bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
-    if (bhead->code == DATA) {
+    if (ELEM(bhead->code, DATA, DDUP)) {
       if (looking && bhead->SDNAnr == sdna_preview_image) {
         PreviewImage *preview_from_file = BLO_library_read_struct(fd, bhead, "PreviewImage");
 
@@ -347,7 +349,7 @@ LinkNode *BLO_blendhandle_get_previews(BlendHandle *bh, int ofblocktype, int *r_
           break;
       }
     }
-    else if (bhead->code == DATA) {
+    else if (ELEM(bhead->code, DATA, DDUP)) {
       if (looking) {
         if (bhead->SDNAnr == DNA_struct_find_nr(fd->filesdna, "PreviewImage")) {
           prv = BLO_library_read_struct(fd, bhead, "PreviewImage");
@@ -436,11 +438,14 @@ BlendFileData *BLO_read_from_file(const char *filepath,
 {
   BlendFileData *bfd = NULL;
   FileData *fd;
+  const double time_start = PIL_check_seconds_timer();
 
   fd = blo_filedata_from_file(filepath, reports);
   if (fd) {
     fd->skip_flags = skip_flags;
+    blo_read_profile_begin(fd, time_start);
     bfd = blo_read_file_internal(fd, filepath);
+    blo_read_profile_end(fd, filepath);
     blo_filedata_free(fd);
   }
 
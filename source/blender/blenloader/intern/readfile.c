@@ -65,10 +65,12 @@
 #include "BLI_endian_defines.h"
 #include "BLI_endian_switch.h"
 #include "BLI_ghash.h"
+#include "BLI_hash_mm2a.h"
 #include "BLI_linklist.h"
 #include "BLI_math.h"
 #include "BLI_memarena.h"
 #include "BLI_mempool.h"
+#include "BLI_task.h"
 #include "BLI_threads.h"
 
 #include "PIL_time.h"
@@ -78,6 +80,7 @@
 #include "BKE_anim_data.h"
 #include "BKE_animsys.h"
 #include "BKE_asset.h"
+#include "BKE_blender_version.h"
 #include "BKE_collection.h"
 #include "BKE_global.h" /* for G */
 #include "BKE_idprop.h"
@@ -184,6 +187,21 @@
 /* use GHash for BHead name-based lookups (speeds up linking) */
 #define USE_GHASH_BHEAD
 
+/**
+ * Minimum size of packed file contents to leave in the file with #G_FILE_LAZY_PACKED_READ,
+ * smaller blocks are cheap enough to read immediately.
+ */
+#define DEFERRED_DATA_MIN_SIZE (64 * 1024)
+
+/**
+ * Convert the DNA of the blocks of every data-block in parallel, before they are handed over to
+ * #read_struct, see #read_libblock_reconstruct_structs.
+ *
+ * \note Only the conversion itself is threaded, the address maps, `direct_link` and
+ * `lib_link` code still runs on the main thread in file order.
+ */
+#define USE_PARALLEL_STRUCT_RECONSTRUCT
+
 /* Use GHash for restoring pointers by name */
 #define USE_GHASH_RESTORE_POINTER
 
@@ -206,6 +224,10 @@ typedef struct BHeadN {
   bool has_data;
 #endif
   bool is_memchunk_identical;
+#ifdef USE_PARALLEL_STRUCT_RECONSTRUCT
+  /** Data already converted to the current DNA, ownership is taken by #read_struct. */
+  void *data_reconstructed;
+#endif
   struct BHead bhead;
 } BHeadN;
 
@@ -258,6 +280,18 @@ typedef struct OldNew {
   int nr;
 } OldNew;
 
+/** Statistics printed with `--debug`, kept over #oldnewmap_clear. */
+typedef struct OldNewMapStats {
+  int64_t inserts;
+  int64_t lookups;
+  /** Number of slots visited by all inserts. Lookups are only counted, to keep them cheap. */
+  int64_t probes;
+  int probes_max;
+  int entries_max;
+  /** Number of times the map was rebuilt, because it was too small. */
+  int rehashes;
+} OldNewMapStats;
+
 typedef struct OldNewMap {
   /* Array that stores the actual entries. */
   OldNew *entries;
@@ -266,9 +300,14 @@ typedef struct OldNewMap {
   int32_t *map;
 
   int capacity_exp;
+  /* The arrays are not shrunk when clearing, only grown when needed. */
+  int capacity_exp_alloc;
+
+  OldNewMapStats stats;
 } OldNewMap;
 
-#define ENTRIES_CAPACITY(onm) (1ll << (onm)->capacity_exp)
+#define ENTRIES_CAPACITY_EXP(capacity_exp) (1ll << (capacity_exp))
+#define ENTRIES_CAPACITY(onm) ENTRIES_CAPACITY_EXP((onm)->capacity_exp)
 #define MAP_CAPACITY(onm) (1ll << ((onm)->capacity_exp + 1))
 #define SLOT_MASK(onm) (MAP_CAPACITY(onm) - 1)
 #define DEFAULT_SIZE_EXP 6
@@ -285,6 +324,14 @@ typedef struct OldNewMap {
           perturb >>= PERTURB_SHIFT, \
           INDEX_NAME = onm->map[SLOT_NAME])
 
+BLI_INLINE void oldnewmap_stats_add_probes(OldNewMap *onm, int probes)
+{
+  onm->stats.probes += probes;
+  if (UNLIKELY(probes > onm->stats.probes_max)) {
+    onm->stats.probes_max = probes;
+  }
+}
+
 static void oldnewmap_insert_index_in_map(OldNewMap *onm, const void *ptr, int index)
 {
   ITER_SLOTS (onm, ptr, slot, stored_index) {
@@ -297,7 +344,9 @@ static void oldnewmap_insert_index_in_map(OldNewMap *onm, const void *ptr, int i
 
 static void oldnewmap_insert_or_replace(OldNewMap *onm, OldNew entry)
 {
+  int probes = 0;
   ITER_SLOTS (onm, entry.oldp, slot, index) {
+    probes++;
     if (index == -1) {
       onm->entries[onm->nentries] = entry;
       onm->map[slot] = onm->nentries;
@@ -309,6 +358,8 @@ static void oldnewmap_insert_or_replace(OldNewMap *onm, OldNew entry)
       break;
     }
   }
+  onm->stats.inserts++;
+  oldnewmap_stats_add_probes(onm, probes);
 }
 
 static OldNew *oldnewmap_lookup_entry(const OldNewMap *onm, const void *addr)
@@ -331,17 +382,28 @@ static void oldnewmap_clear_map(OldNewMap *onm)
   memset(onm->map, 0xFF, MAP_CAPACITY(onm) * sizeof(*onm->map));
 }
 
-static void oldnewmap_increase_size(OldNewMap *onm)
+static void oldnewmap_resize(OldNewMap *onm, int capacity_exp)
 {
-  onm->capacity_exp++;
-  onm->entries = MEM_reallocN(onm->entries, sizeof(*onm->entries) * ENTRIES_CAPACITY(onm));
-  onm->map = MEM_reallocN(onm->map, sizeof(*onm->map) * MAP_CAPACITY(onm));
+  onm->capacity_exp = capacity_exp;
+  if (capacity_exp > onm->capacity_exp_alloc) {
+    onm->capacity_exp_alloc = capacity_exp;
+    onm->entries = MEM_reallocN(onm->entries, sizeof(*onm->entries) * ENTRIES_CAPACITY(onm));
+    /* The map is rebuilt from the entries, no need to copy it. */
+    MEM_freeN(onm->map);
+    onm->map = MEM_malloc_arrayN(MAP_CAPACITY(onm), sizeof(*onm->map), "OldNewMap.map");
+  }
   oldnewmap_clear_map(onm);
   for (int i = 0; i < onm->nentries; i++) {
     oldnewmap_insert_index_in_map(onm, onm->entries[i].oldp, i);
   }
 }
 
+static void oldnewmap_increase_size(OldNewMap *onm)
+{
+  onm->stats.rehashes++;
+  oldnewmap_resize(onm, onm->capacity_exp + 1);
+}
+
 /* Public OldNewMap API */
 
 static OldNewMap *oldnewmap_new(void)
@@ -349,6 +411,7 @@ static OldNewMap *oldnewmap_new(void)
   OldNewMap *onm = MEM_callocN(sizeof(*onm), "OldNewMap");
 
   onm->capacity_exp = DEFAULT_SIZE_EXP;
+  onm->capacity_exp_alloc = DEFAULT_SIZE_EXP;
   onm->entries = MEM_malloc_arrayN(
       ENTRIES_CAPACITY(onm), sizeof(*onm->entries), "OldNewMap.entries");
   onm->map = MEM_malloc_arrayN(MAP_CAPACITY(onm), sizeof(*onm->map), "OldNewMap.map");
@@ -357,6 +420,22 @@ static OldNewMap *oldnewmap_new(void)
   return onm;
 }
 
+/**
+ * Make room for \a entries_len more entries at once, avoids rebuilding the map multiple times
+ * when the number of inserted entries is known in advance.
+ */
+static void oldnewmap_reserve(OldNewMap *onm, int entries_len)
+{
+  const int64_t entries_len_total = (int64_t)onm->nentries + entries_len;
+  int capacity_exp = onm->capacity_exp;
+  while (ENTRIES_CAPACITY_EXP(capacity_exp) < entries_len_total) {
+    capacity_exp++;
+  }
+  if (capacity_exp != onm->capacity_exp) {
+    oldnewmap_resize(onm, capacity_exp);
+  }
+}
+
 static void oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void *newaddr, int nr)
 {
   if (oldaddr == NULL || newaddr == NULL) {
@@ -372,6 +451,9 @@ static void oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void *newaddr,
   entry.newp = newaddr;
   entry.nr = nr;
   oldnewmap_insert_or_replace(onm, entry);
+  if (UNLIKELY(onm->nentries > onm->stats.entries_max)) {
+    onm->stats.entries_max = onm->nentries;
+  }
 }
 
 void blo_do_versions_oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void *newaddr, int nr)
@@ -381,6 +463,7 @@ void blo_do_versions_oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void
 
 static void *oldnewmap_lookup_and_inc(OldNewMap *onm, const void *addr, bool increase_users)
 {
+  onm->stats.lookups++;
   OldNew *entry = oldnewmap_lookup_entry(onm, addr);
   if (entry == NULL) {
     return NULL;
@@ -424,6 +507,22 @@ static void oldnewmap_clear(OldNewMap *onm)
   onm->nentries = 0;
 }
 
+static void oldnewmap_stats_print(const OldNewMap *onm, const char *name)
+{
+  const OldNewMapStats *stats = &onm->stats;
+  printf("%s: %s: %" PRId64 " inserts, %" PRId64
+         " lookups, %d entries max, %.2f insert probes average, %d insert probes max, "
+         "%d rehashes\n",
+         __func__,
+         name,
+         stats->inserts,
+         stats->lookups,
+         stats->entries_max,
+         stats->inserts ? (double)stats->probes / (double)stats->inserts : 0.0,
+         stats->probes_max,
+         stats->rehashes);
+}
+
 static void oldnewmap_free(OldNewMap *onm)
 {
   MEM_freeN(onm->entries);
@@ -431,6 +530,7 @@ static void oldnewmap_free(OldNewMap *onm)
   MEM_freeN(onm);
 }
 
+#undef ENTRIES_CAPACITY_EXP
 #undef ENTRIES_CAPACITY
 #undef MAP_CAPACITY
 #undef SLOT_MASK
@@ -677,6 +777,189 @@ static Main *blo_find_main(FileData *fd, const char *filepath, const char *relab
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name Load Profiling
+ *
+ * Optional instrumentation of #BLO_read_from_file, enabled with #BLO_read_profile_set
+ * (`--profile-blend-load` on the command line). Wall time and bytes read are accumulated per
+ * loading phase and per ID type, then appended to the report file as one JSON object per line.
+ *
+ * Phases nest: library reading includes reading, versioning and linking the library data-blocks,
+ * and reading data-blocks includes converting their DNA, so phase times don't add up to the total.
+ * \{ */
+
+typedef enum eReadProfilePhase {
+  READ_PROFILE_OPEN = 0,
+  READ_PROFILE_RECONSTRUCT,
+  READ_PROFILE_READ_IDS,
+  READ_PROFILE_VERSIONING,
+  READ_PROFILE_LIBRARIES,
+  READ_PROFILE_LIB_LINK,
+  READ_PROFILE_REFCOUNT,
+  READ_PROFILE_LIB_OVERRIDES,
+} eReadProfilePhase;
+#define READ_PROFILE_PHASE_NUM (READ_PROFILE_LIB_OVERRIDES + 1)
+
+static const char *read_profile_phase_names[READ_PROFILE_PHASE_NUM] = {
+    "open",
+    "reconstruct",
+    "read_ids",
+    "versioning",
+    "libraries",
+    "lib_link",
+    "refcount",
+    "lib_overrides",
+};
+
+typedef struct BlendReadProfileSpan {
+  double time_start;
+  size_t bytes_start;
+} BlendReadProfileSpan;
+
+typedef struct BlendReadProfile {
+  double time_start;
+  /** Bytes read from all files (including libraries) so far. */
+  size_t bytes_read;
+  struct {
+    double time;
+    size_t bytes;
+  } phases[READ_PROFILE_PHASE_NUM];
+  struct {
+    int count;
+    /** Size of the ID block and all its data blocks, as stored in the file. */
+    size_t bytes;
+    double time_read;
+    double time_lib_link;
+  } id_types[INDEX_ID_MAX];
+} BlendReadProfile;
+
+/** Report file path, empty when profiling is disabled, `-` to print to the standard output. */
+static char read_profile_filepath[FILE_MAX] = "";
+
+void BLO_read_profile_set(const char *filepath)
+{
+  BLI_strncpy(read_profile_filepath, filepath ? filepath : "", sizeof(read_profile_filepath));
+}
+
+BLI_INLINE void read_profile_bytes_add(FileData *fd, size_t bytes)
+{
+  if (fd->profile) {
+    fd->profile->bytes_read += bytes;
+  }
+}
+
+static void read_profile_span_begin(const FileData *fd, BlendReadProfileSpan *r_span)
+{
+  if (fd->profile) {
+    r_span->time_start = PIL_check_seconds_timer();
+    r_span->bytes_start = fd->profile->bytes_read;
+  }
+}
+
+static void read_profile_span_end(FileData *fd,
+                                  const BlendReadProfileSpan *span,
+                                  const eReadProfilePhase phase)
+{
+  if (fd->profile) {
+    fd->profile->phases[phase].time += PIL_check_seconds_timer() - span->time_start;
+    fd->profile->phases[phase].bytes += fd->profile->bytes_read - span->bytes_start;
+  }
+}
+
+static int read_profile_id_type_index(const short idcode)
+{
+  const int index = BKE_idtype_idcode_to_index(idcode);
+  return (index >= 0 && index < INDEX_ID_MAX) ? index : -1;
+}
+
+/**
+ * Start profiling when enabled, \a time_start is taken before the file was opened
+ * so the open phase includes reading the header and the SDNA.
+ */
+void blo_read_profile_begin(FileData *fd, const double time_start)
+{
+  if (read_profile_filepath[0] == '\0') {
+    return;
+  }
+  BlendReadProfile *profile = MEM_callocN(sizeof(*profile), __func__);
+  profile->time_start = time_start;
+  profile->bytes_read = (size_t)fd->file->offset;
+  profile->phases[READ_PROFILE_OPEN].time = PIL_check_seconds_timer() - time_start;
+  profile->phases[READ_PROFILE_OPEN].bytes = profile->bytes_read;
+  fd->profile = profile;
+}
+
+static void read_profile_write(const BlendReadProfile *profile, const char *filepath, FILE *fp)
+{
+  char filepath_esc[FILE_MAX * 2];
+  BLI_str_escape(filepath_esc, filepath, sizeof(filepath_esc));
+
+  fprintf(fp,
+          "{\"filepath\": \"%s\", \"time\": %.6f, \"bytes\": %zu, \"phases\": {",
+          filepath_esc,
+          PIL_check_seconds_timer() - profile->time_start,
+          profile->bytes_read);
+  for (int i = 0; i < READ_PROFILE_PHASE_NUM; i++) {
+    fprintf(fp,
+            "%s\"%s\": {\"time\": %.6f, \"bytes\": %zu}",
+            i ? ", " : "",
+            read_profile_phase_names[i],
+            profile->phases[i].time,
+            profile->phases[i].bytes);
+  }
+  fprintf(fp, "}, \"id_types\": {");
+  bool is_first = true;
+  for (int i = 0; i < INDEX_ID_MAX; i++) {
+    if (profile->id_types[i].count == 0) {
+      continue;
+    }
+    fprintf(fp,
+            "%s\"%s\": {\"count\": %d, \"bytes\": %zu, \"time_read\": %.6f, "
+            "\"time_lib_link\": %.6f}",
+            is_first ? "" : ", ",
+            BKE_idtype_idcode_to_name(BKE_idtype_idcode_from_index(i)),
+            profile->id_types[i].count,
+            profile->id_types[i].bytes,
+            profile->id_types[i].time_read,
+            profile->id_types[i].time_lib_link);
+    is_first = false;
+  }
+  fprintf(fp, "}}\n");
+}
+
+/**
+ * Write the report of a profiled load and free the profile.
+ */
+void blo_read_profile_end(FileData *fd, const char *filepath)
+{
+  BlendReadProfile *profile = fd->profile;
+  if (profile == NULL) {
+    return;
+  }
+  fd->profile = NULL;
+
+  if (STREQ(read_profile_filepath, "-")) {
+    read_profile_write(profile, filepath, stdout);
+    fflush(stdout);
+  }
+  else {
+    FILE *fp = BLI_fopen(read_profile_filepath, "a");
+    if (fp != NULL) {
+      read_profile_write(profile, filepath, fp);
+      fclose(fp);
+    }
+    else {
+      CLOG_ERROR(&LOG,
+                 "Unable to write load profile to '%s': %s",
+                 read_profile_filepath,
+                 strerror(errno));
+    }
+  }
+  MEM_freeN(profile);
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name File Parsing
  * \{ */
@@ -786,6 +1069,7 @@ static BHeadN *get_bhead(FileData *fd)
       if (fd->flags & FD_FLAGS_FILE_POINTSIZE_IS_4) {
         bhead4.code = DATA;
         readsize = fd->file->read(fd->file, &bhead4, sizeof(bhead4));
+        read_profile_bytes_add(fd, (size_t)MAX2(readsize, 0));
 
         if (readsize == sizeof(bhead4) || bhead4.code == ENDB) {
           if (fd->flags & FD_FLAGS_SWITCH_ENDIAN) {
@@ -809,6 +1093,7 @@ static BHeadN *get_bhead(FileData *fd)
       else {
         bhead8.code = DATA;
         readsize = fd->file->read(fd->file, &bhead8, sizeof(bhead8));
+        read_profile_bytes_add(fd, (size_t)MAX2(readsize, 0));
 
         if (readsize == sizeof(bhead8) || bhead8.code == ENDB) {
           if (fd->flags & FD_FLAGS_SWITCH_ENDIAN) {
@@ -850,6 +1135,9 @@ static BHeadN *get_bhead(FileData *fd)
           new_bhead->file_offset = fd->file->offset;
           new_bhead->has_data = false;
           new_bhead->is_memchunk_identical = false;
+#  ifdef USE_PARALLEL_STRUCT_RECONSTRUCT
+          new_bhead->data_reconstructed = NULL;
+#  endif
           new_bhead->bhead = bhead;
           off64_t seek_new = fd->file->seek(fd->file, bhead.len, SEEK_CUR);
           if (seek_new == -1) {
@@ -869,13 +1157,18 @@ static BHeadN *get_bhead(FileData *fd)
         if (new_bhead) {
           new_bhead->next = new_bhead->prev = NULL;
 #ifdef USE_BHEAD_READ_ON_DEMAND
-          new_bhead->file_offset = 0; /* don't seek. */
+          /* Not used for reading (the data is already read), only to find #DDUP sources. */
+          new_bhead->file_offset = fd->file->offset;
           new_bhead->has_data = true;
 #endif
           new_bhead->is_memchunk_identical = false;
+#ifdef USE_PARALLEL_STRUCT_RECONSTRUCT
+          new_bhead->data_reconstructed = NULL;
+#endif
           new_bhead->bhead = bhead;
 
           readsize = fd->file->read(fd->file, new_bhead + 1, (size_t)bhead.len);
+          read_profile_bytes_add(fd, (size_t)MAX2(readsize, 0));
 
           if (readsize != bhead.len) {
             fd->is_eof = true;
@@ -972,6 +1265,9 @@ static bool blo_bhead_read_data(FileData *fd, BHead *thisblock, void *buf)
     if (fd->file->read(fd->file, buf, (size_t)new_bhead->bhead.len) != new_bhead->bhead.len) {
       success = false;
     }
+    else {
+      read_profile_bytes_add(fd, (size_t)new_bhead->bhead.len);
+    }
     if (fd->flags & FD_FLAGS_IS_MEMFILE) {
       new_bhead->is_memchunk_identical = ((UndoReader *)fd->file)->memchunk_identical;
     }
@@ -990,6 +1286,9 @@ static BHead *blo_bhead_read_full(FileData *fd, BHead *thisblock)
   new_bhead_data->file_offset = new_bhead->file_offset;
   new_bhead_data->has_data = true;
   new_bhead_data->is_memchunk_identical = false;
+#  ifdef USE_PARALLEL_STRUCT_RECONSTRUCT
+  new_bhead_data->data_reconstructed = NULL;
+#  endif
   if (!blo_bhead_read_data(fd, thisblock, new_bhead_data + 1)) {
     MEM_freeN(new_bhead_data);
     return NULL;
@@ -1053,6 +1352,145 @@ static void decode_blender_header(FileData *fd)
   }
 }
 
+/* -------------------------------------------------------------------- */
+/** \name SDNA Cache
+ *
+ * Converting a file's DNA for reading (#DNA_struct_get_compareflags and
+ * #DNA_reconstruct_info_create) only depends on the DNA stored in the file and its version.
+ * Files written by the same Blender build share that DNA, so the results are cached for the
+ * whole process, avoiding the setup cost when many files or libraries are read.
+ * \{ */
+
+/** Different DNA's seen in a session are few, this only limits memory in pathological cases. */
+#define SDNA_CACHE_MAX_ENTRIES 32
+
+typedef struct SDNACacheEntry {
+  struct SDNACacheEntry *next, *prev;
+
+  /* Key. */
+  uint32_t hash;
+  int fileversion, subversion;
+  bool do_endian_swap;
+  /** Copy of the DNA1 block, used for exact comparison. */
+  void *data;
+  int data_len;
+
+  /* Value. */
+  struct SDNA *filesdna;
+  const char *compflags;
+  struct DNA_ReconstructInfo *reconstruct_info;
+} SDNACacheEntry;
+
+static struct {
+  ListBase entries;
+  int entries_len;
+  ThreadMutex mutex;
+} g_sdna_cache = {{NULL, NULL}, 0, BLI_MUTEX_INITIALIZER};
+
+static SDNACacheEntry *sdna_cache_entry_new(const void *data,
+                                            const int data_len,
+                                            const bool do_endian_swap,
+                                            const int fileversion,
+                                            const int subversion,
+                                            const struct SDNA *memsdna,
+                                            const char **r_error_message)
+{
+  struct SDNA *filesdna = DNA_sdna_from_data(
+      data, data_len, do_endian_swap, true, r_error_message);
+  if (filesdna == NULL) {
+    return NULL;
+  }
+  blo_do_versions_dna(filesdna, fileversion, subversion);
+
+  SDNACacheEntry *entry = MEM_callocN(sizeof(*entry), __func__);
+  entry->fileversion = fileversion;
+  entry->subversion = subversion;
+  entry->do_endian_swap = do_endian_swap;
+  entry->filesdna = filesdna;
+  entry->compflags = DNA_struct_get_compareflags(filesdna, memsdna);
+  entry->reconstruct_info = DNA_reconstruct_info_create(filesdna, memsdna, entry->compflags);
+  return entry;
+}
+
+static void sdna_cache_entry_free(SDNACacheEntry *entry)
+{
+  DNA_reconstruct_info_free(entry->reconstruct_info);
+  MEM_freeN((void *)entry->compflags);
+  DNA_sdna_free(entry->filesdna);
+  MEM_SAFE_FREE(entry->data);
+  MEM_freeN(entry);
+}
+
+/**
+ * Find or create the converted DNA of a file.
+ *
+ * \return The entry to take the DNA from, owned by the cache when it's in #g_sdna_cache.entries,
+ * otherwise by the caller.
+ */
+static SDNACacheEntry *sdna_cache_ensure(FileData *fd,
+                                         const BHead *bhead,
+                                         const int subversion,
+                                         const char **r_error_message)
+{
+  const bool do_endian_swap = (fd->flags & FD_FLAGS_SWITCH_ENDIAN) != 0;
+  const uint32_t hash = BLI_hash_mm2((const uchar *)&bhead[1], (size_t)bhead->len, 0);
+
+  BLI_mutex_lock(&g_sdna_cache.mutex);
+
+  LISTBASE_FOREACH (SDNACacheEntry *, entry, &g_sdna_cache.entries) {
+    if (entry->hash == hash && entry->data_len == bhead->len &&
+        entry->fileversion == fd->fileversion && entry->subversion == subversion &&
+        entry->do_endian_swap == do_endian_swap &&
+        memcmp(entry->data, &bhead[1], (size_t)bhead->len) == 0) {
+      BLI_mutex_unlock(&g_sdna_cache.mutex);
+      return entry;
+    }
+  }
+
+  SDNACacheEntry *entry = sdna_cache_entry_new(&bhead[1],
+                                               bhead->len,
+                                               do_endian_swap,
+                                               fd->fileversion,
+                                               subversion,
+                                               fd->memsdna,
+                                               r_error_message);
+  if (entry != NULL && g_sdna_cache.entries_len < SDNA_CACHE_MAX_ENTRIES) {
+    entry->hash = hash;
+    entry->data_len = bhead->len;
+    entry->data = MEM_mallocN((size_t)bhead->len, __func__);
+    memcpy(entry->data, &bhead[1], (size_t)bhead->len);
+    BLI_addtail(&g_sdna_cache.entries, entry);
+    g_sdna_cache.entries_len++;
+  }
+
+  BLI_mutex_unlock(&g_sdna_cache.mutex);
+  return entry;
+}
+
+static bool sdna_cache_entry_is_cached(const SDNACacheEntry *entry)
+{
+  /* Only cached entries store a copy of their key. */
+  return entry->data != NULL;
+}
+
+/**
+ * Free all cached DNA's, must only be called when no file is being read.
+ */
+void BLO_sdna_cache_free(void)
+{
+  BLI_mutex_lock(&g_sdna_cache.mutex);
+  LISTBASE_FOREACH_MUTABLE (SDNACacheEntry *, entry, &g_sdna_cache.entries) {
+    sdna_cache_entry_free(entry);
+  }
+  BLI_listbase_clear(&g_sdna_cache.entries);
+  g_sdna_cache.entries_len = 0;
+  BLI_mutex_unlock(&g_sdna_cache.mutex);
+}
+
+#undef SDNA_CACHE_MAX_ENTRIES
+
+/** \} */
+
 /**
  * \return Success if the file is read correctly, else set \a r_error_message.
  */
@@ -1078,15 +1516,18 @@ static bool read_file_dna(FileData *fd, const char **r_error_message)
       subversion = atoi(num);
     }
     else if (bhead->code == DNA1) {
-      const bool do_endian_swap = (fd->flags & FD_FLAGS_SWITCH_ENDIAN) != 0;
-
-      fd->filesdna = DNA_sdna_from_data(
-          &bhead[1], bhead->len, do_endian_swap, true, r_error_message);
-      if (fd->filesdna) {
-        blo_do_versions_dna(fd->filesdna, fd->fileversion, subversion);
-        fd->compflags = DNA_struct_get_compareflags(fd->filesdna, fd->memsdna);
-        fd->reconstruct_info = DNA_reconstruct_info_create(
-            fd->filesdna, fd->memsdna, fd->compflags);
+      SDNACacheEntry *sdna_entry = sdna_cache_ensure(fd, bhead, subversion, r_error_message);
+      if (sdna_entry) {
+        fd->filesdna = sdna_entry->filesdna;
+        fd->compflags = sdna_entry->compflags;
+        fd->reconstruct_info = sdna_entry->reconstruct_info;
+        if (sdna_cache_entry_is_cached(sdna_entry)) {
+          fd->flags |= FD_FLAGS_SDNA_IS_SHARED;
+        }
+        else {
+          /* The cache is full, the file data takes ownership. */
+          MEM_freeN(sdna_entry);
+        }
         /* used to retrieve ID names from (bhead+1) */
         fd->id_name_offset = DNA_elem_offset(fd->filesdna, "ID", "char", "name[]");
         BLI_assert(fd->id_name_offset != -1);
@@ -1251,6 +1692,9 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
 
   FileData *fd = filedata_new(reports);
   fd->file = file;
+  if (memcmp(header, "BLENDER", sizeof(header)) == 0) {
+    fd->flags |= FD_FLAGS_IS_UNCOMPRESSED;
+  }
 
   return fd;
 }
@@ -1353,6 +1797,13 @@ void blo_filedata_free(FileData *fd)
   if (fd) {
     fd->file->close(fd->file);
 
+#ifdef USE_PARALLEL_STRUCT_RECONSTRUCT
+    /* Blocks converted ahead of time which ended up not being read (skipped or unknown IDs). */
+    LISTBASE_FOREACH (BHeadN *, new_bhead, &fd->bhead_list) {
+      MEM_SAFE_FREE(new_bhead->data_reconstructed);
+    }
+#endif
+
     /* Free all BHeadN data blocks */
 #ifndef NDEBUG
     BLI_freelistN(&fd->bhead_list);
@@ -1366,19 +1817,42 @@ void blo_filedata_free(FileData *fd)
     }
 #endif
 
-    if (fd->filesdna) {
-      DNA_sdna_free(fd->filesdna);
-    }
-    if (fd->compflags) {
-      MEM_freeN((void *)fd->compflags);
+    /* Shared DNA is owned by the cache, see #BLO_sdna_cache_free. */
+    if ((fd->flags & FD_FLAGS_SDNA_IS_SHARED) == 0) {
+      if (fd->filesdna) {
+        DNA_sdna_free(fd->filesdna);
+      }
+      if (fd->compflags) {
+        MEM_freeN((void *)fd->compflags);
+      }
+      if (fd->reconstruct_info) {
+        DNA_reconstruct_info_free(fd->reconstruct_info);
+      }
     }
-    if (fd->reconstruct_info) {
-      DNA_reconstruct_info_free(fd->reconstruct_info);
+
+    if (G.debug & G_DEBUG) {
+      const struct {
+        const OldNewMap *map;
+        const char *name;
+      } maps[] = {
+          {fd->datamap, "datamap"},
+          {fd->globmap, "globmap"},
+          {fd->libmap, "libmap"},
+          {fd->packedmap, "packedmap"},
+      };
+      for (int i = 0; i < ARRAY_SIZE(maps); i++) {
+        if (maps[i].map && maps[i].map->stats.inserts) {
+          oldnewmap_stats_print(maps[i].map, maps[i].name);
+        }
+      }
     }
 
     if (fd->datamap) {
       oldnewmap_free(fd->datamap);
     }
+    if (fd->deferredmap) {
+      oldnewmap_free(fd->deferredmap);
+    }
     if (fd->globmap) {
       oldnewmap_free(fd->globmap);
     }
@@ -1395,6 +1869,7 @@ void blo_filedata_free(FileData *fd)
     if (fd->bheadmap) {
       MEM_freeN(fd->bheadmap);
     }
+    MEM_SAFE_FREE(fd->bhead_data_index);
 
 #ifdef USE_GHASH_BHEAD
     if (fd->bhead_idname_hash) {
@@ -1541,15 +2016,41 @@ BlendThumbnail *BLO_thumbnail_from_file(const char *filepath)
  * \{ */
 
 /* Only direct data-blocks. */
+/**
+ * Read data which reading was deferred by #read_data_into_datamap, because something else than
+ * the packed file it belongs to is using it.
+ */
+static void *read_deferred_data(FileData *fd, const void *adr, bool increase_users)
+{
+  OldNew *entry = oldnewmap_lookup_entry(fd->deferredmap, adr);
+  if (entry == NULL || entry->newp == NULL) {
+    return NULL;
+  }
+  BHead *bhead = entry->newp;
+  entry->newp = NULL;
+
+  void *data = read_struct(fd, bhead, "Data from deferred read");
+  oldnewmap_insert(fd->datamap, adr, data, 0);
+  return oldnewmap_lookup_and_inc(fd->datamap, adr, increase_users);
+}
+
 static void *newdataadr(FileData *fd, const void *adr)
 {
-  return oldnewmap_lookup_and_inc(fd->datamap, adr, true);
+  void *data = oldnewmap_lookup_and_inc(fd->datamap, adr, true);
+  if (UNLIKELY(data == NULL && fd->deferredmap && adr)) {
+    data = read_deferred_data(fd, adr, true);
+  }
+  return data;
 }
 
 /* Only direct data-blocks. */
 static void *newdataadr_no_us(FileData *fd, const void *adr)
 {
-  return oldnewmap_lookup_and_inc(fd->datamap, adr, false);
+  void *data = oldnewmap_lookup_and_inc(fd->datamap, adr, false);
+  if (UNLIKELY(data == NULL && fd->deferredmap && adr)) {
+    data = read_deferred_data(fd, adr, false);
+  }
+  return data;
 }
 
 /* Direct datablocks with global linking. */
@@ -1565,7 +2066,7 @@ static void *newpackedadr(FileData *fd, const void *adr)
     return oldnewmap_lookup_and_inc(fd->packedmap, adr, true);
   }
 
-  return oldnewmap_lookup_and_inc(fd->datamap, adr, true);
+  return newdataadr(fd, adr);
 }
 
 /* only lib data */
@@ -1637,7 +2138,9 @@ void blo_clear_proxy_pointers_from_lib(Main *oldmain)
 static void insert_packedmap(FileData *fd, PackedFile *pf)
 {
   oldnewmap_insert(fd->packedmap, pf, pf, 0);
-  oldnewmap_insert(fd->packedmap, pf->data, pf->data, 0);
+  if (pf->data) {
+    oldnewmap_insert(fd->packedmap, pf->data, pf->data, 0);
+  }
 }
 
 void blo_make_packed_pointer_map(FileData *fd, Main *oldmain)
@@ -1908,10 +2411,27 @@ static void switch_endian_structs(const struct SDNA *filesdna, BHead *bhead)
   }
 }
 
+static void *read_struct_dedup(FileData *fd, BHead *bh, const char *blockname);
+
 static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
 {
   void *temp = NULL;
 
+  if (UNLIKELY(bh->code == DDUP)) {
+    return read_struct_dedup(fd, bh, blockname);
+  }
+
+#ifdef USE_PARALLEL_STRUCT_RECONSTRUCT
+  {
+    BHeadN *new_bhead = BHEADN_FROM_BHEAD(bh);
+    if (new_bhead->data_reconstructed != NULL) {
+      temp = new_bhead->data_reconstructed;
+      new_bhead->data_reconstructed = NULL;
+      return temp;
+    }
+  }
+#endif
+
   if (bh->len) {
 #ifdef USE_BHEAD_READ_ON_DEMAND
     BHead *bh_orig = bh;
@@ -1976,6 +2496,308 @@ static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
   return temp;
 }
 
+/**
+ * Find the #DATA block a #DDUP block refers to, from the offset of its data in the file.
+ * The index of blocks is extended up to \a bh_ref as needed, earlier blocks are never removed
+ * from #FileData.bhead_list so it stays sorted by offset.
+ */
+static BHead *read_dedup_source_find(FileData *fd, BHead *bh_ref, const uint64_t file_offset)
+{
+#ifdef USE_BHEAD_READ_ON_DEMAND
+  BHeadN *new_bhead = (fd->bhead_data_index_len != 0) ?
+                          fd->bhead_data_index[fd->bhead_data_index_len - 1]->next :
+                          fd->bhead_list.first;
+  for (; new_bhead && &new_bhead->bhead != bh_ref; new_bhead = new_bhead->next) {
+    if (new_bhead->bhead.code != DATA) {
+      continue;
+    }
+    if (fd->bhead_data_index_len == fd->bhead_data_index_alloc) {
+      fd->bhead_data_index_alloc = max_ii(1024, fd->bhead_data_index_alloc * 2);
+      fd->bhead_data_index = MEM_reallocN(
+          fd->bhead_data_index, sizeof(*fd->bhead_data_index) * fd->bhead_data_index_alloc);
+    }
+    fd->bhead_data_index[fd->bhead_data_index_len++] = new_bhead;
+  }
+
+  int low = 0, high = fd->bhead_data_index_len - 1;
+  while (low <= high) {
+    const int mid = low + (high - low) / 2;
+    BHeadN *bhead_mid = fd->bhead_data_index[mid];
+    if ((uint64_t)bhead_mid->file_offset == file_offset) {
+      return &bhead_mid->bhead;
+    }
+    if ((uint64_t)bhead_mid->file_offset < file_offset) {
+      low = mid + 1;
+    }
+    else {
+      high = mid - 1;
+    }
+  }
+#else
+  UNUSED_VARS(fd, bh_ref, file_offset);
+#endif
+  return NULL;
+}
+
+/**
+ * Read the data of the block a #DDUP block refers to.
+ *
+ * \note The source block is read from a copy: it may belong to a data-block that is read
+ * (or skipped) separately. Endian switching of a source already read in-place is not handled,
+ * files needing it can only come from big-endian systems which don't write #DDUP blocks.
+ */
+static void *read_struct_dedup(FileData *fd, BHead *bh, const char *blockname)
+{
+  uint64_t file_offset;
+  if (bh->len != sizeof(file_offset)) {
+    return NULL;
+  }
+  memcpy(&file_offset, bh + 1, sizeof(file_offset));
+  if (fd->flags & FD_FLAGS_SWITCH_ENDIAN) {
+    BLI_endian_switch_uint64(&file_offset);
+  }
+
+  BHead *bh_src = read_dedup_source_find(fd, bh, file_offset);
+  if (UNLIKELY(bh_src == NULL || bh_src->SDNAnr != bh->SDNAnr || bh_src->nr != bh->nr)) {
+    CLOG_ERROR(&LOG, "Invalid reference to de-duplicated data at offset %" PRIu64, file_offset);
+    return NULL;
+  }
+
+  /* Read from a copy, #read_struct may modify or take the data of the block itself. */
+  BHeadN *new_bhead_src = BHEADN_FROM_BHEAD(bh_src);
+  BHeadN *new_bhead_copy;
+#ifdef USE_BHEAD_READ_ON_DEMAND
+  if (new_bhead_src->has_data == false) {
+    BHead *bh_copy = blo_bhead_read_full(fd, bh_src);
+    if (UNLIKELY(bh_copy == NULL)) {
+      fd->flags &= ~FD_FLAGS_FILE_OK;
+      return NULL;
+    }
+    new_bhead_copy = BHEADN_FROM_BHEAD(bh_copy);
+  }
+  else
+#endif
+  {
+    new_bhead_copy = MEM_mallocN(sizeof(BHeadN) + (size_t)bh_src->len, __func__);
+    memcpy(new_bhead_copy, new_bhead_src, sizeof(BHeadN) + (size_t)bh_src->len);
+#ifdef USE_PARALLEL_STRUCT_RECONSTRUCT
+    new_bhead_copy->data_reconstructed = NULL;
+#endif
+  }
+  new_bhead_copy->next = new_bhead_copy->prev = NULL;
+
+  void *temp = read_struct(fd, &new_bhead_copy->bhead, blockname);
+  MEM_freeN(new_bhead_copy);
+  return temp;
+}
+
+#ifdef USE_PARALLEL_STRUCT_RECONSTRUCT
+
+/** Amount of file data converted per batch, limits the temporary memory of on-demand blocks. */
+#  define RECONSTRUCT_BATCH_SIZE (64 * 1024 * 1024)
+/** Below this amount of data, converting on the main thread is cheaper than threading. */
+#  define RECONSTRUCT_THREADING_MIN_SIZE (256 * 1024)
+
+typedef struct ReconstructStructsData {
+  FileData *fd;
+  /** Blocks to convert, may be temporary copies for blocks which data is read on demand. */
+  BHead **bheads;
+  /** The blocks from the file's list the results are stored in. */
+  BHeadN **bheads_dst;
+  int bheads_len;
+  int bheads_capacity;
+  size_t bheads_size;
+} ReconstructStructsData;
+
+static void read_file_reconstruct_structs_cb(void *__restrict userdata,
+                                             const int index,
+                                             const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  ReconstructStructsData *data = userdata;
+  FileData *fd = data->fd;
+  BHead *bh = data->bheads[index];
+
+  if (bh->SDNAnr && (fd->flags & FD_FLAGS_SWITCH_ENDIAN)) {
+    switch_endian_structs(fd->filesdna, bh);
+  }
+  data->bheads_dst[index]->data_reconstructed = DNA_struct_reconstruct(
+      fd->reconstruct_info, bh->SDNAnr, bh->nr, (bh + 1));
+}
+
+static void read_file_reconstruct_structs_batch(ReconstructStructsData *data)
+{
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (data->bheads_size >= RECONSTRUCT_THREADING_MIN_SIZE);
+  BLI_task_parallel_range(0, data->bheads_len, data, read_file_reconstruct_structs_cb, &settings);
+
+  for (int i = 0; i < data->bheads_len; i++) {
+    if (data->bheads[i] != &data->bheads_dst[i]->bhead) {
+      MEM_freeN(BHEADN_FROM_BHEAD(data->bheads[i]));
+    }
+  }
+  data->bheads_len = 0;
+  data->bheads_size = 0;
+}
+
+static bool read_reconstruct_structs_needed(FileData *fd, BHead *bhead)
+{
+  return bhead->len != 0 && fd->compflags[bhead->SDNAnr] == SDNA_CMP_NOT_EQUAL;
+}
+
+/** Queue a block for conversion, converting the queued blocks when there are enough. */
+static void read_file_reconstruct_structs_add(ReconstructStructsData *data, BHead *bhead)
+{
+  BHead *bhead_full = bhead;
+#  ifdef USE_BHEAD_READ_ON_DEMAND
+  if (BHEADN_FROM_BHEAD(bhead)->has_data == false) {
+    /* File access is not thread-safe, read on demand blocks on the main thread. */
+    bhead_full = blo_bhead_read_full(data->fd, bhead);
+    if (UNLIKELY(bhead_full == NULL)) {
+      /* Let #read_struct deal with the error. */
+      return;
+    }
+  }
+#  endif
+
+  if (data->bheads_len == data->bheads_capacity) {
+    data->bheads_capacity = max_ii(1024, data->bheads_capacity * 2);
+    data->bheads = MEM_reallocN_id(
+        data->bheads, sizeof(*data->bheads) * (size_t)data->bheads_capacity, __func__);
+    data->bheads_dst = MEM_reallocN_id(
+        data->bheads_dst, sizeof(*data->bheads_dst) * (size_t)data->bheads_capacity, __func__);
+  }
+  data->bheads[data->bheads_len] = bhead_full;
+  data->bheads_dst[data->bheads_len] = BHEADN_FROM_BHEAD(bhead);
+  data->bheads_len++;
+  data->bheads_size += (size_t)bhead->len;
+
+  if (data->bheads_size >= RECONSTRUCT_BATCH_SIZE) {
+    read_file_reconstruct_structs_batch(data);
+  }
+}
+
+static void read_file_reconstruct_structs_finish(ReconstructStructsData *data)
+{
+  if (data->bheads_len != 0) {
+    read_file_reconstruct_structs_batch(data);
+  }
+  MEM_SAFE_FREE(data->bheads);
+  MEM_SAFE_FREE(data->bheads_dst);
+}
+
+/**
+ * Convert the ID block \a id_bhead and its DATA blocks which DNA differs from the current one,
+ * using multiple threads. The results are picked up by #read_struct right after.
+ *
+ * This is the most expensive part of reading files written by other Blender versions
+ * which doesn't depend on any other block, unlike `direct_link` and `lib_link` code.
+ * Only the blocks of an ID that is actually read are converted, one ID at a time,
+ * so converted data doesn't stay in memory longer than the data it replaces.
+ */
+static void read_libblock_reconstruct_structs(FileData *fd, BHead *id_bhead)
+{
+  /* Only when the DNA is actually different, undo always uses the current DNA. */
+  if (fd->flags & FD_FLAGS_IS_MEMFILE) {
+    return;
+  }
+  /* Allows to compare against the single threaded code path, see #Global.debug_value. */
+  if (G.debug_value == 3200) {
+    return;
+  }
+
+  /* Small data-blocks are converted by #read_struct directly, threading isn't worth it. */
+  size_t size = 0;
+  for (BHead *bhead = id_bhead; bhead && (bhead == id_bhead || bhead->code == DATA);
+       bhead = blo_bhead_next(fd, bhead)) {
+    if (read_reconstruct_structs_needed(fd, bhead)) {
+      size += (size_t)bhead->len;
+    }
+  }
+  if (size < RECONSTRUCT_THREADING_MIN_SIZE) {
+    return;
+  }
+
+  ReconstructStructsData data = {fd};
+
+  for (BHead *bhead = id_bhead; bhead && (bhead == id_bhead || bhead->code == DATA);
+       bhead = blo_bhead_next(fd, bhead)) {
+    if (!read_reconstruct_structs_needed(fd, bhead)) {
+      continue;
+    }
+
+    read_file_reconstruct_structs_add(&data, bhead);
+  }
+  read_file_reconstruct_structs_finish(&data);
+}
+
+int BLO_read_file_reconstruct_structs_compare(const char *filepath,
+                                              BlendFileReadReport *reports)
+{
+  FileData *fd_serial = blo_filedata_from_file(filepath, reports);
+  FileData *fd_parallel = blo_filedata_from_file(filepath, reports);
+  int blocks_num = -1;
+
+  if (fd_serial != NULL && fd_parallel != NULL) {
+    /* Convert all blocks at once, unlike #read_libblock_reconstruct_structs. */
+    ReconstructStructsData data = {fd_parallel};
+    for (BHead *bhead = blo_bhead_first(fd_parallel); bhead && bhead->code != ENDB;
+         bhead = blo_bhead_next(fd_parallel, bhead)) {
+      if ((bhead->code == DATA || blo_bhead_is_id(bhead)) &&
+          read_reconstruct_structs_needed(fd_parallel, bhead)) {
+        read_file_reconstruct_structs_add(&data, bhead);
+      }
+    }
+    read_file_reconstruct_structs_finish(&data);
+
+    /* Both files have the same blocks, the serial one converts them in #read_struct. */
+    blocks_num = 0;
+    BHead *bhead_serial = blo_bhead_first(fd_serial);
+    for (BHead *bhead = blo_bhead_first(fd_parallel); bhead && bhead->code != ENDB;
+         bhead = blo_bhead_next(fd_parallel, bhead),
+               bhead_serial = blo_bhead_next(fd_serial, bhead_serial)) {
+      BHeadN *new_bhead = BHEADN_FROM_BHEAD(bhead);
+      if (new_bhead->data_reconstructed == NULL) {
+        continue;
+      }
+      void *data_serial = read_struct(fd_serial, bhead_serial, __func__);
+      void *data_parallel = read_struct(fd_parallel, bhead, __func__);
+      const size_t len = MEM_allocN_len(data_parallel);
+      if (data_serial == NULL || MEM_allocN_len(data_serial) != len ||
+          memcmp(data_serial, data_parallel, len) != 0) {
+        blocks_num = -1;
+      }
+      MEM_SAFE_FREE(data_serial);
+      MEM_freeN(data_parallel);
+      if (blocks_num == -1) {
+        break;
+      }
+      blocks_num++;
+    }
+  }
+
+  if (fd_serial != NULL) {
+    blo_filedata_free(fd_serial);
+  }
+  if (fd_parallel != NULL) {
+    blo_filedata_free(fd_parallel);
+  }
+  return blocks_num;
+}
+
+#  undef RECONSTRUCT_BATCH_SIZE
+#  undef RECONSTRUCT_THREADING_MIN_SIZE
+
+#else
+
+int BLO_read_file_reconstruct_structs_compare(const char *UNUSED(filepath),
+                                              BlendFileReadReport *UNUSED(reports))
+{
+  return -1;
+}
+
+#endif /* USE_PARALLEL_STRUCT_RECONSTRUCT */
+
 /* Like read_struct, but gets a pointer without allocating. Only works for
  * undo since DNA must match. */
 static const void *peek_struct_undo(FileData *fd, BHead *bhead)
@@ -3101,12 +3923,63 @@ static bool direct_link_id(FileData *fd, Main *main, const int tag, ID *id, ID *
   return success;
 }
 
+#ifdef USE_BHEAD_READ_ON_DEMAND
+/**
+ * Whether reading the contents of this block can be deferred until they are accessed,
+ * see #BLO_read_data_file_location.
+ *
+ * \param packed_data_old: #PackedFile.data of the block before \a bhead, if that was a
+ * #PackedFile. Only the contents of packed files are deferred, they are written right after it.
+ */
+static bool read_data_can_defer(FileData *fd, BHead *bhead, const void *packed_data_old)
+{
+  /* Only raw data (as written by #BLO_write_raw) of uncompressed files. */
+  return packed_data_old != NULL && bhead->old == packed_data_old && bhead->code == DATA &&
+         (fd->flags & FD_FLAGS_IS_UNCOMPRESSED) && fd->relabase[0] != '\0' &&
+         BHEADN_FROM_BHEAD(bhead)->has_data == false && bhead->SDNAnr == 0 &&
+         fd->compflags[0] == SDNA_CMP_EQUAL && bhead->len >= DEFERRED_DATA_MIN_SIZE;
+}
+#endif
+
 /* Read all data associated with a datablock into datamap. */
 static BHead *read_data_into_datamap(FileData *fd, BHead *bhead, const char *allocname)
 {
   bhead = blo_bhead_next(fd, bhead);
 
-  while (bhead && bhead->code == DATA) {
+  if (fd->deferredmap) {
+    /* Deferred data of the previous data-block which was not accessed. */
+    oldnewmap_clear(fd->deferredmap);
+  }
+
+  /* Size the map for all data at once, data-blocks with millions of data blocks
+   * would rebuild it many times otherwise. */
+  int data_len = 0;
+  for (BHead *bhead_iter = bhead; bhead_iter && ELEM(bhead_iter->code, DATA, DDUP);
+       bhead_iter = blo_bhead_next(fd, bhead_iter)) {
+    data_len++;
+  }
+  oldnewmap_reserve(fd->datamap, data_len);
+
+#ifdef USE_BHEAD_READ_ON_DEMAND
+  const int packedfile_sdna_nr = (G.fileflags & G_FILE_LAZY_PACKED_READ) ?
+                                     DNA_struct_find_nr(fd->filesdna, "PackedFile") :
+                                     -1;
+  const void *packed_data_old = NULL;
+#endif
+
+  while (bhead && ELEM(bhead->code, DATA, DDUP)) {
+#ifdef USE_BHEAD_READ_ON_DEMAND
+    if (read_data_can_defer(fd, bhead, packed_data_old)) {
+      if (fd->deferredmap == NULL) {
+        fd->deferredmap = oldnewmap_new();
+      }
+      /* Non-zero user count, the map does not own the BHead. */
+      oldnewmap_insert(fd->deferredmap, bhead->old, bhead, 1);
+      bhead = blo_bhead_next(fd, bhead);
+      continue;
+    }
+#endif
+
     /* The code below is useful for debugging leaks in data read from the blend file.
      * Without this the messages only tell us what ID-type the memory came from,
      * eg: `Data from OB len 64`, see #dataname.
@@ -3128,6 +4001,13 @@ static BHead *read_data_into_datamap(FileData *fd, BHead *bhead, const char *all
       oldnewmap_insert(fd->datamap, bhead->old, data, 0);
     }
 
+#ifdef USE_BHEAD_READ_ON_DEMAND
+    packed_data_old = (data && bhead->code == DATA && packedfile_sdna_nr != -1 &&
+                       bhead->SDNAnr == packedfile_sdna_nr) ?
+                          ((const PackedFile *)data)->data :
+                          NULL;
+#endif
+
     bhead = blo_bhead_next(fd, bhead);
   }
 
@@ -3145,7 +4025,7 @@ static bool read_libblock_is_identical(FileData *fd, BHead *bhead)
   /* Test any other data that is part of ID (logic must match read_data_into_datamap). */
   bhead = blo_bhead_next(fd, bhead);
 
-  while (bhead && bhead->code == DATA) {
+  while (bhead && ELEM(bhead->code, DATA, DDUP)) {
     if (bhead->len && !BHEADN_FROM_BHEAD(bhead)->is_memchunk_identical) {
       return false;
     }
@@ -3394,12 +4274,12 @@ static bool read_libblock_undo_restore(
  * When reading for undo, libraries, linked datablocks and unchanged datablocks
  * will be restored from the old database. Only new or changed datablocks will
  * actually be read. */
-static BHead *read_libblock(FileData *fd,
-                            Main *main,
-                            BHead *bhead,
-                            const int tag,
-                            const bool placeholder_set_indirect_extern,
-                            ID **r_id)
+static BHead *read_libblock_impl(FileData *fd,
+                                 Main *main,
+                                 BHead *bhead,
+                                 const int tag,
+                                 const bool placeholder_set_indirect_extern,
+                                 ID **r_id)
 {
   /* First attempt to restore existing datablocks for undo.
    * When datablocks are changed but still exist, we restore them at the old
@@ -3418,6 +4298,15 @@ static BHead *read_libblock(FileData *fd,
     }
   }
 
+#ifdef USE_PARALLEL_STRUCT_RECONSTRUCT
+  {
+    BlendReadProfileSpan profile_span = {0};
+    read_profile_span_begin(fd, &profile_span);
+    read_libblock_reconstruct_structs(fd, bhead);
+    read_profile_span_end(fd, &profile_span, READ_PROFILE_RECONSTRUCT);
+  }
+#endif
+
   /* Read libblock struct. */
   ID *id = read_struct(fd, bhead, "lib block");
   if (id == NULL) {
@@ -3512,6 +4401,35 @@ static BHead *read_libblock(FileData *fd,
   return bhead;
 }
 
+static BHead *read_libblock(FileData *fd,
+                            Main *main,
+                            BHead *bhead,
+                            const int tag,
+                            const bool placeholder_set_indirect_extern,
+                            ID **r_id)
+{
+  if (fd->profile == NULL) {
+    return read_libblock_impl(fd, main, bhead, tag, placeholder_set_indirect_extern, r_id);
+  }
+
+  const short idcode = (bhead->code == ID_LINK_PLACEHOLDER) ? GS(blo_bhead_id_name(fd, bhead)) :
+                                                              (short)bhead->code;
+  const double time_start = PIL_check_seconds_timer();
+  BHead *bhead_start = bhead;
+  BHead *bhead_next = read_libblock_impl(
+      fd, main, bhead, tag, placeholder_set_indirect_extern, r_id);
+
+  const int index = read_profile_id_type_index(idcode);
+  if (index != -1) {
+    fd->profile->id_types[index].count++;
+    fd->profile->id_types[index].time_read += PIL_check_seconds_timer() - time_start;
+    for (BHead *bh = bhead_start; bh && bh != bhead_next; bh = blo_bhead_next(fd, bh)) {
+      fd->profile->id_types[index].bytes += (size_t)bh->len;
+    }
+  }
+  return bhead_next;
+}
+
 /** \} */
 
 /* -------------------------------------------------------------------- */
@@ -3618,6 +4536,20 @@ static void do_versions_userdef(FileData *UNUSED(fd), BlendFileData *bfd)
   blo_do_versions_userdef(user);
 }
 
+/**
+ * Whether \a main was saved by the current version, in which case all versioning code but the
+ * code added since the last subversion bump can be skipped.
+ */
+static bool do_versions_is_current(const Main *main)
+{
+  /* Allows to compare against full versioning, see #Global.debug_value. */
+  if (G.debug_value == 3201) {
+    return false;
+  }
+  return main->versionfile == BLENDER_FILE_VERSION &&
+         main->subversionfile == BLENDER_FILE_SUBVERSION;
+}
+
 static void do_versions(FileData *fd, Library *lib, Main *main)
 {
   /* WATCH IT!!!: pointers from libdata have not been converted */
@@ -3646,14 +4578,27 @@ static void do_versions(FileData *fd, Library *lib, Main *main)
               main->build_hash);
   }
 
-  blo_do_versions_pre250(fd, lib, main);
-  blo_do_versions_250(fd, lib, main);
-  blo_do_versions_260(fd, lib, main);
-  blo_do_versions_270(fd, lib, main);
-  blo_do_versions_280(fd, lib, main);
-  blo_do_versions_290(fd, lib, main);
-  blo_do_versions_300(fd, lib, main);
-  blo_do_versions_cycles(fd, lib, main);
+  BlendReadProfileSpan profile_span = {0};
+  read_profile_span_begin(fd, &profile_span);
+
+  if (do_versions_is_current(main)) {
+    /* Every other version check fails for the current version, only the code that runs
+     * regardless of the version is left. */
+    blo_do_versions_280_unversioned(main);
+    blo_do_versions_300_pending(fd, lib, main);
+  }
+  else {
+    blo_do_versions_pre250(fd, lib, main);
+    blo_do_versions_250(fd, lib, main);
+    blo_do_versions_260(fd, lib, main);
+    blo_do_versions_270(fd, lib, main);
+    blo_do_versions_280(fd, lib, main);
+    blo_do_versions_290(fd, lib, main);
+    blo_do_versions_300(fd, lib, main);
+    blo_do_versions_cycles(fd, lib, main);
+  }
+
+  read_profile_span_end(fd, &profile_span, READ_PROFILE_VERSIONING);
 
   /* WATCH IT!!!: pointers from libdata have not been converted yet here! */
   /* WATCH IT 2!: Userdef struct init see do_versions_userdef() above! */
@@ -3676,13 +4621,19 @@ static void do_versions_after_linking(Main *main, ReportList *reports)
   /* Don't allow versioning to create new data-blocks. */
   main->is_locked_for_linking = true;
 
-  do_versions_after_linking_250(main);
-  do_versions_after_linking_260(main);
-  do_versions_after_linking_270(main);
-  do_versions_after_linking_280(main, reports);
-  do_versions_after_linking_290(main, reports);
-  do_versions_after_linking_300(main, reports);
-  do_versions_after_linking_cycles(main);
+  if (do_versions_is_current(main)) {
+    do_versions_after_linking_280_unversioned(main);
+    do_versions_after_linking_300_pending(main, reports);
+  }
+  else {
+    do_versions_after_linking_250(main);
+    do_versions_after_linking_260(main);
+    do_versions_after_linking_270(main);
+    do_versions_after_linking_280(main, reports);
+    do_versions_after_linking_290(main, reports);
+    do_versions_after_linking_300(main, reports);
+    do_versions_after_linking_cycles(main);
+  }
 
   main->is_locked_for_linking = false;
 }
@@ -3699,6 +4650,9 @@ static void lib_link_all(FileData *fd, Main *bmain)
 
   BlendLibReader reader = {fd, bmain};
 
+  BlendReadProfileSpan profile_span = {0};
+  read_profile_span_begin(fd, &profile_span);
+
   ID *id;
   FOREACH_MAIN_ID_BEGIN (bmain, id) {
     if ((id->tag & LIB_TAG_NEED_LINK) == 0) {
@@ -3720,6 +4674,8 @@ static void lib_link_all(FileData *fd, Main *bmain)
       continue;
     }
 
+    const double time_id_start = fd->profile ? PIL_check_seconds_timer() : 0.0;
+
     lib_link_id(&reader, id);
 
     const IDTypeInfo *id_type = BKE_idtype_get_info_from_id(id);
@@ -3738,9 +4694,18 @@ static void lib_link_all(FileData *fd, Main *bmain)
     if (id_type->blend_read_undo_preserve != NULL && id->orig_id != NULL) {
       id_type->blend_read_undo_preserve(&reader, id, id->orig_id);
     }
+
+    if (fd->profile) {
+      const int index = read_profile_id_type_index(GS(id->name));
+      if (index != -1) {
+        fd->profile->id_types[index].time_lib_link += PIL_check_seconds_timer() - time_id_start;
+      }
+    }
   }
   FOREACH_MAIN_ID_END;
 
+  read_profile_span_end(fd, &profile_span, READ_PROFILE_LIB_LINK);
+
   /* Cleanup `ID.orig_id`, this is now reserved for depsgraph/COW usage only. */
   FOREACH_MAIN_ID_BEGIN (bmain, id) {
     id->orig_id = NULL;
@@ -3886,6 +4851,24 @@ static BHead *read_userdef(BlendFileData *bfd, FileData *fd, BHead *bhead)
 /** \name Read File (Internal)
  * \{ */
 
+/** Restore the sorting of the ID lists, see #id_sort_by_name. */
+static void main_id_lists_sort(Main *bmain)
+{
+  ListBase *lbarray[INDEX_ID_MAX];
+  int a = set_listbasepointers(bmain, lbarray);
+  while (a--) {
+    ListBase *lb = lbarray[a];
+    ListBase ids = *lb;
+    BLI_listbase_clear(lb);
+    /* Most IDs are still in order, using the last one as hint makes inserting them cheap. */
+    LISTBASE_FOREACH_MUTABLE (ID *, id, &ids) {
+      ID *id_last = lb->last;
+      BLI_addtail(lb, id);
+      id_sort_by_name(lb, id, id_last);
+    }
+  }
+}
+
 BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
 {
   BHead *bhead = blo_bhead_first(fd);
@@ -3931,9 +4914,25 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
     }
   }
 
+  BlendReadProfileSpan profile_span = {0};
+
+  {
+    /* Every ID gets an entry in the lib-map, size it once from the number of ID blocks. */
+    int id_len = 0;
+    for (BHead *bhead_iter = bhead; bhead_iter; bhead_iter = blo_bhead_next(fd, bhead_iter)) {
+      if (blo_bhead_is_id(bhead_iter)) {
+        id_len++;
+      }
+    }
+    oldnewmap_reserve(fd->libmap, id_len);
+  }
+
+  read_profile_span_begin(fd, &profile_span);
+
   while (bhead) {
     switch (bhead->code) {
       case DATA:
+      case DDUP:
       case DNA1:
       case TEST: /* used as preview since 2.5x */
       case REND:
@@ -3953,6 +4952,11 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
       case ENDB:
         bhead = NULL;
         break;
+      case SKIP:
+        /* Replaced by a later block, its #DATA is skipped along with other unused data. */
+        fd->flags |= FD_FLAGS_IS_INCREMENTAL;
+        bhead = blo_bhead_next(fd, bhead);
+        break;
 
       case ID_LINK_PLACEHOLDER:
         if (fd->skip_flags & BLO_READ_SKIP_DATA) {
@@ -3982,6 +4986,13 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
     }
   }
 
+  read_profile_span_end(fd, &profile_span, READ_PROFILE_READ_IDS);
+
+  if ((fd->flags & FD_FLAGS_IS_INCREMENTAL) && (fd->skip_flags & BLO_READ_SKIP_DATA) == 0) {
+    /* Appended IDs are not in the order of the ID lists. */
+    main_id_lists_sort(bfd->main);
+  }
+
   /* do before read_libraries, but skip undo case */
   if ((fd->flags & FD_FLAGS_IS_MEMFILE) == 0) {
     if ((fd->skip_flags & BLO_READ_SKIP_DATA) == 0) {
@@ -3995,7 +5006,9 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
 
   if ((fd->skip_flags & BLO_READ_SKIP_DATA) == 0) {
     fd->reports->duration.libraries = PIL_check_seconds_timer();
+    read_profile_span_begin(fd, &profile_span);
     read_libraries(fd, &mainlist);
+    read_profile_span_end(fd, &profile_span, READ_PROFILE_LIBRARIES);
 
     blo_join_main(&mainlist);
 
@@ -4013,20 +5026,26 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
        * from groups to collections... We could optimize out that first call when we are reading a
        * current version file, but again this is really not a bottle neck currently.
        * So not worth it. */
+      read_profile_span_begin(fd, &profile_span);
       BKE_main_id_refcount_recompute(bfd->main, false);
+      read_profile_span_end(fd, &profile_span, READ_PROFILE_REFCOUNT);
 
       /* Yep, second splitting... but this is a very cheap operation, so no big deal. */
+      read_profile_span_begin(fd, &profile_span);
       blo_split_main(&mainlist, bfd->main);
       LISTBASE_FOREACH (Main *, mainvar, &mainlist) {
         BLI_assert(mainvar->versionfile != 0);
         do_versions_after_linking(mainvar, fd->reports->reports);
       }
       blo_join_main(&mainlist);
+      read_profile_span_end(fd, &profile_span, READ_PROFILE_VERSIONING);
 
       /* And we have to compute those user-reference-counts again, as `do_versions_after_linking()`
        * does not always properly handle user counts, and/or that function does not take into
        * account old, deprecated data. */
+      read_profile_span_begin(fd, &profile_span);
       BKE_main_id_refcount_recompute(bfd->main, false);
+      read_profile_span_end(fd, &profile_span, READ_PROFILE_REFCOUNT);
 
       /* After all data has been read and versioned, uses LIB_TAG_NEW. */
       ntreeUpdateAllNew(bfd->main);
@@ -4041,10 +5060,13 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
     if ((fd->flags & FD_FLAGS_IS_MEMFILE) == 0) {
       /* Do not apply in undo case! */
       fd->reports->duration.lib_overrides = PIL_check_seconds_timer();
+      read_profile_span_begin(fd, &profile_span);
 
       BKE_lib_override_library_main_validate(bfd->main, fd->reports->reports);
       BKE_lib_override_library_main_update(bfd->main);
 
+      read_profile_span_end(fd, &profile_span, READ_PROFILE_LIB_OVERRIDES);
+
       fd->reports->duration.lib_overrides = PIL_check_seconds_timer() -
                                             fd->reports->duration.lib_overrides;
     }
@@ -4107,10 +5129,24 @@ static void sort_bhead_old_map(FileData *fd)
 
   bhs = fd->bheadmap = MEM_malloc_arrayN(tot, sizeof(struct BHeadSort), "BHeadSort");
 
-  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead), bhs++) {
+  bool is_skip = false;
+  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
+    /* Blocks replaced by incremental saving may have the same old address as the new ones. */
+    if (bhead->code == SKIP) {
+      is_skip = true;
+      continue;
+    }
+    if (!ELEM(bhead->code, DATA, DDUP)) {
+      is_skip = false;
+    }
+    else if (is_skip) {
+      continue;
+    }
     bhs->bhead = bhead;
     bhs->old = bhead->old;
+    bhs++;
   }
+  tot = fd->tot_bheadmap = (int)(bhs - fd->bheadmap);
 
   qsort(fd->bheadmap, tot, sizeof(struct BHeadSort), verg_bheadsort);
 }
@@ -5266,10 +6302,21 @@ static FileData *read_library_file_data(FileData *basefd,
                      TIP_("Read packed library:  '%s', parent '%s'"),
                      mainptr->curlib->filepath,
                      library_parent_filepath(mainptr->curlib));
-    fd = blo_filedata_from_memory(pf->data, pf->size, basefd->reports);
+    if (BKE_packedfile_data_ensure(pf)) {
+      fd = blo_filedata_from_memory(pf->data, pf->size, basefd->reports);
+    }
+    else {
+      BLO_reportf_wrap(basefd->reports,
+                       RPT_ERROR,
+                       TIP_("Cannot read packed library:  '%s', parent '%s'"),
+                       mainptr->curlib->filepath,
+                       library_parent_filepath(mainptr->curlib));
+    }
 
-    /* Needed for library_append and read_libraries. */
-    BLI_strncpy(fd->relabase, mainptr->curlib->filepath_abs, sizeof(fd->relabase));
+    if (fd) {
+      /* Needed for library_append and read_libraries. */
+      BLI_strncpy(fd->relabase, mainptr->curlib->filepath_abs, sizeof(fd->relabase));
+    }
   }
   else {
     /* Read file on disk. */
@@ -5291,6 +6338,10 @@ static FileData *read_library_file_data(FileData *basefd,
 
     fd->reports = basefd->reports;
 
+    /* Library reading is accounted for in the profile of the file linking it. */
+    fd->profile = basefd->profile;
+    read_profile_bytes_add(fd, (size_t)fd->file->offset);
+
     if (fd->libmap) {
       oldnewmap_free(fd->libmap);
     }
@@ -5607,6 +6658,38 @@ BlendFileReadReport *BLO_read_data_reports(BlendDataReader *reader)
   return reader->fd->reports;
 }
 
+/**
+ * Get where data that was not read yet is stored in the blend-file, instead of reading it.
+ * This is only the case for the contents of large packed files when #G_FILE_LAZY_PACKED_READ is
+ * set.
+ *
+ * \return false when the data was already read, use #BLO_read_data_address then.
+ */
+bool BLO_read_data_file_location(BlendDataReader *reader,
+                                 const void *old_address,
+                                 const char **r_filepath,
+                                 int64_t *r_file_offset)
+{
+#ifdef USE_BHEAD_READ_ON_DEMAND
+  FileData *fd = reader->fd;
+  if (fd->deferredmap == NULL || old_address == NULL) {
+    return false;
+  }
+  OldNew *entry = oldnewmap_lookup_entry(fd->deferredmap, old_address);
+  if (entry == NULL || entry->newp == NULL) {
+    return false;
+  }
+  BHead *bhead = entry->newp;
+
+  *r_filepath = fd->relabase;
+  *r_file_offset = (int64_t)BHEADN_FROM_BHEAD(bhead)->file_offset;
+  return true;
+#else
+  UNUSED_VARS(reader, old_address, r_filepath, r_file_offset);
+  return false;
+#endif
+}
+
 bool BLO_read_lib_is_undo(BlendLibReader *reader)
 {
   return (reader->fd->flags & FD_FLAGS_IS_MEMFILE);
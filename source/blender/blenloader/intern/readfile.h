@@ -35,6 +35,7 @@
 
 struct BLI_mmap_file;
 struct BLOCacheStorage;
+struct BlendReadProfile;
 struct IDNameLib_Map;
 struct Key;
 struct MemFile;
@@ -53,6 +54,12 @@ enum eFileDataFlag {
   FD_FLAGS_IS_MEMFILE = 1 << 4,
   /* XXX Unused in practice (checked once but never set). */
   FD_FLAGS_NOT_MY_LIBMAP = 1 << 5,
+  /** #FileData.filesdna, compflags & reconstruct_info are owned by the SDNA cache. */
+  FD_FLAGS_SDNA_IS_SHARED = 1 << 6,
+  /** Offsets in the #FileReader stream are offsets in the file on disk. */
+  FD_FLAGS_IS_UNCOMPRESSED = 1 << 7,
+  /** The file contains #SKIP blocks, written by incremental saving. */
+  FD_FLAGS_IS_INCREMENTAL = 1 << 8,
 };
 
 /* Disallow since it's 32bit on ms-windows. */
@@ -103,6 +110,8 @@ typedef struct FileData {
   int id_tag_extra;
 
   struct OldNewMap *datamap;
+  /** Data which reading is deferred until it's accessed, maps old addresses to #BHead. */
+  struct OldNewMap *deferredmap;
   struct OldNewMap *globmap;
   struct OldNewMap *libmap;
   struct OldNewMap *packedmap;
@@ -111,6 +120,11 @@ typedef struct FileData {
   struct BHeadSort *bheadmap;
   int tot_bheadmap;
 
+  /** #DATA blocks sorted by file offset, to find the blocks #DDUP blocks refer to. */
+  struct BHeadN **bhead_data_index;
+  int bhead_data_index_len;
+  int bhead_data_index_alloc;
+
   /** See: #USE_GHASH_BHEAD. */
   struct GHash *bhead_idname_hash;
 
@@ -120,6 +134,10 @@ typedef struct FileData {
   struct IDNameLib_Map *old_idmap;
 
   struct BlendFileReadReport *reports;
+
+  /** Load profiling, NULL unless enabled, see #BLO_read_profile_set.
+   * Shared with the file-data of libraries, owned by the file-data of the main file. */
+  struct BlendReadProfile *profile;
 } FileData;
 
 #define SIZEOFBLENDERHEADER 12
@@ -152,6 +170,8 @@ void blo_cache_storage_old_bmain_clear(FileData *fd, struct Main *bmain_old);
 void blo_cache_storage_end(FileData *fd);
 
 void blo_filedata_free(FileData *fd);
+void blo_read_profile_begin(FileData *fd, const double time_start);
+void blo_read_profile_end(FileData *fd, const char *filepath);
 
 BHead *blo_bhead_first(FileData *fd);
 BHead *blo_bhead_next(FileData *fd, BHead *thisblock);
@@ -181,16 +201,20 @@ void blo_do_versions_250(struct FileData *fd, struct Library *lib, struct Main *
 void blo_do_versions_260(struct FileData *fd, struct Library *lib, struct Main *bmain);
 void blo_do_versions_270(struct FileData *fd, struct Library *lib, struct Main *bmain);
 void blo_do_versions_280(struct FileData *fd, struct Library *lib, struct Main *bmain);
+void blo_do_versions_280_unversioned(struct Main *bmain);
 void blo_do_versions_290(struct FileData *fd, struct Library *lib, struct Main *bmain);
 void blo_do_versions_300(struct FileData *fd, struct Library *lib, struct Main *bmain);
+void blo_do_versions_300_pending(struct FileData *fd, struct Library *lib, struct Main *bmain);
 void blo_do_versions_cycles(struct FileData *fd, struct Library *lib, struct Main *bmain);
 
 void do_versions_after_linking_250(struct Main *bmain);
 void do_versions_after_linking_260(struct Main *bmain);
 void do_versions_after_linking_270(struct Main *bmain);
 void do_versions_after_linking_280(struct Main *bmain, struct ReportList *reports);
+void do_versions_after_linking_280_unversioned(struct Main *bmain);
 void do_versions_after_linking_290(struct Main *bmain, struct ReportList *reports);
 void do_versions_after_linking_300(struct Main *bmain, struct ReportList *reports);
+void do_versions_after_linking_300_pending(struct Main *bmain, struct ReportList *reports);
 void do_versions_after_linking_cycles(struct Main *bmain);
 
 /* This is rather unfortunate to have to expose this here, but better use that nasty hack in
@@ -36,12 +36,17 @@
 #  include <io.h>
 #endif
 
+#include <zstd.h>
+
 #include "MEM_guardedalloc.h"
 
 #include "DNA_listBase.h"
 
 #include "BLI_blenlib.h"
 #include "BLI_ghash.h"
+#include "BLI_hash_mm2a.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
 
 #include "BLO_readfile.h"
 #include "BLO_undofile.h"
@@ -53,6 +58,332 @@
 /* keep last */
 #include "BLI_strict_flags.h"
 
+/* -------------------------------------------------------------------- */
+/** \name Chunk Storage
+ *
+ * The memory of chunks is shared between all chunks with the same content, not only with the
+ * chunk at the same position in the previous step. Buffers that are not used by the most recent
+ * steps are compressed on a background thread, results are only applied on the main thread when
+ * the next step is written, so reading from a buffer never races with its compression.
+ * \{ */
+
+/** Steps that keep their buffers uncompressed, the current step compares with the previous. */
+#define MEMFILE_HOT_STEPS 2
+/** Smaller buffers are not worth compressing. */
+#define MEMFILE_COMPRESS_MIN_SIZE 4096
+#define MEMFILE_COMPRESS_LEVEL 1
+
+typedef struct MemFileBuffer {
+  /** Uncompressed or compressed data. */
+  char *data;
+  /** Size of the uncompressed data. */
+  size_t size;
+  /** Size of the compressed data, zero when uncompressed. */
+  size_t compressed_size;
+  uint hash;
+  /** Number of chunks using the buffer (and compression jobs). */
+  int users;
+  /** Serial number of the last step that uses this buffer, see #MemFileStorage.step. */
+  uint step;
+  bool is_compressing;
+  /** False when an identical buffer was already in #MemFileStorage.buffers. */
+  bool is_in_set;
+  /** The memfile whose #MemFile.size includes this buffer, NULL once it's freed. */
+  MemFile *owner;
+  /** Unique for every buffer created in this session, see #BLO_memfile_chunk_content_key. */
+  uint64_t serial;
+} MemFileBuffer;
+
+typedef struct MemFileCompressJob {
+  struct MemFileCompressJob *next, *prev;
+  MemFileBuffer *buffer;
+  char *compressed_data;
+  size_t compressed_size;
+  /** Protected by #MemFileStorage.mutex. */
+  bool is_done;
+} MemFileCompressJob;
+
+typedef struct MemFileStorage {
+  /** Uncompressed buffers, for finding buffers with the same content. */
+  GSet *buffers;
+  /** All memfiles that use buffers of the storage, to find a new owner for a buffer. */
+  GSet *memfiles;
+  /** Serial number of the step being written. */
+  uint step;
+
+  TaskPool *pool;
+  ListBase jobs;
+  ThreadMutex mutex;
+} MemFileStorage;
+
+static MemFileStorage *g_memfile_storage = NULL;
+/** Kept when the storage is freed, so keys of buffers are never reused. */
+static uint64_t g_memfile_buffer_serial = 0;
+
+static uint memfile_buffer_hash(const void *key)
+{
+  return ((const MemFileBuffer *)key)->hash;
+}
+
+static bool memfile_buffer_cmp(const void *a, const void *b)
+{
+  const MemFileBuffer *buffer_a = a;
+  const MemFileBuffer *buffer_b = b;
+  return (buffer_a->hash != buffer_b->hash) || (buffer_a->size != buffer_b->size) ||
+         (memcmp(buffer_a->data, buffer_b->data, buffer_a->size) != 0);
+}
+
+static MemFileStorage *memfile_storage_ensure(void)
+{
+  if (g_memfile_storage == NULL) {
+    g_memfile_storage = MEM_callocN(sizeof(*g_memfile_storage), __func__);
+    g_memfile_storage->buffers = BLI_gset_new(
+        memfile_buffer_hash, memfile_buffer_cmp, "MemFileStorage.buffers");
+    g_memfile_storage->memfiles = BLI_gset_ptr_new("MemFileStorage.memfiles");
+    g_memfile_storage->pool = BLI_task_pool_create_background(NULL, TASK_PRIORITY_LOW);
+    BLI_mutex_init(&g_memfile_storage->mutex);
+  }
+  return g_memfile_storage;
+}
+
+static void memfile_buffer_release(MemFileBuffer *buffer)
+{
+  BLI_assert(buffer->users > 0);
+  if (--buffer->users != 0) {
+    return;
+  }
+  if (buffer->is_in_set && g_memfile_storage != NULL) {
+    BLI_gset_remove(g_memfile_storage->buffers, buffer, NULL);
+  }
+  MEM_freeN(buffer->data);
+  MEM_freeN(buffer);
+}
+
+/** Decompress \a buffer into \a r_data, which must have room for #MemFileBuffer.size bytes. */
+static bool memfile_buffer_decompress(const MemFileBuffer *buffer, char *r_data)
+{
+  const size_t res = ZSTD_decompress(r_data, buffer->size, buffer->data, buffer->compressed_size);
+  return !ZSTD_isError(res) && (res == buffer->size);
+}
+
+/** Make the buffer uncompressed again, because a new step uses it. */
+static void memfile_buffer_ensure_uncompressed(MemFileStorage *storage, MemFileBuffer *buffer)
+{
+  buffer->step = storage->step;
+  if (buffer->compressed_size == 0) {
+    return;
+  }
+
+  char *data = MEM_mallocN(buffer->size, "MemFileBuffer.data");
+  const bool ok = memfile_buffer_decompress(buffer, data);
+  BLI_assert(ok);
+  UNUSED_VARS_NDEBUG(ok);
+  if (buffer->owner) {
+    buffer->owner->size += buffer->size - buffer->compressed_size;
+  }
+  MEM_freeN(buffer->data);
+  buffer->data = data;
+  buffer->compressed_size = 0;
+
+  /* An identical buffer may have been added in the meantime. */
+  buffer->is_in_set = BLI_gset_add(storage->buffers, buffer);
+}
+
+static void memfile_compress_job_run(TaskPool *__restrict UNUSED(pool), void *taskdata)
+{
+  MemFileCompressJob *job = taskdata;
+  const MemFileBuffer *buffer = job->buffer;
+
+  const size_t bound = ZSTD_compressBound(buffer->size);
+  char *compressed_data = MEM_mallocN(bound, __func__);
+  const size_t compressed_size = ZSTD_compress(
+      compressed_data, bound, buffer->data, buffer->size, MEMFILE_COMPRESS_LEVEL);
+  if (ZSTD_isError(compressed_size) || compressed_size >= buffer->size) {
+    MEM_freeN(compressed_data);
+    compressed_data = NULL;
+  }
+  else {
+    compressed_data = MEM_reallocN(compressed_data, compressed_size);
+  }
+
+  BLI_mutex_lock(&g_memfile_storage->mutex);
+  job->compressed_data = compressed_data;
+  job->compressed_size = compressed_size;
+  job->is_done = true;
+  BLI_mutex_unlock(&g_memfile_storage->mutex);
+}
+
+/**
+ * Apply the results of finished compression jobs, waiting for all jobs when \a do_wait is set.
+ */
+static void memfile_storage_jobs_finish(MemFileStorage *storage, const bool do_wait)
+{
+  if (do_wait) {
+    BLI_task_pool_work_and_wait(storage->pool);
+  }
+
+  LISTBASE_FOREACH_MUTABLE (MemFileCompressJob *, job, &storage->jobs) {
+    BLI_mutex_lock(&storage->mutex);
+    const bool is_done = job->is_done;
+    BLI_mutex_unlock(&storage->mutex);
+    if (!is_done) {
+      continue;
+    }
+
+    MemFileBuffer *buffer = job->buffer;
+    buffer->is_compressing = false;
+    /* Skip buffers that a new step started to use while compressing. */
+    if (job->compressed_data && (buffer->users > 1) &&
+        (buffer->step + MEMFILE_HOT_STEPS <= storage->step)) {
+      if (buffer->is_in_set) {
+        BLI_gset_remove(storage->buffers, buffer, NULL);
+        buffer->is_in_set = false;
+      }
+      if (buffer->owner) {
+        buffer->owner->size -= buffer->size - job->compressed_size;
+      }
+      MEM_freeN(buffer->data);
+      buffer->data = job->compressed_data;
+      buffer->compressed_size = job->compressed_size;
+    }
+    else {
+      MEM_SAFE_FREE(job->compressed_data);
+    }
+    memfile_buffer_release(buffer);
+
+    BLI_remlink(&storage->jobs, job);
+    MEM_freeN(job);
+  }
+}
+
+/** Compress the buffers that are not used by recent steps in the background. */
+static void memfile_storage_compress_cold(MemFileStorage *storage)
+{
+  if (storage->step < MEMFILE_HOT_STEPS) {
+    return;
+  }
+  GSET_FOREACH_BEGIN (MemFileBuffer *, buffer, storage->buffers) {
+    if (buffer->is_compressing || (buffer->size < MEMFILE_COMPRESS_MIN_SIZE) ||
+        (buffer->step + MEMFILE_HOT_STEPS > storage->step)) {
+      continue;
+    }
+    /* The job keeps the buffer alive, it may be used from the main thread in the meantime,
+     * but its data is not changed until the job is finished. */
+    buffer->users++;
+    buffer->is_compressing = true;
+    MemFileCompressJob *job = MEM_callocN(sizeof(*job), __func__);
+    job->buffer = buffer;
+    BLI_addtail(&storage->jobs, job);
+    BLI_task_pool_push(storage->pool, memfile_compress_job_run, job, false, NULL);
+  }
+  GSET_FOREACH_END();
+}
+
+/**
+ * Free the chunk storage, call on exit after all undo steps are freed.
+ */
+void BLO_memfile_storage_exit(void)
+{
+  MemFileStorage *storage = g_memfile_storage;
+  if (storage == NULL) {
+    return;
+  }
+  memfile_storage_jobs_finish(storage, true);
+  BLI_assert(BLI_listbase_is_empty(&storage->jobs));
+  BLI_task_pool_free(storage->pool);
+  BLI_mutex_end(&storage->mutex);
+
+  g_memfile_storage = NULL;
+  /* Buffers still used by memfiles that are not freed yet are freed with them. */
+  GSET_FOREACH_BEGIN (MemFileBuffer *, buffer, storage->buffers) {
+    buffer->is_in_set = false;
+  }
+  GSET_FOREACH_END();
+  BLI_gset_free(storage->buffers, NULL);
+  BLI_gset_free(storage->memfiles, NULL);
+  MEM_freeN(storage);
+}
+
+static size_t memfile_buffer_memory(const MemFileBuffer *buffer)
+{
+  return buffer->compressed_size ? buffer->compressed_size : buffer->size;
+}
+
+/**
+ * Make another memfile the owner of the buffers owned by \a memfile, when they are still used
+ * by it. Buffers not used by other memfiles are left without owner.
+ */
+static void memfile_buffers_transfer_ownership(MemFileStorage *storage, MemFile *memfile)
+{
+  GSet *orphans = NULL;
+  LISTBASE_FOREACH (MemFileChunk *, chunk, &memfile->chunks) {
+    MemFileBuffer *buffer = chunk->buffer;
+    if (buffer->owner != memfile) {
+      continue;
+    }
+    buffer->owner = NULL;
+    if (buffer->users > 1) {
+      if (orphans == NULL) {
+        orphans = BLI_gset_ptr_new(__func__);
+      }
+      BLI_gset_add(orphans, buffer);
+    }
+  }
+  if (orphans == NULL) {
+    return;
+  }
+
+  GSET_FOREACH_BEGIN (MemFile *, memfile_other, storage->memfiles) {
+    if (memfile_other == memfile) {
+      continue;
+    }
+    LISTBASE_FOREACH (MemFileChunk *, chunk, &memfile_other->chunks) {
+      MemFileBuffer *buffer = chunk->buffer;
+      if (BLI_gset_remove(orphans, buffer, NULL)) {
+        buffer->owner = memfile_other;
+        memfile_other->size += memfile_buffer_memory(buffer);
+      }
+    }
+    if (BLI_gset_len(orphans) == 0) {
+      break;
+    }
+  }
+  GSET_FOREACH_END();
+
+  BLI_gset_free(orphans, NULL);
+}
+
+/**
+ * Get the uncompressed data of a chunk, when the buffer is compressed it's decompressed into
+ * \a r_data_temp, which the caller has to free.
+ */
+const char *BLO_memfile_chunk_data_get(const MemFileChunk *chunk, char **r_data_temp)
+{
+  const MemFileBuffer *buffer = chunk->buffer;
+  *r_data_temp = NULL;
+  if (buffer->compressed_size == 0) {
+    return buffer->data;
+  }
+  char *data = MEM_mallocN(buffer->size, __func__);
+  if (!memfile_buffer_decompress(buffer, data)) {
+    MEM_freeN(data);
+    return NULL;
+  }
+  *r_data_temp = data;
+  return data;
+}
+
+/**
+ * Chunks of any step with the same key have the same content, because they share a buffer.
+ * Keys are never reused in a session.
+ */
+uint64_t BLO_memfile_chunk_content_key(const MemFileChunk *chunk)
+{
+  return chunk->buffer->serial;
+}
+
+/** \} */
+
 /* **************** support for memory-write, for undo buffers *************** */
 
 /* not memfile itself */
@@ -60,10 +391,20 @@ void BLO_memfile_free(MemFile *memfile)
 {
   MemFileChunk *chunk;
 
-  while ((chunk = BLI_pophead(&memfile->chunks))) {
-    if (chunk->is_identical == false) {
-      MEM_freeN((void *)chunk->buf);
+  if (g_memfile_storage != NULL) {
+    BLI_gset_remove(g_memfile_storage->memfiles, memfile, NULL);
+    memfile_buffers_transfer_ownership(g_memfile_storage, memfile);
+  }
+  else {
+    LISTBASE_FOREACH (MemFileChunk *, chunk_iter, &memfile->chunks) {
+      if (chunk_iter->buffer->owner == memfile) {
+        chunk_iter->buffer->owner = NULL;
+      }
     }
+  }
+
+  while ((chunk = BLI_pophead(&memfile->chunks))) {
+    memfile_buffer_release(chunk->buffer);
     MEM_freeN(chunk);
   }
   memfile->size = 0;
@@ -80,20 +421,22 @@ void BLO_memfile_merge(MemFile *first, MemFile *second)
 
   /* First, detect all memchunks in second memfile that are not owned by it. */
   for (MemFileChunk *sc = second->chunks.first; sc != NULL; sc = sc->next) {
-    if (sc->is_identical) {
-      BLI_ghash_insert(buffer_to_second_memchunk, (void *)sc->buf, sc);
+    if (sc->buffer->owner != second) {
+      BLI_ghash_insert(buffer_to_second_memchunk, sc->buffer, sc);
     }
   }
 
   /* Now, check all chunks from first memfile (the one we are removing), and if a memchunk owned by
    * it is also used by the second memfile, transfer the ownership. */
   for (MemFileChunk *fc = first->chunks.first; fc != NULL; fc = fc->next) {
-    if (!fc->is_identical) {
-      MemFileChunk *sc = BLI_ghash_lookup(buffer_to_second_memchunk, fc->buf);
+    MemFileBuffer *buffer = fc->buffer;
+    if (buffer->owner == first) {
+      MemFileChunk *sc = BLI_ghash_lookup(buffer_to_second_memchunk, buffer);
       if (sc != NULL) {
-        BLI_assert(sc->is_identical);
+        /* The step this chunk is identical to doesn't exist anymore. */
         sc->is_identical = false;
-        fc->is_identical = true;
+        buffer->owner = second;
+        second->size += memfile_buffer_memory(buffer);
       }
       /* Note that if the second memfile does not use that chunk, we assume that the first one
        * fully owns it without sharing it with any other memfile, and hence it should be freed with
@@ -118,6 +461,11 @@ void BLO_memfile_write_init(MemFileWriteData *mem_data,
                             MemFile *written_memfile,
                             MemFile *reference_memfile)
 {
+  MemFileStorage *storage = memfile_storage_ensure();
+  memfile_storage_jobs_finish(storage, false);
+  storage->step++;
+  BLI_gset_add(storage->memfiles, written_memfile);
+
   mem_data->written_memfile = written_memfile;
   mem_data->reference_memfile = reference_memfile;
   mem_data->reference_current_chunk = reference_memfile ? reference_memfile->chunks.first : NULL;
@@ -153,16 +501,19 @@ void BLO_memfile_write_finalize(MemFileWriteData *mem_data)
   if (mem_data->id_session_uuid_mapping != NULL) {
     BLI_ghash_free(mem_data->id_session_uuid_mapping, NULL, NULL);
   }
+
+  memfile_storage_compress_cold(g_memfile_storage);
 }
 
 void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, size_t size)
 {
   MemFile *memfile = mem_data->written_memfile;
   MemFileChunk **compchunk_step = &mem_data->reference_current_chunk;
+  MemFileStorage *storage = g_memfile_storage;
 
   MemFileChunk *curchunk = MEM_mallocN(sizeof(MemFileChunk), "MemFileChunk");
   curchunk->size = size;
-  curchunk->buf = NULL;
+  curchunk->buffer = NULL;
   curchunk->is_identical = false;
   /* This is unsafe in the sense that an app handler or other code that does not
    * perform an undo push may make changes after the last undo push that
@@ -175,8 +526,11 @@ void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, size_t s
   if (*compchunk_step != NULL) {
     MemFileChunk *compchunk = *compchunk_step;
     if (compchunk->size == curchunk->size) {
-      if (memcmp(compchunk->buf, buf, size) == 0) {
-        curchunk->buf = compchunk->buf;
+      MemFileBuffer *buffer = compchunk->buffer;
+      /* The reference step may be an old one after undoing. */
+      memfile_buffer_ensure_uncompressed(storage, buffer);
+      if (memcmp(buffer->data, buf, size) == 0) {
+        curchunk->buffer = buffer;
         curchunk->is_identical = true;
         compchunk->is_identical_future = true;
       }
@@ -184,13 +538,33 @@ void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, size_t s
     *compchunk_step = compchunk->next;
   }
 
-  /* not equal... */
-  if (curchunk->buf == NULL) {
-    char *buf_new = MEM_mallocN(size, "Chunk buffer");
-    memcpy(buf_new, buf, size);
-    curchunk->buf = buf_new;
-    memfile->size += size;
+  /* not equal, look for the same content in any other step... */
+  if (curchunk->buffer == NULL) {
+    MemFileBuffer buffer_key = {
+        .data = (char *)buf,
+        .size = size,
+        .hash = BLI_hash_mm2((const uchar *)buf, size, 0),
+    };
+    MemFileBuffer *buffer = BLI_gset_lookup(storage->buffers, &buffer_key);
+    if (buffer != NULL) {
+      buffer->step = storage->step;
+      curchunk->buffer = buffer;
+    }
+    else {
+      buffer = MEM_mallocN(sizeof(*buffer), "MemFileBuffer");
+      *buffer = buffer_key;
+      buffer->data = MEM_mallocN(size, "Chunk buffer");
+      memcpy(buffer->data, buf, size);
+      buffer->step = storage->step;
+      buffer->owner = memfile;
+      buffer->is_in_set = true;
+      buffer->serial = ++g_memfile_buffer_serial;
+      BLI_gset_insert(storage->buffers, buffer);
+      curchunk->buffer = buffer;
+      memfile->size += size;
+    }
   }
+  curchunk->buffer->users++;
 }
 
 struct Main *BLO_memfile_main_get(struct MemFile *memfile,
@@ -253,12 +627,15 @@ bool BLO_memfile_write_file(struct MemFile *memfile, const char *filename)
   }
 
   for (chunk = memfile->chunks.first; chunk; chunk = chunk->next) {
+    char *data_temp;
+    const char *data = BLO_memfile_chunk_data_get(chunk, &data_temp);
 #ifdef _WIN32
-    if ((size_t)write(file, chunk->buf, (uint)chunk->size) != chunk->size)
+    const bool ok = data && ((size_t)write(file, data, (uint)chunk->size) == chunk->size);
 #else
-    if ((size_t)write(file, chunk->buf, chunk->size) != chunk->size)
+    const bool ok = data && ((size_t)write(file, data, chunk->size) == chunk->size);
 #endif
-    {
+    MEM_SAFE_FREE(data_temp);
+    if (!ok) {
       break;
     }
   }
@@ -275,6 +652,26 @@ bool BLO_memfile_write_file(struct MemFile *memfile, const char *filename)
   return true;
 }
 
+/** Data of the chunk, decompressing compressed buffers into a cache of the reader. */
+static const char *undo_chunk_data_get(UndoReader *undo, const MemFileChunk *chunk)
+{
+  MemFileBuffer *buffer = chunk->buffer;
+  if (buffer->compressed_size == 0) {
+    return buffer->data;
+  }
+  if (undo->cache_buffer != buffer) {
+    MEM_SAFE_FREE(undo->cache_data);
+    undo->cache_buffer = NULL;
+    char *data_temp;
+    if (BLO_memfile_chunk_data_get(chunk, &data_temp) == NULL) {
+      return NULL;
+    }
+    undo->cache_buffer = buffer;
+    undo->cache_data = data_temp;
+  }
+  return undo->cache_data;
+}
+
 static ssize_t undo_read(FileReader *reader, void *buffer, size_t size)
 {
   UndoReader *undo = (UndoReader *)reader;
@@ -331,7 +728,13 @@ static ssize_t undo_read(FileReader *reader, void *buffer, size_t size)
         readsize = chunk->size - chunkoffset;
       }
 
-      memcpy(POINTER_OFFSET(buffer, totread), chunk->buf + chunkoffset, readsize);
+      const char *chunk_data = undo_chunk_data_get(undo, chunk);
+      if (chunk_data == NULL) {
+        printf("illegal read, chunk data can't be decompressed\n");
+        return 0;
+      }
+
+      memcpy(POINTER_OFFSET(buffer, totread), chunk_data + chunkoffset, readsize);
       totread += readsize;
       undo->reader.offset += (off64_t)readsize;
       seek += readsize;
@@ -352,6 +755,8 @@ static ssize_t undo_read(FileReader *reader, void *buffer, size_t size)
 
 static void undo_close(FileReader *reader)
 {
+  UndoReader *undo = (UndoReader *)reader;
+  MEM_SAFE_FREE(undo->cache_data);
   MEM_freeN(reader);
 }
 
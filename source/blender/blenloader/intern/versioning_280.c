@@ -1185,6 +1185,32 @@ static void do_version_fcurve_hide_viewport_fix(struct ID *UNUSED(id),
   fcu->rna_path = BLI_strdupn("hide_viewport", 13);
 }
 
+/**
+ * Versioning that runs for every file, including files saved by the current version which skip
+ * #do_versions_after_linking_280 (see #do_versions_after_linking in `readfile.c`).
+ */
+void do_versions_after_linking_280_unversioned(Main *bmain)
+{
+  /* Paint Brush. This ensure that the brush paints by default. Used during the development and
+   * patch review of the initial Sculpt Vertex Colors implementation (D5975) */
+  LISTBASE_FOREACH (Brush *, brush, &bmain->brushes) {
+    if (brush->ob_mode & OB_MODE_SCULPT && brush->sculpt_tool == SCULPT_TOOL_PAINT) {
+      brush->tip_roundness = 1.0f;
+      brush->flow = 1.0f;
+      brush->density = 1.0f;
+      brush->tip_scale_x = 1.0f;
+    }
+  }
+
+  /* Pose Brush with support for loose parts. */
+  LISTBASE_FOREACH (Brush *, brush, &bmain->brushes) {
+    if (brush->sculpt_tool == SCULPT_TOOL_POSE && brush->disconnected_distance_max == 0.0f) {
+      brush->flag2 |= BRUSH_USE_CONNECTED_ONLY;
+      brush->disconnected_distance_max = 0.1f;
+    }
+  }
+}
+
 void do_versions_after_linking_280(Main *bmain, ReportList *UNUSED(reports))
 {
   bool use_collection_compat_28 = true;
@@ -1729,24 +1755,7 @@ void do_versions_after_linking_280(Main *bmain, ReportList *UNUSED(reports))
    */
   {
     /* Keep this block, even when empty. */
-    /* Paint Brush. This ensure that the brush paints by default. Used during the development and
-     * patch review of the initial Sculpt Vertex Colors implementation (D5975) */
-    LISTBASE_FOREACH (Brush *, brush, &bmain->brushes) {
-      if (brush->ob_mode & OB_MODE_SCULPT && brush->sculpt_tool == SCULPT_TOOL_PAINT) {
-        brush->tip_roundness = 1.0f;
-        brush->flow = 1.0f;
-        brush->density = 1.0f;
-        brush->tip_scale_x = 1.0f;
-      }
-    }
-
-    /* Pose Brush with support for loose parts. */
-    LISTBASE_FOREACH (Brush *, brush, &bmain->brushes) {
-      if (brush->sculpt_tool == SCULPT_TOOL_POSE && brush->disconnected_distance_max == 0.0f) {
-        brush->flag2 |= BRUSH_USE_CONNECTED_ONLY;
-        brush->disconnected_distance_max = 0.1f;
-      }
-    }
+    do_versions_after_linking_280_unversioned(bmain);
   }
 }
 
@@ -1782,6 +1791,47 @@ static bool seq_update_flags_cb(Sequence *seq, void *UNUSED(user_data))
   return true;
 }
 
+/**
+ * Versioning that runs for every file, including files saved by the current version which skip
+ * #blo_do_versions_280 (see #do_versions in `readfile.c`).
+ */
+void blo_do_versions_280_unversioned(Main *bmain)
+{
+  /* Keep un-versioned until we're finished adding space types. */
+  for (bScreen *screen = bmain->screens.first; screen; screen = screen->id.next) {
+    LISTBASE_FOREACH (ScrArea *, area, &screen->areabase) {
+      LISTBASE_FOREACH (SpaceLink *, sl, &area->spacedata) {
+        ListBase *regionbase = (sl == area->spacedata.first) ? &area->regionbase :
+                                                               &sl->regionbase;
+        /* All spaces that use tools must be eventually added. */
+        ARegion *region = NULL;
+        if (ELEM(sl->spacetype, SPACE_VIEW3D, SPACE_IMAGE, SPACE_SEQ) &&
+            ((region = do_versions_find_region_or_null(regionbase, RGN_TYPE_TOOL_HEADER)) ==
+             NULL)) {
+          /* Add tool header. */
+          region = do_versions_add_region(RGN_TYPE_TOOL_HEADER, "tool header");
+          region->alignment = (U.uiflag & USER_HEADER_BOTTOM) ? RGN_ALIGN_BOTTOM : RGN_ALIGN_TOP;
+
+          ARegion *region_header = do_versions_find_region(regionbase, RGN_TYPE_HEADER);
+          BLI_insertlinkbefore(regionbase, region_header, region);
+          /* Hide by default, enable for painting workspaces (startup only). */
+          region->flag |= RGN_FLAG_HIDDEN | RGN_FLAG_HIDDEN_BY_USER;
+        }
+        if (region != NULL) {
+          SET_FLAG_FROM_TEST(
+              region->flag, region->flag & RGN_FLAG_HIDDEN_BY_USER, RGN_FLAG_HIDDEN);
+        }
+      }
+    }
+  }
+
+  for (wmWindowManager *wm = bmain->wm.first; wm; wm = wm->id.next) {
+    /* Don't rotate light with the viewer by default, make it fixed. Shading settings can't be
+     * edited and this flag should always be set. So we can always execute this. */
+    wm->xr.session_settings.shading.flag |= V3D_SHADING_WORLD_ORIENTATION;
+  }
+}
+
 /* NOLINTNEXTLINE: readability-function-size */
 void blo_do_versions_280(FileData *fd, Library *UNUSED(lib), Main *bmain)
 {
@@ -3870,34 +3920,7 @@ void blo_do_versions_280(FileData *fd, Library *UNUSED(lib), Main *bmain)
   }
 
   /* Keep un-versioned until we're finished adding space types. */
-  {
-    for (bScreen *screen = bmain->screens.first; screen; screen = screen->id.next) {
-      LISTBASE_FOREACH (ScrArea *, area, &screen->areabase) {
-        LISTBASE_FOREACH (SpaceLink *, sl, &area->spacedata) {
-          ListBase *regionbase = (sl == area->spacedata.first) ? &area->regionbase :
-                                                                 &sl->regionbase;
-          /* All spaces that use tools must be eventually added. */
-          ARegion *region = NULL;
-          if (ELEM(sl->spacetype, SPACE_VIEW3D, SPACE_IMAGE, SPACE_SEQ) &&
-              ((region = do_versions_find_region_or_null(regionbase, RGN_TYPE_TOOL_HEADER)) ==
-               NULL)) {
-            /* Add tool header. */
-            region = do_versions_add_region(RGN_TYPE_TOOL_HEADER, "tool header");
-            region->alignment = (U.uiflag & USER_HEADER_BOTTOM) ? RGN_ALIGN_BOTTOM : RGN_ALIGN_TOP;
-
-            ARegion *region_header = do_versions_find_region(regionbase, RGN_TYPE_HEADER);
-            BLI_insertlinkbefore(regionbase, region_header, region);
-            /* Hide by default, enable for painting workspaces (startup only). */
-            region->flag |= RGN_FLAG_HIDDEN | RGN_FLAG_HIDDEN_BY_USER;
-          }
-          if (region != NULL) {
-            SET_FLAG_FROM_TEST(
-                region->flag, region->flag & RGN_FLAG_HIDDEN_BY_USER, RGN_FLAG_HIDDEN);
-          }
-        }
-      }
-    }
-  }
+  blo_do_versions_280_unversioned(bmain);
 
   if (!MAIN_VERSION_ATLEAST(bmain, 280, 60)) {
     if (!DNA_struct_elem_find(fd->filesdna, "bSplineIKConstraint", "short", "yScaleMode")) {
@@ -5094,12 +5117,6 @@ void blo_do_versions_280(FileData *fd, Library *UNUSED(lib), Main *bmain)
       }
     }
 
-    for (wmWindowManager *wm = bmain->wm.first; wm; wm = wm->id.next) {
-      /* Don't rotate light with the viewer by default, make it fixed. Shading settings can't be
-       * edited and this flag should always be set. So we can always execute this. */
-      wm->xr.session_settings.shading.flag |= V3D_SHADING_WORLD_ORIENTATION;
-    }
-
     /* Keep this block, even when empty. */
   }
 }
@@ -449,7 +449,7 @@ static void do_versions_sequencer_speed_effect_recursive(Scene *scene, const Lis
 #undef SEQ_SPEED_COMPRESS_IPO_Y
 }
 
-void do_versions_after_linking_300(Main *bmain, ReportList *UNUSED(reports))
+void do_versions_after_linking_300(Main *bmain, ReportList *reports)
 {
   if (MAIN_VERSION_ATLEAST(bmain, 300, 0) && !MAIN_VERSION_ATLEAST(bmain, 300, 1)) {
     /* Set zero user text objects to have a fake user. */
@@ -489,10 +489,6 @@ void do_versions_after_linking_300(Main *bmain, ReportList *UNUSED(reports))
     assert_sorted_ids(bmain);
   }
 
-  if (MAIN_VERSION_ATLEAST(bmain, 300, 3)) {
-    assert_sorted_ids(bmain);
-  }
-
   if (!MAIN_VERSION_ATLEAST(bmain, 300, 11)) {
     move_vertex_group_names_to_object_data(bmain);
   }
@@ -505,20 +501,34 @@ void do_versions_after_linking_300(Main *bmain, ReportList *UNUSED(reports))
     }
   }
 
-  /**
-   * Versioning code until next subversion bump goes here.
-   *
-   * \note Be sure to check when bumping the version:
-   * - #blo_do_versions_300 in this file.
-   * - "versioning_userdef.c", #blo_do_versions_userdef
-   * - "versioning_userdef.c", #do_versions_theme
-   *
-   * \note Keep this message at the bottom of the function.
-   */
-  {
-    /* Keep this block, even when empty. */
+  if (!MAIN_VERSION_ATLEAST(bmain, 300, 26)) {
     do_versions_idproperty_ui_data(bmain);
   }
+
+  /* Versioning code until next subversion bump goes in #do_versions_after_linking_300_pending.
+   * Keep this call at the bottom of the function. */
+  do_versions_after_linking_300_pending(bmain, reports);
+}
+
+/**
+ * Versioning code until next subversion bump goes here.
+ *
+ * Unlike the rest of versioning this also runs for files saved by the current version,
+ * which skip everything else (see #do_versions_after_linking in `readfile.c`).
+ *
+ * \note Be sure to check when bumping the version:
+ * - #blo_do_versions_300_pending in this file.
+ * - "versioning_userdef.c", #blo_do_versions_userdef
+ * - "versioning_userdef.c", #do_versions_theme
+ *
+ * \note When bumping the version, move the code into #do_versions_after_linking_300 behind a
+ * version check, keep this function, even when empty.
+ */
+void do_versions_after_linking_300_pending(Main *bmain, ReportList *UNUSED(reports))
+{
+  if (MAIN_VERSION_ATLEAST(bmain, 300, 3)) {
+    assert_sorted_ids(bmain);
+  }
 }
 
 static void version_switch_node_input_prefix(Main *bmain)
@@ -850,7 +860,7 @@ static void version_geometry_nodes_add_attribute_input_settings(NodesModifierDat
 }
 
 /* NOLINTNEXTLINE: readability-function-size */
-void blo_do_versions_300(FileData *fd, Library *UNUSED(lib), Main *bmain)
+void blo_do_versions_300(FileData *fd, Library *lib, Main *bmain)
 {
   if (!MAIN_VERSION_ATLEAST(bmain, 300, 1)) {
     /* Set default value for the new bisect_threshold parameter in the mirror modifier. */
@@ -1420,23 +1430,42 @@ void blo_do_versions_300(FileData *fd, Library *UNUSED(lib), Main *bmain)
     }
   }
 
-  /**
-   * Versioning code until next subversion bump goes here.
-   *
-   * \note Be sure to check when bumping the version:
-   * - "versioning_userdef.c", #blo_do_versions_userdef
-   * - "versioning_userdef.c", #do_versions_theme
-   *
-   * \note Keep this message at the bottom of the function.
-   */
-  {
-    /* Keep this block, even when empty. */
+  if (!MAIN_VERSION_ATLEAST(bmain, 300, 26)) {
+    const bool has_cache_memory_limit = DNA_struct_elem_find(
+        fd->filesdna, "NodesModifierData", "int", "cache_memory_limit");
     LISTBASE_FOREACH (Object *, ob, &bmain->objects) {
       LISTBASE_FOREACH (ModifierData *, md, &ob->modifiers) {
         if (md->type == eModifierType_Nodes) {
-          version_geometry_nodes_add_attribute_input_settings((NodesModifierData *)md);
+          NodesModifierData *nmd = (NodesModifierData *)md;
+          version_geometry_nodes_add_attribute_input_settings(nmd);
+          if (!has_cache_memory_limit) {
+            nmd->cache_memory_limit = 256;
+          }
         }
       }
     }
   }
+
+  /* Versioning code until next subversion bump goes in #blo_do_versions_300_pending.
+   * Keep this call at the bottom of the function. */
+  blo_do_versions_300_pending(fd, lib, bmain);
+}
+
+/**
+ * Versioning code until next subversion bump goes here.
+ *
+ * Unlike the rest of versioning this also runs for files saved by the current version,
+ * which skip everything else (see #do_versions in `readfile.c`).
+ *
+ * \note Be sure to check when bumping the version:
+ * - "versioning_userdef.c", #blo_do_versions_userdef
+ * - "versioning_userdef.c", #do_versions_theme
+ *
+ * \note When bumping the version, move the code into #blo_do_versions_300 behind a
+ * version check, keep this function, even when empty.
+ */
+void blo_do_versions_300_pending(FileData *UNUSED(fd),
+                                 Library *UNUSED(lib),
+                                 Main *UNUSED(bmain))
+{
 }
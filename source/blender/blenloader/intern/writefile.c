@@ -50,6 +50,9 @@
  * Almost all data in Blender are structures. Each struct saved
  * gets a BHead header.  With BHead the struct can be linked again
  * and compared with #StructDNA.
+ *
+ * When de-duplicating (see #G_FILE_DEDUPLICATE), a #DATA block identical to one written before
+ * is replaced by a #DDUP block, its data is the offset of the original data in the file.
 
  * WRITE
  * =====
@@ -101,6 +104,9 @@
 #include "BLI_blenlib.h"
 #include "BLI_endian_defines.h"
 #include "BLI_endian_switch.h"
+#include "BLI_ghash.h"
+#include "BLI_hash_md5.h"
+#include "BLI_hash_mm2a.h"
 #include "BLI_link_utils.h"
 #include "BLI_linklist.h"
 #include "BLI_math_base.h"
@@ -152,6 +158,14 @@
 /** Use if we want to store how many bytes have been written to the file. */
 // #define USE_WRITE_DATA_LEN
 
+/** Smaller #DATA blocks are not worth hashing for de-duplication. */
+#define DEDUP_BLOCK_MIN_SIZE 1024
+
+/** Do a full save again after this many incremental saves to the same file. */
+#define INCREMENTAL_SAVE_MAX 32
+/** File offset that has not been set yet. */
+#define WRITE_OFFSET_UNSET UINT64_MAX
+
 /* -------------------------------------------------------------------- */
 /** \name Internal Write Wrapper's (Abstracts Compression)
  * \{ */
@@ -440,6 +454,47 @@ typedef struct {
    * Will be NULL for UNDO.
    */
   WriteWrap *ww;
+
+  /** Offset of the next write in the (uncompressed) file. */
+  uint64_t file_offset;
+
+  /** De-duplication of identical #DATA blocks, see #G_FILE_DEDUPLICATE. */
+  struct {
+    /** Set of #WriteDedupBlock, NULL when not de-duplicating. */
+    GSet *blocks;
+
+    int skipped_len;
+    size_t skipped_size;
+  } dedup;
+
+  /** Incremental saving, see #G_FILE_SAVE_INCREMENTAL. */
+  struct {
+    /** State of the file being written, NULL when not saving incrementally. */
+    struct WriteIncrementalState *state;
+    /** State of the file written before, that is appended to. NULL for full saves. */
+    struct WriteIncrementalState *state_prev;
+
+    /** Hash of the data written for the current ID, two 32 bit hashes with different seeds. */
+    BLI_HashMurmur2A hash[2];
+    bool use_hash;
+    /** Store the offsets of all non #DATA blocks in #WriteIncrementalState.headers. */
+    bool use_record_headers;
+
+    /** Writing an ID, the offset of its #BHead is stored in #id_bhead_offset. */
+    bool is_writing_id;
+    uint64_t id_bhead_offset;
+    /** Offset of the first block of the current ID, to roll back when it is not written. */
+    uint64_t id_file_offset;
+    /**
+     * Data written for the current ID, kept in memory until it is known whether the ID changed.
+     * Only used when the ID was written by the previous save.
+     */
+    bool use_id_data;
+    char *id_data;
+    size_t id_data_len, id_data_alloc;
+    /** #WriteDedupBlock added for the current ID, removed again when it is not written. */
+    LinkNode *id_dedup_blocks;
+  } incremental;
 } WriteData;
 
 typedef struct BlendWriter {
@@ -500,6 +555,17 @@ static void writedata_free(WriteData *wd)
   if (wd->buffer.buf) {
     MEM_freeN(wd->buffer.buf);
   }
+  if (wd->dedup.blocks) {
+    if (G.debug & G_DEBUG) {
+      printf("%s: de-duplicated %d blocks, %zu bytes\n",
+             __func__,
+             wd->dedup.skipped_len,
+             wd->dedup.skipped_size);
+    }
+    BLI_gset_free(wd->dedup.blocks, MEM_freeN);
+  }
+  MEM_SAFE_FREE(wd->incremental.id_data);
+  BLI_linklist_free(wd->incremental.id_dedup_blocks, NULL);
   MEM_freeN(wd);
 }
 
@@ -522,25 +588,10 @@ static void mywrite_flush(WriteData *wd)
 }
 
 /**
- * Low level WRITE(2) wrapper that buffers data
- * \param adr: Pointer to new chunk of data
- * \param len: Length of new chunk of data
+ * Write to the file through the buffer, see #mywrite.
  */
-static void mywrite(WriteData *wd, const void *adr, size_t len)
+static void mywrite_buffered(WriteData *wd, const void *adr, size_t len)
 {
-  if (UNLIKELY(wd->error)) {
-    return;
-  }
-
-  if (UNLIKELY(adr == NULL)) {
-    BLI_assert(0);
-    return;
-  }
-
-#ifdef USE_WRITE_DATA_LEN
-  wd->write_len += len;
-#endif
-
   if (wd->buffer.buf == NULL) {
     writedata_do_write(wd, adr, len);
   }
@@ -575,6 +626,55 @@ static void mywrite(WriteData *wd, const void *adr, size_t len)
   }
 }
 
+/**
+ * Keep data of the current ID in memory, see #WriteData.incremental.use_id_data.
+ */
+static void write_incremental_id_data_append(WriteData *wd, const void *adr, size_t len)
+{
+  if (wd->incremental.id_data_len + len > wd->incremental.id_data_alloc) {
+    wd->incremental.id_data_alloc = max_zz(wd->incremental.id_data_alloc * 2,
+                                           wd->incremental.id_data_len + len);
+    wd->incremental.id_data = MEM_reallocN(wd->incremental.id_data,
+                                           wd->incremental.id_data_alloc);
+  }
+  memcpy(wd->incremental.id_data + wd->incremental.id_data_len, adr, len);
+  wd->incremental.id_data_len += len;
+}
+
+/**
+ * Low level WRITE(2) wrapper that buffers data
+ * \param adr: Pointer to new chunk of data
+ * \param len: Length of new chunk of data
+ */
+static void mywrite(WriteData *wd, const void *adr, size_t len)
+{
+  if (UNLIKELY(wd->error)) {
+    return;
+  }
+
+  if (UNLIKELY(adr == NULL)) {
+    BLI_assert(0);
+    return;
+  }
+
+  if (UNLIKELY(wd->incremental.use_hash)) {
+    BLI_hash_mm2a_add(&wd->incremental.hash[0], adr, len);
+    BLI_hash_mm2a_add(&wd->incremental.hash[1], adr, len);
+  }
+
+#ifdef USE_WRITE_DATA_LEN
+  wd->write_len += len;
+#endif
+  wd->file_offset += len;
+
+  if (UNLIKELY(wd->incremental.use_id_data)) {
+    write_incremental_id_data_append(wd, adr, len);
+    return;
+  }
+
+  mywrite_buffered(wd, adr, len);
+}
+
 /**
  * BeGiN initializer for mywrite
  * \param ww: File write wrapper.
@@ -661,6 +761,347 @@ static void mywrite_id_end(WriteData *wd, ID *UNUSED(id))
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name Data Block De-Duplication
+ * \{ */
+
+typedef struct WriteDedupBlock {
+  /** MD5 of the data. */
+  uchar digest[16];
+  int len;
+  int SDNAnr;
+  int nr;
+  /** Offset of the data (after the #BHead) of the first block with this content. */
+  uint64_t file_offset;
+} WriteDedupBlock;
+
+static uint writedata_dedup_block_hash(const void *key)
+{
+  const WriteDedupBlock *block = key;
+  uint hash;
+  memcpy(&hash, block->digest, sizeof(hash));
+  return hash;
+}
+
+static bool writedata_dedup_block_cmp(const void *a, const void *b)
+{
+  const WriteDedupBlock *block_a = a;
+  const WriteDedupBlock *block_b = b;
+  return !((block_a->len == block_b->len) && (block_a->SDNAnr == block_b->SDNAnr) &&
+           (block_a->nr == block_b->nr) &&
+           (memcmp(block_a->digest, block_b->digest, sizeof(block_a->digest)) == 0));
+}
+
+/**
+ * Write a #DDUP block instead of \a bh when a block with the same data was written before.
+ * Otherwise \a bh is remembered for later blocks, it must be written right after this call.
+ *
+ * \return true when the block was written as a reference, and must not be written.
+ */
+static bool writedata_dedup(WriteData *wd, const BHead *bh, const void *data)
+{
+  WriteDedupBlock *block = MEM_mallocN(sizeof(*block), __func__);
+  BLI_hash_md5_buffer(data, (size_t)bh->len, block->digest);
+  block->len = bh->len;
+  block->SDNAnr = bh->SDNAnr;
+  block->nr = bh->nr;
+  block->file_offset = wd->file_offset + sizeof(BHead);
+
+  void **block_p;
+  if (BLI_gset_ensure_p_ex(wd->dedup.blocks, block, &block_p)) {
+    const WriteDedupBlock *block_orig = *block_p;
+    const uint64_t file_offset = block_orig->file_offset;
+    MEM_freeN(block);
+
+    /* Incremental saving compares with a hash of the data that is not de-duplicated. */
+    const bool use_hash = wd->incremental.use_hash;
+    if (use_hash) {
+      for (int i = 0; i < ARRAY_SIZE(wd->incremental.hash); i++) {
+        BLI_hash_mm2a_add(&wd->incremental.hash[i], (const uchar *)bh, sizeof(BHead));
+        BLI_hash_mm2a_add(&wd->incremental.hash[i], data, (size_t)bh->len);
+      }
+      wd->incremental.use_hash = false;
+    }
+
+    BHead bh_ref = *bh;
+    bh_ref.code = DDUP;
+    bh_ref.len = sizeof(file_offset);
+    mywrite(wd, &bh_ref, sizeof(BHead));
+    mywrite(wd, &file_offset, sizeof(file_offset));
+
+    wd->incremental.use_hash = use_hash;
+
+    wd->dedup.skipped_len++;
+    wd->dedup.skipped_size += (size_t)bh->len;
+    return true;
+  }
+
+  *block_p = block;
+  if (wd->incremental.use_id_data) {
+    BLI_linklist_prepend(&wd->incremental.id_dedup_blocks, block);
+  }
+  return false;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Incremental Saving
+ *
+ * Saving again to a file written before by this session only appends the IDs that changed since,
+ * with #G_FILE_SAVE_INCREMENTAL. The blocks of replaced and removed IDs stay in the file, but
+ * their code is changed to #SKIP so they are ignored when reading. Changes are detected by
+ * hashing all data written for each ID, auto-save uses the chunks of undo steps instead
+ * (see #BLO_write_memfile_incremental).
+ *
+ * The existing file is changed in place, in an order that keeps it readable when interrupted:
+ * - New blocks are appended after the existing #ENDB.
+ * - The old #ENDB is changed to #SKIP, making the new blocks visible.
+ * - Replaced blocks are changed to #SKIP.
+ *
+ * No version backups are made for these saves. After #INCREMENTAL_SAVE_MAX saves, or once the
+ * file doubled in size, a full save is done.
+ *
+ * \note Versions that don't know #SKIP blocks would read the replaced IDs as well, such files
+ * raise their minimum version to 300.26.
+ * \{ */
+
+typedef struct WriteIncrementalID {
+  /** Offset of the #BHead of the ID in the file. */
+  uint64_t file_offset;
+  uint64_t hash;
+} WriteIncrementalID;
+
+typedef struct WriteIncrementalState {
+  struct WriteIncrementalState *next, *prev;
+
+  char filepath[FILE_MAX];
+  /** Used to detect the file was changed by something else. */
+  int64_t file_size;
+  int64_t file_mtime;
+
+  /** Maps #ID.session_uuid to #WriteIncrementalID. */
+  GHash *ids;
+  /** Offsets of the other blocks that are written for every save (#GLOB, libraries). */
+  uint64_t *headers;
+  int headers_len, headers_alloc;
+  /** Offset of the #ENDB block. */
+  uint64_t endb_offset;
+
+  /** Written from an undo step, the hashes of the IDs are not comparable to those of #Main. */
+  bool is_memfile;
+
+  /** Size of the file after the last full save. */
+  int64_t full_size;
+  /** Number of incremental saves since the last full save. */
+  int incremental_len;
+
+  /** Blocks to change to #SKIP after writing, only used while saving. */
+  uint64_t *skip_offsets;
+  int skip_offsets_len, skip_offsets_alloc;
+} WriteIncrementalState;
+
+/** The files written by this session, see #BLO_write_incremental_free. */
+static ListBase g_write_incremental_states = {NULL, NULL};
+
+static void write_offsets_append(uint64_t **offsets, int *len, int *alloc, const uint64_t offset)
+{
+  if (*len == *alloc) {
+    *alloc = max_ii(64, *alloc * 2);
+    *offsets = MEM_reallocN(*offsets, sizeof(**offsets) * (size_t)*alloc);
+  }
+  (*offsets)[(*len)++] = offset;
+}
+
+static WriteIncrementalState *write_incremental_state_new(const char *filepath,
+                                                          const bool is_memfile)
+{
+  WriteIncrementalState *state = MEM_callocN(sizeof(*state), __func__);
+  BLI_strncpy(state->filepath, filepath, sizeof(state->filepath));
+  state->ids = BLI_ghash_int_new(__func__);
+  state->is_memfile = is_memfile;
+  return state;
+}
+
+static void write_incremental_state_free(WriteIncrementalState *state)
+{
+  BLI_ghash_free(state->ids, NULL, MEM_freeN);
+  MEM_SAFE_FREE(state->headers);
+  MEM_SAFE_FREE(state->skip_offsets);
+  MEM_freeN(state);
+}
+
+/**
+ * Take the state of the last save to \a filepath, when that file can still be appended to.
+ */
+static WriteIncrementalState *write_incremental_state_pop(const char *filepath,
+                                                          const bool is_memfile)
+{
+  WriteIncrementalState *state = BLI_findstring(
+      &g_write_incremental_states, filepath, offsetof(WriteIncrementalState, filepath));
+  if (state == NULL) {
+    return NULL;
+  }
+  BLI_remlink(&g_write_incremental_states, state);
+
+  BLI_stat_t st;
+  if ((state->is_memfile != is_memfile) || (BLI_stat(filepath, &st) != 0) ||
+      ((int64_t)st.st_size != state->file_size) ||
+      ((int64_t)st.st_mtime != state->file_mtime) ||
+      (state->incremental_len >= INCREMENTAL_SAVE_MAX) ||
+      (state->file_size > 2 * state->full_size)) {
+    write_incremental_state_free(state);
+    return NULL;
+  }
+  return state;
+}
+
+/** Store the state of a successful save, for the next save to the same file. */
+static void write_incremental_state_store(WriteIncrementalState *state)
+{
+  MEM_SAFE_FREE(state->skip_offsets);
+  state->skip_offsets_len = state->skip_offsets_alloc = 0;
+
+  BLI_stat_t st;
+  if (BLI_stat(state->filepath, &st) != 0) {
+    write_incremental_state_free(state);
+    return;
+  }
+  state->file_size = (int64_t)st.st_size;
+  state->file_mtime = (int64_t)st.st_mtime;
+  if (state->incremental_len == 0) {
+    state->full_size = state->file_size;
+  }
+  BLI_addtail(&g_write_incremental_states, state);
+}
+
+/**
+ * Free the states kept for incremental saving, call on exit.
+ */
+void BLO_write_incremental_free(void)
+{
+  LISTBASE_FOREACH_MUTABLE (WriteIncrementalState *, state, &g_write_incremental_states) {
+    write_incremental_state_free(state);
+  }
+  BLI_listbase_clear(&g_write_incremental_states);
+}
+
+static void write_incremental_state_skip_add(WriteIncrementalState *state, const uint64_t offset)
+{
+  write_offsets_append(
+      &state->skip_offsets, &state->skip_offsets_len, &state->skip_offsets_alloc, offset);
+}
+
+static void write_incremental_skip_add(WriteData *wd, const uint64_t offset)
+{
+  write_incremental_state_skip_add(wd->incremental.state, offset);
+}
+
+/** Mark the #ENDB and the other blocks written for every save as replaced. */
+static void write_incremental_state_skip_headers(WriteIncrementalState *state,
+                                                 const WriteIncrementalState *state_prev)
+{
+  write_incremental_state_skip_add(state, state_prev->endb_offset);
+  for (int i = 0; i < state_prev->headers_len; i++) {
+    write_incremental_state_skip_add(state, state_prev->headers[i]);
+  }
+}
+
+static void write_incremental_hash_begin(WriteData *wd)
+{
+  BLI_hash_mm2a_init(&wd->incremental.hash[0], 0);
+  BLI_hash_mm2a_init(&wd->incremental.hash[1], 1);
+  wd->incremental.use_hash = true;
+}
+
+static uint64_t write_incremental_hash_end(WriteData *wd)
+{
+  wd->incremental.use_hash = false;
+  return ((uint64_t)BLI_hash_mm2a_end(&wd->incremental.hash[0]) << 32) |
+         (uint64_t)BLI_hash_mm2a_end(&wd->incremental.hash[1]);
+}
+
+/**
+ * Start writing an ID, the data is kept in memory when \a use_id_data is set, until
+ * #write_incremental_id_end decides whether it is written to the file.
+ */
+static void write_incremental_id_begin(WriteData *wd, const bool use_id_data)
+{
+  write_incremental_hash_begin(wd);
+  wd->incremental.is_writing_id = true;
+  wd->incremental.id_bhead_offset = WRITE_OFFSET_UNSET;
+  wd->incremental.id_file_offset = wd->file_offset;
+  wd->incremental.use_id_data = use_id_data;
+}
+
+/**
+ * \param do_write: Write the data kept in memory, otherwise it is discarded and the file offset
+ * is rolled back to where the ID started.
+ */
+static void write_incremental_id_end(WriteData *wd, const bool do_write)
+{
+  wd->incremental.is_writing_id = false;
+  if (!wd->incremental.use_id_data) {
+    return;
+  }
+  wd->incremental.use_id_data = false;
+
+  if (do_write) {
+    mywrite_buffered(wd, wd->incremental.id_data, wd->incremental.id_data_len);
+  }
+  else {
+    wd->file_offset = wd->incremental.id_file_offset;
+#ifdef USE_WRITE_DATA_LEN
+    wd->write_len -= wd->incremental.id_data_len;
+#endif
+    /* Later blocks must not refer to the data that is not written. */
+    for (LinkNode *node = wd->incremental.id_dedup_blocks; node; node = node->next) {
+      BLI_gset_remove(wd->dedup.blocks, node->link, MEM_freeN);
+    }
+  }
+  wd->incremental.id_data_len = 0;
+  BLI_linklist_free(wd->incremental.id_dedup_blocks, NULL);
+  wd->incremental.id_dedup_blocks = NULL;
+}
+
+/**
+ * Open the previously saved file for appending after its #ENDB.
+ * \return The file handle, -1 on failure.
+ */
+static int write_incremental_open(const WriteIncrementalState *state_prev)
+{
+  int oflags = O_BINARY | O_WRONLY;
+#ifdef O_NOFOLLOW
+  oflags |= O_NOFOLLOW;
+#endif
+  const int file = BLI_open(state_prev->filepath, oflags, 0);
+  if (file == -1) {
+    return -1;
+  }
+  const int64_t offset = (int64_t)(state_prev->endb_offset + sizeof(BHead));
+  if (BLI_lseek(file, offset, SEEK_SET) != offset) {
+    close(file);
+    return -1;
+  }
+  return file;
+}
+
+/** Change the code of the blocks replaced by the appended ones to #SKIP. */
+static bool write_incremental_skip_blocks(const int file, const WriteIncrementalState *state)
+{
+  const int code = SKIP;
+  for (int i = 0; i < state->skip_offsets_len; i++) {
+    const int64_t offset = (int64_t)state->skip_offsets[i];
+    if ((BLI_lseek(file, offset, SEEK_SET) != offset) ||
+        (write(file, &code, sizeof(code)) != sizeof(code))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name Generic DNA File Writing
  * \{ */
@@ -690,6 +1131,23 @@ static void writestruct_at_address_nr(
     return;
   }
 
+  if (wd->incremental.use_record_headers && filecode != DATA) {
+    WriteIncrementalState *state = wd->incremental.state;
+    write_offsets_append(
+        &state->headers, &state->headers_len, &state->headers_alloc, wd->file_offset);
+  }
+  /* Data of some IDs is written before the ID itself. */
+  if (wd->incremental.is_writing_id && filecode != DATA &&
+      wd->incremental.id_bhead_offset == WRITE_OFFSET_UNSET) {
+    wd->incremental.id_bhead_offset = wd->file_offset;
+  }
+
+  if (wd->dedup.blocks && filecode == DATA && bh.len >= DEDUP_BLOCK_MIN_SIZE) {
+    if (writedata_dedup(wd, &bh, data)) {
+      return;
+    }
+  }
+
   mywrite(wd, &bh, sizeof(BHead));
   mywrite(wd, data, (size_t)bh.len);
 }
@@ -724,6 +1182,12 @@ static void writedata(WriteData *wd, int filecode, size_t len, const void *adr)
   bh.SDNAnr = 0;
   bh.len = (int)len;
 
+  if (wd->dedup.blocks && filecode == DATA && bh.len >= DEDUP_BLOCK_MIN_SIZE) {
+    if (writedata_dedup(wd, &bh, adr)) {
+      return;
+    }
+  }
+
   mywrite(wd, &bh, sizeof(BHead));
   mywrite(wd, adr, len);
 }
@@ -1014,6 +1478,19 @@ static void write_libraries(WriteData *wd, Main *main)
   mywrite_flush(wd);
 }
 
+/**
+ * Raise the oldest version that can read the file, when the file uses block codes that older
+ * versions don't know. These versions skip unknown blocks, so they would load the file with data
+ * missing or replaced data instead of warning about it.
+ */
+static void write_global_min_version_ensure(FileGlobal *fg, short version, short subversion)
+{
+  if (fg->minversion < version || (fg->minversion == version && fg->minsubversion < subversion)) {
+    fg->minversion = version;
+    fg->minsubversion = subversion;
+  }
+}
+
 /* context is usually defined by WM, two cases where no WM is available:
  * - for forward compatibility, curscreen has to be saved
  * - for undofile, curscene needs to be saved */
@@ -1053,6 +1530,10 @@ static void write_global(WriteData *wd, int fileflags, Main *mainvar)
   fg.subversion = BLENDER_FILE_SUBVERSION;
   fg.minversion = BLENDER_FILE_MIN_VERSION;
   fg.minsubversion = BLENDER_FILE_MIN_SUBVERSION;
+  if (wd->dedup.blocks || wd->incremental.state_prev) {
+    /* #DDUP and #SKIP blocks are supported since 300.26. */
+    write_global_min_version_ensure(&fg, 300, 26);
+  }
 #ifdef WITH_BUILDINFO
   {
     extern unsigned long build_commit_timestamp;
@@ -1086,6 +1567,84 @@ static void write_thumb(WriteData *wd, const BlendThumbnail *thumb)
 /** \name File Writing (Private)
  * \{ */
 
+/**
+ * Write \a id and all its data, \a id_buffer is used for the copy of the ID that is written.
+ */
+static void write_id(BlendWriter *writer, ID *id, void *id_buffer, const size_t idtype_struct_size)
+{
+  memcpy(id_buffer, id, idtype_struct_size);
+
+  /* Clear runtime data to reduce false detection of changed data in undo/redo context. */
+  ((ID *)id_buffer)->tag = 0;
+  ((ID *)id_buffer)->us = 0;
+  ((ID *)id_buffer)->icon_id = 0;
+  /* Those listbase data change every time we add/remove an ID, and also often when
+   * renaming one (due to re-sorting). This avoids generating a lot of false 'is changed'
+   * detections between undo steps. */
+  ((ID *)id_buffer)->prev = NULL;
+  ((ID *)id_buffer)->next = NULL;
+  /* Those runtime pointers should never be set during writing stage, but just in case clear
+   * them too. */
+  ((ID *)id_buffer)->orig_id = NULL;
+  ((ID *)id_buffer)->newid = NULL;
+  /* Even though in theory we could be able to preserve this python instance across undo even
+   * when we need to re-read the ID into its original address, this is currently cleared in
+   * #direct_link_id_common in `readfile.c` anyway, */
+  ((ID *)id_buffer)->py_instance = NULL;
+
+  const IDTypeInfo *id_type = BKE_idtype_get_info_from_id(id);
+  if (id_type->blend_write != NULL) {
+    id_type->blend_write(writer, (ID *)id_buffer, id);
+  }
+}
+
+/**
+ * Write \a id when it changed since the previous save, see #G_FILE_SAVE_INCREMENTAL.
+ */
+static void write_id_incremental(BlendWriter *writer,
+                                 ID *id,
+                                 void *id_buffer,
+                                 const size_t idtype_struct_size)
+{
+  WriteData *wd = writer->wd;
+  WriteIncrementalState *state = wd->incremental.state;
+  WriteIncrementalState *state_prev = wd->incremental.state_prev;
+  void *key = POINTER_FROM_UINT(id->session_uuid);
+
+  WriteIncrementalID *id_written = (state_prev != NULL) ?
+                                       BLI_ghash_popkey(state_prev->ids, key, NULL) :
+                                       NULL;
+
+  /* The data of IDs that have been written before is only hashed first, unchanged IDs are kept
+   * in the file as-is. */
+  write_incremental_id_begin(wd, id_written != NULL);
+  write_id(writer, id, id_buffer, idtype_struct_size);
+  const uint64_t hash = write_incremental_hash_end(wd);
+  const uint64_t bhead_offset = wd->incremental.id_bhead_offset;
+
+  if ((id_written != NULL) && (hash == id_written->hash)) {
+    write_incremental_id_end(wd, false);
+    BLI_ghash_insert(state->ids, key, id_written);
+    return;
+  }
+  write_incremental_id_end(wd, true);
+
+  if (id_written != NULL) {
+    write_incremental_skip_add(wd, id_written->file_offset);
+  }
+  if (bhead_offset == WRITE_OFFSET_UNSET) {
+    /* Nothing has been written. */
+    MEM_SAFE_FREE(id_written);
+    return;
+  }
+  if (id_written == NULL) {
+    id_written = MEM_mallocN(sizeof(*id_written), __func__);
+  }
+  id_written->file_offset = bhead_offset;
+  id_written->hash = hash;
+  BLI_ghash_insert(state->ids, key, id_written);
+}
+
 /* if MemFile * there's filesave to memory */
 static bool write_file_handle(Main *mainvar,
                               WriteWrap *ww,
@@ -1093,7 +1652,9 @@ static bool write_file_handle(Main *mainvar,
                               MemFile *current,
                               int write_flags,
                               bool use_userdef,
-                              const BlendThumbnail *thumb)
+                              const BlendThumbnail *thumb,
+                              WriteIncrementalState *incremental_state,
+                              WriteIncrementalState *incremental_state_prev)
 {
   BHead bhead;
   ListBase mainlist;
@@ -1105,17 +1666,35 @@ static bool write_file_handle(Main *mainvar,
   wd = mywrite_begin(ww, compare, current);
   BlendWriter writer = {wd};
 
-  sprintf(buf,
-          "BLENDER%c%c%.3d",
-          (sizeof(void *) == 8) ? '-' : '_',
-          (ENDIAN_ORDER == B_ENDIAN) ? 'V' : 'v',
-          BLENDER_FILE_VERSION);
+  if ((write_flags & G_FILE_DEDUPLICATE) && !wd->use_memfile) {
+    wd->dedup.blocks = BLI_gset_new(
+        writedata_dedup_block_hash, writedata_dedup_block_cmp, "WriteData.dedup.blocks");
+  }
+
+  wd->incremental.state = incremental_state;
+  wd->incremental.state_prev = incremental_state_prev;
+
+  if (incremental_state_prev == NULL) {
+    sprintf(buf,
+            "BLENDER%c%c%.3d",
+            (sizeof(void *) == 8) ? '-' : '_',
+            (ENDIAN_ORDER == B_ENDIAN) ? 'V' : 'v',
+            BLENDER_FILE_VERSION);
+
+    mywrite(wd, buf, 12);
 
-  mywrite(wd, buf, 12);
+    write_renderinfo(wd, mainvar);
+    write_thumb(wd, thumb);
+  }
+  else {
+    /* Appending after the #ENDB block, the blocks that are written again replace the old ones. */
+    wd->file_offset = incremental_state_prev->endb_offset + sizeof(BHead);
+    write_incremental_state_skip_headers(incremental_state, incremental_state_prev);
+  }
 
-  write_renderinfo(wd, mainvar);
-  write_thumb(wd, thumb);
+  wd->incremental.use_record_headers = (incremental_state != NULL);
   write_global(wd, write_flags, mainvar);
+  wd->incremental.use_record_headers = false;
 
   /* The window-manager and screen often change,
    * avoid thumbnail detecting changes because of this. */
@@ -1193,29 +1772,11 @@ static bool write_file_handle(Main *mainvar,
 
         mywrite_id_begin(wd, id);
 
-        memcpy(id_buffer, id, idtype_struct_size);
-
-        /* Clear runtime data to reduce false detection of changed data in undo/redo context. */
-        ((ID *)id_buffer)->tag = 0;
-        ((ID *)id_buffer)->us = 0;
-        ((ID *)id_buffer)->icon_id = 0;
-        /* Those listbase data change every time we add/remove an ID, and also often when
-         * renaming one (due to re-sorting). This avoids generating a lot of false 'is changed'
-         * detections between undo steps. */
-        ((ID *)id_buffer)->prev = NULL;
-        ((ID *)id_buffer)->next = NULL;
-        /* Those runtime pointers should never be set during writing stage, but just in case clear
-         * them too. */
-        ((ID *)id_buffer)->orig_id = NULL;
-        ((ID *)id_buffer)->newid = NULL;
-        /* Even though in theory we could be able to preserve this python instance across undo even
-         * when we need to re-read the ID into its original address, this is currently cleared in
-         * #direct_link_id_common in `readfile.c` anyway, */
-        ((ID *)id_buffer)->py_instance = NULL;
-
-        const IDTypeInfo *id_type = BKE_idtype_get_info_from_id(id);
-        if (id_type->blend_write != NULL) {
-          id_type->blend_write(&writer, (ID *)id_buffer, id);
+        if (wd->incremental.state != NULL) {
+          write_id_incremental(&writer, id, id_buffer, idtype_struct_size);
+        }
+        else {
+          write_id(&writer, id, id_buffer, idtype_struct_size);
         }
 
         if (do_override) {
@@ -1238,8 +1799,18 @@ static bool write_file_handle(Main *mainvar,
     override_storage = NULL;
   }
 
+  if (incremental_state_prev != NULL) {
+    /* IDs that were removed since the previous save. */
+    GHASH_FOREACH_BEGIN (WriteIncrementalID *, id_written, incremental_state_prev->ids) {
+      write_incremental_skip_add(wd, id_written->file_offset);
+    }
+    GHASH_FOREACH_END();
+  }
+
   /* Special handling, operating over split Mains... */
+  wd->incremental.use_record_headers = (incremental_state != NULL);
   write_libraries(wd, mainvar->next);
+  wd->incremental.use_record_headers = false;
 
   /* So changes above don't cause a 'DNA1' to be detected as changed on undo. */
   mywrite_flush(wd);
@@ -1252,9 +1823,14 @@ static bool write_file_handle(Main *mainvar,
    *
    * Note that we *borrow* the pointer to 'DNAstr',
    * so writing each time uses the same address and doesn't cause unnecessary undo overhead. */
-  writedata(wd, DNA1, (size_t)wd->sdna->data_len, wd->sdna->data);
+  if (incremental_state_prev == NULL) {
+    writedata(wd, DNA1, (size_t)wd->sdna->data_len, wd->sdna->data);
+  }
 
   /* end of file */
+  if (incremental_state != NULL) {
+    incremental_state->endb_offset = wd->file_offset;
+  }
   memset(&bhead, 0, sizeof(BHead));
   bhead.code = ENDB;
   mywrite(wd, &bhead, sizeof(BHead));
@@ -1306,6 +1882,92 @@ static bool do_history(const char *name, ReportList *reports)
   return 0;
 }
 
+/** Finds the blocks in the data of an undo step, while it's written to a file. */
+typedef struct WriteMemFileScan {
+  /** The #BHead being read, it may span chunks. */
+  BHead bhead;
+  size_t bhead_len;
+  /** Bytes of block data to skip before the next #BHead. */
+  uint64_t skip_len;
+  /** Offset of the #GLOB block. */
+  uint64_t glob_offset;
+} WriteMemFileScan;
+
+/**
+ * Scan \a data written at \a file_offset for blocks. The offset of the first block that isn't
+ * #DATA is stored in \a r_id_offset when given, that's the #BHead of the ID. Otherwise the
+ * offsets of all blocks other than #DATA are stored in \a state.
+ */
+static void write_memfile_scan(WriteMemFileScan *scan,
+                               WriteIncrementalState *state,
+                               const char *data,
+                               size_t len,
+                               uint64_t file_offset,
+                               uint64_t *r_id_offset)
+{
+  while (len > 0) {
+    if (scan->skip_len > 0) {
+      const size_t skip = (scan->skip_len < len) ? (size_t)scan->skip_len : len;
+      scan->skip_len -= skip;
+      data += skip;
+      len -= skip;
+      file_offset += skip;
+      continue;
+    }
+
+    const size_t copy = min_zz(sizeof(BHead) - scan->bhead_len, len);
+    memcpy((char *)&scan->bhead + scan->bhead_len, data, copy);
+    scan->bhead_len += copy;
+    data += copy;
+    len -= copy;
+    file_offset += copy;
+    if (scan->bhead_len < sizeof(BHead)) {
+      break;
+    }
+    scan->bhead_len = 0;
+    scan->skip_len = (uint64_t)scan->bhead.len;
+
+    const int code = scan->bhead.code;
+    const uint64_t bhead_offset = file_offset - sizeof(BHead);
+    if (r_id_offset != NULL) {
+      if ((code != DATA) && (*r_id_offset == WRITE_OFFSET_UNSET)) {
+        *r_id_offset = bhead_offset;
+      }
+    }
+    else if (code == ENDB) {
+      state->endb_offset = bhead_offset;
+    }
+    else if (code != DATA) {
+      if (code == GLOB) {
+        scan->glob_offset = bhead_offset;
+      }
+      write_offsets_append(
+          &state->headers, &state->headers_len, &state->headers_alloc, bhead_offset);
+    }
+  }
+}
+
+/**
+ * Undo steps are written without #SKIP blocks, raise the minimum version in the #GLOB block
+ * appended to the file, like #write_global does.
+ */
+static bool write_memfile_min_version_ensure(const int file, const uint64_t glob_offset)
+{
+  FileGlobal fg;
+  fg.minversion = BLENDER_FILE_MIN_VERSION;
+  fg.minsubversion = BLENDER_FILE_MIN_SUBVERSION;
+  write_global_min_version_ensure(&fg, 300, 26);
+
+  const int64_t offset = (int64_t)(glob_offset + sizeof(BHead) +
+                                   offsetof(FileGlobal, minversion));
+  BLI_STATIC_ASSERT(offsetof(FileGlobal, minsubversion) ==
+                        offsetof(FileGlobal, minversion) + sizeof(short),
+                    "minversion and minsubversion are written together");
+  const short versions[2] = {fg.minversion, fg.minsubversion};
+  return (BLI_lseek(file, offset, SEEK_SET) == offset) &&
+         (write(file, versions, sizeof(versions)) == sizeof(versions));
+}
+
 /** \} */
 
 /* -------------------------------------------------------------------- */
@@ -1340,14 +2002,44 @@ bool BLO_write_file(Main *mainvar,
     BLO_main_validate_shapekeys(mainvar, reports);
   }
 
+  /* The state of an earlier save is outdated once the file is written again. */
+  WriteIncrementalState *incremental_state_prev = write_incremental_state_pop(filepath, false);
+  WriteIncrementalState *incremental_state = NULL;
+  if ((write_flags & G_FILE_SAVE_INCREMENTAL) && !(write_flags & G_FILE_COMPRESS) &&
+      !use_userdef) {
+    incremental_state = write_incremental_state_new(filepath, false);
+  }
+  else if (incremental_state_prev != NULL) {
+    write_incremental_state_free(incremental_state_prev);
+    incremental_state_prev = NULL;
+  }
+
   /* open temporary file, so we preserve the original in case we crash */
   BLI_snprintf(tempname, sizeof(tempname), "%s@", filepath);
 
   ww_handle_init((write_flags & G_FILE_COMPRESS) ? WW_WRAP_ZSTD : WW_WRAP_NONE, &ww);
 
-  if (ww.open(&ww, tempname) == false) {
+  if (incremental_state_prev != NULL) {
+    /* Append to the existing file, instead of writing the temporary file. */
+    ww.file_handle = write_incremental_open(incremental_state_prev);
+    if (ww.file_handle != -1) {
+      incremental_state->incremental_len = incremental_state_prev->incremental_len + 1;
+      incremental_state->full_size = incremental_state_prev->full_size;
+    }
+    else {
+      /* Fall back to a full save. */
+      write_incremental_state_free(incremental_state_prev);
+      incremental_state_prev = NULL;
+    }
+  }
+  const bool use_append = (incremental_state_prev != NULL);
+
+  if (!use_append && (ww.open(&ww, tempname) == false)) {
     BKE_reportf(
         reports, RPT_ERROR, "Cannot open file %s for writing: %s", tempname, strerror(errno));
+    if (incremental_state != NULL) {
+      write_incremental_state_free(incremental_state);
+    }
     return 0;
   }
 
@@ -1413,7 +2105,19 @@ bool BLO_write_file(Main *mainvar,
   }
 
   /* actual file writing */
-  const bool err = write_file_handle(mainvar, &ww, NULL, NULL, write_flags, use_userdef, thumb);
+  bool err = write_file_handle(mainvar,
+                               &ww,
+                               NULL,
+                               NULL,
+                               write_flags,
+                               use_userdef,
+                               thumb,
+                               incremental_state,
+                               incremental_state_prev);
+
+  if (!err && use_append) {
+    err = !write_incremental_skip_blocks(ww.file_handle, incremental_state);
+  }
 
   ww.close(&ww);
 
@@ -1422,28 +2126,48 @@ bool BLO_write_file(Main *mainvar,
     BKE_bpath_list_free(path_list_backup);
   }
 
+  if (incremental_state_prev != NULL) {
+    write_incremental_state_free(incremental_state_prev);
+  }
+
   if (err) {
     BKE_report(reports, RPT_ERROR, strerror(errno));
-    remove(tempname);
+    if (!use_append) {
+      remove(tempname);
+    }
+    if (incremental_state != NULL) {
+      write_incremental_state_free(incremental_state);
+    }
 
     return 0;
   }
 
   /* file save to temporary file was successful */
-  /* now do reverse file history (move .blend1 -> .blend2, .blend -> .blend1) */
-  if (use_save_versions) {
+  /* now do reverse file history (move .blend1 -> .blend2, .blend -> .blend1),
+   * not when appending, which changed the file in place. */
+  if (use_save_versions && !use_append) {
     const bool err_hist = do_history(filepath, reports);
     if (err_hist) {
       BKE_report(reports, RPT_ERROR, "Version backup failed (file saved with @)");
+      if (incremental_state != NULL) {
+        write_incremental_state_free(incremental_state);
+      }
       return 0;
     }
   }
 
-  if (BLI_rename(tempname, filepath) != 0) {
+  if (!use_append && (BLI_rename(tempname, filepath) != 0)) {
     BKE_report(reports, RPT_ERROR, "Cannot change old file (file saved with @)");
+    if (incremental_state != NULL) {
+      write_incremental_state_free(incremental_state);
+    }
     return 0;
   }
 
+  if (incremental_state != NULL) {
+    write_incremental_state_store(incremental_state);
+  }
+
   if (G.debug & G_DEBUG_IO && mainvar->lock != NULL) {
     BKE_report(reports, RPT_INFO, "Checking sanity of current .blend file *AFTER* save to disk");
     BLO_main_validate_libraries(mainvar, reports);
@@ -1460,11 +2184,174 @@ bool BLO_write_file_mem(Main *mainvar, MemFile *compare, MemFile *current, int w
   bool use_userdef = false;
 
   const bool err = write_file_handle(
-      mainvar, NULL, compare, current, write_flags, use_userdef, NULL);
+      mainvar, NULL, compare, current, write_flags, use_userdef, NULL, NULL, NULL);
 
   return (err == 0);
 }
 
+/**
+ * Write an undo step to \a filepath, like #BLO_memfile_write_file. When this session wrote the
+ * file before, only the IDs that changed since are appended, see #G_FILE_SAVE_INCREMENTAL.
+ *
+ * The chunks of an undo step are written per ID, and chunks with the same content share their
+ * buffer with other steps (see #BLO_memfile_chunk_content_key). So the IDs that changed are
+ * found by comparing these keys, without hashing any data.
+ *
+ * \return Success.
+ */
+bool BLO_write_memfile_incremental(MemFile *memfile, const char *filepath)
+{
+  WriteIncrementalState *state_prev = write_incremental_state_pop(filepath, true);
+  WriteIncrementalState *state = write_incremental_state_new(filepath, true);
+
+  int file = -1;
+  if (state_prev != NULL) {
+    file = write_incremental_open(state_prev);
+    if (file != -1) {
+      state->incremental_len = state_prev->incremental_len + 1;
+      state->full_size = state_prev->full_size;
+    }
+    else {
+      write_incremental_state_free(state_prev);
+      state_prev = NULL;
+    }
+  }
+  if (state_prev == NULL) {
+    int oflags = O_BINARY | O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_NOFOLLOW
+    /* Don't write to a symlink, see #BLO_memfile_write_file. */
+    oflags |= O_NOFOLLOW;
+#endif
+    file = BLI_open(filepath, oflags, 0666);
+  }
+  if (file == -1) {
+    fprintf(stderr,
+            "Unable to save '%s': %s\n",
+            filepath,
+            errno ? strerror(errno) : "Unknown error opening file");
+    write_incremental_state_free(state);
+    return false;
+  }
+
+  /* The "BLENDER-v300" header, only written to a new file. */
+  const uint64_t file_header_len = 12;
+
+  WriteMemFileScan scan = {.skip_len = (state_prev == NULL) ? file_header_len : 0};
+  uint64_t file_offset = 0;
+  if (state_prev != NULL) {
+    file_offset = state_prev->endb_offset + sizeof(BHead);
+    write_incremental_state_skip_headers(state, state_prev);
+  }
+  uint64_t memfile_offset = 0;
+  bool ok = true;
+
+  MemFileChunk *chunk = memfile->chunks.first;
+  while (ok && (chunk != NULL)) {
+    /* The chunks of an ID are contiguous, see #mywrite_id_end. */
+    const uint id_session_uuid = chunk->id_session_uuid;
+    MemFileChunk *chunk_end = chunk->next;
+    while ((chunk_end != NULL) && (chunk_end->id_session_uuid == id_session_uuid)) {
+      chunk_end = chunk_end->next;
+    }
+
+    WriteIncrementalID *id_written = NULL;
+    if (id_session_uuid != MAIN_ID_SESSION_UUID_UNSET) {
+      BLI_HashMurmur2A mm2[2];
+      BLI_hash_mm2a_init(&mm2[0], 0);
+      BLI_hash_mm2a_init(&mm2[1], 1);
+      for (MemFileChunk *chunk_iter = chunk; chunk_iter != chunk_end;
+           chunk_iter = chunk_iter->next) {
+        const uint64_t key[2] = {BLO_memfile_chunk_content_key(chunk_iter), chunk_iter->size};
+        BLI_hash_mm2a_add(&mm2[0], (const uchar *)key, sizeof(key));
+        BLI_hash_mm2a_add(&mm2[1], (const uchar *)key, sizeof(key));
+      }
+      const uint64_t hash = ((uint64_t)BLI_hash_mm2a_end(&mm2[0]) << 32) |
+                            (uint64_t)BLI_hash_mm2a_end(&mm2[1]);
+
+      void *key = POINTER_FROM_UINT(id_session_uuid);
+      id_written = (state_prev != NULL) ? BLI_ghash_popkey(state_prev->ids, key, NULL) : NULL;
+      if ((id_written != NULL) && (id_written->hash == hash)) {
+        /* Unchanged, keep the ID in the file as-is. */
+        BLI_ghash_insert(state->ids, key, id_written);
+        for (; chunk != chunk_end; chunk = chunk->next) {
+          memfile_offset += chunk->size;
+        }
+        continue;
+      }
+      if (id_written != NULL) {
+        write_incremental_state_skip_add(state, id_written->file_offset);
+      }
+      else {
+        id_written = MEM_mallocN(sizeof(*id_written), __func__);
+      }
+      id_written->file_offset = WRITE_OFFSET_UNSET;
+      id_written->hash = hash;
+    }
+
+    for (; ok && (chunk != chunk_end); chunk = chunk->next) {
+      char *data_temp;
+      const char *data = BLO_memfile_chunk_data_get(chunk, &data_temp);
+      size_t len = chunk->size;
+      if (data == NULL) {
+        ok = false;
+        break;
+      }
+      if ((state_prev != NULL) && (memfile_offset < file_header_len)) {
+        const size_t skip = min_zz((size_t)(file_header_len - memfile_offset), len);
+        data += skip;
+        len -= skip;
+      }
+      memfile_offset += chunk->size;
+
+      write_memfile_scan(
+          &scan, state, data, len, file_offset, id_written ? &id_written->file_offset : NULL);
+#ifdef _WIN32
+      ok = ((size_t)write(file, data, (uint)len) == len);
+#else
+      ok = ((size_t)write(file, data, len) == len);
+#endif
+      file_offset += len;
+      MEM_SAFE_FREE(data_temp);
+    }
+
+    if (id_written != NULL) {
+      if (id_written->file_offset != WRITE_OFFSET_UNSET) {
+        BLI_ghash_insert(state->ids, POINTER_FROM_UINT(id_session_uuid), id_written);
+      }
+      else {
+        MEM_freeN(id_written);
+      }
+    }
+  }
+  BLI_assert(!ok || ((scan.bhead_len == 0) && (scan.skip_len == 0)));
+
+  if (state_prev != NULL) {
+    /* IDs that were removed since the previous save. */
+    GHASH_FOREACH_BEGIN (WriteIncrementalID *, id_written, state_prev->ids) {
+      write_incremental_state_skip_add(state, id_written->file_offset);
+    }
+    GHASH_FOREACH_END();
+
+    /* The new blocks only become visible once the old #ENDB is skipped. */
+    ok = ok && write_memfile_min_version_ensure(file, scan.glob_offset) &&
+         write_incremental_skip_blocks(file, state);
+    write_incremental_state_free(state_prev);
+  }
+
+  close(file);
+
+  if (!ok) {
+    fprintf(stderr,
+            "Unable to save '%s': %s\n",
+            filepath,
+            errno ? strerror(errno) : "Unknown error writing file");
+    write_incremental_state_free(state);
+    return false;
+  }
+  write_incremental_state_store(state);
+  return true;
+}
+
 void BLO_write_raw(BlendWriter *writer, size_t size_in_bytes, const void *data_ptr)
 {
   writedata(writer->wd, DATA, size_in_bytes, data_ptr);
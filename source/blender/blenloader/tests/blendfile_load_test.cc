@@ -17,6 +17,29 @@
  */
 #include "blendfile_loading_base_test.h"
 
+#include "MEM_guardedalloc.h"
+
+#include "BKE_appdir.h"
+#include "BKE_global.h"
+#include "BKE_lib_id.h"
+#include "BKE_main.h"
+#include "BKE_packedFile.h"
+#include "BKE_text.h"
+
+#include "BLI_fileops.h"
+#include "BLI_listbase.h"
+#include "BLI_path_util.h"
+#include "BLI_string.h"
+#include "BLI_timeit.hh"
+
+#include "BLO_readfile.h"
+#include "BLO_undofile.h"
+#include "BLO_writefile.h"
+
+#include "DNA_image_types.h"
+#include "DNA_packedFile_types.h"
+#include "DNA_text_types.h"
+
 class BlendfileLoadingTest : public BlendfileLoadingBaseTest {
 };
 
@@ -29,3 +52,337 @@ TEST_F(BlendfileLoadingTest, CanaryTest)
   depsgraph_create(DAG_EVAL_RENDER);
   EXPECT_NE(nullptr, this->depsgraph);
 }
+
+static Text *text_add_with_line(Main *bmain, const char *name, const char *line)
+{
+  Text *text = BKE_text_add(bmain, name);
+  TextLine *tl = static_cast<TextLine *>(text->lines.first);
+  MEM_freeN(tl->line);
+  tl->line = BLI_strdup(line);
+  tl->len = strlen(line);
+  return text;
+}
+
+TEST_F(BlendfileLoadingTest, DeduplicateDataBlocks)
+{
+  const std::string line_shared(4096, 'a');
+  const std::string line_unique(4096, 'b');
+
+  Main *bmain = BKE_main_new();
+  text_add_with_line(bmain, "A", line_shared.c_str());
+  text_add_with_line(bmain, "B", line_shared.c_str());
+  text_add_with_line(bmain, "C", line_unique.c_str());
+
+  BKE_tempdir_init(nullptr);
+  char filepath[FILE_MAX], filepath_dedup[FILE_MAX];
+  BLI_join_dirfile(filepath, sizeof(filepath), BKE_tempdir_base(), "dedup_none.blend");
+  BLI_join_dirfile(
+      filepath_dedup, sizeof(filepath_dedup), BKE_tempdir_base(), "dedup_blocks.blend");
+
+  BlendFileWriteParams params{};
+  params.remap_mode = BLO_WRITE_PATH_REMAP_NONE;
+  const bool write_ok =
+      BLO_write_file(bmain, filepath, 0, &params, nullptr) &&
+      BLO_write_file(bmain, filepath_dedup, G_FILE_DEDUPLICATE, &params, nullptr);
+  BKE_main_free(bmain);
+  ASSERT_TRUE(write_ok);
+
+  /* Only the second copy of the shared line is replaced by a reference. */
+  const size_t size = BLI_file_size(filepath);
+  const size_t size_dedup = BLI_file_size(filepath_dedup);
+  EXPECT_LT(size_dedup, size - 4000);
+  EXPECT_GT(size_dedup, size - 4096 - 64);
+
+  BlendFileReadReport bf_reports = {nullptr};
+  bfile = BLO_read_from_file(filepath_dedup, BLO_READ_SKIP_NONE, &bf_reports);
+  ASSERT_NE(bfile, nullptr);
+  /* Versions that don't know #DDUP blocks warn about the file. */
+  EXPECT_EQ(bfile->main->minversionfile, 300);
+  EXPECT_EQ(bfile->main->minsubversionfile, 26);
+  ASSERT_EQ(BLI_listbase_count(&bfile->main->texts), 3);
+  LISTBASE_FOREACH (Text *, text, &bfile->main->texts) {
+    const TextLine *tl = static_cast<const TextLine *>(text->lines.first);
+    ASSERT_NE(tl, nullptr);
+    ASSERT_NE(tl->line, nullptr);
+    EXPECT_EQ(STREQ(text->id.name + 2, "C") ? line_unique : line_shared, tl->line);
+  }
+
+  BLI_delete(filepath, false, false);
+  BLI_delete(filepath_dedup, false, false);
+}
+
+TEST_F(BlendfileLoadingTest, IncrementalSave)
+{
+  const std::string line_large(64 * 1024, 'a');
+
+  Main *bmain = BKE_main_new();
+  text_add_with_line(bmain, "A", line_large.c_str());
+  Text *text_b = text_add_with_line(bmain, "B", "b");
+  Text *text_c = text_add_with_line(bmain, "C", "c");
+
+  BKE_tempdir_init(nullptr);
+  char filepath[FILE_MAX];
+  BLI_join_dirfile(filepath, sizeof(filepath), BKE_tempdir_base(), "incremental.blend");
+
+  BlendFileWriteParams params{};
+  params.remap_mode = BLO_WRITE_PATH_REMAP_NONE;
+  bool write_ok = BLO_write_file(bmain, filepath, G_FILE_SAVE_INCREMENTAL, &params, nullptr);
+  const size_t size_full = BLI_file_size(filepath);
+
+  /* Change, remove and add a text, the unchanged large text is not written again. */
+  TextLine *tl = static_cast<TextLine *>(text_b->lines.first);
+  MEM_freeN(tl->line);
+  tl->line = BLI_strdup("b changed");
+  tl->len = strlen(tl->line);
+  BKE_id_delete(bmain, text_c);
+  text_add_with_line(bmain, "D", "d");
+
+  write_ok = write_ok &&
+             BLO_write_file(bmain, filepath, G_FILE_SAVE_INCREMENTAL, &params, nullptr);
+  const size_t size_incremental = BLI_file_size(filepath);
+  BKE_main_free(bmain);
+  BLO_write_incremental_free();
+  ASSERT_TRUE(write_ok);
+  EXPECT_GT(size_incremental, size_full);
+  EXPECT_LT(size_incremental, size_full + line_large.size() / 2);
+
+  BlendFileReadReport bf_reports = {nullptr};
+  bfile = BLO_read_from_file(filepath, BLO_READ_SKIP_NONE, &bf_reports);
+  ASSERT_NE(bfile, nullptr);
+  EXPECT_EQ(bfile->main->minversionfile, 300);
+  EXPECT_EQ(bfile->main->minsubversionfile, 26);
+  ASSERT_EQ(BLI_listbase_count(&bfile->main->texts), 3);
+  const char *names[] = {"A", "B", "D"};
+  const char *lines[] = {line_large.c_str(), "b changed", "d"};
+  int i = 0;
+  LISTBASE_FOREACH (Text *, text, &bfile->main->texts) {
+    EXPECT_STREQ(text->id.name + 2, names[i]);
+    tl = static_cast<TextLine *>(text->lines.first);
+    ASSERT_NE(tl, nullptr);
+    EXPECT_STREQ(tl->line, lines[i]);
+    i++;
+  }
+
+  BLI_delete(filepath, false, false);
+}
+
+TEST_F(BlendfileLoadingTest, IncrementalSaveMemFile)
+{
+  const std::string line_large(64 * 1024, 'a');
+
+  Main *bmain = BKE_main_new();
+  text_add_with_line(bmain, "A", line_large.c_str());
+  Text *text_b = text_add_with_line(bmain, "B", "b");
+  Text *text_c = text_add_with_line(bmain, "C", "c");
+
+  BKE_tempdir_init(nullptr);
+  char filepath[FILE_MAX];
+  BLI_join_dirfile(filepath, sizeof(filepath), BKE_tempdir_base(), "incremental_memfile.blend");
+
+  /* Auto-save writes the active undo step. */
+  MemFile memfile_a = {{nullptr}};
+  bool write_ok = BLO_write_file_mem(bmain, nullptr, &memfile_a, 0) &&
+                  BLO_write_memfile_incremental(&memfile_a, filepath);
+  const size_t size_full = BLI_file_size(filepath);
+
+  /* Change, remove and add a text, the large text shares its chunks with the previous step. */
+  TextLine *tl = static_cast<TextLine *>(text_b->lines.first);
+  MEM_freeN(tl->line);
+  tl->line = BLI_strdup("b changed");
+  tl->len = strlen(tl->line);
+  BKE_id_delete(bmain, text_c);
+  text_add_with_line(bmain, "D", "d");
+
+  MemFile memfile_b = {{nullptr}};
+  write_ok = write_ok && BLO_write_file_mem(bmain, &memfile_a, &memfile_b, 0) &&
+             BLO_write_memfile_incremental(&memfile_b, filepath);
+  const size_t size_incremental = BLI_file_size(filepath);
+  BLO_memfile_free(&memfile_a);
+  BLO_memfile_free(&memfile_b);
+  BKE_main_free(bmain);
+  BLO_write_incremental_free();
+  ASSERT_TRUE(write_ok);
+  EXPECT_GT(size_incremental, size_full);
+  EXPECT_LT(size_incremental, size_full + line_large.size() / 2);
+
+  BlendFileReadReport bf_reports = {nullptr};
+  bfile = BLO_read_from_file(filepath, BLO_READ_SKIP_NONE, &bf_reports);
+  ASSERT_NE(bfile, nullptr);
+  EXPECT_EQ(bfile->main->minversionfile, 300);
+  EXPECT_EQ(bfile->main->minsubversionfile, 26);
+  ASSERT_EQ(BLI_listbase_count(&bfile->main->texts), 3);
+  const char *names[] = {"A", "B", "D"};
+  const char *lines[] = {line_large.c_str(), "b changed", "d"};
+  int i = 0;
+  LISTBASE_FOREACH (Text *, text, &bfile->main->texts) {
+    EXPECT_STREQ(text->id.name + 2, names[i]);
+    tl = static_cast<TextLine *>(text->lines.first);
+    ASSERT_NE(tl, nullptr);
+    EXPECT_STREQ(tl->line, lines[i]);
+    i++;
+  }
+
+  BLI_delete(filepath, false, false);
+}
+
+/**
+ * Set this to 1 to activate the benchmark. It is disabled by default, because it writes a large
+ * file to the temporary directory. Run with `--debug` to print the #OldNewMap statistics.
+ */
+#if 0
+TEST_F(BlendfileLoadingTest, BenchmarkManyDataBlocks)
+{
+  /* Every text line is written as two data blocks, the #TextLine and its string. */
+  const int lines_len = 2500000;
+
+  Main *bmain = BKE_main_new();
+  Text *text = BKE_text_add(bmain, "Benchmark");
+  for (int i = 0; i < lines_len; i++) {
+    TextLine *tl = static_cast<TextLine *>(MEM_callocN(sizeof(TextLine), __func__));
+    tl->line = BLI_sprintfN("line %d", i);
+    tl->len = strlen(tl->line);
+    BLI_addtail(&text->lines, tl);
+  }
+
+  BKE_tempdir_init(nullptr);
+  char filepath[FILE_MAX];
+  BLI_join_dirfile(filepath, sizeof(filepath), BKE_tempdir_base(), "many_data_blocks.blend");
+
+  BlendFileWriteParams params{};
+  params.remap_mode = BLO_WRITE_PATH_REMAP_NONE;
+  const bool write_ok = BLO_write_file(bmain, filepath, 0, &params, nullptr);
+  BKE_main_free(bmain);
+  ASSERT_TRUE(write_ok);
+
+  {
+    SCOPED_TIMER("Read 5M data blocks");
+    BlendFileReadReport bf_reports = {nullptr};
+    bfile = BLO_read_from_file(filepath, BLO_READ_SKIP_NONE, &bf_reports);
+  }
+  ASSERT_NE(bfile, nullptr);
+  text = static_cast<Text *>(bfile->main->texts.first);
+  ASSERT_NE(text, nullptr);
+  EXPECT_EQ(BLI_listbase_count(&text->lines), lines_len + 1);
+
+  BLI_delete(filepath, false, false);
+}
+#endif /* Benchmark */
+
+static PackedFile *image_first_packedfile(Main *bmain)
+{
+  const Image *image = static_cast<const Image *>(bmain->images.first);
+  if (image == nullptr || image->packedfiles.first == nullptr) {
+    return nullptr;
+  }
+  return static_cast<ImagePackedFile *>(image->packedfiles.first)->packedfile;
+}
+
+TEST_F(BlendfileLoadingTest, LazyPackedFileRead)
+{
+  /* Large enough to be left in the file. */
+  std::string contents(256 * 1024, '\0');
+  for (size_t i = 0; i < contents.size(); i++) {
+    contents[i] = static_cast<char>(i * 7);
+  }
+
+  Main *bmain = BKE_main_new();
+  Image *image = static_cast<Image *>(BKE_id_new(bmain, ID_IM, "Packed"));
+  void *data = MEM_mallocN(contents.size(), __func__);
+  memcpy(data, contents.data(), contents.size());
+  ImagePackedFile *imapf = static_cast<ImagePackedFile *>(
+      MEM_callocN(sizeof(ImagePackedFile), __func__));
+  STRNCPY(imapf->filepath, "//packed.png");
+  imapf->packedfile = BKE_packedfile_new_from_memory(data, contents.size());
+  BLI_addtail(&image->packedfiles, imapf);
+
+  BKE_tempdir_init(nullptr);
+  char filepath[FILE_MAX];
+  BLI_join_dirfile(filepath, sizeof(filepath), BKE_tempdir_base(), "lazy_packed.blend");
+  BlendFileWriteParams params{};
+  params.remap_mode = BLO_WRITE_PATH_REMAP_NONE;
+  const bool write_ok = BLO_write_file(bmain, filepath, 0, &params, nullptr);
+  BKE_main_free(bmain);
+  ASSERT_TRUE(write_ok);
+
+  const int fileflags = G.fileflags;
+  G.fileflags |= G_FILE_LAZY_PACKED_READ;
+  BlendFileReadReport bf_reports = {nullptr};
+  bfile = BLO_read_from_file(filepath, BLO_READ_SKIP_NONE, &bf_reports);
+  G.fileflags = fileflags;
+  ASSERT_NE(bfile, nullptr);
+  PackedFile *pf = image_first_packedfile(bfile->main);
+  ASSERT_NE(pf, nullptr);
+  EXPECT_EQ(pf->size, static_cast<int>(contents.size()));
+  EXPECT_EQ(pf->data, nullptr);
+
+  /* An undo step only stores where the contents are, reading it defers them again. */
+  MemFile memfile = {{nullptr}};
+  ASSERT_TRUE(BLO_write_file_mem(bfile->main, nullptr, &memfile, 0));
+  EXPECT_EQ(pf->data, nullptr);
+  BlendFileReadParams read_params{};
+  read_params.skip_flags = BLO_READ_SKIP_UNDO_OLD_MAIN;
+  BlendFileData *bfd_undo = BLO_read_from_memfile(
+      bfile->main, filepath, &memfile, &read_params, nullptr);
+  BLO_memfile_free(&memfile);
+  ASSERT_NE(bfd_undo, nullptr);
+  PackedFile *pf_undo = image_first_packedfile(bfd_undo->main);
+  ASSERT_NE(pf_undo, nullptr);
+  EXPECT_EQ(pf_undo->flag, 0);
+  EXPECT_EQ(pf_undo->data, nullptr);
+  ASSERT_TRUE(BKE_packedfile_data_ensure(pf_undo));
+  EXPECT_EQ(std::string_view(static_cast<const char *>(pf_undo->data), pf_undo->size), contents);
+  BLO_blendfiledata_free(bfd_undo);
+
+  /* The contents are read on first access. */
+  EXPECT_EQ(pf->data, nullptr);
+  ASSERT_TRUE(BKE_packedfile_data_ensure(pf));
+  EXPECT_EQ(std::string_view(static_cast<const char *>(pf->data), pf->size), contents);
+
+  BLI_delete(filepath, false, false);
+}
+
+TEST_F(BlendfileLoadingTest, ParallelStructReconstruct)
+{
+  /* Enough data to convert it with multiple threads. */
+  Main *bmain = BKE_main_new();
+  Text *text = text_add_with_line(bmain, "A", "line");
+  for (int i = 0; i < 20000; i++) {
+    TextLine *tl = static_cast<TextLine *>(MEM_callocN(sizeof(TextLine), __func__));
+    tl->line = BLI_sprintfN("line %d", i);
+    tl->len = strlen(tl->line);
+    BLI_addtail(&text->lines, tl);
+  }
+
+  BKE_tempdir_init(nullptr);
+  char filepath[FILE_MAX];
+  BLI_join_dirfile(filepath, sizeof(filepath), BKE_tempdir_base(), "reconstruct.blend");
+  BlendFileWriteParams params{};
+  params.remap_mode = BLO_WRITE_PATH_REMAP_NONE;
+  const bool write_ok = BLO_write_file(bmain, filepath, 0, &params, nullptr);
+  BKE_main_free(bmain);
+  ASSERT_TRUE(write_ok);
+
+  /* Rename the `len` member in the DNA stored in the file, so that all structs using it
+   * (including #TextLine) differ from the current DNA and need to be converted. */
+  size_t size;
+  char *file_data = static_cast<char *>(BLI_file_read_binary_as_mem(filepath, 0, &size));
+  ASSERT_NE(file_data, nullptr);
+  const std::string_view file_view(file_data, size);
+  const size_t dna_offset = file_view.rfind("SDNANAME");
+  ASSERT_NE(dna_offset, std::string_view::npos);
+  const std::string_view name("\0len\0", 5);
+  const size_t name_offset = file_view.find(name, dna_offset);
+  ASSERT_NE(name_offset, std::string_view::npos);
+  file_data[name_offset + 3] = 'x';
+  FILE *file = BLI_fopen(filepath, "wb");
+  ASSERT_NE(file, nullptr);
+  EXPECT_EQ(fwrite(file_data, 1, size, file), size);
+  fclose(file);
+  MEM_freeN(file_data);
+
+  /* Every converted block is the same with and without threads. */
+  BlendFileReadReport bf_reports = {nullptr};
+  EXPECT_GT(BLO_read_file_reconstruct_structs_compare(filepath, &bf_reports), 20000);
+
+  BLI_delete(filepath, false, false);
+}
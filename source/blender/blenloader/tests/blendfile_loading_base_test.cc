@@ -93,6 +93,7 @@ void BlendfileLoadingBaseTest::TearDownTestCase()
   RNA_exit();
 
   DEG_free_node_types();
+  BLO_sdna_cache_free();
   DNA_sdna_current_free();
   BLI_threadapi_exit();
 
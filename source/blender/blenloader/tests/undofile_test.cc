@@ -0,0 +1,129 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <string>
+#include <vector>
+
+#include "MEM_guardedalloc.h"
+
+#include "DNA_listBase.h"
+
+#include "BLI_listbase.h"
+
+#include "BLO_undofile.h"
+
+/** Write an undo step with one chunk for each of \a chunks. */
+static void memfile_write(MemFile *memfile,
+                          MemFile *reference,
+                          const std::vector<std::string> &chunks)
+{
+  MemFileWriteData mem_data = {nullptr};
+  BLO_memfile_write_init(&mem_data, memfile, reference);
+  for (const std::string &chunk : chunks) {
+    BLO_memfile_chunk_add(&mem_data, chunk.data(), chunk.size());
+  }
+  BLO_memfile_write_finalize(&mem_data);
+}
+
+static const MemFileChunk *memfile_chunk(const MemFile *memfile, const int index)
+{
+  return static_cast<const MemFileChunk *>(BLI_findlink(&memfile->chunks, index));
+}
+
+static std::string memfile_chunk_data(const MemFileChunk *chunk, bool *r_is_compressed)
+{
+  char *data_temp;
+  const char *data = BLO_memfile_chunk_data_get(chunk, &data_temp);
+  if (data == nullptr) {
+    return "";
+  }
+  std::string result(data, chunk->size);
+  *r_is_compressed = (data_temp != nullptr);
+  MEM_SAFE_FREE(data_temp);
+  return result;
+}
+
+TEST(undofile, ChunkSharingByContent)
+{
+  const std::string a(8192, 'a');
+  const std::string b(8192, 'b');
+  const std::string c(8192, 'c');
+
+  MemFile memfile_1 = {{nullptr}};
+  memfile_write(&memfile_1, nullptr, {a, b});
+  EXPECT_EQ(memfile_1.size, a.size() + b.size());
+
+  /* The chunks moved, they are found by content instead of by position. */
+  MemFile memfile_2 = {{nullptr}};
+  memfile_write(&memfile_2, &memfile_1, {b, a, c});
+  const MemFileChunk *chunk_1a = memfile_chunk(&memfile_1, 0);
+  const MemFileChunk *chunk_1b = memfile_chunk(&memfile_1, 1);
+  const MemFileChunk *chunk_2b = memfile_chunk(&memfile_2, 0);
+  const MemFileChunk *chunk_2a = memfile_chunk(&memfile_2, 1);
+  const MemFileChunk *chunk_2c = memfile_chunk(&memfile_2, 2);
+  EXPECT_EQ(BLO_memfile_chunk_content_key(chunk_2a), BLO_memfile_chunk_content_key(chunk_1a));
+  EXPECT_EQ(BLO_memfile_chunk_content_key(chunk_2b), BLO_memfile_chunk_content_key(chunk_1b));
+  EXPECT_NE(BLO_memfile_chunk_content_key(chunk_2c), BLO_memfile_chunk_content_key(chunk_1a));
+  EXPECT_NE(BLO_memfile_chunk_content_key(chunk_2c), BLO_memfile_chunk_content_key(chunk_1b));
+  EXPECT_FALSE(chunk_2a->is_identical);
+  EXPECT_FALSE(chunk_2b->is_identical);
+  /* Shared buffers are only counted for the step that created them. */
+  EXPECT_EQ(memfile_2.size, c.size());
+
+  /* The same position and content is detected as identical to the previous step. */
+  MemFile memfile_3 = {{nullptr}};
+  memfile_write(&memfile_3, &memfile_2, {b, c});
+  EXPECT_TRUE(memfile_chunk(&memfile_3, 0)->is_identical);
+  EXPECT_FALSE(memfile_chunk(&memfile_3, 1)->is_identical);
+  EXPECT_EQ(memfile_3.size, 0u);
+
+  /* Freeing the step that created a buffer keeps it for the steps still using it. */
+  BLO_memfile_free(&memfile_1);
+  EXPECT_EQ(memfile_2.size + memfile_3.size, a.size() + b.size() + c.size());
+  bool is_compressed = false;
+  EXPECT_EQ(memfile_chunk_data(memfile_chunk(&memfile_3, 0), &is_compressed), b);
+
+  BLO_memfile_free(&memfile_2);
+  BLO_memfile_free(&memfile_3);
+  BLO_memfile_storage_exit();
+}
+
+TEST(undofile, CompressColdSteps)
+{
+  const std::string a(65536, 'a');
+  const std::string b(65536, 'b');
+
+  MemFile memfiles[4] = {{{nullptr}}};
+  memfile_write(&memfiles[0], nullptr, {a});
+  for (int i = 1; i < 4; i++) {
+    memfile_write(&memfiles[i], &memfiles[i - 1], {b + std::to_string(i)});
+  }
+  /* Wait for the background compression of the buffers no recent step uses. */
+  BLO_memfile_storage_exit();
+
+  const MemFileChunk *chunk_a = memfile_chunk(&memfiles[0], 0);
+  const uint64_t key_a = BLO_memfile_chunk_content_key(chunk_a);
+  EXPECT_LT(memfiles[0].size, a.size() / 16);
+  bool is_compressed = false;
+  EXPECT_EQ(memfile_chunk_data(chunk_a, &is_compressed), a);
+  EXPECT_TRUE(is_compressed);
+  /* The last steps stay uncompressed. */
+  EXPECT_EQ(memfile_chunk_data(memfile_chunk(&memfiles[3], 0), &is_compressed), b + "3");
+  EXPECT_FALSE(is_compressed);
+
+  /* A new step using the same content decompresses the buffer again, and shares it. */
+  MemFile memfile_new = {{nullptr}};
+  memfile_write(&memfile_new, &memfiles[0], {a});
+  EXPECT_TRUE(memfile_chunk(&memfile_new, 0)->is_identical);
+  EXPECT_EQ(BLO_memfile_chunk_content_key(memfile_chunk(&memfile_new, 0)), key_a);
+  EXPECT_EQ(memfiles[0].size, a.size());
+  EXPECT_EQ(memfile_chunk_data(chunk_a, &is_compressed), a);
+  EXPECT_FALSE(is_compressed);
+
+  for (MemFile &memfile : memfiles) {
+    BLO_memfile_free(&memfile);
+  }
+  BLO_memfile_free(&memfile_new);
+  BLO_memfile_storage_exit();
+}
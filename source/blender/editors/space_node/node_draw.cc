@@ -1553,6 +1553,38 @@ static void node_add_error_message_button(
   UI_block_emboss_set(node.block, UI_EMBOSS);
 }
 
+static void node_add_execution_time_label(const bContext *C, bNode &node, const rctf &rect)
+{
+  SpaceNode *snode = CTX_wm_space_node(C);
+  const geo_log::NodeLog *node_log = geo_log::ModifierLog::find_node_by_node_editor_context(*snode,
+                                                                                            node);
+  if (node_log == nullptr) {
+    return;
+  }
+  const std::chrono::microseconds exec_time = node_log->execution_time();
+  /* Don't clutter the editor with nodes that hardly take any time. */
+  if (exec_time.count() < 100) {
+    return;
+  }
+
+  char exec_time_str[32];
+  BLI_snprintf(exec_time_str, sizeof(exec_time_str), "%.1f ms", exec_time.count() / 1000.0);
+  uiDefBut(node.block,
+           UI_BTYPE_LABEL,
+           0,
+           exec_time_str,
+           rect.xmin,
+           rect.ymax,
+           BLI_rctf_size_x(&rect),
+           UI_UNIT_Y,
+           nullptr,
+           0,
+           0,
+           0,
+           0,
+           TIP_("Time spent executing the node in the last evaluation"));
+}
+
 static void node_draw_basis(const bContext *C,
                             const View2D *v2d,
                             const SpaceNode *snode,
@@ -1671,6 +1703,7 @@ static void node_draw_basis(const bContext *C,
   }
 
   node_add_error_message_button(C, *ntree, *node, *rct, iconofs);
+  node_add_execution_time_label(C, *node, *rct);
 
   /* Title. */
   if (node->flag & SELECT) {
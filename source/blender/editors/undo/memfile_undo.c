@@ -101,6 +101,15 @@ static bool memfile_undosys_step_encode(struct bContext *UNUSED(C),
   us->data = BKE_memfile_undo_encode(bmain, us_prev ? us_prev->data : NULL);
   us->step.data_size = us->data->undo_size;
 
+  /* Memory of older steps shrinks as their data is compressed in the background,
+   * update it for the memory limit of the undo stack. */
+  LISTBASE_FOREACH (UndoStep *, us_iter, &ustack->steps) {
+    if (us_iter->type == BKE_UNDOSYS_TYPE_MEMFILE && us_iter != us_p) {
+      MemFileUndoData *data = ((MemFileUndoStep *)us_iter)->data;
+      us_iter->data_size = data->undo_size = data->memfile.size;
+    }
+  }
+
   /* Store the fact that we should not re-use old data with that undo step, and reset the Main
    * flag. */
   us->step.use_old_bmain_data = !bmain->use_memfile_full_barrier;
@@ -156,6 +156,11 @@ template<typename NodePtr> class GFieldBase {
     return *a.node_ == *b.node_ && a.node_output_index_ == b.node_output_index_;
   }
 
+  friend bool operator!=(const GFieldBase &a, const GFieldBase &b)
+  {
+    return !(a == b);
+  }
+
   uint64_t hash() const
   {
     return get_default_hash_2(*node_, node_output_index_);
@@ -188,6 +193,11 @@ class GField : public GFieldBase<std::shared_ptr<FieldNode>> {
       : GFieldBase<std::shared_ptr<FieldNode>>(std::move(node), node_output_index)
   {
   }
+
+  const std::shared_ptr<FieldNode> &node_ptr() const
+  {
+    return node_;
+  }
 };
 
 /**
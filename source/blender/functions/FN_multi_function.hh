@@ -72,6 +72,28 @@ class MultiFunction {
     return false;
   }
 
+  /**
+   * Functions that compute every output element only from the input elements at the same index
+   * can provide an element kernel. It processes contiguous arrays, without the indirections of
+   * #MFParams and virtual arrays. That allows fusing chains of such functions into a single loop,
+   * see #FusedMultiFunction. All parameters of those functions are single inputs or outputs.
+   */
+  virtual bool has_element_kernel() const
+  {
+    return false;
+  }
+
+  /**
+   * \param inputs: One pointer to \a amount initialized values for every input parameter.
+   * \param outputs: One pointer to \a amount uninitialized values for every output parameter.
+   */
+  virtual void call_element_kernel(const int64_t UNUSED(amount),
+                                   Span<const void *> UNUSED(inputs),
+                                   Span<void *> UNUSED(outputs)) const
+  {
+    BLI_assert_unreachable();
+  }
+
   int param_amount() const
   {
     return signature_ref_->param_types.size();
@@ -39,7 +39,9 @@ namespace blender::fn {
 template<typename In1, typename Out1> class CustomMF_SI_SO : public MultiFunction {
  private:
   using FunctionT = std::function<void(IndexMask, const VArray<In1> &, MutableSpan<Out1>)>;
+  using ElementKernelT = std::function<void(int64_t, const In1 *, Out1 *)>;
   FunctionT function_;
+  ElementKernelT element_kernel_;
   MFSignature signature_;
 
  public:
@@ -56,6 +58,11 @@ template<typename In1, typename Out1> class CustomMF_SI_SO : public MultiFunctio
   CustomMF_SI_SO(StringRef name, ElementFuncT element_fn)
       : CustomMF_SI_SO(name, CustomMF_SI_SO::create_function(element_fn))
   {
+    element_kernel_ = [=](const int64_t amount, const In1 *in1, Out1 *out1) {
+      for (int64_t i = 0; i < amount; i++) {
+        new (static_cast<void *>(&out1[i])) Out1(element_fn(in1[i]));
+      }
+    };
   }
 
   template<typename ElementFuncT> static FunctionT create_function(ElementFuncT element_fn)
@@ -75,6 +82,18 @@ template<typename In1, typename Out1> class CustomMF_SI_SO : public MultiFunctio
     MutableSpan<Out1> out1 = params.uninitialized_single_output<Out1>(1);
     function_(mask, in1, out1);
   }
+
+  bool has_element_kernel() const override
+  {
+    return bool(element_kernel_);
+  }
+
+  void call_element_kernel(const int64_t amount,
+                           Span<const void *> inputs,
+                           Span<void *> outputs) const override
+  {
+    element_kernel_(amount, static_cast<const In1 *>(inputs[0]), static_cast<Out1 *>(outputs[0]));
+  }
 };
 
 /**
@@ -88,7 +107,9 @@ class CustomMF_SI_SI_SO : public MultiFunction {
  private:
   using FunctionT =
       std::function<void(IndexMask, const VArray<In1> &, const VArray<In2> &, MutableSpan<Out1>)>;
+  using ElementKernelT = std::function<void(int64_t, const In1 *, const In2 *, Out1 *)>;
   FunctionT function_;
+  ElementKernelT element_kernel_;
   MFSignature signature_;
 
  public:
@@ -106,6 +127,11 @@ class CustomMF_SI_SI_SO : public MultiFunction {
   CustomMF_SI_SI_SO(StringRef name, ElementFuncT element_fn)
       : CustomMF_SI_SI_SO(name, CustomMF_SI_SI_SO::create_function(element_fn))
   {
+    element_kernel_ = [=](const int64_t amount, const In1 *in1, const In2 *in2, Out1 *out1) {
+      for (int64_t i = 0; i < amount; i++) {
+        new (static_cast<void *>(&out1[i])) Out1(element_fn(in1[i], in2[i]));
+      }
+    };
   }
 
   template<typename ElementFuncT> static FunctionT create_function(ElementFuncT element_fn)
@@ -129,6 +155,21 @@ class CustomMF_SI_SI_SO : public MultiFunction {
     MutableSpan<Out1> out1 = params.uninitialized_single_output<Out1>(2);
     function_(mask, in1, in2, out1);
   }
+
+  bool has_element_kernel() const override
+  {
+    return bool(element_kernel_);
+  }
+
+  void call_element_kernel(const int64_t amount,
+                           Span<const void *> inputs,
+                           Span<void *> outputs) const override
+  {
+    element_kernel_(amount,
+                    static_cast<const In1 *>(inputs[0]),
+                    static_cast<const In2 *>(inputs[1]),
+                    static_cast<Out1 *>(outputs[0]));
+  }
 };
 
 /**
@@ -146,7 +187,10 @@ class CustomMF_SI_SI_SI_SO : public MultiFunction {
                                        const VArray<In2> &,
                                        const VArray<In3> &,
                                        MutableSpan<Out1>)>;
+  using ElementKernelT =
+      std::function<void(int64_t, const In1 *, const In2 *, const In3 *, Out1 *)>;
   FunctionT function_;
+  ElementKernelT element_kernel_;
   MFSignature signature_;
 
  public:
@@ -165,6 +209,12 @@ class CustomMF_SI_SI_SI_SO : public MultiFunction {
   CustomMF_SI_SI_SI_SO(StringRef name, ElementFuncT element_fn)
       : CustomMF_SI_SI_SI_SO(name, CustomMF_SI_SI_SI_SO::create_function(element_fn))
   {
+    element_kernel_ =
+        [=](const int64_t amount, const In1 *in1, const In2 *in2, const In3 *in3, Out1 *out1) {
+          for (int64_t i = 0; i < amount; i++) {
+            new (static_cast<void *>(&out1[i])) Out1(element_fn(in1[i], in2[i], in3[i]));
+          }
+        };
   }
 
   template<typename ElementFuncT> static FunctionT create_function(ElementFuncT element_fn)
@@ -188,6 +238,22 @@ class CustomMF_SI_SI_SI_SO : public MultiFunction {
     MutableSpan<Out1> out1 = params.uninitialized_single_output<Out1>(3);
     function_(mask, in1, in2, in3, out1);
   }
+
+  bool has_element_kernel() const override
+  {
+    return bool(element_kernel_);
+  }
+
+  void call_element_kernel(const int64_t amount,
+                           Span<const void *> inputs,
+                           Span<void *> outputs) const override
+  {
+    element_kernel_(amount,
+                    static_cast<const In1 *>(inputs[0]),
+                    static_cast<const In2 *>(inputs[1]),
+                    static_cast<const In3 *>(inputs[2]),
+                    static_cast<Out1 *>(outputs[0]));
+  }
 };
 
 /**
@@ -207,7 +273,10 @@ class CustomMF_SI_SI_SI_SI_SO : public MultiFunction {
                                        const VArray<In3> &,
                                        const VArray<In4> &,
                                        MutableSpan<Out1>)>;
+  using ElementKernelT =
+      std::function<void(int64_t, const In1 *, const In2 *, const In3 *, const In4 *, Out1 *)>;
   FunctionT function_;
+  ElementKernelT element_kernel_;
   MFSignature signature_;
 
  public:
@@ -227,6 +296,16 @@ class CustomMF_SI_SI_SI_SI_SO : public MultiFunction {
   CustomMF_SI_SI_SI_SI_SO(StringRef name, ElementFuncT element_fn)
       : CustomMF_SI_SI_SI_SI_SO(name, CustomMF_SI_SI_SI_SI_SO::create_function(element_fn))
   {
+    element_kernel_ = [=](const int64_t amount,
+                          const In1 *in1,
+                          const In2 *in2,
+                          const In3 *in3,
+                          const In4 *in4,
+                          Out1 *out1) {
+      for (int64_t i = 0; i < amount; i++) {
+        new (static_cast<void *>(&out1[i])) Out1(element_fn(in1[i], in2[i], in3[i], in4[i]));
+      }
+    };
   }
 
   template<typename ElementFuncT> static FunctionT create_function(ElementFuncT element_fn)
@@ -252,6 +331,23 @@ class CustomMF_SI_SI_SI_SI_SO : public MultiFunction {
     MutableSpan<Out1> out1 = params.uninitialized_single_output<Out1>(4);
     function_(mask, in1, in2, in3, in4, out1);
   }
+
+  bool has_element_kernel() const override
+  {
+    return bool(element_kernel_);
+  }
+
+  void call_element_kernel(const int64_t amount,
+                           Span<const void *> inputs,
+                           Span<void *> outputs) const override
+  {
+    element_kernel_(amount,
+                    static_cast<const In1 *>(inputs[0]),
+                    static_cast<const In2 *>(inputs[1]),
+                    static_cast<const In3 *>(inputs[2]),
+                    static_cast<const In4 *>(inputs[3]),
+                    static_cast<Out1 *>(outputs[0]));
+  }
 };
 
 /**
@@ -322,6 +418,22 @@ template<typename From, typename To> class CustomMF_Convert : public MultiFuncti
       new (static_cast<void *>(&outputs[i])) To(inputs[i]);
     }
   }
+
+  bool has_element_kernel() const override
+  {
+    return true;
+  }
+
+  void call_element_kernel(const int64_t amount,
+                           Span<const void *> inputs,
+                           Span<void *> outputs) const override
+  {
+    const From *from = static_cast<const From *>(inputs[0]);
+    To *to = static_cast<To *>(outputs[0]);
+    for (int64_t i = 0; i < amount; i++) {
+      new (static_cast<void *>(&to[i])) To(from[i]);
+    }
+  }
 };
 
 /**
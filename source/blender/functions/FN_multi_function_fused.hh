@@ -0,0 +1,63 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+/** \file
+ * \ingroup fn
+ *
+ * A #FusedMultiFunction evaluates a tree of functions that have an element kernel (see
+ * #MultiFunction::has_element_kernel) in a single loop. The indices are processed in small blocks,
+ * so that all intermediate values of a block stay in the L1 cache. That avoids the overhead of
+ * calling every function separately with its own buffers, and the kernels of simple functions are
+ * vectorized by the compiler.
+ */
+
+#include "FN_multi_function.hh"
+
+namespace blender::fn {
+
+class FusedMultiFunction : public MultiFunction {
+ public:
+  /**
+   * A call of one of the fused functions. Values are referenced by register indices. The inputs
+   * of the fused function are the first registers, followed by the outputs of all steps.
+   */
+  struct Step {
+    const MultiFunction *fn;
+    Vector<int> input_registers;
+  };
+
+ private:
+  Vector<Step> steps_;
+  Vector<const CPPType *> register_types_;
+  int input_amount_;
+  /** Number of indices that are evaluated at once. */
+  int64_t block_size_;
+  MFSignature signature_;
+
+ public:
+  /**
+   * \param steps: Functions with an element kernel and a single output. A step may only use
+   * registers of the inputs and of earlier steps. The output of the last step is the output of
+   * the fused function.
+   */
+  FusedMultiFunction(std::string name, Span<const CPPType *> input_types, Vector<Step> steps);
+
+  void call(IndexMask mask, MFParams params, MFContext context) const override;
+};
+
+}  // namespace blender::fn
@@ -24,16 +24,35 @@
 
 namespace blender::fn {
 
-/** A multi-function that executes a procedure internally. */
+/**
+ * A multi-function that executes a procedure internally.
+ *
+ * Large masks are split into chunks that are small enough for all intermediate values of the
+ * procedure to stay in the CPU cache. The entire procedure is executed for one chunk before
+ * moving on to the next, and chunks are evaluated in parallel. Without chunking, every instruction
+ * is executed for the full mask first, which streams every intermediate buffer through memory.
+ */
 class MFProcedureExecutor : public MultiFunction {
  private:
   MFSignature signature_;
   const MFProcedure &procedure_;
+  /** Maximum number of indices evaluated at once. Zero when chunking is disabled. */
+  int64_t chunk_size_ = 0;
 
  public:
   MFProcedureExecutor(std::string name, const MFProcedure &procedure);
 
   void call(IndexMask mask, MFParams params, MFContext context) const override;
+
+  int64_t chunk_size() const;
+  /**
+   * Change the number of indices that are evaluated at once. Zero disables chunking. By default,
+   * it is derived from the memory used by the variables of the procedure per index.
+   */
+  void set_chunk_size(int64_t chunk_size);
+
+ private:
+  void call_chunked(IndexMask full_mask, MFParams params, MFContext context) const;
 };
 
 }  // namespace blender::fn
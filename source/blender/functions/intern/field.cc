@@ -21,7 +21,7 @@
 #include "BLI_vector_set.hh"
 
 #include "FN_field.hh"
-#include "FN_multi_function_parallel.hh"
+#include "FN_multi_function_fused.hh"
 
 namespace blender::fn {
 
@@ -139,13 +139,310 @@ static Set<GFieldRef> find_varying_fields(const FieldTreeInfo &field_tree_info,
   return found_fields;
 }
 
+/**
+ * Identifies the values computed by a #FieldOperation. Operations with the same key compute the
+ * same values, even when they are different nodes.
+ */
+struct OperationKey {
+  const MultiFunction *fn;
+  Span<GField> inputs;
+
+  uint64_t hash() const
+  {
+    uint64_t hash = fn->hash();
+    for (const GField &input : inputs) {
+      hash = hash * 33 ^ input.hash();
+    }
+    return hash;
+  }
+
+  friend bool operator==(const OperationKey &a, const OperationKey &b)
+  {
+    return (a.fn == b.fn || a.fn->equals(*b.fn)) && a.inputs == b.inputs;
+  }
+};
+
+/**
+ * Simplifies a field tree before it is converted into a procedure:
+ * - Constant sub-trees that are used by varying operations are evaluated once and replaced by a
+ *   single constant.
+ * - Operations that compute the same function on the same inputs are deduplicated, so that
+ *   sub-trees that are built multiple times (e.g. in node groups) are only evaluated once.
+ *
+ * Nodes that don't change are reused, so the optimized tree references the original nodes where
+ * possible. New nodes are owned by the optimizer, so it has to outlive the evaluation.
+ */
+class FieldTreeOptimizer {
+ private:
+  /** Shared pointers of all nodes that may be used as input of new operations. */
+  Map<const FieldNode *, std::shared_ptr<FieldNode>> shared_nodes_;
+  /** The node that replaces every varying operation. */
+  Map<const FieldNode *, const FieldNode *> optimized_nodes_;
+  /** The first node that has been found for every distinct operation. */
+  Map<OperationKey, const FieldNode *> node_by_key_;
+  /** Deduplicated and folded constants by the field they replace. */
+  Map<GFieldRef, GField> constant_fields_;
+
+ public:
+  Vector<GFieldRef> optimize(Span<GFieldRef> fields)
+  {
+    /* Find all varying operations, with the inputs of an operation before the operation itself.
+     * Constant sub-trees are not traversed, because they are replaced as a whole. */
+    Vector<const FieldOperation *> sorted_operations;
+    Set<const FieldNode *> handled_nodes;
+    struct NodeWithIndex {
+      const FieldOperation *operation;
+      int current_input_index = 0;
+    };
+    Stack<NodeWithIndex> nodes_to_check;
+    for (const GFieldRef &field : fields) {
+      if (is_varying_operation(field.node()) && handled_nodes.add(&field.node())) {
+        nodes_to_check.push({static_cast<const FieldOperation *>(&field.node())});
+      }
+      while (!nodes_to_check.is_empty()) {
+        NodeWithIndex &node_with_index = nodes_to_check.peek();
+        const Span<GField> inputs = node_with_index.operation->inputs();
+        if (node_with_index.current_input_index == inputs.size()) {
+          sorted_operations.append(node_with_index.operation);
+          nodes_to_check.pop();
+          continue;
+        }
+        const GField &input = inputs[node_with_index.current_input_index];
+        node_with_index.current_input_index++;
+        shared_nodes_.add(&input.node(), input.node_ptr());
+        if (is_varying_operation(input.node()) && handled_nodes.add(&input.node())) {
+          nodes_to_check.push({static_cast<const FieldOperation *>(&input.node())});
+        }
+      }
+    }
+
+    /* Operations that are only referenced by the given fields can't be used as input of new
+     * nodes, because there is no shared pointer to them. Handle them last, so that they never
+     * replace an operation that is used as an input. */
+    for (const bool is_used_as_input : {true, false}) {
+      for (const FieldOperation *operation : sorted_operations) {
+        if (shared_nodes_.contains(operation) == is_used_as_input) {
+          this->optimize_operation(*operation);
+        }
+      }
+    }
+
+    Vector<GFieldRef> optimized_fields;
+    for (const GFieldRef &field : fields) {
+      if (is_varying_operation(field.node())) {
+        optimized_fields.append(
+            {*optimized_nodes_.lookup(&field.node()), field.node_output_index()});
+      }
+      else {
+        /* Constant outputs are evaluated separately anyway. */
+        optimized_fields.append(field);
+      }
+    }
+    return optimized_fields;
+  }
+
+ private:
+  static bool is_varying_operation(const FieldNode &node)
+  {
+    return node.is_operation() && node.depends_on_input();
+  }
+
+  void optimize_operation(const FieldOperation &operation)
+  {
+    Vector<GField> inputs;
+    bool inputs_changed = false;
+    for (const GField &input : operation.inputs()) {
+      GField new_input = this->optimize_input(input);
+      inputs_changed |= &new_input.node() != &input.node();
+      inputs.append(std::move(new_input));
+    }
+
+    const MultiFunction &fn = operation.multi_function();
+    if (const FieldNode *const *existing_node = node_by_key_.lookup_ptr({&fn, inputs})) {
+      optimized_nodes_.add_new(&operation, *existing_node);
+      return;
+    }
+    const FieldOperation *new_operation = &operation;
+    if (inputs_changed) {
+      auto node = std::make_shared<FieldOperation>(fn, std::move(inputs));
+      new_operation = node.get();
+      shared_nodes_.add_new(new_operation, std::move(node));
+    }
+    node_by_key_.add_new({&fn, new_operation->inputs()}, new_operation);
+    optimized_nodes_.add_new(&operation, new_operation);
+  }
+
+  GField optimize_input(const GField &input)
+  {
+    if (input.node().is_input()) {
+      return input;
+    }
+    if (input.node().depends_on_input()) {
+      /* The operation has been optimized already, because inputs are handled first. */
+      const FieldNode *node = optimized_nodes_.lookup(&input.node());
+      if (node == &input.node()) {
+        return input;
+      }
+      return {shared_nodes_.lookup(node), input.node_output_index()};
+    }
+    return constant_fields_.lookup_or_add_cb(input, [&]() {
+      const FieldOperation &operation = static_cast<const FieldOperation &>(input.node());
+      /* Operations without inputs don't have to be evaluated to be constant. */
+      GField constant_field = operation.inputs().is_empty() ?
+                                  input :
+                                  make_field_constant_if_possible(input);
+      const FieldOperation &constant_operation = static_cast<const FieldOperation &>(
+          constant_field.node());
+      const OperationKey key{&constant_operation.multi_function(), {}};
+      if (const FieldNode *const *existing_node = node_by_key_.lookup_ptr(key)) {
+        return GField{shared_nodes_.lookup(*existing_node), constant_field.node_output_index()};
+      }
+      node_by_key_.add_new(key, &constant_operation);
+      shared_nodes_.add(&constant_operation, constant_field.node_ptr());
+      return constant_field;
+    });
+  }
+};
+
+/**
+ * A tree of element-wise operations that is evaluated by a single #FusedMultiFunction.
+ */
+struct FusedOperations {
+  const MultiFunction *fn;
+  /** Fields that are passed into the fused function. */
+  Vector<GField> inputs;
+};
+
+static bool is_fusable_field(const GFieldRef &field, const Set<GFieldRef> &varying_fields)
+{
+  if (!field.node().is_operation()) {
+    return false;
+  }
+  const FieldOperation &operation = static_cast<const FieldOperation &>(field.node());
+  /* Constant fields are better computed only once by the procedure executor. */
+  return operation.multi_function().has_element_kernel() && varying_fields.contains(field);
+}
+
+/**
+ * \return True when the field is only used by a single fusable operation, so that it can be
+ * computed in the same loop as that operation without storing it for all indices.
+ */
+static bool is_fused_into_user(const GFieldRef &field,
+                               const FieldTreeInfo &field_tree_info,
+                               const Set<GFieldRef> &varying_fields,
+                               Span<GFieldRef> output_fields)
+{
+  if (!is_fusable_field(field, varying_fields) || output_fields.contains(field)) {
+    return false;
+  }
+  const Span<GFieldRef> users = field_tree_info.field_users.lookup(field);
+  if (users.is_empty()) {
+    return false;
+  }
+  for (const GFieldRef &user : users) {
+    if (user != users[0]) {
+      return false;
+    }
+  }
+  return is_fusable_field(users[0], varying_fields);
+}
+
+struct OperationFuser {
+  const FieldTreeInfo &field_tree_info;
+  const Set<GFieldRef> &varying_fields;
+  Span<GFieldRef> output_fields;
+
+  Vector<GField> inputs;
+  Vector<FusedMultiFunction::Step> steps;
+  /** Input registers are encoded as negative numbers until the number of inputs is known. */
+  Map<GFieldRef, int> register_by_field;
+
+  int add_input(const GField &field)
+  {
+    if (const int *register_index = register_by_field.lookup_ptr(field)) {
+      return *register_index;
+    }
+    int register_index;
+    if (is_fused_into_user(field, field_tree_info, varying_fields, output_fields)) {
+      register_index = this->add_operation(static_cast<const FieldOperation &>(field.node()));
+    }
+    else {
+      register_index = -1 - inputs.size();
+      inputs.append(field);
+    }
+    register_by_field.add_new(field, register_index);
+    return register_index;
+  }
+
+  int add_operation(const FieldOperation &operation)
+  {
+    Vector<int> input_registers;
+    for (const GField &input_field : operation.inputs()) {
+      input_registers.append(this->add_input(input_field));
+    }
+    steps.append({&operation.multi_function(), std::move(input_registers)});
+    return steps.size() - 1;
+  }
+};
+
+/**
+ * Find trees of operations with element kernels that can be evaluated in a single loop. That
+ * avoids writing every intermediate value to memory for all indices.
+ *
+ * \return The fused operations by the field that they compute.
+ */
+static Map<GFieldRef, FusedOperations> fuse_operations(ResourceScope &scope,
+                                                       const FieldTreeInfo &field_tree_info,
+                                                       const Set<GFieldRef> &varying_fields,
+                                                       Span<GFieldRef> output_fields)
+{
+  /* Every operation is either an output or used by another field. */
+  VectorSet<GFieldRef> fields;
+  fields.add_multiple(output_fields);
+  for (const GFieldRef &field : field_tree_info.field_users.keys()) {
+    fields.add(field);
+  }
+
+  Map<GFieldRef, FusedOperations> fused_operations;
+  for (const GFieldRef &field : fields) {
+    if (!is_fusable_field(field, varying_fields) ||
+        is_fused_into_user(field, field_tree_info, varying_fields, output_fields)) {
+      continue;
+    }
+    OperationFuser fuser{field_tree_info, varying_fields, output_fields};
+    fuser.add_operation(static_cast<const FieldOperation &>(field.node()));
+    if (fuser.steps.size() < 2) {
+      continue;
+    }
+
+    /* Now that all inputs are known, the registers of the steps can be finalized. */
+    const int input_amount = fuser.inputs.size();
+    for (FusedMultiFunction::Step &step : fuser.steps) {
+      for (int &register_index : step.input_registers) {
+        register_index = (register_index < 0) ? -1 - register_index :
+                                                input_amount + register_index;
+      }
+    }
+    Vector<const CPPType *> input_types;
+    for (const GField &input : fuser.inputs) {
+      input_types.append(&input.cpp_type());
+    }
+    const MultiFunction &fn = scope.construct<FusedMultiFunction>(
+        "Fused", input_types, std::move(fuser.steps));
+    fused_operations.add_new(field, {&fn, std::move(fuser.inputs)});
+  }
+  return fused_operations;
+}
+
 /**
  * Builds the #procedure so that it computes the the fields.
  */
 static void build_multi_function_procedure_for_fields(MFProcedure &procedure,
                                                       ResourceScope &scope,
                                                       const FieldTreeInfo &field_tree_info,
-                                                      Span<GFieldRef> output_fields)
+                                                      Span<GFieldRef> output_fields,
+                                                      const Map<GFieldRef, FusedOperations>
+                                                          &fused_operations)
 {
   MFProcedureBuilder builder{procedure};
   /* Every input, intermediate and output field corresponds to a variable in the procedure. */
@@ -181,7 +478,9 @@ static void build_multi_function_procedure_for_fields(MFProcedure &procedure,
       BLI_assert(field.node().is_operation());
 
       const FieldOperation &operation = static_cast<const FieldOperation &>(field.node());
-      const Span<GField> operation_inputs = operation.inputs();
+      /* Fused operations are evaluated by one function that gets the inputs of the entire tree. */
+      const FusedOperations *fused = fused_operations.lookup_ptr(field);
+      const Span<GField> operation_inputs = fused ? fused->inputs.as_span() : operation.inputs();
 
       if (field_with_index.current_input_index < operation_inputs.size()) {
         /* Not all inputs are handled yet. Push the next input field to the stack and increment the
@@ -192,7 +491,7 @@ static void build_multi_function_procedure_for_fields(MFProcedure &procedure,
       else {
         /* All inputs variables are ready, now gather all variables that are used by the function
          * and call it. */
-        const MultiFunction &multi_function = operation.multi_function();
+        const MultiFunction &multi_function = fused ? *fused->fn : operation.multi_function();
         Vector<MFVariable *> variables(multi_function.param_amount());
 
         int param_input_index = 0;
@@ -310,8 +609,13 @@ Vector<const GVArray *> evaluate_fields(ResourceScope &scope,
     return dst_varrays[index];
   };
 
+  /* Deduplicate operations and fold constants before the procedure is built. The optimizer owns
+   * new nodes, so it has to be alive until the evaluation is done. */
+  FieldTreeOptimizer optimizer;
+  const Vector<GFieldRef> optimized_fields = optimizer.optimize(fields_to_evaluate);
+
   /* Traverse the field tree and prepare some data that is used in later steps. */
-  FieldTreeInfo field_tree_info = preprocess_field_tree(fields_to_evaluate);
+  FieldTreeInfo field_tree_info = preprocess_field_tree(optimized_fields);
 
   /* Get inputs that will be passed into the field when evaluated. */
   Vector<const GVArray *> field_context_inputs = get_field_context_inputs(
@@ -319,8 +623,8 @@ Vector<const GVArray *> evaluate_fields(ResourceScope &scope,
 
   /* Finish fields that output an input varray directly. For those we don't have to do any further
    * processing. */
-  for (const int out_index : fields_to_evaluate.index_range()) {
-    const GFieldRef &field = fields_to_evaluate[out_index];
+  for (const int out_index : optimized_fields.index_range()) {
+    const GFieldRef &field = optimized_fields[out_index];
     if (!field.node().is_input()) {
       continue;
     }
@@ -338,12 +642,12 @@ Vector<const GVArray *> evaluate_fields(ResourceScope &scope,
   Vector<int> varying_field_indices;
   Vector<GFieldRef> constant_fields_to_evaluate;
   Vector<int> constant_field_indices;
-  for (const int i : fields_to_evaluate.index_range()) {
+  for (const int i : optimized_fields.index_range()) {
     if (r_varrays[i] != nullptr) {
       /* Already done. */
       continue;
     }
-    GFieldRef field = fields_to_evaluate[i];
+    GFieldRef field = optimized_fields[i];
     if (varying_fields.contains(field)) {
       varying_fields_to_evaluate.append(field);
       varying_field_indices.append(i);
@@ -357,15 +661,15 @@ Vector<const GVArray *> evaluate_fields(ResourceScope &scope,
   /* Evaluate varying fields if necessary. */
   if (!varying_fields_to_evaluate.is_empty()) {
     /* Build the procedure for those fields. */
+    const Map<GFieldRef, FusedOperations> fused_operations = fuse_operations(
+        scope, field_tree_info, varying_fields, varying_fields_to_evaluate);
     MFProcedure procedure;
     build_multi_function_procedure_for_fields(
-        procedure, scope, field_tree_info, varying_fields_to_evaluate);
+        procedure, scope, field_tree_info, varying_fields_to_evaluate, fused_operations);
+    /* The executor evaluates large masks in cache-sized chunks on multiple threads. */
     MFProcedureExecutor procedure_executor{"Procedure", procedure};
-    /* Add multi threading capabilities to the field evaluation. */
-    const int grain_size = 10000;
-    fn::ParallelMultiFunction parallel_procedure_executor{procedure_executor, grain_size};
     /* Utility variable to make easy to switch the executor. */
-    const MultiFunction &executor_fn = parallel_procedure_executor;
+    const MultiFunction &executor_fn = procedure_executor;
 
     MFParamsBuilder mf_params{executor_fn, &mask};
     MFContextBuilder mf_context;
@@ -416,7 +720,7 @@ Vector<const GVArray *> evaluate_fields(ResourceScope &scope,
     /* Build the procedure for those fields. */
     MFProcedure procedure;
     build_multi_function_procedure_for_fields(
-        procedure, scope, field_tree_info, constant_fields_to_evaluate);
+        procedure, scope, field_tree_info, constant_fields_to_evaluate, {});
     MFProcedureExecutor procedure_executor{"Procedure", procedure};
     MFParamsBuilder mf_params{procedure_executor, 1};
     MFContextBuilder mf_context;
@@ -453,7 +757,7 @@ Vector<const GVArray *> evaluate_fields(ResourceScope &scope,
   /* Copy data to supplied destination arrays if necessary. In some cases the evaluation above has
    * written the computed data in the right place already. */
   if (!dst_varrays.is_empty()) {
-    for (const int out_index : fields_to_evaluate.index_range()) {
+    for (const int out_index : optimized_fields.index_range()) {
       GVMutableArray *output_varray = get_dst_varray_if_available(out_index);
       if (output_varray == nullptr) {
         /* Caller did not provide a destination for this output. */
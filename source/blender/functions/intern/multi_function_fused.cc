@@ -0,0 +1,164 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "FN_multi_function_fused.hh"
+
+#include "BLI_array.hh"
+#include "BLI_linear_allocator.hh"
+
+namespace blender::fn {
+
+/** Approximate amount of memory used by the registers of one block. */
+static constexpr int64_t block_memory_budget = 16 * 1024;
+
+FusedMultiFunction::FusedMultiFunction(std::string name,
+                                       Span<const CPPType *> input_types,
+                                       Vector<Step> steps)
+    : steps_(std::move(steps)), register_types_(input_types), input_amount_(input_types.size())
+{
+  BLI_assert(!steps_.is_empty());
+
+  MFSignatureBuilder signature{std::move(name)};
+  for (const int i : input_types.index_range()) {
+    signature.single_input("In" + std::to_string(i), *input_types[i]);
+  }
+
+  for (const Step &step : steps_) {
+    BLI_assert(step.fn->has_element_kernel());
+    for (const int param_index : step.fn->param_indices()) {
+      const MFParamType param_type = step.fn->param_type(param_index);
+      if (param_type.category() == MFParamType::SingleOutput) {
+        register_types_.append(&param_type.data_type().single_type());
+      }
+      else {
+        BLI_assert(param_type.category() == MFParamType::SingleInput);
+        BLI_assert(step.input_registers[param_index] < register_types_.size());
+      }
+    }
+    BLI_assert(register_types_.size() == input_amount_ + (&step - steps_.begin()) + 1);
+  }
+  signature.single_output("Out", *register_types_.last());
+
+  signature_ = signature.build();
+  this->set_signature(&signature_);
+
+  int64_t bytes_per_index = 0;
+  for (const CPPType *type : register_types_) {
+    bytes_per_index += type->size();
+  }
+  block_size_ = std::clamp<int64_t>(block_memory_budget / bytes_per_index, 32, 1024);
+}
+
+void FusedMultiFunction::call(IndexMask mask, MFParams params, MFContext UNUSED(context)) const
+{
+  if (mask.is_empty()) {
+    return;
+  }
+  const int register_amount = register_types_.size();
+  const int output_register = register_amount - 1;
+  const CPPType &output_type = *register_types_[output_register];
+  GMutableSpan output = params.uninitialized_single_output(input_amount_);
+
+  /* Every register has a buffer for one block. It is only used when the values can't be
+   * referenced directly in the input or output arrays. */
+  const int64_t block_size = std::min(block_size_, mask.size());
+  LinearAllocator<> allocator;
+  Array<void *> buffers(register_amount);
+  for (const int i : IndexRange(register_amount)) {
+    const CPPType &type = *register_types_[i];
+    buffers[i] = allocator.allocate(type.size() * block_size, type.alignment());
+  }
+
+  Array<const GVArray *> inputs(input_amount_);
+  for (const int i : IndexRange(input_amount_)) {
+    inputs[i] = &params.readonly_single_input(i);
+    if (inputs[i]->is_single()) {
+      /* Constant inputs are the same in every block. */
+      const CPPType &type = *register_types_[i];
+      inputs[i]->get_internal_single_to_uninitialized(buffers[i]);
+      type.fill_construct_n(buffers[i], POINTER_OFFSET(buffers[i], type.size()), block_size - 1);
+    }
+  }
+
+  Array<const void *> registers(register_amount);
+  Vector<const void *, 4> step_inputs;
+
+  for (int64_t block_start = 0; block_start < mask.size(); block_start += block_size) {
+    const int64_t amount = std::min(block_size, mask.size() - block_start);
+    const IndexMask block_mask = mask.indices().slice(block_start, amount);
+    /* When the indices are contiguous, inputs and outputs are accessed in place. */
+    const bool is_contiguous = block_mask.is_range();
+    const int64_t first_index = block_mask[0];
+
+    for (const int i : IndexRange(input_amount_)) {
+      const GVArray &varray = *inputs[i];
+      const CPPType &type = *register_types_[i];
+      if (varray.is_single()) {
+        registers[i] = buffers[i];
+      }
+      else if (is_contiguous && varray.is_span()) {
+        registers[i] = POINTER_OFFSET(varray.get_internal_span().data(),
+                                      type.size() * first_index);
+      }
+      else {
+        for (const int64_t j : block_mask.index_range()) {
+          varray.get_to_uninitialized(block_mask[j], POINTER_OFFSET(buffers[i], type.size() * j));
+        }
+        registers[i] = buffers[i];
+      }
+    }
+
+    for (const int step_index : steps_.index_range()) {
+      const Step &step = steps_[step_index];
+      const int register_index = input_amount_ + step_index;
+      void *step_output = buffers[register_index];
+      if (register_index == output_register && is_contiguous) {
+        step_output = POINTER_OFFSET(output.data(), output_type.size() * first_index);
+      }
+      step_inputs.clear();
+      for (const int input_register : step.input_registers) {
+        step_inputs.append(registers[input_register]);
+      }
+      step.fn->call_element_kernel(amount, step_inputs, {&step_output, 1});
+      registers[register_index] = step_output;
+    }
+
+    /* Destruct the values that are not needed anymore. */
+    for (const int i : IndexRange(input_amount_)) {
+      if (registers[i] == buffers[i] && !inputs[i]->is_single()) {
+        register_types_[i]->destruct_n(buffers[i], amount);
+      }
+    }
+    for (const int i : IndexRange(input_amount_, steps_.size() - 1)) {
+      register_types_[i]->destruct_n(buffers[i], amount);
+    }
+    if (!is_contiguous) {
+      for (const int64_t j : block_mask.index_range()) {
+        output_type.relocate_construct(
+            POINTER_OFFSET(buffers[output_register], output_type.size() * j),
+            POINTER_OFFSET(output.data(), output_type.size() * block_mask[j]));
+      }
+    }
+  }
+
+  for (const int i : IndexRange(input_amount_)) {
+    if (inputs[i]->is_single()) {
+      register_types_[i]->destruct_n(buffers[i], block_size);
+    }
+  }
+}
+
+}  // namespace blender::fn
@@ -14,23 +14,79 @@
  * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
  */
 
+#include "FN_generic_virtual_array.hh"
 #include "FN_multi_function_procedure_executor.hh"
 
+#include "BLI_enumerable_thread_specific.hh"
 #include "BLI_stack.hh"
+#include "BLI_task.hh"
 
 namespace blender::fn {
 
+/**
+ * Approximate amount of memory that the variables of one chunk may use. Since not all variables
+ * are alive at the same time, the intermediate values of a chunk usually fit into the L2 cache of
+ * typical CPUs. Chunks should not be much smaller than the lower limit, because evaluating a
+ * procedure has some overhead per instruction that has to be amortized over many indices.
+ */
+static constexpr int64_t chunk_memory_budget = 1024 * 1024;
+static constexpr int64_t min_chunk_size = 4096;
+static constexpr int64_t max_chunk_size = 32768;
+
+static int64_t default_chunk_size(const MFProcedure &procedure)
+{
+  int64_t bytes_per_index = 0;
+  for (const MFVariable *variable : procedure.variables()) {
+    const MFDataType data_type = variable->data_type();
+    switch (data_type.category()) {
+      case MFDataType::Single: {
+        bytes_per_index += data_type.single_type().size();
+        break;
+      }
+      case MFDataType::Vector: {
+        /* The size of vectors is unknown, assume that they are small. */
+        bytes_per_index += 4 * data_type.vector_base_type().size();
+        break;
+      }
+    }
+  }
+  if (bytes_per_index == 0) {
+    return max_chunk_size;
+  }
+  return std::clamp(chunk_memory_budget / bytes_per_index, min_chunk_size, max_chunk_size);
+}
+
 MFProcedureExecutor::MFProcedureExecutor(std::string name, const MFProcedure &procedure)
     : procedure_(procedure)
 {
   MFSignatureBuilder signature(std::move(name));
 
+  bool chunking_supported = true;
   for (const ConstMFParameter &param : procedure.params()) {
     signature.add(param.variable->name(), MFParamType(param.type, param.variable->data_type()));
+    if (param.variable->data_type().category() == MFDataType::Vector) {
+      /* Vector parameters can't be sliced yet. */
+      chunking_supported = false;
+    }
   }
 
   signature_ = signature.build();
   this->set_signature(&signature_);
+
+  if (chunking_supported) {
+    chunk_size_ = default_chunk_size(procedure);
+  }
+}
+
+int64_t MFProcedureExecutor::chunk_size() const
+{
+  return chunk_size_;
+}
+
+void MFProcedureExecutor::set_chunk_size(const int64_t chunk_size)
+{
+  BLI_assert(chunk_size >= 0);
+  chunk_size_ = chunk_size;
 }
 
 using IndicesSplitVectors = std::array<Vector<int64_t>, 2>;
@@ -149,9 +205,15 @@ class ValueAllocator : NonCopyable, NonMovable {
   /* The integer key is the size of one element (e.g. 4 for an integer buffer). All buffers are
    * aligned to #min_alignment bytes. */
   Map<int, Stack<void *>> span_buffers_free_list_;
+  /* Minimum number of elements in span buffers. When this is larger than the requested sizes,
+   * buffers can be reused for differently sized masks. */
+  int64_t min_span_buffer_size_;
 
  public:
-  ValueAllocator() = default;
+  ValueAllocator(const int64_t min_span_buffer_size = 0)
+      : min_span_buffer_size_(min_span_buffer_size)
+  {
+  }
 
   ~ValueAllocator()
   {
@@ -192,15 +254,18 @@ class ValueAllocator : NonCopyable, NonMovable {
 
     const int element_size = type.size();
     const int alignment = type.alignment();
+    /* All buffers that can be reused must have the same size. */
+    BLI_assert(min_span_buffer_size_ == 0 || size <= min_span_buffer_size_);
+    const int64_t buffer_size = std::max<int64_t>(size, min_span_buffer_size_);
 
     if (alignment > min_alignment) {
       /* In this rare case we fallback to not reusing existing buffers. */
-      buffer = MEM_mallocN_aligned(element_size * size, alignment, __func__);
+      buffer = MEM_mallocN_aligned(element_size * buffer_size, alignment, __func__);
     }
     else {
       Stack<void *> *stack = span_buffers_free_list_.lookup_ptr(element_size);
       if (stack == nullptr || stack->is_empty()) {
-        buffer = MEM_mallocN_aligned(element_size * size, min_alignment, __func__);
+        buffer = MEM_mallocN_aligned(element_size * buffer_size, min_alignment, __func__);
       }
       else {
         /* Reuse existing buffer. */
@@ -812,12 +877,13 @@ void ValueAllocator::release_variable_state(VariableState *state)
 /** Keeps track of the states of all variables during evaluation. */
 class VariableStates {
  private:
-  ValueAllocator value_allocator_;
+  ValueAllocator &value_allocator_;
   Map<const MFVariable *, VariableState *> variable_states_;
   IndexMask full_mask_;
 
  public:
-  VariableStates(IndexMask full_mask) : full_mask_(full_mask)
+  VariableStates(ValueAllocator &value_allocator, IndexMask full_mask)
+      : value_allocator_(value_allocator), full_mask_(full_mask)
   {
   }
 
@@ -1145,17 +1211,18 @@ class InstructionScheduler {
   }
 };
 
-void MFProcedureExecutor::call(IndexMask full_mask, MFParams params, MFContext context) const
+static void execute_procedure(const MFProcedureExecutor &fn,
+                              const MFProcedure &procedure,
+                              IndexMask full_mask,
+                              MFParams params,
+                              MFContext context,
+                              ValueAllocator &value_allocator)
 {
-  BLI_assert(procedure_.validate());
-
-  LinearAllocator<> allocator;
-
-  VariableStates variable_states{full_mask};
-  variable_states.add_initial_variable_states(*this, procedure_, params);
+  VariableStates variable_states{value_allocator, full_mask};
+  variable_states.add_initial_variable_states(fn, procedure, params);
 
   InstructionScheduler scheduler;
-  scheduler.add_referenced_indices(*procedure_.entry(), full_mask);
+  scheduler.add_referenced_indices(*procedure.entry(), full_mask);
 
   /* Loop until all indices got to a return instruction. */
   while (NextInstructionInfo instr_info = scheduler.pop_next()) {
@@ -1201,9 +1268,9 @@ void MFProcedureExecutor::call(IndexMask full_mask, MFParams params, MFContext c
     }
   }
 
-  for (const int param_index : this->param_indices()) {
-    const MFParamType param_type = this->param_type(param_index);
-    const MFVariable *variable = procedure_.params()[param_index].variable;
+  for (const int param_index : fn.param_indices()) {
+    const MFParamType param_type = fn.param_type(param_index);
+    const MFVariable *variable = procedure.params()[param_index].variable;
     VariableState &variable_state = variable_states.get_variable_state(*variable);
     switch (param_type.interface_type()) {
       case MFParamType::Input: {
@@ -1224,4 +1291,108 @@ void MFProcedureExecutor::call(IndexMask full_mask, MFParams params, MFContext c
   }
 }
 
+void MFProcedureExecutor::call(IndexMask full_mask, MFParams params, MFContext context) const
+{
+  BLI_assert(procedure_.validate());
+
+  if (chunk_size_ > 0 && full_mask.size() > chunk_size_) {
+    this->call_chunked(full_mask, params, context);
+    return;
+  }
+
+  ValueAllocator value_allocator;
+  execute_procedure(*this, procedure_, full_mask, params, context, value_allocator);
+}
+
+/**
+ * Split the mask into chunks whose indices are at most \a chunk_size apart, so that the buffers
+ * for the offset indices of every chunk have at most that size.
+ */
+static Vector<IndexRange> split_mask_into_chunks(const IndexMask mask, const int64_t chunk_size)
+{
+  Vector<IndexRange> chunks;
+  if (mask.is_range()) {
+    for (int64_t start = 0; start < mask.size(); start += chunk_size) {
+      chunks.append(IndexRange(start, std::min(chunk_size, mask.size() - start)));
+    }
+    return chunks;
+  }
+  const Span<int64_t> indices = mask.indices();
+  int64_t start = 0;
+  while (start < indices.size()) {
+    const int64_t *chunk_end = std::lower_bound(
+        indices.begin() + start, indices.end(), indices[start] + chunk_size);
+    const int64_t end = chunk_end - indices.begin();
+    chunks.append(IndexRange(start, end - start));
+    start = end;
+  }
+  return chunks;
+}
+
+void MFProcedureExecutor::call_chunked(IndexMask full_mask,
+                                       MFParams params,
+                                       MFContext context) const
+{
+  const Vector<IndexRange> chunks = split_mask_into_chunks(full_mask, chunk_size_);
+
+  /* Every thread reuses the same buffers for all the chunks it evaluates. When a chunk waits for
+   * nested parallel work, the thread may start evaluating another chunk, which is fine, because
+   * the allocator only hands out buffers that are not used currently. */
+  threading::EnumerableThreadSpecific<ValueAllocator> value_allocators(
+      [&]() { return ValueAllocator(chunk_size_); });
+
+  threading::parallel_for(chunks.index_range(), 1, [&](const IndexRange chunk_range) {
+    ValueAllocator &value_allocator = value_allocators.local();
+    for (const IndexRange mask_slice : chunks.as_span().slice(chunk_range)) {
+      Vector<int64_t> sub_mask_indices;
+      const IndexMask sub_mask = full_mask.slice_and_offset(mask_slice, sub_mask_indices);
+      const int64_t input_slice_start = full_mask[mask_slice.first()];
+      const int64_t input_slice_size = full_mask[mask_slice.last()] - input_slice_start + 1;
+      const IndexRange input_slice_range{input_slice_start, input_slice_size};
+
+      MFParamsBuilder sub_params{*this, sub_mask.min_array_size()};
+      ResourceScope &scope = sub_params.resource_scope();
+
+      /* All parameters are sliced so that the procedure only sees the indices of the chunk. */
+      for (const int param_index : this->param_indices()) {
+        const MFParamType param_type = this->param_type(param_index);
+        switch (param_type.category()) {
+          case MFParamType::SingleInput: {
+            const GVArray &varray = params.readonly_single_input(param_index);
+            const GVArray &sliced_varray = scope.construct<GVArray_Slice>(varray,
+                                                                          input_slice_range);
+            sub_params.add_readonly_single_input(sliced_varray);
+            break;
+          }
+          case MFParamType::SingleMutable: {
+            const GMutableSpan span = params.single_mutable(param_index);
+            sub_params.add_single_mutable(span.slice(input_slice_start, input_slice_size));
+            break;
+          }
+          case MFParamType::SingleOutput: {
+            /* Ignored outputs stay ignored, the outer params would allocate a temporary buffer
+             * for the whole mask, which isn't thread-safe. */
+            if (!params.single_output_is_required(param_index)) {
+              sub_params.add_ignored_single_output();
+              break;
+            }
+            const GMutableSpan span = params.uninitialized_single_output(param_index);
+            sub_params.add_uninitialized_single_output(
+                span.slice(input_slice_start, input_slice_size));
+            break;
+          }
+          case MFParamType::VectorInput:
+          case MFParamType::VectorMutable:
+          case MFParamType::VectorOutput: {
+            BLI_assert_unreachable();
+            break;
+          }
+        }
+      }
+
+      execute_procedure(*this, procedure_, sub_mask, sub_params, context, value_allocator);
+    }
+  });
+}
+
 }  // namespace blender::fn
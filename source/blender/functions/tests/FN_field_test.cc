@@ -291,4 +291,191 @@ TEST(field, IgnoredOutput)
   EXPECT_EQ(results->get(3), 5);
 }
 
+/**
+ * Forwards to another function and counts how often it is called on its own and how often its
+ * element kernel is called as part of a fused function.
+ */
+class CountingElementFunction : public MultiFunction {
+ private:
+  const MultiFunction &fn_;
+
+ public:
+  mutable int call_count = 0;
+  mutable int kernel_call_count = 0;
+
+  CountingElementFunction(const MultiFunction &fn) : fn_(fn)
+  {
+    BLI_assert(fn.has_element_kernel());
+    this->set_signature(&fn.signature());
+  }
+
+  void call(IndexMask mask, MFParams params, MFContext context) const override
+  {
+    fn_.call(mask, params, context);
+    call_count++;
+  }
+
+  bool has_element_kernel() const override
+  {
+    return true;
+  }
+
+  void call_element_kernel(const int64_t amount,
+                           Span<const void *> inputs,
+                           Span<void *> outputs) const override
+  {
+    fn_.call_element_kernel(amount, inputs, outputs);
+    kernel_call_count++;
+  }
+};
+
+TEST(field, FusedFunctions)
+{
+  GField index_field{std::make_shared<IndexFieldInput>()};
+
+  auto add_fn = std::make_shared<CustomMF_SI_SI_SO<int, int, int>>(
+      "add", [](int a, int b) { return a + b; });
+  auto mul_fn = std::make_shared<CustomMF_SI_SI_SO<int, int, int>>(
+      "mul", [](int a, int b) { return a * b; });
+  const CountingElementFunction sum_fn{*add_fn};
+  const CountingElementFunction square_fn{*mul_fn};
+  GField ten_field{std::make_shared<FieldOperation>(std::make_unique<CustomMF_Constant<int>>(10)),
+                   0};
+
+  /* The chain is evaluated in a fused loop. The squared field is used twice by the same
+   * operation, the sum field is used by two operations and is not fused. */
+  GField sum_field{
+      std::make_shared<FieldOperation>(sum_fn, Vector<GField>{index_field, ten_field}), 0};
+  GField squared_field{
+      std::make_shared<FieldOperation>(square_fn, Vector<GField>{sum_field, sum_field}), 0};
+  GField doubled_field{
+      std::make_shared<FieldOperation>(*add_fn, Vector<GField>{squared_field, squared_field}), 0};
+  GField result_field_1{
+      std::make_shared<FieldOperation>(*add_fn, Vector<GField>{doubled_field, ten_field}), 0};
+  GField result_field_2{
+      std::make_shared<FieldOperation>(*mul_fn, Vector<GField>{sum_field, ten_field}), 0};
+
+  Array<int> result_1(10);
+  Array<int> result_2(10);
+
+  const Array<int64_t> indices = {1, 2, 3, 5, 8};
+  const IndexMask mask{indices};
+
+  FieldContext context;
+  FieldEvaluator evaluator{context, &mask};
+  evaluator.add_with_destination(result_field_1, result_1.as_mutable_span());
+  evaluator.add_with_destination(result_field_2, result_2.as_mutable_span());
+  evaluator.evaluate();
+  EXPECT_EQ(result_1[1], 252);
+  EXPECT_EQ(result_1[2], 298);
+  EXPECT_EQ(result_1[8], 658);
+  EXPECT_EQ(result_2[1], 110);
+  EXPECT_EQ(result_2[8], 180);
+  /* The squared field is only computed by the fused function, all indices fit into one block. */
+  EXPECT_EQ(square_fn.call_count, 0);
+  EXPECT_EQ(square_fn.kernel_call_count, 1);
+  EXPECT_EQ(sum_fn.call_count, 1);
+  EXPECT_EQ(sum_fn.kernel_call_count, 0);
+}
+
+/**
+ * Adds two integers and counts how often it is called, which is once per call instruction in the
+ * procedure that evaluates a field.
+ */
+class CountingAddFunction : public MultiFunction {
+ public:
+  mutable int call_count = 0;
+
+  CountingAddFunction()
+  {
+    static MFSignature signature = []() {
+      MFSignatureBuilder signature("Counting Add");
+      signature.single_input<int>("A");
+      signature.single_input<int>("B");
+      signature.single_output<int>("Result");
+      return signature.build();
+    }();
+    this->set_signature(&signature);
+  }
+
+  void call(IndexMask mask, MFParams params, MFContext UNUSED(context)) const override
+  {
+    const VArray<int> &a = params.readonly_single_input<int>(0, "A");
+    const VArray<int> &b = params.readonly_single_input<int>(1, "B");
+    MutableSpan<int> result = params.uninitialized_single_output<int>(2, "Result");
+    for (const int64_t i : mask) {
+      result[i] = a[i] + b[i];
+    }
+    call_count++;
+  }
+};
+
+TEST(field, DeduplicateOperations)
+{
+  CountingAddFunction add_fn;
+  GField index_field{std::make_shared<IndexFieldInput>()};
+
+  /* Two separately built nodes that compute the same value. */
+  GField field_a{
+      std::make_shared<FieldOperation>(add_fn, Vector<GField>{index_field, index_field}), 0};
+  GField field_b{
+      std::make_shared<FieldOperation>(add_fn, Vector<GField>{index_field, index_field}), 0};
+  GField field_c{std::make_shared<FieldOperation>(add_fn, Vector<GField>{field_b, index_field}),
+                 0};
+
+  Array<int> result_1(10);
+  Array<int> result_2(10);
+
+  const Array<int64_t> indices = {2, 4, 6, 8};
+  const IndexMask mask{indices};
+
+  FieldContext context;
+  FieldEvaluator evaluator{context, &mask};
+  evaluator.add_with_destination(field_a, result_1.as_mutable_span());
+  evaluator.add_with_destination(field_c, result_2.as_mutable_span());
+  evaluator.evaluate();
+  EXPECT_EQ(add_fn.call_count, 2);
+  EXPECT_EQ(result_1[2], 4);
+  EXPECT_EQ(result_1[8], 16);
+  EXPECT_EQ(result_2[2], 6);
+  EXPECT_EQ(result_2[8], 24);
+}
+
+TEST(field, ConstantFolding)
+{
+  CountingAddFunction add_fn;
+  CountingAddFunction constant_add_fn;
+  GField index_field{std::make_shared<IndexFieldInput>()};
+
+  /* Both constant sub-trees are folded to the same value, so that the operations that use them
+   * can be deduplicated. */
+  GField constant_a{std::make_shared<FieldOperation>(
+                        constant_add_fn,
+                        Vector<GField>{make_constant_field<int>(2), make_constant_field<int>(3)}),
+                    0};
+  GField constant_b{std::make_shared<FieldOperation>(
+                        constant_add_fn,
+                        Vector<GField>{make_constant_field<int>(1), make_constant_field<int>(4)}),
+                    0};
+  GField field_a{std::make_shared<FieldOperation>(add_fn, Vector<GField>{index_field, constant_a}),
+                 0};
+  GField field_b{std::make_shared<FieldOperation>(add_fn, Vector<GField>{index_field, constant_b}),
+                 0};
+
+  Array<int> result_1(10);
+  Array<int> result_2(10);
+
+  FieldContext context;
+  FieldEvaluator evaluator{context, 10};
+  evaluator.add_with_destination(field_a, result_1.as_mutable_span());
+  evaluator.add_with_destination(field_b, result_2.as_mutable_span());
+  evaluator.evaluate();
+  EXPECT_EQ(constant_add_fn.call_count, 2);
+  EXPECT_EQ(add_fn.call_count, 1);
+  EXPECT_EQ(result_1[0], 5);
+  EXPECT_EQ(result_1[9], 14);
+  EXPECT_EQ(result_2[0], 5);
+  EXPECT_EQ(result_2[9], 14);
+}
+
 }  // namespace blender::fn::tests
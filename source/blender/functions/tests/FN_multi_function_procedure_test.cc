@@ -341,4 +341,98 @@ TEST(multi_function_procedure, BufferReuse)
   EXPECT_EQ(results[4], 53);
 }
 
+TEST(multi_function_procedure, Chunked)
+{
+  /**
+   * procedure(int a, int &b, int *out) {
+   *   int c = a + 10;
+   *   bool d = a < 500;
+   *   if (d) {
+   *     b += 100;
+   *   }
+   *   out = c + b;
+   * }
+   */
+
+  CustomMF_SI_SO<int, int> add_10_fn{"add 10", [](int a) { return a + 10; }};
+  CustomMF_SI_SO<int, bool> less_than_fn{"less than 500", [](int a) { return a < 500; }};
+  CustomMF_SM<int> add_100_fn{"add 100", [](int &a) { a += 100; }};
+  CustomMF_SI_SI_SO<int, int, int> add_fn{"add", [](int a, int b) { return a + b; }};
+
+  MFProcedure procedure;
+  MFProcedureBuilder builder{procedure};
+
+  MFVariable *var_a = &builder.add_single_input_parameter<int>();
+  MFVariable *var_b = &builder.add_single_mutable_parameter<int>();
+  auto [var_c] = builder.add_call<1>(add_10_fn, {var_a});
+  auto [var_d] = builder.add_call<1>(less_than_fn, {var_a});
+  builder.add_destruct(*var_a);
+  MFProcedureBuilder::Branch branch = builder.add_branch(*var_d);
+  branch.branch_false.add_destruct(*var_d);
+  branch.branch_true.add_destruct(*var_d);
+  branch.branch_true.add_call(add_100_fn, {var_b});
+  builder.set_cursor_after_branch(branch);
+  auto [var_out] = builder.add_call<1>(add_fn, {var_c, var_b});
+  builder.add_destruct(*var_c);
+  builder.add_return();
+  builder.add_output_parameter(*var_out);
+
+  EXPECT_TRUE(procedure.validate());
+
+  MFProcedureExecutor procedure_fn{"Chunked", procedure};
+  EXPECT_GT(procedure_fn.chunk_size(), 0);
+  procedure_fn.set_chunk_size(100);
+
+  const int size = 1000;
+  Array<int> inputs(size);
+  for (const int i : inputs.index_range()) {
+    inputs[i] = (i * 7) % size;
+  }
+
+  /* Evaluate a contiguous and a sparse mask, with and without chunking. */
+  Vector<int64_t> sparse_indices;
+  for (int i = 0; i < size; i += 3) {
+    sparse_indices.append(i);
+  }
+  sparse_indices.append(size - 1);
+  const IndexMask masks[] = {IndexRange(size), sparse_indices.as_span()};
+
+  for (const IndexMask &mask : masks) {
+    Array<int> mutables(size, 1);
+    Array<int> results(size, -1);
+
+    MFParamsBuilder params{procedure_fn, size};
+    params.add_readonly_single_input(inputs.as_span());
+    params.add_single_mutable(mutables.as_mutable_span());
+    params.add_uninitialized_single_output(results.as_mutable_span());
+
+    MFContextBuilder context;
+    procedure_fn.call(mask, params, context);
+
+    for (const int64_t i : mask) {
+      const int expected_mutable = inputs[i] < 500 ? 101 : 1;
+      EXPECT_EQ(mutables[i], expected_mutable);
+      EXPECT_EQ(results[i], inputs[i] + 10 + expected_mutable);
+    }
+    /* Indices that are not in the mask are not touched. */
+    if (!mask.is_range()) {
+      EXPECT_EQ(mutables[1], 1);
+      EXPECT_EQ(results[1], -1);
+    }
+  }
+
+  /* The procedure is still evaluated for the mutable parameter when the output is ignored. */
+  Array<int> mutables(size, 1);
+  MFParamsBuilder params{procedure_fn, size};
+  params.add_readonly_single_input(inputs.as_span());
+  params.add_single_mutable(mutables.as_mutable_span());
+  params.add_ignored_single_output();
+
+  MFContextBuilder context;
+  procedure_fn.call(IndexRange(size), params, context);
+  for (const int i : inputs.index_range()) {
+    EXPECT_EQ(mutables[i], inputs[i] < 500 ? 101 : 1);
+  }
+}
+
 }  // namespace blender::fn::tests
@@ -4,6 +4,7 @@
 
 #include "FN_multi_function.hh"
 #include "FN_multi_function_builder.hh"
+#include "FN_multi_function_fused.hh"
 #include "FN_multi_function_test_common.hh"
 
 namespace blender::fn::tests {
@@ -355,5 +356,63 @@ TEST(multi_function, IgnoredOutputs)
   }
 }
 
+TEST(multi_function, FusedMultiFunction)
+{
+  CustomMF_SI_SI_SO<int, int, int> add_fn{"add", [](int a, int b) { return a + b; }};
+  CustomMF_SI_SO<int, std::string> to_string_fn{"to string",
+                                                [](int a) { return std::to_string(a); }};
+  CustomMF_SI_SI_SO<std::string, int, std::string> append_fn{
+      "append", [](const std::string &a, int b) { return a + "_" + std::to_string(b); }};
+
+  /* fused(a, b) = to_string(a + b) + "_" + (a + b) */
+  Vector<FusedMultiFunction::Step> steps;
+  steps.append({&add_fn, {0, 1}});
+  steps.append({&to_string_fn, {2}});
+  steps.append({&append_fn, {3, 2}});
+  const CPPType &int_type = CPPType::get<int>();
+  FusedMultiFunction fn{"fused", {&int_type, &int_type}, std::move(steps)};
+
+  const int size = 3000;
+  Array<int> values_a(size);
+  for (const int i : values_a.index_range()) {
+    values_a[i] = i;
+  }
+  const int value_b = 10;
+
+  {
+    Array<std::string> outputs(size, NoInitialization());
+    MFParamsBuilder params(fn, size);
+    params.add_readonly_single_input(values_a.as_span());
+    params.add_readonly_single_input(&value_b);
+    params.add_uninitialized_single_output(outputs.as_mutable_span());
+    MFContextBuilder context;
+    fn.call(IndexRange(size), params, context);
+
+    EXPECT_EQ(outputs[0], "10_10");
+    EXPECT_EQ(outputs[1], "11_11");
+    EXPECT_EQ(outputs[2999], "3009_3009");
+  }
+  {
+    Vector<int64_t> indices;
+    for (int i = 0; i < size; i += 3) {
+      indices.append(i);
+    }
+    Array<std::string> outputs(size, "");
+    CPPType::get<std::string>().destruct_indices(outputs.data(), indices.as_span());
+    MFParamsBuilder params(fn, size);
+    params.add_readonly_single_input(values_a.as_span());
+    params.add_readonly_single_input(&value_b);
+    params.add_uninitialized_single_output(outputs.as_mutable_span());
+    MFContextBuilder context;
+    fn.call(indices.as_span(), params, context);
+
+    EXPECT_EQ(outputs[0], "10_10");
+    EXPECT_EQ(outputs[1], "");
+    EXPECT_EQ(outputs[3], "13_13");
+    EXPECT_EQ(outputs[2997], "3007_3007");
+    EXPECT_EQ(outputs[2998], "");
+  }
+}
+
 }  // namespace
 }  // namespace blender::fn::tests
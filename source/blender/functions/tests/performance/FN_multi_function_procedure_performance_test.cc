@@ -0,0 +1,151 @@
+/* Apache License, Version 2.0 */
+
+/** \file
+ * Benchmarks of the multi-function procedure executor.
+ *
+ * A long chain of cheap math functions is evaluated like a field with many math nodes. Every
+ * measurement reports the time and the peak amount of memory allocated for intermediate values,
+ * which is a good indicator for how much of them has to go through main memory.
+ *
+ * When the `BLI_BENCHMARK_OUTPUT` environment variable is set, results are also appended to that
+ * file as JSON lines, see BLI_benchmark_report.hh.
+ */
+
+#include "testing/testing.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_array.hh"
+#include "BLI_task.h"
+
+#include "BLI_benchmark_report.hh"
+
+#include "FN_multi_function_builder.hh"
+#include "FN_multi_function_fused.hh"
+#include "FN_multi_function_parallel.hh"
+#include "FN_multi_function_procedure_builder.hh"
+#include "FN_multi_function_procedure_executor.hh"
+
+#include "PIL_time.h"
+
+namespace blender::fn::tests {
+
+static constexpr int CHAIN_LENGTH = 32;
+static constexpr int REPEAT = 3;
+
+static void benchmark_report(const char *name,
+                             const int64_t size,
+                             const double seconds,
+                             const size_t peak_memory)
+{
+  const double items_per_second = (double)size / seconds;
+  printf("\t%-10s %-20s %8lld: %.3e s, %8.2f M items/s, %8.2f MB peak\n",
+         "Procedure",
+         name,
+         (long long)size,
+         seconds,
+         items_per_second / 1e6,
+         peak_memory / (1024.0 * 1024.0));
+
+  char extra_json[64];
+  snprintf(extra_json,
+           sizeof(extra_json),
+           "\"peak_memory\": %llu",
+           (unsigned long long)peak_memory);
+  blender::tests::benchmark_write_json("Procedure", "math chain", name, size, seconds, extra_json);
+}
+
+/**
+ * Evaluate \a fn, which has two float inputs and one float output, for all indices and report
+ * the fastest run.
+ */
+static void benchmark_procedure(const char *name, const MultiFunction &fn, const int64_t size)
+{
+  Array<float> a(size, 1.0f);
+  Array<float> b(size, 0.5f);
+  Array<float> result(size);
+
+  double best = DBL_MAX;
+  size_t peak_memory = 0;
+  for (int i = 0; i < REPEAT; i++) {
+    MFParamsBuilder params{fn, size};
+    params.add_readonly_single_input(a.as_span());
+    params.add_readonly_single_input(b.as_span());
+    params.add_uninitialized_single_output(result.as_mutable_span());
+    MFContextBuilder context;
+
+    const size_t memory_before = MEM_get_memory_in_use();
+    MEM_reset_peak_memory();
+    const double start = PIL_check_seconds_timer();
+    fn.call(IndexRange(size), params, context);
+    best = std::min(best, PIL_check_seconds_timer() - start);
+    peak_memory = std::max(peak_memory, MEM_get_peak_memory() - memory_before);
+  }
+  benchmark_report(name, size, best, peak_memory);
+}
+
+TEST(fn_benchmark, ProcedureMathChain)
+{
+  /**
+   * procedure(float a, float b, float *out) {
+   *   float x = a;
+   *   x = x + b;
+   *   x = x * b;
+   *   ... repeated #CHAIN_LENGTH times
+   *   out = x;
+   * }
+   */
+  CustomMF_SI_SI_SO<float, float, float> add_fn{"add", [](float a, float b) { return a + b; }};
+  CustomMF_SI_SI_SO<float, float, float> multiply_fn{"multiply",
+                                                     [](float a, float b) { return a * b; }};
+
+  MFProcedure procedure;
+  MFProcedureBuilder builder{procedure};
+  MFVariable *var_a = &builder.add_single_input_parameter<float>();
+  MFVariable *var_b = &builder.add_single_input_parameter<float>();
+  MFVariable *var_x = var_a;
+  for (int i = 0; i < CHAIN_LENGTH; i++) {
+    const MultiFunction &fn = (i % 2 == 0) ? (const MultiFunction &)add_fn : multiply_fn;
+    auto [var_next] = builder.add_call<1>(fn, {var_x, var_b});
+    builder.add_destruct(*var_x);
+    var_x = var_next;
+  }
+  builder.add_destruct(*var_b);
+  builder.add_return();
+  builder.add_output_parameter(*var_x);
+  EXPECT_TRUE(procedure.validate());
+
+  BLI_task_scheduler_init();
+
+  /* Every instruction is evaluated for all indices before the next one. */
+  MFProcedureExecutor full_executor{"Full", procedure};
+  full_executor.set_chunk_size(0);
+  /* How fields were evaluated before the executor supported chunks. */
+  ParallelMultiFunction sliced_executor{full_executor, 10000};
+  /* The entire procedure is evaluated for cache-sized chunks. */
+  MFProcedureExecutor chunked_executor{"Chunked", procedure};
+  /* The entire chain is evaluated by a single loop over small blocks. */
+  Vector<FusedMultiFunction::Step> steps;
+  for (int i = 0; i < CHAIN_LENGTH; i++) {
+    const MultiFunction &fn = (i % 2 == 0) ? (const MultiFunction &)add_fn : multiply_fn;
+    steps.append({&fn, {(i == 0) ? 0 : i + 1, 1}});
+  }
+  const CPPType &float_type = CPPType::get<float>();
+  FusedMultiFunction fused_fn{"Fused", {&float_type, &float_type}, std::move(steps)};
+  ParallelMultiFunction fused_executor{fused_fn, 10000};
+
+  for (const int64_t size : {10000, 1000000, 10000000}) {
+    benchmark_procedure("full", full_executor, size);
+    benchmark_procedure("slices_10000", sliced_executor, size);
+    benchmark_procedure("chunked", chunked_executor, size);
+    benchmark_procedure("fused", fused_executor, size);
+  }
+
+  BLI_task_scheduler_exit();
+}
+
+}  // namespace blender::fn::tests
@@ -573,7 +573,10 @@
   }
 
 #define _DNA_DEFAULT_NodesModifierData \
-  { 0 }
+  { \
+    .flag = 0, \
+    .cache_memory_limit = 256, \
+  }
 
 #define _DNA_DEFAULT_SkinModifierData \
   { \
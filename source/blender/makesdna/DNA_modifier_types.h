@@ -2262,12 +2262,24 @@ typedef struct NodesModifierData {
   struct bNodeTree *node_group;
   struct NodesModifierSettings settings;
 
+  /** #NodesModifierFlag. */
+  int flag;
+  /** Maximum memory used by cached node outputs, in megabytes. */
+  int cache_memory_limit;
+
   /* Contains logged information from the last evaluation. This can be used to help the user to
    * debug a node tree. */
   void *runtime_eval_log;
-  void *_pad1;
+  /* Node outputs of the last evaluation that can be reused by the next one. Only used when
+   * #NODES_MODIFIER_USE_CACHE is set. */
+  void *runtime_cache;
 } NodesModifierData;
 
+/** #NodesModifierData.flag */
+typedef enum NodesModifierFlag {
+  NODES_MODIFIER_USE_CACHE = (1 << 0),
+} NodesModifierFlag;
+
 typedef struct MeshToVolumeModifierData {
   ModifierData modifier;
 
@@ -30,9 +30,21 @@ extern "C" {
 typedef struct PackedFile {
   int size;
   int seek;
+  /** #ePackedFileFlag. */
+  int flag;
+  char _pad[4];
   void *data;
 } PackedFile;
 
+/** #PackedFile.flag */
+typedef enum ePackedFileFlag {
+  /**
+   * Only written by undo steps: #PackedFile.data is the location of the contents in the
+   * blend-file they were deferred from, instead of the contents.
+   */
+  PF_FLAG_DATA_DEFERRED = (1 << 0),
+} ePackedFileFlag;
+
 #ifdef __cplusplus
 }
 #endif
@@ -1139,6 +1139,8 @@ typedef struct DNA_ReconstructInfo {
 
   int *step_counts;
   ReconstructStep **steps;
+  /** Structs (indexed by new struct number) that only need a plain copy of their memory. */
+  bool *is_plain_copy;
 } DNA_ReconstructInfo;
 
 static void reconstruct_structs(const DNA_ReconstructInfo *reconstruct_info,
@@ -1223,6 +1225,11 @@ static void reconstruct_structs(const DNA_ReconstructInfo *reconstruct_info,
   const int old_block_size = reconstruct_info->oldsdna->types_size[old_struct->type];
   const int new_block_size = reconstruct_info->newsdna->types_size[new_struct->type];
 
+  if (reconstruct_info->is_plain_copy[new_struct_nr]) {
+    memcpy(new_blocks, old_blocks, (size_t)blocks * (size_t)new_block_size);
+    return;
+  }
+
   for (int a = 0; a < blocks; a++) {
     const char *old_block = old_blocks + a * old_block_size;
     char *new_block = new_blocks + a * new_block_size;
@@ -1256,7 +1263,10 @@ void *DNA_struct_reconstruct(const DNA_ReconstructInfo *reconstruct_info,
   const SDNA_Struct *new_struct = newsdna->structs[new_struct_nr];
   const int new_block_size = newsdna->types_size[new_struct->type];
 
-  char *new_blocks = MEM_callocN(blocks * new_block_size, "reconstruct");
+  /* Plain copies overwrite the entire memory, no need to clear it first. */
+  char *new_blocks = reconstruct_info->is_plain_copy[new_struct_nr] ?
+                         MEM_mallocN((size_t)blocks * (size_t)new_block_size, "reconstruct") :
+                         MEM_callocN((size_t)blocks * (size_t)new_block_size, "reconstruct");
   reconstruct_structs(
       reconstruct_info, blocks, old_struct_nr, new_struct_nr, old_blocks, new_blocks);
   return new_blocks;
@@ -1521,11 +1531,51 @@ static int compress_reconstruct_steps(ReconstructStep *steps, const int old_step
         new_step_count++;
         break;
       case RECONSTRUCT_STEP_CAST_PRIMITIVE:
+        if (new_step_count > 0) {
+          /* Try to merge this cast with the previous one, when both cast between the same types
+           * and the arrays are directly next to each other. */
+          ReconstructStep *prev_step = &steps[new_step_count - 1];
+          if (prev_step->type == RECONSTRUCT_STEP_CAST_PRIMITIVE &&
+              prev_step->data.cast_primitive.old_type == step->data.cast_primitive.old_type &&
+              prev_step->data.cast_primitive.new_type == step->data.cast_primitive.new_type) {
+            const int old_size = DNA_elem_type_size(step->data.cast_primitive.old_type);
+            const int new_size = DNA_elem_type_size(step->data.cast_primitive.new_type);
+            const int prev_len = prev_step->data.cast_primitive.array_len;
+            if (prev_step->data.cast_primitive.old_offset + prev_len * old_size ==
+                    step->data.cast_primitive.old_offset &&
+                prev_step->data.cast_primitive.new_offset + prev_len * new_size ==
+                    step->data.cast_primitive.new_offset) {
+              prev_step->data.cast_primitive.array_len += step->data.cast_primitive.array_len;
+              break;
+            }
+          }
+        }
+        steps[new_step_count] = *step;
+        new_step_count++;
+        break;
       case RECONSTRUCT_STEP_CAST_POINTER_TO_32:
       case RECONSTRUCT_STEP_CAST_POINTER_TO_64:
+        if (new_step_count > 0) {
+          /* Pointers are often grouped (e.g. `next` and `prev`), convert them in one go. */
+          ReconstructStep *prev_step = &steps[new_step_count - 1];
+          if (prev_step->type == step->type) {
+            const int old_size = (step->type == RECONSTRUCT_STEP_CAST_POINTER_TO_32) ? 8 : 4;
+            const int new_size = (step->type == RECONSTRUCT_STEP_CAST_POINTER_TO_32) ? 4 : 8;
+            const int prev_len = prev_step->data.cast_pointer.array_len;
+            if (prev_step->data.cast_pointer.old_offset + prev_len * old_size ==
+                    step->data.cast_pointer.old_offset &&
+                prev_step->data.cast_pointer.new_offset + prev_len * new_size ==
+                    step->data.cast_pointer.new_offset) {
+              prev_step->data.cast_pointer.array_len += step->data.cast_pointer.array_len;
+              break;
+            }
+          }
+        }
+        steps[new_step_count] = *step;
+        new_step_count++;
+        break;
       case RECONSTRUCT_STEP_SUBSTRUCT:
-        /* These steps are not changed at all for now. It should be possible to merge consecutive
-         * steps of the same type, but it is not really worth it. */
+        /* These steps are not changed at all for now. */
         steps[new_step_count] = *step;
         new_step_count++;
         break;
@@ -1534,6 +1584,21 @@ static int compress_reconstruct_steps(ReconstructStep *steps, const int old_step
   return new_step_count;
 }
 
+/**
+ * Check whether the compressed steps copy the entire struct as is, in which case arrays of the
+ * struct can be copied in a single memcpy.
+ */
+static bool reconstruct_steps_is_plain_copy(const ReconstructStep *steps,
+                                            const int steps_len,
+                                            const int old_struct_size,
+                                            const int new_struct_size)
+{
+  return steps_len == 1 && steps[0].type == RECONSTRUCT_STEP_MEMCPY &&
+         steps[0].data.memcpy.old_offset == 0 && steps[0].data.memcpy.new_offset == 0 &&
+         steps[0].data.memcpy.size == old_struct_size &&
+         steps[0].data.memcpy.size == new_struct_size;
+}
+
 /**
  * Pre-process information about how structs in \a newsdna can be reconstructed from structs in
  * \a oldsdna. This information is then used to speedup #DNA_struct_reconstruct.
@@ -1549,6 +1614,8 @@ DNA_ReconstructInfo *DNA_reconstruct_info_create(const SDNA *oldsdna,
   reconstruct_info->step_counts = MEM_malloc_arrayN(sizeof(int), newsdna->structs_len, __func__);
   reconstruct_info->steps = MEM_malloc_arrayN(
       sizeof(ReconstructStep *), newsdna->structs_len, __func__);
+  reconstruct_info->is_plain_copy = MEM_calloc_arrayN(
+      sizeof(bool), newsdna->structs_len, __func__);
 
   /* Generate reconstruct steps for all structs. */
   for (int new_struct_nr = 0; new_struct_nr < newsdna->structs_len; new_struct_nr++) {
@@ -1569,6 +1636,11 @@ DNA_ReconstructInfo *DNA_reconstruct_info_create(const SDNA *oldsdna,
 
     reconstruct_info->steps[new_struct_nr] = steps;
     reconstruct_info->step_counts[new_struct_nr] = steps_len;
+    reconstruct_info->is_plain_copy[new_struct_nr] = reconstruct_steps_is_plain_copy(
+        steps,
+        steps_len,
+        oldsdna->types_size[old_struct->type],
+        newsdna->types_size[new_struct->type]);
 
 /* This is useful when debugging the reconstruct steps. */
 #if 0
@@ -1594,6 +1666,7 @@ void DNA_reconstruct_info_free(DNA_ReconstructInfo *reconstruct_info)
   }
   MEM_freeN(reconstruct_info->steps);
   MEM_freeN(reconstruct_info->step_counts);
+  MEM_freeN(reconstruct_info->is_plain_copy);
   MEM_freeN(reconstruct_info);
 }
 
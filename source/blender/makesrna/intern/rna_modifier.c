@@ -6943,6 +6943,21 @@ static void rna_def_modifier_nodes(BlenderRNA *brna)
   RNA_def_property_flag(prop, PROP_EDITABLE);
   RNA_def_property_update(prop, 0, "rna_NodesModifier_node_group_update");
 
+  prop = RNA_def_property(srna, "use_cache", PROP_BOOLEAN, PROP_NONE);
+  RNA_def_property_boolean_sdna(prop, NULL, "flag", NODES_MODIFIER_USE_CACHE);
+  RNA_def_property_ui_text(
+      prop,
+      "Cache",
+      "Reuse outputs of nodes whose inputs did not change since the last evaluation");
+  RNA_def_property_update(prop, 0, "rna_Modifier_update");
+
+  prop = RNA_def_property(srna, "cache_memory_limit", PROP_INT, PROP_NONE);
+  RNA_def_property_range(prop, 1, INT_MAX);
+  RNA_def_property_ui_range(prop, 16, 16384, 16, -1);
+  RNA_def_property_ui_text(
+      prop, "Memory Limit", "Maximum memory used by cached node outputs, in megabytes");
+  RNA_def_property_update(prop, 0, "rna_Modifier_update");
+
   RNA_define_lib_overridable(false);
 }
 
@@ -45,6 +45,10 @@ const EnumPropertyItem rna_enum_unpack_method_items[] = {
 static void rna_PackedImage_data_get(PointerRNA *ptr, char *value)
 {
   PackedFile *pf = (PackedFile *)ptr->data;
+  if (!BKE_packedfile_data_ensure(pf)) {
+    value[0] = '\0';
+    return;
+  }
   memcpy(value, pf->data, (size_t)pf->size);
   value[pf->size] = '\0';
 }
@@ -80,6 +80,7 @@
 
 #include "MOD_modifiertypes.h"
 #include "MOD_nodes.h"
+#include "MOD_nodes_cache.hh"
 #include "MOD_nodes_evaluator.hh"
 #include "MOD_ui_common.h"
 
@@ -105,6 +106,9 @@ using blender::StringRefNull;
 using blender::Vector;
 using blender::fn::GMutablePointer;
 using blender::fn::GPointer;
+using blender::modifiers::geometry_nodes::GeometryNodesCache;
+using blender::modifiers::geometry_nodes::GeometryNodesCacheEvaluation;
+using blender::modifiers::geometry_nodes::GeometryNodesCacheStats;
 using blender::nodes::GeoNodeExecParams;
 using blender::threading::EnumerableThreadSpecific;
 using namespace blender::fn::multi_function_types;
@@ -792,7 +796,31 @@ static GeometrySet compute_geometry(const DerivedNodeTree &tree,
 {
   blender::ResourceScope scope;
   blender::LinearAllocator<> &allocator = scope.linear_allocator();
-  blender::nodes::NodeMultiFunctions mf_by_node{tree, scope};
+  /* Shared, because the cache keeps fields that reference these functions. */
+  std::shared_ptr<blender::ResourceScope> functions_scope =
+      std::make_shared<blender::ResourceScope>();
+  blender::nodes::NodeMultiFunctions mf_by_node{tree, *functions_scope};
+
+  NodesModifierData *nmd_orig = (NodesModifierData *)BKE_modifier_get_original(&nmd->modifier);
+  std::optional<GeometryNodesCacheEvaluation> cache_evaluation;
+  /* Like the evaluation log, the cache is stored in the original modifier, which may only be
+   * modified by the active depsgraph. */
+  const bool is_active_evaluation = logging_enabled(ctx);
+  if (is_active_evaluation && (nmd->flag & NODES_MODIFIER_USE_CACHE)) {
+    if (nmd_orig->runtime_cache == nullptr) {
+      nmd_orig->runtime_cache = new GeometryNodesCache();
+    }
+    cache_evaluation.emplace(*static_cast<GeometryNodesCache *>(nmd_orig->runtime_cache),
+                             (int64_t)nmd->cache_memory_limit * 1024 * 1024,
+                             functions_scope);
+    if (cache_evaluation->is_active()) {
+      /* Keeps a reference to the input geometry, so that nodes modifying it have to copy it. */
+      cache_evaluation->add_input_geometry(input_geometry_set);
+    }
+  }
+  else if (is_active_evaluation && nmd_orig->runtime_cache != nullptr) {
+    static_cast<GeometryNodesCache *>(nmd_orig->runtime_cache)->clear();
+  }
 
   Map<DOutputSocket, GMutablePointer> group_inputs;
 
@@ -839,6 +867,9 @@ static GeometrySet compute_geometry(const DerivedNodeTree &tree,
     find_sockets_to_preview(nmd, ctx, tree, preview_sockets);
     eval_params.force_compute_sockets.extend(preview_sockets.begin(), preview_sockets.end());
     geo_logger.emplace(std::move(preview_sockets));
+    /* Only the evaluation that logs replaces the log, so it can be read here safely. */
+    eval_params.previous_log = static_cast<const geo_log::ModifierLog *>(
+        nmd_orig->runtime_eval_log);
   }
 
   eval_params.input_values = group_inputs;
@@ -848,10 +879,12 @@ static GeometrySet compute_geometry(const DerivedNodeTree &tree,
   eval_params.depsgraph = ctx->depsgraph;
   eval_params.self_object = ctx->object;
   eval_params.geo_logger = geo_logger.has_value() ? &*geo_logger : nullptr;
+  if (cache_evaluation.has_value() && cache_evaluation->is_active()) {
+    eval_params.cache = &*cache_evaluation;
+  }
   blender::modifiers::geometry_nodes::evaluate_geometry_nodes(eval_params);
 
   if (geo_logger.has_value()) {
-    NodesModifierData *nmd_orig = (NodesModifierData *)BKE_modifier_get_original(&nmd->modifier);
     clear_runtime_data(nmd_orig);
     nmd_orig->runtime_eval_log = new geo_log::ModifierLog(*geo_logger);
   }
@@ -1118,9 +1151,44 @@ static void panel_draw(const bContext *C, Panel *panel)
   modifier_panel_end(layout, ptr);
 }
 
+static void cache_panel_draw_header(const bContext *UNUSED(C), Panel *panel)
+{
+  uiLayout *layout = panel->layout;
+  PointerRNA *ptr = modifier_panel_get_property_pointers(panel, nullptr);
+
+  uiItemR(layout, ptr, "use_cache", 0, nullptr, ICON_NONE);
+}
+
+static void cache_panel_draw(const bContext *UNUSED(C), Panel *panel)
+{
+  uiLayout *layout = panel->layout;
+  PointerRNA *ptr = modifier_panel_get_property_pointers(panel, nullptr);
+  NodesModifierData *nmd = static_cast<NodesModifierData *>(ptr->data);
+
+  uiLayoutSetPropSep(layout, true);
+  uiLayoutSetActive(layout, nmd->flag & NODES_MODIFIER_USE_CACHE);
+
+  uiItemR(layout, ptr, "cache_memory_limit", 0, nullptr, ICON_NONE);
+
+  if (nmd->runtime_cache != nullptr) {
+    const GeometryNodesCacheStats stats =
+        static_cast<const GeometryNodesCache *>(nmd->runtime_cache)->stats();
+    char stats_str[128];
+    BLI_snprintf(stats_str,
+                 sizeof(stats_str),
+                 TIP_("Reused %d, computed %d nodes, %.1f MB"),
+                 stats.hits,
+                 stats.misses,
+                 stats.memory / (1024.0 * 1024.0));
+    uiItemL(layout, stats_str, ICON_INFO);
+  }
+}
+
 static void panelRegister(ARegionType *region_type)
 {
-  modifier_panel_register(region_type, eModifierType_Nodes, panel_draw);
+  PanelType *panel_type = modifier_panel_register(region_type, eModifierType_Nodes, panel_draw);
+  modifier_subpanel_register(
+      region_type, "cache", "", cache_panel_draw_header, cache_panel_draw, panel_type);
 }
 
 static void blendWrite(BlendWriter *writer, const ModifierData *md)
@@ -1139,6 +1207,7 @@ static void blendRead(BlendDataReader *reader, ModifierData *md)
   BLO_read_data_address(reader, &nmd->settings.properties);
   IDP_BlendDataRead(reader, &nmd->settings.properties);
   nmd->runtime_eval_log = nullptr;
+  nmd->runtime_cache = nullptr;
 }
 
 static void copyData(const ModifierData *md, ModifierData *target, const int flag)
@@ -1149,6 +1218,7 @@ static void copyData(const ModifierData *md, ModifierData *target, const int fla
   BKE_modifier_copydata_generic(md, target, flag);
 
   tnmd->runtime_eval_log = nullptr;
+  tnmd->runtime_cache = nullptr;
 
   if (nmd->settings.properties != nullptr) {
     tnmd->settings.properties = IDP_CopyProperty_ex(nmd->settings.properties, flag);
@@ -1164,6 +1234,10 @@ static void freeData(ModifierData *md)
   }
 
   clear_runtime_data(nmd);
+  if (nmd->runtime_cache != nullptr) {
+    delete static_cast<GeometryNodesCache *>(nmd->runtime_cache);
+    nmd->runtime_cache = nullptr;
+  }
 }
 
 static void requiredDataMask(Object *UNUSED(ob),
@@ -0,0 +1,610 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup modifiers
+ */
+
+#include <optional>
+
+#include "MOD_nodes_cache.hh"
+
+#include "BLI_float4x4.hh"
+#include "BLI_hash_mm2a.h"
+#include "BLI_listbase.h"
+#include "BLI_set.hh"
+
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+#include "DNA_node_types.h"
+#include "DNA_object_types.h"
+#include "DNA_pointcloud_types.h"
+
+#include "BKE_attribute_access.hh"
+#include "BKE_customdata.h"
+#include "BKE_node.h"
+
+#include "FN_field.hh"
+#include "FN_field_cpp_type.hh"
+
+#include "MEM_guardedalloc.h"
+
+namespace blender::modifiers::geometry_nodes {
+
+using fn::FieldCPPType;
+using fn::FieldNode;
+using fn::FieldOperation;
+using fn::GField;
+using fn::GFieldRef;
+
+/* -------------------------------------------------------------------- */
+/** \name Cacheable Nodes
+ * \{ */
+
+static bool node_is_cacheable(const DNode node)
+{
+  const bNodeType &type = *node->typeinfo();
+  if (type.geometry_node_execute == nullptr) {
+    return false;
+  }
+  /* Lazy nodes may be executed multiple times with different sets of inputs. */
+  if (type.geometry_node_execute_supports_laziness) {
+    return false;
+  }
+  /* The output of these nodes depends on more than their inputs and settings. */
+  if (STR_ELEM(type.idname, "GeometryNodeIsViewport", "GeometryNodeLegacyAttributeCurveMap")) {
+    return false;
+  }
+  /* The referenced data-block can change without the node changing, e.g. in the material input
+   * node. */
+  if (node->bnode()->id != nullptr) {
+    return false;
+  }
+  for (const InputSocketRef *socket : node->inputs()) {
+    if (!socket->is_available()) {
+      continue;
+    }
+    /* Data-blocks can change without the socket value changing. */
+    if (ELEM(socket->bsocket()->type,
+             SOCK_OBJECT,
+             SOCK_COLLECTION,
+             SOCK_TEXTURE,
+             SOCK_IMAGE,
+             SOCK_MATERIAL)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static std::string node_path(const DNode node)
+{
+  std::string path = node->name();
+  for (const DTreeContext *context = node.context(); context->parent_node() != nullptr;
+       context = context->parent_context()) {
+    path = context->parent_node()->name() + "/" + path;
+  }
+  return path;
+}
+
+template<typename T> static void append_bytes(std::string &r_bytes, const T &value)
+{
+  r_bytes.append((const char *)&value, sizeof(T));
+}
+
+/**
+ * Everything that defines the behavior of a node apart from its inputs. Geometry node storage
+ * does not contain pointers, except for the nodes that have been excluded in #node_is_cacheable.
+ * Nodes referencing a data-block are excluded there as well.
+ */
+static std::string node_settings(const DNode node)
+{
+  const bNode &bnode = *node->bnode();
+  std::string settings = bnode.idname;
+  append_bytes(settings, bnode.custom1);
+  append_bytes(settings, bnode.custom2);
+  append_bytes(settings, bnode.custom3);
+  append_bytes(settings, bnode.custom4);
+  if (bnode.storage != nullptr) {
+    settings.append((const char *)bnode.storage, MEM_allocN_len(bnode.storage));
+  }
+  return settings;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Input Geometry Versions
+ * \{ */
+
+/** Computes a 64 bit hash from a stream of data. */
+class DataHasher {
+ private:
+  BLI_HashMurmur2A hash_low_;
+  BLI_HashMurmur2A hash_high_;
+
+ public:
+  DataHasher()
+  {
+    BLI_hash_mm2a_init(&hash_low_, 0);
+    BLI_hash_mm2a_init(&hash_high_, 1);
+  }
+
+  void add(const void *data, const size_t size)
+  {
+    BLI_hash_mm2a_add(&hash_low_, (const unsigned char *)data, size);
+    BLI_hash_mm2a_add(&hash_high_, (const unsigned char *)data, size);
+  }
+
+  template<typename T> void add_value(const T &value)
+  {
+    this->add(&value, sizeof(T));
+  }
+
+  void add_string(const StringRef str)
+  {
+    this->add(str.data(), (size_t)str.size());
+  }
+
+  uint64_t end()
+  {
+    return ((uint64_t)BLI_hash_mm2a_end(&hash_high_) << 32) | BLI_hash_mm2a_end(&hash_low_);
+  }
+};
+
+static bool hash_custom_data(const CustomData &data, const int size, DataHasher &hasher)
+{
+  for (const int i : IndexRange(data.totlayer)) {
+    const CustomDataLayer &layer = data.layers[i];
+    hasher.add_value(layer.type);
+    hasher.add_value(layer.flag);
+    hasher.add_string(layer.name);
+    if (layer.type == CD_MDEFORMVERT) {
+      const MDeformVert *dverts = (const MDeformVert *)layer.data;
+      for (const int i_vert : IndexRange(size)) {
+        const MDeformVert &dvert = dverts[i_vert];
+        hasher.add_value(dvert.totweight);
+        hasher.add(dvert.dw, sizeof(MDeformWeight) * (size_t)dvert.totweight);
+      }
+    }
+    else if (CustomData_layertype_is_dynamic(layer.type)) {
+      /* Layer types that reference other memory are not supported. */
+      return false;
+    }
+    else {
+      hasher.add(layer.data, CustomData_sizeof(layer.type) * (size_t)size);
+    }
+  }
+  return true;
+}
+
+static std::optional<uint64_t> hash_mesh(const Mesh &mesh)
+{
+  DataHasher hasher;
+  hasher.add_value(mesh.totvert);
+  hasher.add_value(mesh.totedge);
+  hasher.add_value(mesh.totloop);
+  hasher.add_value(mesh.totpoly);
+  hasher.add_value(mesh.flag);
+  hasher.add_value(mesh.smoothresh);
+  hasher.add(mesh.mat, sizeof(Material *) * (size_t)mesh.totcol);
+  LISTBASE_FOREACH (const bDeformGroup *, group, &mesh.vertex_group_names) {
+    hasher.add_string(group->name);
+  }
+  if (!hash_custom_data(mesh.vdata, mesh.totvert, hasher) ||
+      !hash_custom_data(mesh.edata, mesh.totedge, hasher) ||
+      !hash_custom_data(mesh.ldata, mesh.totloop, hasher) ||
+      !hash_custom_data(mesh.pdata, mesh.totpoly, hasher)) {
+    return std::nullopt;
+  }
+  return hasher.end();
+}
+
+static std::optional<uint64_t> hash_pointcloud(const PointCloud &pointcloud)
+{
+  DataHasher hasher;
+  hasher.add_value(pointcloud.totpoint);
+  hasher.add(pointcloud.mat, sizeof(Material *) * (size_t)pointcloud.totcol);
+  if (!hash_custom_data(pointcloud.pdata, pointcloud.totpoint, hasher)) {
+    return std::nullopt;
+  }
+  return hasher.end();
+}
+
+/** A version based on the content of the component, if that is supported for its type. */
+static std::optional<uint64_t> hash_component(const GeometryComponent &component)
+{
+  switch (component.type()) {
+    case GEO_COMPONENT_TYPE_MESH: {
+      const Mesh *mesh = static_cast<const MeshComponent &>(component).get_for_read();
+      if (mesh == nullptr) {
+        return 0;
+      }
+      return hash_mesh(*mesh);
+    }
+    case GEO_COMPONENT_TYPE_POINT_CLOUD: {
+      const PointCloud *pointcloud =
+          static_cast<const PointCloudComponent &>(component).get_for_read();
+      if (pointcloud == nullptr) {
+        return 0;
+      }
+      return hash_pointcloud(*pointcloud);
+    }
+    default:
+      return std::nullopt;
+  }
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Compare Inputs
+ * \{ */
+
+using FieldNodePair = std::pair<const FieldNode *, const FieldNode *>;
+
+/**
+ * Fields are created anew in every evaluation, so they have to be compared by their structure.
+ * \param checked_pairs: Pairs of nodes that compare equal or are being compared already. This
+ * avoids an exponential number of comparisons when nodes are shared by many users.
+ */
+static bool fields_are_equal(const GFieldRef a,
+                             const GFieldRef b,
+                             Set<FieldNodePair> &checked_pairs)
+{
+  if (a.node_output_index() != b.node_output_index()) {
+    return false;
+  }
+  const FieldNode &node_a = a.node();
+  const FieldNode &node_b = b.node();
+  if (&node_a == &node_b) {
+    return true;
+  }
+  if (node_a.is_input() || node_b.is_input()) {
+    return node_a == node_b;
+  }
+  if (!checked_pairs.add({&node_a, &node_b})) {
+    return true;
+  }
+  const FieldOperation &operation_a = static_cast<const FieldOperation &>(node_a);
+  const FieldOperation &operation_b = static_cast<const FieldOperation &>(node_b);
+  const fn::MultiFunction &fn_a = operation_a.multi_function();
+  const fn::MultiFunction &fn_b = operation_b.multi_function();
+  if (&fn_a != &fn_b && !fn_a.equals(fn_b)) {
+    return false;
+  }
+  const Span<GField> inputs_a = operation_a.inputs();
+  const Span<GField> inputs_b = operation_b.inputs();
+  if (inputs_a.size() != inputs_b.size()) {
+    return false;
+  }
+  for (const int i : inputs_a.index_range()) {
+    if (!fields_are_equal(inputs_a[i], inputs_b[i], checked_pairs)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool inputs_are_equal(const NodeCacheInput &a, const NodeCacheInput &b)
+{
+  if (a.socket_index != b.socket_index || a.type != b.type) {
+    return false;
+  }
+  if (a.value == nullptr) {
+    return a.geometry_versions == b.geometry_versions;
+  }
+  if (const FieldCPPType *field_type = dynamic_cast<const FieldCPPType *>(a.type)) {
+    Set<FieldNodePair> checked_pairs;
+    return fields_are_equal(
+        field_type->get_gfield(a.value), field_type->get_gfield(b.value), checked_pairs);
+  }
+  return a.type->is_equal(a.value, b.value);
+}
+
+static bool entry_inputs_are_equal(const NodeCacheEntry &a, const NodeCacheEntry &b)
+{
+  if (a.settings != b.settings || a.inputs.size() != b.inputs.size()) {
+    return false;
+  }
+  for (const int i : a.inputs.index_range()) {
+    if (!inputs_are_equal(a.inputs[i], b.inputs[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Memory Usage
+ * \{ */
+
+static int64_t estimate_geometry_memory(const GeometrySet &geometry)
+{
+  int64_t memory = 0;
+  for (const GeometryComponent *component : geometry.get_components_for_read()) {
+    component->attribute_foreach(
+        [&](const bke::AttributeIDRef &UNUSED(attribute_id), const AttributeMetaData &meta_data) {
+          const CPPType *type = bke::custom_data_type_to_cpp_type(meta_data.data_type);
+          if (type != nullptr) {
+            memory += (int64_t)component->attribute_domain_size(meta_data.domain) * type->size();
+          }
+          return true;
+        });
+    if (component->type() == GEO_COMPONENT_TYPE_MESH) {
+      const Mesh *mesh = static_cast<const MeshComponent *>(component)->get_for_read();
+      if (mesh != nullptr) {
+        memory += (int64_t)mesh->totedge * sizeof(MEdge) + (int64_t)mesh->totloop * sizeof(MLoop) +
+                  (int64_t)mesh->totpoly * sizeof(MPoly);
+      }
+    }
+    else if (component->type() == GEO_COMPONENT_TYPE_INSTANCES) {
+      const InstancesComponent *instances = static_cast<const InstancesComponent *>(component);
+      memory += (int64_t)instances->instances_amount() * sizeof(float4x4);
+    }
+  }
+  return memory;
+}
+
+static int64_t estimate_value_memory(const GPointer value)
+{
+  if (value.type()->is<GeometrySet>()) {
+    return estimate_geometry_memory(*value.get<GeometrySet>());
+  }
+  return value.type()->size();
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Cache
+ * \{ */
+
+NodeCacheEntry::~NodeCacheEntry()
+{
+  for (NodeCacheInput &input : inputs) {
+    if (input.value != nullptr) {
+      input.type->destruct(input.value);
+    }
+  }
+  for (GMutablePointer &output : outputs) {
+    output.destruct();
+  }
+}
+
+GeometryNodesCacheStats GeometryNodesCache::stats() const
+{
+  std::lock_guard lock{stats_mutex_};
+  return stats_;
+}
+
+void GeometryNodesCache::clear()
+{
+  std::unique_lock lock{evaluation_mutex_, std::try_to_lock};
+  if (!lock.owns_lock()) {
+    return;
+  }
+  entries_.clear();
+  std::lock_guard stats_lock{stats_mutex_};
+  stats_ = {};
+}
+
+GeometryNodesCacheEvaluation::GeometryNodesCacheEvaluation(
+    GeometryNodesCache &cache,
+    const int64_t memory_limit,
+    std::shared_ptr<ResourceScope> functions_scope)
+    : cache_(cache),
+      evaluation_lock_(cache.evaluation_mutex_, std::try_to_lock),
+      memory_limit_(memory_limit),
+      functions_scope_(std::move(functions_scope))
+{
+}
+
+GeometryNodesCacheEvaluation::~GeometryNodesCacheEvaluation()
+{
+  if (!this->is_active()) {
+    return;
+  }
+  cache_.entries_ = std::move(new_entries_);
+  std::lock_guard lock{cache_.stats_mutex_};
+  cache_.stats_.hits = hits_;
+  cache_.stats_.misses = misses_;
+  cache_.stats_.entries = cache_.entries_.size();
+  cache_.stats_.memory = memory_;
+}
+
+bool GeometryNodesCacheEvaluation::is_active() const
+{
+  return evaluation_lock_.owns_lock();
+}
+
+void GeometryNodesCacheEvaluation::add_input_geometry(const GeometrySet &geometry)
+{
+  BLI_assert(this->is_active());
+  input_geometries_.append(geometry);
+  for (const GeometryComponent *component : geometry.get_components_for_read()) {
+    const std::optional<uint64_t> hash = hash_component(*component);
+    if (hash.has_value()) {
+      component_versions_.add(component, get_default_hash_2(*hash, (int)component->type()));
+    }
+  }
+}
+
+bool GeometryNodesCacheEvaluation::geometry_versions(const GeometrySet &geometry,
+                                                     Vector<uint64_t> &r_versions)
+{
+  std::lock_guard lock{mutex_};
+  for (const GeometryComponent *component : geometry.get_components_for_read()) {
+    const uint64_t *version = component_versions_.lookup_ptr(component);
+    if (version == nullptr) {
+      return false;
+    }
+    r_versions.append(*version);
+  }
+  return true;
+}
+
+std::unique_ptr<NodeCacheEntry> GeometryNodesCacheEvaluation::begin_node(
+    const DNode node, const Span<NodeCacheInputValue> inputs)
+{
+  if (!node_is_cacheable(node)) {
+    return {};
+  }
+  std::unique_ptr<NodeCacheEntry> entry = std::make_unique<NodeCacheEntry>();
+  for (const NodeCacheInputValue &input_value : inputs) {
+    const CPPType &type = *input_value.value.type();
+    entry->inputs.append_as();
+    NodeCacheInput &input = entry->inputs.last();
+    input.socket_index = input_value.socket_index;
+    input.type = &type;
+    if (type.is<GeometrySet>()) {
+      if (!this->geometry_versions(*input_value.value.get<GeometrySet>(),
+                                   input.geometry_versions)) {
+        return {};
+      }
+    }
+    else if (dynamic_cast<const FieldCPPType *>(&type) != nullptr ||
+             type.is_equality_comparable()) {
+      input.value = entry->allocator.allocate(type.size(), type.alignment());
+      type.copy_construct(input_value.value.get(), input.value);
+    }
+    else {
+      return {};
+    }
+  }
+  entry->id = cache_.next_entry_id_.fetch_add(1);
+  entry->node_path = node_path(node);
+  entry->settings = node_settings(node);
+  entry->outputs.resize(node->outputs().size());
+  entry->functions_scope = functions_scope_;
+  return entry;
+}
+
+static uint64_t output_geometry_version(const NodeCacheEntry &entry,
+                                        const int socket_index,
+                                        const GeometryComponent &component)
+{
+  return get_default_hash_3(entry.id, socket_index, (int)component.type());
+}
+
+void GeometryNodesCacheEvaluation::register_outputs(const NodeCacheEntry &entry)
+{
+  std::lock_guard lock{mutex_};
+  for (const int i : entry.outputs.index_range()) {
+    const GMutablePointer value = entry.outputs[i];
+    if (value.get() == nullptr || !value.type()->is<GeometrySet>()) {
+      continue;
+    }
+    for (const GeometryComponent *component :
+         value.get<GeometrySet>()->get_components_for_read()) {
+      /* A component that is passed through keeps the version it had before. */
+      component_versions_.add(component, output_geometry_version(entry, i, *component));
+    }
+  }
+}
+
+void GeometryNodesCacheEvaluation::unregister_outputs(const NodeCacheEntry &entry)
+{
+  std::lock_guard lock{mutex_};
+  for (const int i : entry.outputs.index_range()) {
+    const GMutablePointer value = entry.outputs[i];
+    if (value.get() == nullptr || !value.type()->is<GeometrySet>()) {
+      continue;
+    }
+    for (const GeometryComponent *component :
+         value.get<GeometrySet>()->get_components_for_read()) {
+      const uint64_t *version = component_versions_.lookup_ptr(component);
+      if (version != nullptr && *version == output_geometry_version(entry, i, *component)) {
+        component_versions_.remove(component);
+      }
+    }
+  }
+}
+
+std::shared_ptr<const NodeCacheEntry> GeometryNodesCacheEvaluation::find_reusable(
+    const NodeCacheEntry &entry, const Span<int> required_outputs, const bool need_warnings)
+{
+  const std::shared_ptr<NodeCacheEntry> *cached_entry_ptr = cache_.entries_.lookup_ptr(
+      entry.node_path);
+  if (cached_entry_ptr == nullptr) {
+    return {};
+  }
+  const std::shared_ptr<NodeCacheEntry> &cached_entry = *cached_entry_ptr;
+  if (need_warnings && !cached_entry->warnings_captured) {
+    return {};
+  }
+  for (const int socket_index : required_outputs) {
+    if (cached_entry->outputs[socket_index].get() == nullptr) {
+      return {};
+    }
+  }
+  if (!entry_inputs_are_equal(entry, *cached_entry)) {
+    return {};
+  }
+
+  this->register_outputs(*cached_entry);
+  std::lock_guard lock{mutex_};
+  hits_++;
+  /* The entry stays valid for the duration of the evaluation, because it is still referenced by
+   * the cache. It is only kept for the next evaluation if it fits into the budget. */
+  if (memory_ + cached_entry->memory <= memory_limit_) {
+    memory_ += cached_entry->memory;
+    new_entries_.add_overwrite(cached_entry->node_path, cached_entry);
+  }
+  return cached_entry;
+}
+
+void GeometryNodesCacheEvaluation::add_output(NodeCacheEntry &entry,
+                                              const int socket_index,
+                                              const GPointer value)
+{
+  const CPPType &type = *value.type();
+  void *buffer = entry.allocator.allocate(type.size(), type.alignment());
+  type.copy_construct(value.get(), buffer);
+  entry.outputs[socket_index] = {type, buffer};
+  entry.memory += estimate_value_memory(value);
+  if (type.is<GeometrySet>()) {
+    std::lock_guard lock{mutex_};
+    for (const GeometryComponent *component :
+         value.get<GeometrySet>()->get_components_for_read()) {
+      component_versions_.add(component, output_geometry_version(entry, socket_index, *component));
+    }
+  }
+}
+
+void GeometryNodesCacheEvaluation::end_node(std::unique_ptr<NodeCacheEntry> entry)
+{
+  {
+    std::lock_guard lock{mutex_};
+    misses_++;
+    if (memory_ + entry->memory <= memory_limit_) {
+      memory_ += entry->memory;
+      std::string node_path = entry->node_path;
+      new_entries_.add_overwrite(std::move(node_path), std::move(entry));
+      return;
+    }
+  }
+  /* The entry is freed, so its outputs are not referenced by the cache anymore. Other entries
+   * might have used its versions already. That is fine, because the versions of this entry are
+   * never used again. */
+  this->unregister_outputs(*entry);
+}
+
+/** \} */
+
+}  // namespace blender::modifiers::geometry_nodes
@@ -0,0 +1,201 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+/** \file
+ * \ingroup modifiers
+ *
+ * A geometry nodes modifier can keep the outputs of nodes from one evaluation to the next. When a
+ * node is about to be executed again with the same settings and the same inputs, the outputs of
+ * the previous execution are reused instead. This makes changes at the end of a node tree
+ * interactive, even when the nodes before are expensive.
+ *
+ * Only nodes whose outputs depend on nothing but their inputs and settings are cached. Geometry
+ * inputs are not compared by their content. Instead, every geometry component gets a version
+ * number:
+ * - Components of the geometry passed into the modifier get a version based on a hash of their
+ *   data.
+ * - Components that are output by a cached node get a version that is derived from the cache
+ *   entry, which stays the same for as long as the entry is reused.
+ * Components that have a version are always referenced by the cache, so that they are copied
+ * instead of being modified in place and their address is not reused for other data while the
+ * version is in use.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+#include "BLI_linear_allocator.hh"
+#include "BLI_map.hh"
+#include "BLI_resource_scope.hh"
+
+#include "BKE_geometry_set.hh"
+
+#include "NOD_derived_node_tree.hh"
+#include "NOD_geometry_nodes_eval_log.hh"
+
+#include "FN_generic_pointer.hh"
+
+namespace geo_log = blender::nodes::geometry_nodes_eval_log;
+
+namespace blender::modifiers::geometry_nodes {
+
+using namespace nodes::derived_node_tree_types;
+using fn::CPPType;
+using fn::GMutablePointer;
+using fn::GPointer;
+
+/** A value that is passed into a node, see #GeometryNodesCacheEvaluation::begin_node. */
+struct NodeCacheInputValue {
+  int socket_index;
+  GPointer value;
+};
+
+/** An input value of a cached node in a form that can be compared to later inputs. */
+struct NodeCacheInput {
+  int socket_index;
+  const CPPType *type;
+  /** Versions of the components if the input is a geometry. */
+  Vector<uint64_t> geometry_versions;
+  /** Copy of the value (or field) for all other types. */
+  void *value = nullptr;
+};
+
+/** The inputs and outputs of one execution of a node. */
+struct NodeCacheEntry : NonCopyable, NonMovable {
+  /** Unique identifier of the entry, used to derive versions of output geometries. */
+  uint64_t id = 0;
+  /** Path of the node through all parent node groups. */
+  std::string node_path;
+  /** Type and settings of the node. */
+  std::string settings;
+  Vector<NodeCacheInput> inputs;
+  /** Computed output values indexed by socket index. Unused outputs are empty. */
+  Vector<GMutablePointer> outputs;
+  /** Warnings that have been reported by the node. */
+  Vector<geo_log::NodeWarning> warnings;
+  /** False when the node was executed without a logger, so warnings have not been captured. */
+  bool warnings_captured = false;
+  /** Approximate number of bytes that are kept alive by the outputs. */
+  int64_t memory = 0;
+  /** Time it took to compute the outputs. It is logged again when the outputs are reused. */
+  std::chrono::microseconds execution_time{0};
+  /** Keeps the multi-functions alive that are referenced by fields in the inputs and outputs. */
+  std::shared_ptr<ResourceScope> functions_scope;
+  LinearAllocator<> allocator;
+
+  ~NodeCacheEntry();
+};
+
+struct GeometryNodesCacheStats {
+  /** Number of nodes whose outputs have been reused in the last evaluation. */
+  int hits = 0;
+  /** Number of cacheable nodes that had to be executed in the last evaluation. */
+  int misses = 0;
+  /** Number of nodes that are cached and the approximate memory used by their outputs. */
+  int entries = 0;
+  int64_t memory = 0;
+};
+
+/** Persistent cache that is stored in the runtime data of the original modifier. */
+class GeometryNodesCache : NonCopyable, NonMovable {
+ private:
+  /** Only one evaluation can use the cache at the same time. */
+  std::mutex evaluation_mutex_;
+  /** Entries of the last evaluation by node path. */
+  Map<std::string, std::shared_ptr<NodeCacheEntry>> entries_;
+  std::atomic<uint64_t> next_entry_id_ = 1;
+
+  mutable std::mutex stats_mutex_;
+  GeometryNodesCacheStats stats_;
+
+  friend class GeometryNodesCacheEvaluation;
+
+ public:
+  GeometryNodesCacheStats stats() const;
+  /** Free all entries, unless the cache is used by an evaluation currently. */
+  void clear();
+};
+
+/**
+ * Gives the nodes of one evaluation access to the cache. All entries that have been reused or
+ * created during the evaluation replace the entries of the cache when this is destructed.
+ */
+class GeometryNodesCacheEvaluation : NonCopyable, NonMovable {
+ private:
+  GeometryNodesCache &cache_;
+  std::unique_lock<std::mutex> evaluation_lock_;
+  int64_t memory_limit_;
+  std::shared_ptr<ResourceScope> functions_scope_;
+
+  /** Protects all members below. */
+  std::mutex mutex_;
+  Map<std::string, std::shared_ptr<NodeCacheEntry>> new_entries_;
+  int64_t memory_ = 0;
+  int hits_ = 0;
+  int misses_ = 0;
+  /** Versions of all geometry components that are referenced by the cache. */
+  Map<const GeometryComponent *, uint64_t> component_versions_;
+  /** References the geometries passed into the modifier, so that their version stays valid. */
+  Vector<GeometrySet> input_geometries_;
+
+ public:
+  /**
+   * \param functions_scope: Owns the multi-functions of the evaluated node tree. It is kept alive
+   * by the cache, because fields in cached values reference these functions.
+   */
+  GeometryNodesCacheEvaluation(GeometryNodesCache &cache,
+                               int64_t memory_limit,
+                               std::shared_ptr<ResourceScope> functions_scope);
+  ~GeometryNodesCacheEvaluation();
+
+  /** False when the cache is used by another evaluation already. */
+  bool is_active() const;
+
+  /** Give all components of a geometry that is passed into the modifier a version. */
+  void add_input_geometry(const GeometrySet &geometry);
+
+  /**
+   * Gather everything the outputs of the node depend on, before the node is executed.
+   * \return Null when the node can't be cached.
+   */
+  std::unique_ptr<NodeCacheEntry> begin_node(DNode node, Span<NodeCacheInputValue> inputs);
+
+  /**
+   * Find an entry of the previous evaluation that has the same inputs as \a entry and contains
+   * all the given outputs. The versions of its output geometries are registered for this
+   * evaluation, so its outputs can be forwarded directly.
+   */
+  std::shared_ptr<const NodeCacheEntry> find_reusable(const NodeCacheEntry &entry,
+                                                      Span<int> required_outputs,
+                                                      bool need_warnings);
+
+  /** Store a copy of an output value of the node before it is passed on. */
+  void add_output(NodeCacheEntry &entry, int socket_index, GPointer value);
+
+  /** Called after the node has been executed. The entry is kept if it fits into the budget. */
+  void end_node(std::unique_ptr<NodeCacheEntry> entry);
+
+ private:
+  bool geometry_versions(const GeometrySet &geometry, Vector<uint64_t> &r_versions);
+  void register_outputs(const NodeCacheEntry &entry);
+  void unregister_outputs(const NodeCacheEntry &entry);
+};
+
+}  // namespace blender::modifiers::geometry_nodes
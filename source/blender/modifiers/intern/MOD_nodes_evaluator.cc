@@ -28,6 +28,7 @@
 
 #include "BLT_translation.h"
 
+#include "BLI_array.hh"
 #include "BLI_enumerable_thread_specific.hh"
 #include "BLI_stack.hh"
 #include "BLI_task.h"
@@ -227,6 +228,17 @@ struct NodeState {
    * not run twice at the same time accidentally.
    */
   NodeScheduleState schedule_state = NodeScheduleState::NotScheduled;
+
+  /**
+   * Estimated time in seconds from the start of this node until all the group outputs that depend
+   * on it are computed, i.e. the cost of the most expensive path from this node to an output.
+   * When multiple nodes are ready to run, the one with the highest cost is executed first, so that
+   * the critical path of the tree is started as early as possible.
+   *
+   * This is computed before evaluation starts and is not changed afterwards, so it can be read
+   * without a lock.
+   */
+  float critical_path_cost = 0.0f;
 };
 
 /**
@@ -365,6 +377,9 @@ class NodeParamsProvider : public nodes::GeoNodeExecParamsProvider {
 
   bool lazy_require_input(StringRef identifier) override;
   bool lazy_output_is_required(StringRef identifier) const override;
+
+  /* Outputs are copied into this entry when the node is cached. */
+  NodeCacheEntry *cache_entry = nullptr;
 };
 
 class GeometryNodesEvaluator {
@@ -395,6 +410,14 @@ class GeometryNodesEvaluator {
    */
   TaskPool *task_pool_ = nullptr;
 
+  /**
+   * Nodes that have been scheduled but did not start running yet, as a heap ordered by
+   * #NodeState::critical_path_cost. A task in the pool does not run a specific node. Instead, it
+   * runs the most important node that is ready at the time the task starts. There is exactly one
+   * task in the pool for every node in this heap.
+   */
+  ReadyNodeHeap<const NodeWithState *> ready_nodes_;
+
   GeometryNodesEvaluationParams &params_;
   const blender::nodes::DataTypeConversions &conversions_;
 
@@ -413,6 +436,7 @@ class GeometryNodesEvaluator {
     task_pool_ = BLI_task_pool_create(this, TASK_PRIORITY_HIGH);
 
     this->create_states_for_reachable_nodes();
+    this->compute_critical_path_costs();
     this->forward_group_inputs();
     this->schedule_initial_nodes();
 
@@ -468,6 +492,60 @@ class GeometryNodesEvaluator {
         });
   }
 
+  /**
+   * Compute #NodeState::critical_path_cost for all nodes. The users of a node are the nodes
+   * closer to the group outputs.
+   */
+  void compute_critical_path_costs()
+  {
+    Array<float> node_costs(node_states_.size());
+    for (const int64_t i : IndexRange(node_states_.size())) {
+      node_costs[i] = this->estimate_node_cost(node_states_[i].node);
+    }
+    Array<float> path_costs(node_states_.size());
+    geometry_nodes::compute_critical_path_costs(
+        node_costs,
+        [&](const int64_t node_index, FunctionRef<void(int64_t user_index)> fn) {
+          const DNode node = node_states_[node_index].node;
+          for (const OutputSocketRef *output_ref : node->outputs()) {
+            const DOutputSocket output{node.context(), output_ref};
+            output.foreach_target_socket(
+                [&](const DInputSocket target) {
+                  /* Users that are not reachable from the group outputs have no state. */
+                  const int64_t user_index = node_states_.index_of_try_as(target.node());
+                  if (user_index != -1) {
+                    fn(user_index);
+                  }
+                },
+                [](const DSocket UNUSED(skipped_socket)) {});
+          }
+        },
+        path_costs);
+    for (const int64_t i : IndexRange(node_states_.size())) {
+      node_states_[i].state->critical_path_cost = path_costs[i];
+    }
+  }
+
+  /**
+   * Estimated execution time of the node in seconds. Uses the time the node took in the previous
+   * evaluation if it is known.
+   */
+  float estimate_node_cost(const DNode node) const
+  {
+    if (params_.previous_log != nullptr) {
+      const geo_log::NodeLog *node_log = params_.previous_log->lookup_node_log(node);
+      if (node_log != nullptr) {
+        return std::chrono::duration<float>(node_log->execution_time()).count();
+      }
+    }
+    if (node->typeinfo()->geometry_node_execute != nullptr) {
+      /* Geometry nodes generally do their work when they are executed. */
+      return 1e-3f;
+    }
+    /* Other nodes typically only build fields which are evaluated later. */
+    return 1e-6f;
+  }
+
   void initialize_node_state(const DNode node, NodeState &node_state, LinearAllocator<> &allocator)
   {
     /* Construct arrays of the correct size. */
@@ -653,11 +731,11 @@ class GeometryNodesEvaluator {
     }
   }
 
-  static void run_node_from_task_pool(TaskPool *task_pool, void *task_data)
+  static void run_node_from_task_pool(TaskPool *task_pool, void *UNUSED(task_data))
   {
     void *user_data = BLI_task_pool_user_data(task_pool);
     GeometryNodesEvaluator &evaluator = *(GeometryNodesEvaluator *)user_data;
-    const NodeWithState *node_with_state = (const NodeWithState *)task_data;
+    const NodeWithState *node_with_state = evaluator.ready_nodes_.pop();
 
     evaluator.node_task_run(node_with_state->node, *node_with_state->state);
   }
@@ -848,27 +926,50 @@ class GeometryNodesEvaluator {
     }
     node_state.has_been_executed = true;
 
-    /* Use the geometry node execute callback if it exists. */
+    /* Use the geometry node execute callback if it exists. It logs the execution time itself,
+     * because the outputs might be reused from the cache. */
     if (bnode.typeinfo->geometry_node_execute != nullptr) {
       this->execute_geometry_node(node, node_state);
       return;
     }
 
+    const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
     /* Use the multi-function implementation if it exists. */
     const MultiFunction *multi_function = params_.mf_by_node->try_get(node);
     if (multi_function != nullptr) {
       this->execute_multi_function_node(node, *multi_function, node_state);
-      return;
     }
-
-    this->execute_unknown_node(node, node_state);
+    else {
+      this->execute_unknown_node(node, node_state);
+    }
+    this->log_execution_time(node, std::chrono::steady_clock::now() - begin);
   }
 
   void execute_geometry_node(const DNode node, NodeState &node_state)
   {
     const bNode &bnode = *node->bnode();
+    const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+    std::unique_ptr<NodeCacheEntry> cache_entry;
+    if (params_.cache != nullptr) {
+      Vector<NodeCacheInputValue> input_values;
+      if (this->get_input_values_for_cache(node, node_state, input_values)) {
+        cache_entry = params_.cache->begin_node(node, input_values);
+      }
+      if (cache_entry && this->try_reuse_cached_outputs(node, node_state, *cache_entry)) {
+        return;
+      }
+    }
+
+    geo_log::LocalGeoLogger *local_logger = nullptr;
+    int64_t warnings_start = 0;
+    if (cache_entry && params_.geo_logger != nullptr) {
+      local_logger = &params_.geo_logger->local();
+      warnings_start = local_logger->node_warnings().size();
+    }
 
     NodeParamsProvider params_provider{*this, node, node_state};
+    params_provider.cache_entry = cache_entry.get();
     GeoNodeExecParams params{params_provider};
     if (USER_EXPERIMENTAL_TEST(&U, use_geometry_nodes_fields)) {
       if (node->idname().find("Legacy") != StringRef::not_found) {
@@ -877,6 +978,118 @@ class GeometryNodesEvaluator {
       }
     }
     bnode.typeinfo->geometry_node_execute(params);
+
+    const std::chrono::steady_clock::duration execution_time = std::chrono::steady_clock::now() -
+                                                               begin;
+    this->log_execution_time(node, execution_time);
+
+    if (cache_entry) {
+      cache_entry->execution_time = std::chrono::duration_cast<std::chrono::microseconds>(
+          execution_time);
+      if (local_logger != nullptr) {
+        /* Other nodes might have been executed by this thread in the mean time. */
+        for (const geo_log::NodeWithWarning &warning :
+             local_logger->node_warnings().drop_front(warnings_start)) {
+          if (warning.node == node) {
+            cache_entry->warnings.append(warning.warning);
+          }
+        }
+        cache_entry->warnings_captured = true;
+      }
+      params_.cache->end_node(std::move(cache_entry));
+    }
+  }
+
+  /**
+   * Get the values that are passed into the node, without extracting them. Values of multi-input
+   * sockets are in the order of the links.
+   */
+  bool get_input_values_for_cache(const DNode node,
+                                  NodeState &node_state,
+                                  Vector<NodeCacheInputValue> &r_values)
+  {
+    for (const int i : node->inputs().index_range()) {
+      const InputSocketRef &socket_ref = node->input(i);
+      InputState &input_state = node_state.inputs[i];
+      if (!socket_ref.is_available() || input_state.type == nullptr) {
+        continue;
+      }
+      if (!input_state.was_ready_for_execution) {
+        return false;
+      }
+      if (!socket_ref.is_multi_input_socket()) {
+        const SingleInputValue &single_value = *input_state.value.single;
+        if (single_value.value == nullptr) {
+          return false;
+        }
+        r_values.append({i, {*input_state.type, single_value.value}});
+        continue;
+      }
+      const MultiInputValue &multi_value = *input_state.value.multi;
+      Array<bool> item_is_used(multi_value.items.size(), false);
+      const DInputSocket socket{node.context(), &socket_ref};
+      socket.foreach_origin_socket([&](DSocket origin) {
+        for (const int item_index : multi_value.items.index_range()) {
+          const MultiInputValueItem &item = multi_value.items[item_index];
+          if (item.origin == origin && item.value != nullptr && !item_is_used[item_index]) {
+            item_is_used[item_index] = true;
+            r_values.append({i, {*input_state.type, item.value}});
+            return;
+          }
+        }
+      });
+      if (!item_is_used.as_span().contains(true)) {
+        /* The socket is not linked, so the value from the socket itself is used. */
+        if (multi_value.items.size() != 1 || multi_value.items[0].value == nullptr) {
+          return false;
+        }
+        r_values.append({i, {*input_state.type, multi_value.items[0].value}});
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Forward the outputs of an earlier execution of the node with the same inputs.
+   * \return False when the node has to be executed.
+   */
+  bool try_reuse_cached_outputs(const DNode node,
+                                NodeState &node_state,
+                                const NodeCacheEntry &cache_entry)
+  {
+    Vector<int> required_outputs;
+    for (const int i : node->outputs().index_range()) {
+      const OutputState &output_state = node_state.outputs[i];
+      if (node->output(i).is_available() && !output_state.has_been_computed &&
+          output_state.output_usage_for_execution != ValueUsage::Unused) {
+        required_outputs.append(i);
+      }
+    }
+    std::shared_ptr<const NodeCacheEntry> cached_entry = params_.cache->find_reusable(
+        cache_entry, required_outputs, params_.geo_logger != nullptr);
+    if (!cached_entry) {
+      return false;
+    }
+
+    LinearAllocator<> &allocator = local_allocators_.local();
+    for (const int i : required_outputs) {
+      const GMutablePointer cached_value = cached_entry->outputs[i];
+      const CPPType &type = *cached_value.type();
+      void *buffer = allocator.allocate(type.size(), type.alignment());
+      type.copy_construct(cached_value.get(), buffer);
+      this->forward_output(node.output(i), {type, buffer});
+      node_state.outputs[i].has_been_computed = true;
+    }
+    if (params_.geo_logger != nullptr) {
+      geo_log::LocalGeoLogger &local_logger = params_.geo_logger->local();
+      for (const geo_log::NodeWarning &warning : cached_entry->warnings) {
+        local_logger.log_node_warning(node, warning.type, warning.message);
+      }
+      /* Log the time of the execution that computed the outputs, so that the node is still
+       * estimated to be expensive in the next evaluation, when its inputs may have changed. */
+      local_logger.log_execution_time(node, cached_entry->execution_time);
+    }
+    return true;
   }
 
   void execute_multi_function_node(const DNode node,
@@ -1182,8 +1395,8 @@ class GeometryNodesEvaluator {
     /* Push the task to the pool while it is not locked to avoid a deadlock in case when the task
      * is executed immediately. */
     const NodeWithState *node_with_state = node_states_.lookup_key_ptr_as(node);
-    BLI_task_pool_push(
-        task_pool_, run_node_from_task_pool, (void *)node_with_state, false, nullptr);
+    ready_nodes_.push(node_with_state, node_with_state->state->critical_path_cost);
+    BLI_task_pool_push(task_pool_, run_node_from_task_pool, nullptr, false, nullptr);
   }
 
   /**
@@ -1470,6 +1683,15 @@ class GeometryNodesEvaluator {
     params_.geo_logger->local().log_value_for_sockets(sockets, value);
   }
 
+  void log_execution_time(const DNode node, const std::chrono::steady_clock::duration exec_time)
+  {
+    if (params_.geo_logger == nullptr) {
+      return;
+    }
+    params_.geo_logger->local().log_execution_time(
+        node, std::chrono::duration_cast<std::chrono::microseconds>(exec_time));
+  }
+
   /* In most cases when `NodeState` is accessed, the node has to be locked first to avoid race
    * conditions. */
   template<typename Function>
@@ -1608,6 +1830,9 @@ void NodeParamsProvider::set_output(StringRef identifier, GMutablePointer value)
 
   OutputState &output_state = node_state_.outputs[socket->index()];
   BLI_assert(!output_state.has_been_computed);
+  if (cache_entry != nullptr) {
+    evaluator_.params_.cache->add_output(*cache_entry, socket->index(), value);
+  }
   evaluator_.forward_output(socket, value);
   output_state.has_been_computed = true;
 }
@@ -1669,4 +1894,42 @@ void evaluate_geometry_nodes(GeometryNodesEvaluationParams &params)
   evaluator.execute();
 }
 
+void compute_critical_path_costs(
+    const Span<float> node_costs,
+    const FunctionRef<void(int64_t node_index, FunctionRef<void(int64_t user_index)> fn)>
+        foreach_user,
+    MutableSpan<float> r_path_costs)
+{
+  BLI_assert(node_costs.size() == r_path_costs.size());
+  /* Every node is handled after all of its users. */
+  Array<bool> is_computed(node_costs.size(), false);
+  Stack<int64_t> nodes_to_check;
+  for (const int64_t i : node_costs.index_range()) {
+    nodes_to_check.push(i);
+  }
+  while (!nodes_to_check.is_empty()) {
+    const int64_t node_index = nodes_to_check.peek();
+    if (is_computed[node_index]) {
+      nodes_to_check.pop();
+      continue;
+    }
+    float max_user_cost = 0.0f;
+    bool all_user_costs_computed = true;
+    foreach_user(node_index, [&](const int64_t user_index) {
+      if (is_computed[user_index]) {
+        max_user_cost = std::max(max_user_cost, r_path_costs[user_index]);
+      }
+      else {
+        all_user_costs_computed = false;
+        nodes_to_check.push(user_index);
+      }
+    });
+    if (all_user_costs_computed) {
+      r_path_costs[node_index] = node_costs[node_index] + max_user_cost;
+      is_computed[node_index] = true;
+      nodes_to_check.pop();
+    }
+  }
+}
+
 }  // namespace blender::modifiers::geometry_nodes
@@ -16,7 +16,12 @@
 
 #pragma once
 
+#include <algorithm>
+#include <mutex>
+
+#include "BLI_function_ref.hh"
 #include "BLI_map.hh"
+#include "BLI_vector.hh"
 
 #include "NOD_derived_node_tree.hh"
 #include "NOD_geometry_nodes_eval_log.hh"
@@ -28,6 +33,8 @@
 
 #include "FN_multi_function.hh"
 
+#include "MOD_nodes_cache.hh"
+
 namespace geo_log = blender::nodes::geometry_nodes_eval_log;
 
 namespace blender::modifiers::geometry_nodes {
@@ -52,10 +59,62 @@ struct GeometryNodesEvaluationParams {
   Depsgraph *depsgraph;
   Object *self_object;
   geo_log::GeoLogger *geo_logger;
+  /* Log of a previous evaluation of the same node tree. When available, the logged execution
+   * times are used to decide which nodes to execute first. */
+  const geo_log::ModifierLog *previous_log = nullptr;
+  /* Outputs of nodes are reused from and stored in this cache when it is not null. */
+  GeometryNodesCacheEvaluation *cache = nullptr;
 
   Vector<GMutablePointer> r_output_values;
 };
 
 void evaluate_geometry_nodes(GeometryNodesEvaluationParams &params);
 
+/**
+ * Compute the cost of the most expensive path from every node to a node without users. The cost
+ * of a path is the sum of the costs of its nodes. Nodes are referenced by their index.
+ * \param foreach_user: Calls the given function for every user of a node. Users that are
+ * reported multiple times are fine, cycles are not.
+ */
+void compute_critical_path_costs(
+    Span<float> node_costs,
+    FunctionRef<void(int64_t node_index, FunctionRef<void(int64_t user_index)> fn)> foreach_user,
+    MutableSpan<float> r_path_costs);
+
+/**
+ * Nodes that are ready to be executed, ordered by a cost such as the critical path cost. Values
+ * can be pushed and popped from multiple threads.
+ */
+template<typename T> class ReadyNodeHeap : NonCopyable, NonMovable {
+ private:
+  struct Item {
+    T value;
+    float cost;
+  };
+  Vector<Item> items_;
+  std::mutex mutex_;
+
+  static bool is_less_important(const Item &a, const Item &b)
+  {
+    return a.cost < b.cost;
+  }
+
+ public:
+  void push(T value, const float cost)
+  {
+    std::lock_guard lock{mutex_};
+    items_.append({std::move(value), cost});
+    std::push_heap(items_.begin(), items_.end(), is_less_important);
+  }
+
+  /** Remove the value with the highest cost. The heap must not be empty. */
+  T pop()
+  {
+    std::lock_guard lock{mutex_};
+    BLI_assert(!items_.is_empty());
+    std::pop_heap(items_.begin(), items_.end(), is_less_important);
+    return items_.pop_last().value;
+  }
+};
+
 }  // namespace blender::modifiers::geometry_nodes
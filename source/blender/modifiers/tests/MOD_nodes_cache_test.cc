@@ -0,0 +1,237 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <array>
+
+#include "MOD_nodes_cache.hh"
+
+#include "DNA_material_types.h"
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+#include "DNA_node_types.h"
+
+#include "BLI_float3.hh"
+
+#include "BKE_idtype.h"
+#include "BKE_lib_id.h"
+#include "BKE_mesh.h"
+#include "BKE_node.h"
+
+namespace blender::modifiers::geometry_nodes::tests {
+
+class NodesCacheTest : public testing::Test {
+ protected:
+  bNodeTree *ntree_ = nullptr;
+  GeometryNodesCache cache_;
+
+  static void SetUpTestCase()
+  {
+    BKE_idtype_init();
+    BKE_node_system_init();
+  }
+
+  static void TearDownTestCase()
+  {
+    BKE_node_system_exit();
+  }
+
+  void SetUp() override
+  {
+    ntree_ = ntreeAddTree(nullptr, "Test", "GeometryNodeTree");
+  }
+
+  void TearDown() override
+  {
+    BKE_id_free(nullptr, ntree_);
+  }
+
+  static DNode find_node(const DerivedNodeTree &tree, const bNode *bnode)
+  {
+    for (const NodeRef *node_ref : tree.root_context().tree().nodes()) {
+      if (node_ref->bnode() == bnode) {
+        return {&tree.root_context(), node_ref};
+      }
+    }
+    return {};
+  }
+
+  /**
+   * Run a single node through the cache like the modifier does.
+   * \return True when the outputs of a previous evaluation have been reused.
+   */
+  bool evaluate(bNode *bnode,
+                Span<NodeCacheInputValue> inputs,
+                const GeometrySet &input_geometry,
+                const GeometrySet &output_geometry,
+                const int64_t memory_limit = 1024 * 1024 * 1024)
+  {
+    NodeTreeRefMap tree_refs;
+    DerivedNodeTree tree{*ntree_, tree_refs};
+    GeometryNodesCacheEvaluation evaluation{
+        cache_, memory_limit, std::make_shared<ResourceScope>()};
+    EXPECT_TRUE(evaluation.is_active());
+    evaluation.add_input_geometry(input_geometry);
+
+    std::unique_ptr<NodeCacheEntry> entry = evaluation.begin_node(find_node(tree, bnode), inputs);
+    if (!entry) {
+      ADD_FAILURE() << "Node is not cacheable";
+      return false;
+    }
+    const std::array<int, 1> required_outputs = {0};
+    if (evaluation.find_reusable(*entry, required_outputs, false)) {
+      return true;
+    }
+    evaluation.add_output(*entry, 0, &output_geometry);
+    evaluation.end_node(std::move(entry));
+    return false;
+  }
+};
+
+static GeometrySet create_mesh_geometry()
+{
+  return GeometrySet::create_with_mesh(BKE_mesh_new_nomain(4, 0, 0, 0, 0));
+}
+
+TEST_F(NodesCacheTest, ReuseUnchangedNode)
+{
+  bNode *circle = nodeAddNode(nullptr, ntree_, "GeometryNodeMeshCircle");
+  const int vertices = 32;
+  const float radius = 1.0f;
+  const std::array<NodeCacheInputValue, 2> inputs = {
+      NodeCacheInputValue{0, &vertices}, NodeCacheInputValue{1, &radius}};
+  const GeometrySet output = create_mesh_geometry();
+
+  EXPECT_FALSE(this->evaluate(circle, inputs, {}, output));
+  EXPECT_TRUE(this->evaluate(circle, inputs, {}, output));
+  EXPECT_TRUE(this->evaluate(circle, inputs, {}, output));
+
+  const GeometryNodesCacheStats stats = cache_.stats();
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 0);
+  EXPECT_EQ(stats.entries, 1);
+  EXPECT_GT(stats.memory, 0);
+}
+
+TEST_F(NodesCacheTest, InvalidateAfterInputChange)
+{
+  bNode *circle = nodeAddNode(nullptr, ntree_, "GeometryNodeMeshCircle");
+  const int vertices = 32;
+  float radius = 1.0f;
+  const std::array<NodeCacheInputValue, 2> inputs = {
+      NodeCacheInputValue{0, &vertices}, NodeCacheInputValue{1, &radius}};
+  const GeometrySet output = create_mesh_geometry();
+
+  EXPECT_FALSE(this->evaluate(circle, inputs, {}, output));
+  radius = 2.0f;
+  EXPECT_FALSE(this->evaluate(circle, inputs, {}, output));
+  EXPECT_TRUE(this->evaluate(circle, inputs, {}, output));
+}
+
+TEST_F(NodesCacheTest, InvalidateAfterSettingChange)
+{
+  bNode *circle = nodeAddNode(nullptr, ntree_, "GeometryNodeMeshCircle");
+  const int vertices = 32;
+  const float radius = 1.0f;
+  const std::array<NodeCacheInputValue, 2> inputs = {
+      NodeCacheInputValue{0, &vertices}, NodeCacheInputValue{1, &radius}};
+  const GeometrySet output = create_mesh_geometry();
+
+  EXPECT_FALSE(this->evaluate(circle, inputs, {}, output));
+  NodeGeometryMeshCircle *storage = static_cast<NodeGeometryMeshCircle *>(circle->storage);
+  storage->fill_type = GEO_NODE_MESH_CIRCLE_FILL_NGON;
+  EXPECT_FALSE(this->evaluate(circle, inputs, {}, output));
+  EXPECT_TRUE(this->evaluate(circle, inputs, {}, output));
+}
+
+TEST_F(NodesCacheTest, InvalidateAfterGeometryChange)
+{
+  bNode *transform = nodeAddNode(nullptr, ntree_, "GeometryNodeTransform");
+  GeometrySet geometry = create_mesh_geometry();
+  const float3 translation{1.0f, 0.0f, 0.0f};
+  const std::array<NodeCacheInputValue, 2> inputs = {
+      NodeCacheInputValue{0, &geometry}, NodeCacheInputValue{1, &translation}};
+  const GeometrySet output = create_mesh_geometry();
+
+  EXPECT_FALSE(this->evaluate(transform, inputs, geometry, output));
+  EXPECT_TRUE(this->evaluate(transform, inputs, geometry, output));
+
+  Mesh *mesh = geometry.get_mesh_for_write();
+  mesh->mvert[0].co[0] = 5.0f;
+  EXPECT_FALSE(this->evaluate(transform, inputs, geometry, output));
+  EXPECT_TRUE(this->evaluate(transform, inputs, geometry, output));
+}
+
+TEST_F(NodesCacheTest, MemoryLimit)
+{
+  bNode *circle = nodeAddNode(nullptr, ntree_, "GeometryNodeMeshCircle");
+  const int vertices = 32;
+  const float radius = 1.0f;
+  const std::array<NodeCacheInputValue, 2> inputs = {
+      NodeCacheInputValue{0, &vertices}, NodeCacheInputValue{1, &radius}};
+  const GeometrySet output = create_mesh_geometry();
+
+  EXPECT_FALSE(this->evaluate(circle, inputs, {}, output, 0));
+  EXPECT_EQ(cache_.stats().entries, 0);
+  EXPECT_FALSE(this->evaluate(circle, inputs, {}, output, 0));
+
+  /* An entry that has been kept is dropped once it doesn't fit into the budget anymore. */
+  EXPECT_FALSE(this->evaluate(circle, inputs, {}, output));
+  EXPECT_EQ(cache_.stats().entries, 1);
+  EXPECT_TRUE(this->evaluate(circle, inputs, {}, output, 0));
+  EXPECT_EQ(cache_.stats().entries, 0);
+  EXPECT_FALSE(this->evaluate(circle, inputs, {}, output));
+}
+
+TEST_F(NodesCacheTest, KeepExecutionTime)
+{
+  bNode *circle = nodeAddNode(nullptr, ntree_, "GeometryNodeMeshCircle");
+  const int vertices = 32;
+  const float radius = 1.0f;
+  const std::array<NodeCacheInputValue, 2> inputs = {
+      NodeCacheInputValue{0, &vertices}, NodeCacheInputValue{1, &radius}};
+  const GeometrySet output = create_mesh_geometry();
+  const std::array<int, 1> required_outputs = {0};
+  NodeTreeRefMap tree_refs;
+  DerivedNodeTree tree{*ntree_, tree_refs};
+
+  {
+    GeometryNodesCacheEvaluation evaluation{
+        cache_, 1024 * 1024 * 1024, std::make_shared<ResourceScope>()};
+    std::unique_ptr<NodeCacheEntry> entry = evaluation.begin_node(find_node(tree, circle), inputs);
+    ASSERT_NE(entry, nullptr);
+    evaluation.add_output(*entry, 0, &output);
+    entry->execution_time = std::chrono::microseconds(5000);
+    evaluation.end_node(std::move(entry));
+  }
+  /* The time of the original execution is kept by every evaluation that reuses the outputs. */
+  for (int i = 0; i < 2; i++) {
+    GeometryNodesCacheEvaluation evaluation{
+        cache_, 1024 * 1024 * 1024, std::make_shared<ResourceScope>()};
+    std::unique_ptr<NodeCacheEntry> entry = evaluation.begin_node(find_node(tree, circle), inputs);
+    ASSERT_NE(entry, nullptr);
+    std::shared_ptr<const NodeCacheEntry> cached_entry = evaluation.find_reusable(
+        *entry, required_outputs, false);
+    ASSERT_NE(cached_entry, nullptr);
+    EXPECT_EQ(cached_entry->execution_time, std::chrono::microseconds(5000));
+  }
+}
+
+TEST_F(NodesCacheTest, DataBlockNodesAreNotCached)
+{
+  bNode *material_node = nodeAddNode(nullptr, ntree_, "GeometryNodeInputMaterial");
+  Material *material = static_cast<Material *>(BKE_id_new_nomain(ID_MA, nullptr));
+  material_node->id = &material->id;
+
+  {
+    NodeTreeRefMap tree_refs;
+    DerivedNodeTree tree{*ntree_, tree_refs};
+    GeometryNodesCacheEvaluation evaluation{cache_, 1024, std::make_shared<ResourceScope>()};
+    EXPECT_EQ(evaluation.begin_node(find_node(tree, material_node), {}), nullptr);
+  }
+
+  material_node->id = nullptr;
+  BKE_id_free(nullptr, material);
+}
+
+}  // namespace blender::modifiers::geometry_nodes::tests
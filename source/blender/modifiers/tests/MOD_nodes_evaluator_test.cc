@@ -0,0 +1,86 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "BLI_array.hh"
+#include "BLI_task.hh"
+
+#include "MOD_nodes_evaluator.hh"
+
+namespace blender::modifiers::geometry_nodes::tests {
+
+TEST(nodes_evaluator, CriticalPathCosts)
+{
+  /**
+   *       1 ---> 3 ---> 4
+   *     /             /
+   *   0 ---> 2 ------
+   *               5 (no users)
+   */
+  const Array<Vector<int64_t>> users = {{1, 2, 2}, {3}, {4}, {4}, {}, {}};
+  const Array<float> node_costs = {1.0f, 2.0f, 10.0f, 3.0f, 0.5f, 4.0f};
+  Array<float> path_costs(node_costs.size(), -1.0f);
+  compute_critical_path_costs(
+      node_costs,
+      [&](const int64_t node_index, FunctionRef<void(int64_t user_index)> fn) {
+        for (const int64_t user_index : users[node_index]) {
+          fn(user_index);
+        }
+      },
+      path_costs);
+
+  EXPECT_FLOAT_EQ(path_costs[4], 0.5f);
+  EXPECT_FLOAT_EQ(path_costs[3], 3.5f);
+  EXPECT_FLOAT_EQ(path_costs[2], 10.5f);
+  EXPECT_FLOAT_EQ(path_costs[1], 5.5f);
+  /* The path through the expensive node is the critical one. */
+  EXPECT_FLOAT_EQ(path_costs[0], 11.5f);
+  EXPECT_FLOAT_EQ(path_costs[5], 4.0f);
+}
+
+TEST(nodes_evaluator, CriticalPathCostsLongChain)
+{
+  /* Deep trees must not overflow the call stack. */
+  const int64_t size = 100000;
+  const Array<float> node_costs(size, 1.0f);
+  Array<float> path_costs(size);
+  compute_critical_path_costs(
+      node_costs,
+      [&](const int64_t node_index, FunctionRef<void(int64_t user_index)> fn) {
+        if (node_index + 1 < size) {
+          fn(node_index + 1);
+        }
+      },
+      path_costs);
+  EXPECT_FLOAT_EQ(path_costs[0], float(size));
+  EXPECT_FLOAT_EQ(path_costs[size - 1], 1.0f);
+}
+
+TEST(nodes_evaluator, ReadyNodeHeapOrder)
+{
+  ReadyNodeHeap<int> heap;
+  heap.push(1, 0.5f);
+  heap.push(2, 3.0f);
+  heap.push(3, 1.0f);
+  EXPECT_EQ(heap.pop(), 2);
+  heap.push(4, 2.0f);
+  EXPECT_EQ(heap.pop(), 4);
+  EXPECT_EQ(heap.pop(), 3);
+  EXPECT_EQ(heap.pop(), 1);
+}
+
+TEST(nodes_evaluator, ReadyNodeHeapThreaded)
+{
+  ReadyNodeHeap<int> heap;
+  const int size = 10000;
+  threading::parallel_for(IndexRange(size), 100, [&](const IndexRange range) {
+    for (const int i : range) {
+      heap.push(i, float(i));
+    }
+  });
+  for (int i = size - 1; i >= 0; i--) {
+    EXPECT_EQ(heap.pop(), i);
+  }
+}
+
+}  // namespace blender::modifiers::geometry_nodes::tests
@@ -19,7 +19,7 @@
 /**
  * Many geometry nodes related UI features need access to data produced during evaluation. Not only
  * is the final output required but also the intermediate results. Those features include
- * attribute search, node warnings, socket inspection and the viewer node.
+ * attribute search, node warnings, node timings, socket inspection and the viewer node.
  *
  * This file provides the framework for logging data during evaluation and accessing the data after
  * evaluation.
@@ -30,6 +30,8 @@
  * necessary information.
  */
 
+#include <chrono>
+
 #include "BLI_enumerable_thread_specific.hh"
 #include "BLI_function_ref.hh"
 #include "BLI_linear_allocator.hh"
@@ -144,6 +146,11 @@ struct NodeWithWarning {
   NodeWarning warning;
 };
 
+struct NodeWithExecutionTime {
+  DNode node;
+  std::chrono::microseconds exec_time;
+};
+
 /** The same value can be referenced by multiple sockets when they are linked. */
 struct ValueOfSockets {
   Span<DSocket> sockets;
@@ -164,6 +171,7 @@ class LocalGeoLogger {
   std::unique_ptr<LinearAllocator<>> allocator_;
   Vector<ValueOfSockets> values_;
   Vector<NodeWithWarning> node_warnings_;
+  Vector<NodeWithExecutionTime> node_exec_times_;
 
   friend ModifierLog;
 
@@ -176,6 +184,13 @@ class LocalGeoLogger {
   void log_value_for_sockets(Span<DSocket> sockets, GPointer value);
   void log_multi_value_socket(DSocket socket, Span<GPointer> values);
   void log_node_warning(DNode node, NodeWarningType type, std::string message);
+  void log_execution_time(DNode node, std::chrono::microseconds exec_time);
+
+  /** All warnings that have been logged by this thread so far, in the order they were logged. */
+  Span<NodeWithWarning> node_warnings() const
+  {
+    return node_warnings_;
+  }
 };
 
 /** The root logger class. */
@@ -232,6 +247,8 @@ class NodeLog {
   Vector<SocketLog> input_logs_;
   Vector<SocketLog> output_logs_;
   Vector<NodeWarning, 0> warnings_;
+  /* Total time spent executing the node, summed over all threads. */
+  std::chrono::microseconds exec_time_{0};
 
   friend ModifierLog;
 
@@ -254,6 +271,11 @@ class NodeLog {
     return warnings_;
   }
 
+  std::chrono::microseconds execution_time() const
+  {
+    return exec_time_;
+  }
+
   Vector<const GeometryAttributeInfo *> lookup_available_attributes() const;
 };
 
@@ -289,6 +311,11 @@ class ModifierLog {
     return *root_tree_logs_;
   }
 
+  /* Find the log of a node in the tree that has been evaluated, in a later evaluation of the same
+   * tree. */
+  const TreeLog *lookup_tree_log(const DTreeContext &tree_context) const;
+  const NodeLog *lookup_node_log(DNode node) const;
+
   /* Utilities to find logged information for a specific context. */
   static const ModifierLog *find_root_by_node_editor_context(const SpaceNode &snode);
   static const TreeLog *find_tree_by_node_editor_context(const SpaceNode &snode);
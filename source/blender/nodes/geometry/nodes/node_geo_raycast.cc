@@ -14,6 +14,8 @@
  * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
  */
 
+#include "BLI_task.hh"
+
 #include "DNA_mesh_types.h"
 
 #include "BKE_bvhutils.h"
@@ -101,21 +103,32 @@ static void raycast_to_mesh(const Mesh &mesh,
     return;
   }
 
-  for (const int i : ray_origins.index_range()) {
-    const float ray_length = ray_lengths[i];
-    const float3 ray_origin = ray_origins[i];
-    const float3 ray_direction = ray_directions[i].normalized();
-
-    BVHTreeRayHit hit;
-    hit.index = -1;
-    hit.dist = ray_length;
-    if (BLI_bvhtree_ray_cast(tree_data.tree,
-                             ray_origin,
-                             ray_direction,
+  const int rays_num = ray_origins.size();
+  Array<float3> origins(rays_num);
+  Array<float3> directions(rays_num);
+  Array<BVHTreeRayHit> hits(rays_num);
+  threading::parallel_for(IndexRange(rays_num), 1024, [&](IndexRange range) {
+    for (const int i : range) {
+      origins[i] = ray_origins[i];
+      directions[i] = ray_directions[i].normalized();
+      hits[i].index = -1;
+      hits[i].dist = ray_lengths[i];
+    }
+  });
+
+  BLI_bvhtree_ray_cast_batch(tree_data.tree,
+                             reinterpret_cast<const float(*)[3]>(origins.data()),
+                             reinterpret_cast<const float(*)[3]>(directions.data()),
+                             rays_num,
                              0.0f,
-                             &hit,
+                             hits.data(),
                              tree_data.raycast_callback,
-                             &tree_data) != -1) {
+                             &tree_data,
+                             BVH_RAYCAST_DEFAULT);
+
+  for (const int i : IndexRange(rays_num)) {
+    const BVHTreeRayHit &hit = hits[i];
+    if (hit.index != -1) {
       if (!r_hit.is_empty()) {
         r_hit[i] = hit.index >= 0;
       }
@@ -147,7 +160,7 @@ static void raycast_to_mesh(const Mesh &mesh,
         r_hit_normals[i] = float3(0.0f, 0.0f, 0.0f);
       }
       if (!r_hit_distances.is_empty()) {
-        r_hit_distances[i] = ray_length;
+        r_hit_distances[i] = ray_lengths[i];
       }
     }
   }
@@ -54,6 +54,12 @@ ModifierLog::ModifierLog(GeoLogger &logger)
                                                        node_with_warning.node);
       node_log.warnings_.append(node_with_warning.warning);
     }
+
+    for (NodeWithExecutionTime &node_with_exec_time : local_logger.node_exec_times_) {
+      NodeLog &node_log = this->lookup_or_add_node_log(log_by_tree_context,
+                                                       node_with_exec_time.node);
+      node_log.exec_time_ += node_with_exec_time.exec_time;
+    }
   }
 }
 
@@ -99,6 +105,28 @@ SocketLog &ModifierLog::lookup_or_add_socket_log(LogByTreeContext &log_by_tree_c
   return socket_log;
 }
 
+const TreeLog *ModifierLog::lookup_tree_log(const DTreeContext &tree_context) const
+{
+  const DTreeContext *parent_context = tree_context.parent_context();
+  if (parent_context == nullptr) {
+    return root_tree_logs_.get();
+  }
+  const TreeLog *parent_log = this->lookup_tree_log(*parent_context);
+  if (parent_log == nullptr) {
+    return nullptr;
+  }
+  return parent_log->lookup_child_log(tree_context.parent_node()->name());
+}
+
+const NodeLog *ModifierLog::lookup_node_log(const DNode node) const
+{
+  const TreeLog *tree_log = this->lookup_tree_log(*node.context());
+  if (tree_log == nullptr) {
+    return nullptr;
+  }
+  return tree_log->lookup_node_log(node->name());
+}
+
 void ModifierLog::foreach_node_log(FunctionRef<void(const NodeLog &)> fn) const
 {
   if (root_tree_logs_) {
@@ -378,4 +406,9 @@ void LocalGeoLogger::log_node_warning(DNode node, NodeWarningType type, std::str
   node_warnings_.append({node, {type, std::move(message)}});
 }
 
+void LocalGeoLogger::log_execution_time(DNode node, std::chrono::microseconds exec_time)
+{
+  node_exec_times_.append({node, exec_time});
+}
+
 }  // namespace blender::nodes::geometry_nodes_eval_log
@@ -48,6 +48,7 @@
 #include "BKE_fcurve.h"
 #include "BKE_lib_id.h"
 #include "BKE_main.h"
+#include "BKE_packedFile.h"
 
 #include "IMB_colormanagement.h"
 #include "IMB_imbuf.h"
@@ -3785,7 +3786,7 @@ void SEQ_effect_text_font_load(TextVars *data, const bool do_id_user)
     id_us_plus(&vfont->id);
   }
 
-  if (vfont->packedfile != NULL) {
+  if (vfont->packedfile != NULL && BKE_packedfile_data_ensure(vfont->packedfile)) {
     PackedFile *pf = vfont->packedfile;
     /* Create a name that's unique between library data-blocks to avoid loading
      * a font per strip which will load fonts many times. */
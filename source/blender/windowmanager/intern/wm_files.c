@@ -1914,7 +1914,8 @@ static void wm_autosave_write(Main *bmain, wmWindowManager *wm)
   const bool use_memfile = (U.uiflag & USER_GLOBALUNDO) != 0;
   MemFile *memfile = use_memfile ? ED_undosys_stack_memfile_get_active(wm->undo_stack) : NULL;
   if (memfile != NULL) {
-    BLO_memfile_write_file(memfile, filepath);
+    /* Only appends the IDs that changed since the last auto-save. */
+    BLO_write_memfile_incremental(memfile, filepath);
   }
   else {
     if (use_memfile) {
@@ -1923,7 +1924,8 @@ static void wm_autosave_write(Main *bmain, wmWindowManager *wm)
     }
 
     /* Save as regular blend file with recovery information. */
-    const int fileflags = (G.fileflags & ~G_FILE_COMPRESS) | G_FILE_RECOVER_WRITE;
+    const int fileflags = (G.fileflags & ~G_FILE_COMPRESS) | G_FILE_RECOVER_WRITE |
+                          G_FILE_SAVE_INCREMENTAL;
 
     ED_editors_flush_edits(bmain);
 
@@ -3070,6 +3072,9 @@ static int wm_save_as_mainfile_exec(bContext *C, wmOperator *op)
 
   /* set compression flag */
   SET_FLAG_FROM_TEST(fileflags, RNA_boolean_get(op->ptr, "compress"), G_FILE_COMPRESS);
+  SET_FLAG_FROM_TEST(fileflags, RNA_boolean_get(op->ptr, "deduplicate"), G_FILE_DEDUPLICATE);
+  SET_FLAG_FROM_TEST(
+      fileflags, RNA_boolean_get(op->ptr, "incremental"), G_FILE_SAVE_INCREMENTAL);
 
   const bool ok = wm_file_write(C, path, fileflags, remap_mode, use_save_as_copy, op->reports);
 
@@ -3150,6 +3155,20 @@ void WM_OT_save_as_mainfile(wmOperatorType *ot)
                                  FILE_DEFAULTDISPLAY,
                                  FILE_SORT_DEFAULT);
   RNA_def_boolean(ot->srna, "compress", false, "Compress", "Write compressed .blend file");
+  prop = RNA_def_boolean(ot->srna,
+                         "deduplicate",
+                         false,
+                         "Deduplicate",
+                         "Store identical data only once, "
+                         "the file can't be opened by versions without support for this");
+  RNA_def_property_flag(prop, PROP_SKIP_SAVE);
+  prop = RNA_def_boolean(ot->srna,
+                         "incremental",
+                         false,
+                         "Incremental",
+                         "When saving again to the same file, only append the data that changed, "
+                         "the file can't be opened by versions without support for this");
+  RNA_def_property_flag(prop, PROP_SKIP_SAVE);
   RNA_def_boolean(ot->srna,
                   "relative_remap",
                   true,
@@ -3220,6 +3239,20 @@ void WM_OT_save_mainfile(wmOperatorType *ot)
                                  FILE_DEFAULTDISPLAY,
                                  FILE_SORT_DEFAULT);
   RNA_def_boolean(ot->srna, "compress", false, "Compress", "Write compressed .blend file");
+  prop = RNA_def_boolean(ot->srna,
+                         "deduplicate",
+                         false,
+                         "Deduplicate",
+                         "Store identical data only once, "
+                         "the file can't be opened by versions without support for this");
+  RNA_def_property_flag(prop, PROP_SKIP_SAVE);
+  prop = RNA_def_boolean(ot->srna,
+                         "incremental",
+                         false,
+                         "Incremental",
+                         "When saving again to the same file, only append the data that changed, "
+                         "the file can't be opened by versions without support for this");
+  RNA_def_property_flag(prop, PROP_SKIP_SAVE);
   RNA_def_boolean(ot->srna,
                   "relative_remap",
                   false,
@@ -49,6 +49,7 @@
 #include "BLI_timer.h"
 #include "BLI_utildefines.h"
 
+#include "BLO_readfile.h"
 #include "BLO_undofile.h"
 #include "BLO_writefile.h"
 
@@ -642,6 +643,9 @@ void WM_exit_ex(bContext *C, const bool do_python)
 
   GHOST_DisposeSystemPaths();
 
+  BLO_sdna_cache_free();
+  BLO_write_incremental_free();
+  BLO_memfile_storage_exit();
   DNA_sdna_current_free();
 
   BLI_threadapi_exit();
@@ -40,10 +40,11 @@
 #  include "BLI_string.h"
 #  include "BLI_string_utf8.h"
 #  include "BLI_system.h"
+#  include "BLI_task.h"
 #  include "BLI_threads.h"
 #  include "BLI_utildefines.h"
 
-#  include "BLO_readfile.h" /* only for BLO_has_bfile_extension */
+#  include "BLO_readfile.h"
 
 #  include "BKE_blender_version.h"
 #  include "BKE_context.h"
@@ -602,6 +603,7 @@ static int arg_handle_print_help(int UNUSED(argc), const char **UNUSED(argv), vo
 
   printf("\n");
   BLI_args_print_arg_doc(ba, "--debug-fpe");
+  BLI_args_print_arg_doc(ba, "--debug-task-profile");
   BLI_args_print_arg_doc(ba, "--debug-exit-on-error");
   BLI_args_print_arg_doc(ba, "--disable-crash-handler");
   BLI_args_print_arg_doc(ba, "--disable-abort-handler");
@@ -614,6 +616,8 @@ static int arg_handle_print_help(int UNUSED(argc), const char **UNUSED(argv), vo
   BLI_args_print_arg_doc(ba, "--app-template");
   BLI_args_print_arg_doc(ba, "--factory-startup");
   BLI_args_print_arg_doc(ba, "--enable-event-simulate");
+  BLI_args_print_arg_doc(ba, "--lazy-packed-files");
+  BLI_args_print_arg_doc(ba, "--profile-blend-load");
   printf("\n");
   BLI_args_print_arg_doc(ba, "--env-system-datafiles");
   BLI_args_print_arg_doc(ba, "--env-system-scripts");
@@ -1145,6 +1149,33 @@ static int arg_handle_enable_event_simulate(int UNUSED(argc),
   return 0;
 }
 
+static const char arg_handle_lazy_packed_files_set_doc[] =
+    "\n\t"
+    "Leave the contents of large packed files in the blend-file until they are used.\n"
+    "\tOnly applies to uncompressed blend-files.";
+static int arg_handle_lazy_packed_files_set(int UNUSED(argc),
+                                            const char **UNUSED(argv),
+                                            void *UNUSED(data))
+{
+  G.fileflags |= G_FILE_LAZY_PACKED_READ;
+  return 0;
+}
+
+static const char arg_handle_profile_blend_load_set_doc[] =
+    "<filename>\n"
+    "\tTime the phases of loading blend-files and the reading of each ID type,\n"
+    "\tappending a JSON report per loaded file to <filename> ('-' for the standard output).";
+static int arg_handle_profile_blend_load_set(int argc, const char **argv, void *UNUSED(data))
+{
+  const char *arg_id = "--profile-blend-load";
+  if (argc > 1) {
+    BLO_read_profile_set(argv[1]);
+    return 1;
+  }
+  printf("\nError: '%s' no args given.\n", arg_id);
+  return 0;
+}
+
 static const char arg_handle_env_system_set_doc_datafiles[] =
     "\n\t"
     "Set the " STRINGIFY_ARG(BLENDER_SYSTEM_DATAFILES) " environment variable.";
@@ -1494,6 +1525,20 @@ static int arg_handle_threads_set(int argc, const char **argv, void *UNUSED(data
   return 0;
 }
 
+static const char arg_handle_debug_task_profile_set_doc[] =
+    "<filepath>\n"
+    "\tRecord the tasks run by the task scheduler and write them to <filepath> on exit,\n"
+    "\tin the Chrome trace event format. Statistics per call site and thread are printed as well.";
+static int arg_handle_debug_task_profile_set(int argc, const char **argv, void *UNUSED(data))
+{
+  if (argc > 1) {
+    BLI_task_profile_begin(argv[1]);
+    return 1;
+  }
+  printf("\nError: you must specify a filepath after '--debug-task-profile'.\n");
+  return 0;
+}
+
 static const char arg_handle_verbosity_set_doc[] =
     "<verbose>\n"
     "\tSet the logging verbosity level for debug messages that support it.";
@@ -2054,6 +2099,7 @@ void main_args_setup(bContext *C, bArgs *ba)
   BLI_args_add(ba, NULL, "--env-system-python", CB_EX(arg_handle_env_system_set, python), NULL);
 
   BLI_args_add(ba, "-t", "--threads", CB(arg_handle_threads_set), NULL);
+  BLI_args_add(ba, NULL, "--debug-task-profile", CB(arg_handle_debug_task_profile_set), NULL);
 
   /* Include in the environment pass so it's possible display errors initializing subsystems,
    * especially `bpy.appdir` since it's useful to show errors finding paths on startup. */
@@ -2214,6 +2260,8 @@ void main_args_setup(bContext *C, bArgs *ba)
   BLI_args_add(ba, NULL, "--app-template", CB(arg_handle_app_template), NULL);
   BLI_args_add(ba, NULL, "--factory-startup", CB(arg_handle_factory_startup_set), NULL);
   BLI_args_add(ba, NULL, "--enable-event-simulate", CB(arg_handle_enable_event_simulate), NULL);
+  BLI_args_add(ba, NULL, "--lazy-packed-files", CB(arg_handle_lazy_packed_files_set), NULL);
+  BLI_args_add(ba, NULL, "--profile-blend-load", CB(arg_handle_profile_blend_load_set), NULL);
 
   /* Pass: Custom Window Stuff. */
   BLI_args_pass_set(ba, ARG_PASS_SETTINGS_GUI);
@@ -0,0 +1,65 @@
+# Apache License, Version 2.0
+
+import api
+
+
+def _run(args):
+    import bpy
+    import os
+    import tempfile
+    import time
+
+    # Generate a file with many data-blocks, saved by the build being tested so it uses the
+    # fast path that skips versioning for files of the current version.
+    bpy.ops.wm.read_factory_settings(use_empty=True)
+    num_ids = args['num_ids']
+    collection = bpy.context.scene.collection
+    for i in range(num_ids // 4):
+        mesh = bpy.data.meshes.new(f"Mesh{i}")
+        ob = bpy.data.objects.new(f"Object{i}", mesh)
+        collection.objects.link(ob)
+        mesh.materials.append(bpy.data.materials.new(f"Material{i}"))
+        ob["prop"] = i
+        bpy.data.node_groups.new(f"NodeTree{i}", 'GeometryNodeTree')
+
+    with tempfile.TemporaryDirectory() as tmpdir:
+        filepath = os.path.join(tmpdir, "versioning.blend")
+        bpy.ops.wm.save_as_mainfile(filepath=filepath)
+
+        # Debug value 3201 forces running all versioning code.
+        bpy.app.debug_value = 3201 if args['full_versioning'] else 0
+
+        # Load once to ensure it's cached by OS
+        bpy.ops.wm.open_mainfile(filepath=filepath)
+        bpy.ops.wm.read_homefile(use_empty=True)
+
+        start_time = time.time()
+        bpy.ops.wm.open_mainfile(filepath=filepath)
+        elapsed_time = time.time() - start_time
+
+        bpy.app.debug_value = 0
+
+    result = {'time': elapsed_time}
+    return result
+
+
+class BlendLoadVersioningTest(api.Test):
+    def __init__(self, num_ids, full_versioning):
+        self.num_ids = num_ids
+        self.full_versioning = full_versioning
+
+    def name(self):
+        name = f"{self.num_ids // 1000}k_ids"
+        return name + ("_full_versioning" if self.full_versioning else "_current_version")
+
+    def category(self):
+        return "blend_load_versioning"
+
+    def run(self, env, device_id):
+        args = {'num_ids': self.num_ids, 'full_versioning': self.full_versioning}
+        result, _ = env.run_in_blender(_run, args)
+        return result
+
+
+def generate(env):
+    return [BlendLoadVersioningTest(100000, full_versioning) for full_versioning in (False, True)]